@@ -59,7 +59,6 @@
 #include "algorithm/argon2d/argon2d.h"
 #include "algorithm/mtp_algo.h"
 #include "algorithm/heavyhash-gate.h"
-#include "algorithm/keccak_tiny.h"
 
 #include "compat.h"
 
@@ -134,6 +133,43 @@ void gen_hash(const unsigned char *data, unsigned int len, unsigned char *hash)
   sph_sha256_close(&ctx_sha2, hash);
 }
 
+/* Both coinbase hashes in use start with a plain SHA-256 pass, so the part
+ * of the coinbase in front of nonce2 only needs hashing once per notify.
+ * Call with the pool's data_lock held for writing. */
+void coinbase_midstate(struct pool *pool)
+{
+  pool->swork.cb_midstate_valid = pool->algorithm.gen_hash == gen_hash ||
+                                  pool->algorithm.gen_hash == sha256;
+  if (!pool->swork.cb_midstate_valid)
+    return;
+
+  sph_sha256_init(&pool->swork.cb_midstate);
+  sph_sha256(&pool->swork.cb_midstate, pool->coinbase, pool->nonce2_offset);
+}
+
+/* Coinbase hash for the merkle root, with nonce2 already in pool->coinbase.
+ * Call with the pool's data_lock held. */
+void gen_coinbase_hash(struct pool *pool, unsigned char *hash)
+{
+  unsigned char hash1[32];
+  sph_sha256_context ctx;
+
+  if (!pool->swork.cb_midstate_valid) {
+    pool->algorithm.gen_hash(pool->coinbase, pool->swork.cb_len, hash);
+    return;
+  }
+
+  memcpy(&ctx, &pool->swork.cb_midstate, sizeof(ctx));
+  sph_sha256(&ctx, pool->coinbase + pool->nonce2_offset, pool->swork.cb_len - pool->nonce2_offset);
+  if (pool->algorithm.gen_hash == sha256) {
+    sph_sha256_close(&ctx, hash);
+    return;
+  }
+  sph_sha256_close(&ctx, hash1);
+  sph_sha256(&ctx, hash1, 32);
+  sph_sha256_close(&ctx, hash);
+}
+
 void sha256d_midstate(struct work *work)
 {
   unsigned char data[64];
@@ -2051,21 +2087,12 @@ static cl_int queue_heavyhash_kernel(_clState *clState, dev_blk_ctx *blk, __mayb
   flip80(clState->cldata, blk->work->data);
   status = clEnqueueWriteBuffer(clState->commandQueue, clState->CLbuffer0, true, 0, 80, clState->cldata, 0, NULL, NULL);
 
-    uint32_t edata[20];
     uint32_t seed[8];
 
     uint8_t matrix[64][64];
-    struct xoshiro_state state;
-
-    memcpy(edata, clState->cldata, 80);
 
-	kt_sha3_256((uint8_t *)seed, 32, (uint8_t *)(edata + 1), 32);
-
-    for (int i = 0; i < 4; ++i) {
-        state.s[i] = le64dec(seed + 2*i);
-    }
-
-    generate_matrix(matrix, &state);
+    heavyhash_seed(blk->work->data, seed);
+    heavyhash_get_matrix(&blk->work->pool->heavyhash_cache, seed, matrix);
 
     status = clEnqueueWriteBuffer(clState->commandQueue, clState->padbuffer8, true, 0, 64 * 64, matrix, 0, NULL, NULL);
 
@@ -2114,7 +2141,6 @@ static cl_int queue_ethash_kernel(_clState *clState, dev_blk_ctx *blk, __maybe_u
         int size = ++pool->eth_cache.nDevs;
         pool->eth_cache.dags = (eth_dag_t **) realloc(pool->eth_cache.dags, sizeof(void*) * size);
         pool->eth_cache.dags[size-1] = dag;
-        dag->pool = pool;
         cg_dwlock(&pool->data_lock);
       }
       dag->max_epoch = blk->work->eth_epoch + eth_future_epochs;
@@ -2132,9 +2158,17 @@ static cl_int queue_ethash_kernel(_clState *clState, dev_blk_ctx *blk, __maybe_u
       cg_dlock(&pool->data_lock);
 
     applog(LOG_DEBUG, "DAG being regenerated.");
-    cl_mem eth_cache = clCreateBuffer(clState->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR | CL_MEM_HOST_WRITE_ONLY, CacheSize, pool->eth_cache.dag_cache, &status);
+    /* Build from the shared cache of the work's epoch, which may no longer be the pool's */
+    eth_cache_entry_t *entry = eth_cache_get(blk->work->eth_epoch);
     cg_runlock(&pool->data_lock);
+    if (entry == NULL) {
+      cg_wunlock(&dag->lock);
+      applog(LOG_DEBUG, "THR[%d]: no ethash cache for epoch %u", blk->work->thr_id, blk->work->eth_epoch);
+      return 1;
+    }
+    cl_mem eth_cache = clCreateBuffer(clState->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR | CL_MEM_HOST_WRITE_ONLY, CacheSize, entry->cache, &status);
     if (status != CL_SUCCESS) {
+      eth_cache_release(entry);
       clReleaseMemObject(eth_cache);
       cg_wunlock(&dag->lock);
       applog(LOG_ERR, "Error %d: Creating the ethash cache buffer failed.", status);
@@ -2161,10 +2195,13 @@ static cl_int queue_ethash_kernel(_clState *clState, dev_blk_ctx *blk, __maybe_u
 
     clReleaseMemObject(eth_cache);
     if (status != CL_SUCCESS) {
+      eth_cache_release(entry);
       cg_wunlock(&dag->lock);
       applog(LOG_ERR, "Error %d: Setting args for the DAG kernel and/or executing it.", status);
       return status;
     }
+    eth_cache_release(dag->cache);
+    dag->cache = entry;
     dag->current_epoch = blk->work->eth_epoch;
     cg_dwlock(&dag->lock);
     applog(LOG_NOTICE, "GPU%d: new DAG created", blk->work->thr->cgpu->device_id);
@@ -2199,23 +2236,84 @@ static cl_int queue_ethash_kernel(_clState *clState, dev_blk_ctx *blk, __maybe_u
   return status;
 }
 
-void get_argon_block(cl_command_queue Queue, cl_mem block, cl_mem block2, uint8_t* clblock, uint32_t index)
+/* Read the 1 KiB argon blocks index[0..count-1] into dst[0..count-1]. The
+ * reads are all enqueued non-blocking and waited for once, so a batch costs
+ * a single round trip to the device. Blocks past the first 2M live in
+ * block2. */
+cl_int get_argon_blocks(cl_command_queue Queue, cl_mem block, cl_mem block2, uint8_t *const *dst, const uint32_t *index, int count)
 {
-	size_t TheSize = 128*sizeof(uint64_t);
-	size_t TheOffSet = 128*sizeof(uint64_t)*index;
-	size_t Shift = 2 * 1024 * 1024 * 128 * sizeof(uint64_t);
-	cl_int status;
-if (index < 2 * 1024 * 1024)
-	status = clEnqueueReadBuffer(Queue, block, CL_TRUE, TheOffSet, TheSize, clblock, 0, NULL, NULL);
-else 
-	status = clEnqueueReadBuffer(Queue, block2, CL_TRUE, TheOffSet-Shift, TheSize, clblock, 0, NULL, NULL);
+	const size_t TheSize = 128 * sizeof(uint64_t);
+	const uint32_t Split = 2 * 1024 * 1024;
+	cl_int status = CL_SUCCESS, ret = CL_SUCCESS;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (index[i] < Split)
+			status = clEnqueueReadBuffer(Queue, block, CL_FALSE, TheSize * index[i], TheSize, dst[i], 0, NULL, NULL);
+		else
+			status = clEnqueueReadBuffer(Queue, block2, CL_FALSE, TheSize * (index[i] - Split), TheSize, dst[i], 0, NULL, NULL);
+		if (status != CL_SUCCESS) {
+			applog(LOG_ERR, "Error %d reading argon block %u.", status, index[i]);
+			ret = status;
+			break;
+		}
+	}
+	/* wait even after an error: the reads already queued still land in dst */
+	status = clFinish(Queue);
 	if (status != CL_SUCCESS) {
-		applog(LOG_ERR, "reading %d with writing to CLbuffer0.", status);
+		applog(LOG_ERR, "Error %d waiting for argon block reads.", status);
+		ret = status;
 	}
+	return ret;
 }
 
 
 
+static void mtp_release_buffers(mtp_gpu_t *buffer)
+{
+	cl_mem *mems[] = { &buffer->hblock, &buffer->hblock2, &buffer->tree, &buffer->blockheader, &buffer->root };
+	size_t i;
+
+	for (i = 0; i < sizeof(mems) / sizeof(mems[0]); i++) {
+		if (*mems[i] != NULL) {
+			clReleaseMemObject(*mems[i]);
+			*mems[i] = NULL;
+		}
+	}
+	buffer->context = NULL;
+}
+
+/* Create the device's MTP buffers, about 4 GiB, once for all jobs */
+static cl_int mtp_create_buffers(_clState *clState, mtp_gpu_t *buffer)
+{
+	const size_t hbs_half = 2 * 1024 * 1024 * 128 * sizeof(uint64_t);
+	const struct {
+		cl_mem *mem;
+		size_t size;
+		const char *name;
+	} bufs[] = {
+		{ &buffer->hblock, hbs_half, "hblock" },
+		{ &buffer->hblock2, hbs_half, "hblock2" },
+		{ &buffer->tree, MTP_TREE_SIZE, "tree" },
+		{ &buffer->blockheader, 8 * sizeof(uint32_t), "blockheader" },
+		{ &buffer->root, 4 * sizeof(uint32_t), "root" },
+	};
+	cl_int status = CL_SUCCESS;
+	size_t i;
+
+	for (i = 0; i < sizeof(bufs) / sizeof(bufs[0]); i++) {
+		*bufs[i].mem = clCreateBuffer(clState->context, CL_MEM_READ_WRITE, bufs[i].size, NULL, &status);
+		if (status != CL_SUCCESS) {
+			*bufs[i].mem = NULL;
+			applog(LOG_ERR, "Error %d while creating the %s buffers.", status, bufs[i].name);
+			mtp_release_buffers(buffer);
+			return status;
+		}
+	}
+	buffer->context = clState->context;
+	return status;
+}
+
 static cl_int queue_mtp_kernel(_clState *clState, dev_blk_ctx *blk, __maybe_unused cl_uint threads)
 {
 	struct pool *pool = blk->work->pool;
@@ -2276,75 +2374,24 @@ static cl_int queue_mtp_kernel(_clState *clState, dev_blk_ctx *blk, __maybe_unus
 
 
 		////////////////////////////////////////////////
-		if (buffer->prev_job_id != NULL) {
-
-			//		free_memory(&mtp->context, (unsigned char *)mtp->instance.memory, mtp->instance.memory_argon_blocks, sizeof(argon_block));
-
-			free(mtp->instance.memory);
-			//			mtp->ordered_tree->Destructor();
-			call_MerkleTree_Destructor(mtp->ordered_tree);
-			free(mtp->dx);
-			//		delete  mtp->ordered_tree;
-			clReleaseMemObject(buffer->hblock);
-			clReleaseMemObject(buffer->hblock2);
-			clReleaseMemObject(buffer->tree);
-			clReleaseMemObject(buffer->blockheader);
-			clReleaseMemObject(buffer->root);
-
-		}
-
-
-
-		////////////
-		size_t hbs_half = 2 * 1024 * 1024 * 128 * sizeof(uint64_t);
-		uint32_t argon_memcost = 4 * 1024 * 1024;
-		size_t hbs = 4 * 1024 * 1024 * 128 * sizeof(uint64_t);
-		//			size_t hbs = 4244635648;
-		/*
-		buffer->hblock		= clCreateBuffer(clState->context, CL_MEM_READ_WRITE , hbs, NULL, &status);
-		if (status != CL_SUCCESS) {
-		buffer->hblock = NULL;
-		applog(LOG_ERR, "Error %d while creating the hblock buffers.", status);
-		return status;
+		// The buffers outlive jobs; only a new context (the device was
+		// re-initialized) makes them stale
+		if (buffer->hblock != NULL && buffer->context != clState->context)
+			mtp_release_buffers(buffer);
+		if (buffer->hblock == NULL) {
+			status = mtp_create_buffers(clState, buffer);
+			if (status != CL_SUCCESS)
+				return status;
 		}
-		*/
-		buffer->hblock = clCreateBuffer(clState->context, CL_MEM_READ_WRITE, hbs_half, NULL, &status);
-		if (status != CL_SUCCESS) {
-			buffer->hblock = NULL;
-			applog(LOG_ERR, "Error %d while creating the hblock buffers.", status);
-			return status;
-		}
-		buffer->hblock2 = clCreateBuffer(clState->context, CL_MEM_READ_WRITE, hbs_half, NULL, &status);
-		if (status != CL_SUCCESS) {
-			buffer->hblock = NULL;
-			applog(LOG_ERR, "Error %d while creating the hblock buffers.", status);
-			return status;
+		if (mtp->dx == NULL) {
+			mtp->dx = (uint8_t*)malloc(MTP_TREE_SIZE);
+			if (mtp->dx == NULL) {
+				applog(LOG_ERR, "Failed to allocate the MTP tree leaves.");
+				return CL_OUT_OF_HOST_MEMORY;
+			}
 		}
 
-		size_t ts = sizeof(uint64_t) * 2 * 1048576 * 4;
-		buffer->tree = clCreateBuffer(clState->context, CL_MEM_READ_WRITE, ts, NULL, &status);
-		if (status != CL_SUCCESS) {
-			buffer->tree = NULL;
-			applog(LOG_ERR, "Error %d while creating the tree buffers.", status);
-			return status;
-		}
-		size_t bs = 8 * sizeof(uint32_t);
-		buffer->blockheader = clCreateBuffer(clState->context, CL_MEM_READ_WRITE, bs, NULL, &status);
-		if (status != CL_SUCCESS) {
-			buffer->blockheader = NULL;
-			applog(LOG_ERR, "Error %d while creating the blockheader buffers.", status);
-			return status;
-		}
-		size_t rs = 4 * sizeof(uint32_t);
-		buffer->root = clCreateBuffer(clState->context, CL_MEM_READ_WRITE, rs, NULL, &status);
-		if (status != CL_SUCCESS) {
-			buffer->root = NULL;
-			applog(LOG_ERR, "Error %d while creating the root buffers.", status);
-			return status;
-		}
-
-
-		mtp->dx = (uint8_t*)malloc(MTP_TREE_SIZE);
+		uint32_t argon_memcost = 4 * 1024 * 1024;
 
 		mtp->context = init_mtp_argon2d_param((const char*)endiandata);
 		mtp_argon2_ctx_from_mtp(&mtp->context, &mtp->instance);
@@ -2499,7 +2546,10 @@ for (int i = 0; i<4; i++) {
 		clEnqueueReadBuffer(clState->commandQueue, buffer->tree, CL_TRUE, 0, mtp_tree_size, mtp->dx, 0, NULL, NULL);
 
 		//	mtp->ordered_tree = new MerkleTree(mtp->dx, true);
-		mtp->ordered_tree = call_new_MerkleTree(mtp->dx, true);
+		if (mtp->ordered_tree == NULL)
+			mtp->ordered_tree = call_new_MerkleTree(mtp->dx, true);
+		else
+			call_MerkleTree_rebuild(mtp->ordered_tree, mtp->dx);
 
 
 		buffer->prev_job_id = pool->swork.job_id;
@@ -2673,7 +2723,7 @@ static cl_int queue_lbry_kernel(struct __clState *clState, struct _dev_blk_ctx *
 static algorithm_settings_t algos[] = {
   // kernels starting from this will have difficulty calculated by using litecoin algorithm
 #define A_SCRYPT(a) \
-  { a, ALGO_SCRYPT, "", 1, 65536, 65536, 0, 0, 0xFF, 0xFFFFFFFFULL, 0x0000ffffUL, 0, -1, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, scrypt_regenhash, NULL, NULL, queue_scrypt_kernel, gen_hash, append_scrypt_compiler_options }
+  { a, ALGO_SCRYPT, "", 1, 65536, 65536, 0, 0, 0xFF, 0xFFFFFFFFULL, 0x0000ffffUL, 0, -1, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, scrypt_regenhash, NULL, NULL, queue_scrypt_kernel, gen_hash, append_scrypt_compiler_options, scrypt_regenhash_batch }
   A_SCRYPT("ckolivas"),
   A_SCRYPT("alexkarnew"),
   A_SCRYPT("alexkarnold"),
@@ -2753,32 +2803,32 @@ static algorithm_settings_t algos[] = {
 #undef A_QUARK
 
   // kernels starting from this will have difficulty calculated by using bitcoin algorithm
-#define A_DARK(a, b) \
-  { a, ALGO_X11, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 0, 0, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, b, NULL, NULL, queue_sph_kernel, gen_hash, append_x11_compiler_options }
-  A_DARK("darkcoin", darkcoin_regenhash),
-  A_DARK("sibcoin", sibcoin_regenhash),  
-  A_DARK("inkcoin", inkcoin_regenhash),
-  A_DARK("myriadcoin-groestl", myriadcoin_groestl_regenhash),
+#define A_DARK(a, b, c) \
+  { a, ALGO_X11, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 0, 0, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, b, NULL, NULL, queue_sph_kernel, gen_hash, append_x11_compiler_options, c }
+  A_DARK("darkcoin", darkcoin_regenhash, darkcoin_regenhash_batch),
+  A_DARK("sibcoin", sibcoin_regenhash, NULL),  
+  A_DARK("inkcoin", inkcoin_regenhash, NULL),
+  A_DARK("myriadcoin-groestl", myriadcoin_groestl_regenhash, NULL),
 #undef A_DARK
 
   { "twecoin", ALGO_TWE, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 0, 0, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, twecoin_regenhash, NULL, NULL, queue_sph_kernel, sha256, NULL },
   { "maxcoin", ALGO_KECCAK, "", 1, 256, 1, 4, 15, 0x0F, 0xFFFFULL, 0x000000ffUL, 0, 0, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, maxcoin_regenhash, NULL, NULL, queue_maxcoin_kernel, sha256, NULL },
 
-  { "darkcoin-mod", ALGO_X11, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 10, 8 * 16 * 4194304, 0, darkcoin_regenhash, NULL, NULL, queue_darkcoin_mod_kernel, gen_hash, append_x11_compiler_options },
+  { "darkcoin-mod", ALGO_X11, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 10, 8 * 16 * 4194304, 0, darkcoin_regenhash, NULL, NULL, queue_darkcoin_mod_kernel, gen_hash, append_x11_compiler_options, darkcoin_regenhash_batch },
   { "chainox", ALGO_0X10, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 10, 8 * 16 * 4194304, 0, chainox_regenhash, NULL, NULL, queue_chainox_kernel, gen_hash, append_x11_compiler_options },
   { "chainox_navi", ALGO_0X10_NAVI, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 10, 8 * 16 * 4194304, 0, chainox_regenhash, NULL, NULL, queue_chainox_navi_kernel, gen_hash, append_x11_compiler_options },
 
   { "sibcoin-mod", ALGO_X11, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 11, 2 * 16 * 4194304, 0, sibcoin_regenhash, NULL, NULL, queue_sibcoin_mod_kernel, gen_hash, append_x11_compiler_options },
   
-  { "marucoin", ALGO_X13, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 0, 0, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, marucoin_regenhash, NULL, NULL, queue_sph_kernel, gen_hash, append_x13_compiler_options },
-  { "marucoin-mod", ALGO_X13, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 12, 8 * 16 * 4194304, 0, marucoin_regenhash, NULL, NULL, queue_marucoin_mod_kernel, gen_hash, append_x13_compiler_options },
-  { "marucoin-modold", ALGO_X13, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 10, 8 * 16 * 4194304, 0, marucoin_regenhash, NULL, NULL, queue_marucoin_mod_old_kernel, gen_hash, append_x13_compiler_options },
+  { "marucoin", ALGO_X13, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 0, 0, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, marucoin_regenhash, NULL, NULL, queue_sph_kernel, gen_hash, append_x13_compiler_options, marucoin_regenhash_batch },
+  { "marucoin-mod", ALGO_X13, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 12, 8 * 16 * 4194304, 0, marucoin_regenhash, NULL, NULL, queue_marucoin_mod_kernel, gen_hash, append_x13_compiler_options, marucoin_regenhash_batch },
+  { "marucoin-modold", ALGO_X13, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 10, 8 * 16 * 4194304, 0, marucoin_regenhash, NULL, NULL, queue_marucoin_mod_old_kernel, gen_hash, append_x13_compiler_options, marucoin_regenhash_batch },
 
-  { "x14", ALGO_X14, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 13, 8 * 16 * 4194304, 0, x14_regenhash, NULL, NULL, queue_x14_kernel, gen_hash, append_x13_compiler_options },
-  { "x14old", ALGO_X14, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 10, 8 * 16 * 4194304, 0, x14_regenhash, NULL, NULL, queue_x14_old_kernel, gen_hash, append_x13_compiler_options },
+  { "x14", ALGO_X14, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 13, 8 * 16 * 4194304, 0, x14_regenhash, NULL, NULL, queue_x14_kernel, gen_hash, append_x13_compiler_options, x14_regenhash_batch },
+  { "x14old", ALGO_X14, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 10, 8 * 16 * 4194304, 0, x14_regenhash, NULL, NULL, queue_x14_old_kernel, gen_hash, append_x13_compiler_options, x14_regenhash_batch },
 
-  { "bitblock", ALGO_X15, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 14, 4 * 16 * 4194304, 0, bitblock_regenhash, NULL, NULL, queue_bitblock_kernel, gen_hash, append_x13_compiler_options },
-  { "bitblockold", ALGO_X15, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 10, 4 * 16 * 4194304, 0, bitblock_regenhash, NULL, NULL, queue_bitblockold_kernel, gen_hash, append_x13_compiler_options },
+  { "bitblock", ALGO_X15, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 14, 4 * 16 * 4194304, 0, bitblock_regenhash, NULL, NULL, queue_bitblock_kernel, gen_hash, append_x13_compiler_options, bitblock_regenhash_batch },
+  { "bitblockold", ALGO_X15, "", 1, 1, 1, 0, 0, 0xFF, 0xFFFFULL, 0x0000ffffUL, 10, 4 * 16 * 4194304, 0, bitblock_regenhash, NULL, NULL, queue_bitblockold_kernel, gen_hash, append_x13_compiler_options, bitblock_regenhash_batch },
 
   { "argon2d",ALGO_ARGON2D,"",1,65536,65536,0,0,0xFF,0xFFFFULL,0x0000ffffUL,2,-1, 0 ,argon2d_regenhash,NULL,NULL,queue_argon2d_kernel,gen_hash, NULL },
 
@@ -2864,6 +2914,7 @@ void copy_algorithm_settings(algorithm_t* dest, const char* algo)
       dest->queue_kernel = src->queue_kernel;
       dest->gen_hash = src->gen_hash;
       dest->set_compile_options = src->set_compile_options;
+      dest->regenhash_batch = src->regenhash_batch;
       break;
     }
   }
@@ -2876,6 +2927,15 @@ void copy_algorithm_settings(algorithm_t* dest, const char* algo)
   }
 }
 
+/* Returns the name of the n-th entry of the algorithm table, or NULL past the
+ * last one */
+const char *algorithm_name(unsigned int n)
+{
+  if (n >= sizeof(algos) / sizeof(algos[0]) - 1)
+    return NULL;
+  return algos[n].name;
+}
+
 static const char *lookup_algorithm_alias(const char *lookup_alias, uint8_t *nfactor)
 {
 #define ALGO_ALIAS_NF(alias, name, nf) \
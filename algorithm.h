@@ -72,6 +72,10 @@ extern const char *algorithm_type_str[];
 
 extern void gen_hash(const unsigned char *data, unsigned int len, unsigned char *hash);
 
+struct pool;
+extern void coinbase_midstate(struct pool *pool);
+extern void gen_coinbase_hash(struct pool *pool, unsigned char *hash);
+
 struct __clState;
 struct _dev_blk_ctx;
 struct _build_kernel_data;
@@ -104,6 +108,8 @@ typedef struct _algorithm_t {
   cl_int(*queue_kernel)(struct __clState *, struct _dev_blk_ctx *, cl_uint);
   void(*gen_hash)(const unsigned char *, unsigned int, unsigned char *);
   void(*set_compile_options)(struct _build_kernel_data *, struct cgpu_info *, struct _algorithm_t *);
+  /* Optional: regenhash for several nonces of one work at once */
+  void(*regenhash_batch)(struct work *, const uint32_t *, int, uint32_t (*)[8]);
 } algorithm_t;
 
 typedef struct _algorithm_settings_t
@@ -128,8 +134,15 @@ typedef struct _algorithm_settings_t
 	cl_int   (*queue_kernel)(struct __clState *, struct _dev_blk_ctx *, cl_uint);
 	void     (*gen_hash)(const unsigned char *, unsigned int, unsigned char *);
 	void     (*set_compile_options)(build_kernel_data *, struct cgpu_info *, algorithm_t *);
+	void     (*regenhash_batch)(struct work *, const uint32_t *, int, uint32_t (*)[8]);
 } algorithm_settings_t;
 
+/* Copy the settings of the named algorithm, without resolving aliases. */
+void copy_algorithm_settings(algorithm_t* dest, const char* algo);
+
+/* Name of the n-th known algorithm, NULL past the last one. */
+const char *algorithm_name(unsigned int n);
+
 /* Set default parameters based on name. */
 void set_algorithm(algorithm_t* algo, const char* name);
 
@@ -29,7 +29,9 @@
 
 #include "config.h"
 #include "miner.h"
+#include "findnonce.h"
 
+#include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -47,6 +49,8 @@
 #include "sph/sph_simd.h"
 #include "sph/sph_echo.h"
 
+#include "mb512.h"
+
 /* Move init out of loop, so init once externally, and then use one single memcpy with that bigger memory block */
 typedef struct {
     sph_blake512_context    blake1;
@@ -163,6 +167,19 @@ void darkcoin_regenhash(struct work *work)
         xhash(ohash, data);
 }
 
+/* darkcoin_regenhash() for several nonces of the same work. hashes[i] gets
+ * what work->hash would hold after regenerating with nonces[i]. */
+void darkcoin_regenhash_batch(struct work *work, const uint32_t *nonces, int count, uint32_t (*hashes)[8])
+{
+        uint32_t hash[MAXBUFFERS][16];
+        int i;
+
+        assert(count <= MAXBUFFERS);
+        mb512_x11_work(work, nonces, count, hash);
+        for (i = 0; i < count; i++)
+                memcpy(hashes[i], hash[i], 32);
+}
+
 bool scanhash_darkcoin(struct thr_info *thr, const unsigned char __maybe_unused *pmidstate,
 		     unsigned char *pdata, unsigned char __maybe_unused *phash1,
 		     unsigned char __maybe_unused *phash, const unsigned char *ptarget,
@@ -2,7 +2,7 @@
 
 #include "config.h"
 #include "algorithm/ethash.h"
-#include "algorithm/eth-sha3.h"
+#include "algorithm/keccakf.h"
 
 #define FNV_PRIME    0x01000193
 
@@ -31,7 +31,7 @@ uint32_t EthCalcEpochNumber(uint8_t *SeedHash)
   for(int Epoch = 0; Epoch < 2048; ++Epoch) {
     if (!memcmp(TestSeedHash, SeedHash, 32))
       return Epoch;
-    SHA3_256(TestSeedHash, TestSeedHash, 32);
+    keccak_256(TestSeedHash, TestSeedHash, 32);
   }
   
   applog(LOG_ERR, "Error on epoch calculation.");
@@ -45,7 +45,7 @@ Node CalcDAGItem(const Node *CacheInputNodes, uint32_t NodeCount, uint32_t NodeI
   
   DAGNode.words[0] ^= NodeIdx;
 
-  SHA3_512(DAGNode.bytes, DAGNode.bytes, sizeof(Node));
+  keccak_512(DAGNode.bytes, DAGNode.bytes, 64);
   
   for(uint32_t i = 0; i < 256; ++i) {
     uint32_t parent_index = fnv(NodeIdx ^ i, DAGNode.words[i % 16]) % NodeCount;
@@ -57,7 +57,7 @@ Node CalcDAGItem(const Node *CacheInputNodes, uint32_t NodeCount, uint32_t NodeI
     }
   }
 
-  SHA3_512(DAGNode.bytes, DAGNode.bytes, sizeof(Node));
+  keccak_512(DAGNode.bytes, DAGNode.bytes, 64);
   
   return DAGNode;
 }
@@ -78,7 +78,7 @@ void LightEthash(uint8_t *restrict OutHash, uint8_t *restrict MixHash, const uin
   // later for the final hash, and is therefore saved.
   memcpy(TmpBuf, HeaderPoWHash, 32UL);
   memcpy(TmpBuf + 8UL, &Nonce, 8UL);
-  sha3_512((uint8_t *)TmpBuf, 64UL, (uint8_t *)TmpBuf, 40UL);
+  keccak_512((uint8_t *)TmpBuf, (uint8_t *)TmpBuf, 40UL);
   
   memcpy(MixState, TmpBuf, 64UL);
   
@@ -113,18 +113,156 @@ void LightEthash(uint8_t *restrict OutHash, uint8_t *restrict MixHash, const uin
   
   // Hash the initial hash and the mix hash concatenated
   // to get the final proof-of-work hash that is our output.
-  sha3_256(OutHash, 32UL, (uint8_t *)TmpBuf, 96UL);
+  keccak_256(OutHash, (uint8_t *)TmpBuf, 96UL);
+}
+
+#define ETH_BATCH_LANES 4
+
+// Keccak-512 in place over Count nodes, through the multi-buffer engine
+static void KeccakNodes(Node *Nodes, uint32_t Count)
+{
+  uint8_t *io[ETH_BATCH_LANES * 2];
+  
+  for(uint32_t j = 0; j < Count; ++j)
+    io[j] = Nodes[j].bytes;
+  keccakf_hash_multi(io, 64, (const uint8_t * const *)io, 64, 72, KECCAK_PAD_KECCAK, Count);
+}
+
+// Same as CalcDAGItem() for Count independent items at once. Interleaving
+// them lets the parent lookups of one item overlap the cache misses of the
+// others instead of waiting on each one in turn.
+static void CalcDAGItems(Node *restrict Out, const Node *Cache, uint32_t NodeCount, const uint32_t *NodeIdx, uint32_t Count)
+{
+  for(uint32_t j = 0; j < Count; ++j) {
+    Out[j] = Cache[NodeIdx[j] % NodeCount];
+    Out[j].words[0] ^= NodeIdx[j];
+  }
+  
+  KeccakNodes(Out, Count);
+  
+  for(uint32_t i = 0; i < 256; ++i) {
+    for(uint32_t j = 0; j < Count; ++j) {
+      uint32_t parent_index = fnv(NodeIdx[j] ^ i, Out[j].words[i % 16]) % NodeCount;
+      Node const *parent = Cache + parent_index;
+      
+      for(int k = 0; k < 16; ++k) {
+        Out[j].words[k] *= FNV_PRIME;
+        Out[j].words[k] ^= parent->words[k];
+      }
+    }
+  }
+  
+  KeccakNodes(Out, Count);
+}
+
+// LightEthash() on up to ETH_BATCH_LANES nonces in lockstep
+static void LightEthashLanes(uint8_t (*OutHash)[32], uint8_t (*MixHash)[32], const uint8_t *HeaderPoWHash, const Node *Cache, const uint64_t EpochNumber, const uint64_t *Nonces, uint32_t Lanes)
+{
+  uint32_t MixState[ETH_BATCH_LANES][32], TmpBuf[ETH_BATCH_LANES][24];
+  uint32_t Init0[ETH_BATCH_LANES], MixValue[ETH_BATCH_LANES], Idx[ETH_BATCH_LANES * 2];
+  uint32_t NodeCount = EthGetCacheSize(EpochNumber) / sizeof(Node);
+  uint64_t DagSize = EthGetDAGSize(EpochNumber) / (sizeof(Node) << 1);
+  Node DAGSliceNodes[ETH_BATCH_LANES * 2];
+  uint8_t *io[ETH_BATCH_LANES], *out[ETH_BATCH_LANES];
+  
+  for(uint32_t l = 0; l < Lanes; ++l) {
+    memcpy(TmpBuf[l], HeaderPoWHash, 32UL);
+    memcpy(TmpBuf[l] + 8UL, Nonces + l, 8UL);
+    io[l] = (uint8_t *)TmpBuf[l];
+    out[l] = OutHash[l];
+  }
+  keccakf_hash_multi(io, 64, (const uint8_t * const *)io, 40, 72, KECCAK_PAD_KECCAK, Lanes);
+  
+  for(uint32_t l = 0; l < Lanes; ++l) {
+    memcpy(MixState[l], TmpBuf[l], 64UL);
+    memcpy(MixState[l] + 16UL, MixState[l], 64UL);
+    Init0[l] = MixValue[l] = MixState[l][0];
+  }
+  
+  for(uint32_t i = 0; i < 64; ++i) {
+    for(uint32_t l = 0; l < Lanes; ++l) {
+      uint32_t row = fnv(Init0[l] ^ i, MixValue[l]) % DagSize;
+      Idx[l << 1] = row << 1;
+      Idx[(l << 1) + 1] = (row << 1) + 1;
+    }
+    
+    CalcDAGItems(DAGSliceNodes, Cache, NodeCount, Idx, Lanes << 1);
+    
+    for(uint32_t l = 0; l < Lanes; ++l) {
+      DAG128 *DAGSlice = (DAG128 *)(DAGSliceNodes + (l << 1));
+      
+      for(uint32_t col = 0; col < 32; ++col)
+        MixState[l][col] = fnv(MixState[l][col], DAGSlice->Columns[col]);
+      MixValue[l] = MixState[l][(i + 1) & 0x1F];
+    }
+  }
+  
+  for(uint32_t l = 0; l < Lanes; ++l) {
+    for(int i = 0; i < 8; ++i)
+      TmpBuf[l][i + 16] = fnv_reduce(MixState[l] + (i << 2));
+    memcpy(MixHash[l], TmpBuf[l] + 16, 32UL);
+  }
+  keccakf_hash_multi(out, 32, (const uint8_t * const *)io, 96, 136, KECCAK_PAD_KECCAK, Lanes);
+}
+
+// Batched LightEthash(): Count nonces, results in OutHash[i] and MixHash[i]
+void LightEthashBatch(uint8_t (*OutHash)[32], uint8_t (*MixHash)[32], const uint8_t *HeaderPoWHash, const Node *Cache, const uint64_t EpochNumber, const uint64_t *Nonces, uint32_t Count)
+{
+  for(uint32_t i = 0; i < Count; i += ETH_BATCH_LANES) {
+    uint32_t Lanes = Count - i < ETH_BATCH_LANES ? Count - i : ETH_BATCH_LANES;
+    
+    LightEthashLanes(OutHash + i, MixHash + i, HeaderPoWHash, Cache, EpochNumber, Nonces + i, Lanes);
+  }
 }
 
 void ethash_regenhash(struct work *work)
 {
   uint8_t hash[32];
+  eth_cache_entry_t *entry;
+
   applog(LOG_DEBUG, "Regenhash: First qword of input: 0x%016llX.", work->Nonce);
-  cg_rlock(&work->pool->data_lock);
-  LightEthash(hash, work->mixhash, work->data, (Node *)work->pool->eth_cache.dag_cache, work->eth_epoch, work->Nonce);
+  /* The registry keeps the cache alive while we hold the reference, even if
+   * the pool has already rolled over to the next epoch. */
+  entry = eth_cache_get(work->eth_epoch);
+  if (entry == NULL) {
+    applog(LOG_DEBUG, "No ethash cache for epoch %u, cannot verify share.", work->eth_epoch);
+    memset(work->hash, 0xff, 32);
+    return;
+  }
+  LightEthash(hash, work->mixhash, work->data, (Node *)entry->cache, work->eth_epoch, work->Nonce);
+  eth_cache_release(entry);
   for (int i = 0; i < 32; i++)
     work->hash[i] = hash[31 - i];
-  cg_runlock(&work->pool->data_lock);
   
   applog(LOG_DEBUG, "Last ulong: 0x%016llX.", *((uint64_t *)(work->hash + 24)));
 }
+
+/* Verify several nonces of the same work in one go. hashes[i] receives the
+ * byte-reversed PoW hash (as ethash_regenhash() leaves in work->hash) and
+ * mixhashes[i] the mix hash of work->Nonce + nonces[i]. The cache reference
+ * is taken once for the whole batch. Returns false if the epoch's cache is
+ * gone, in which case nothing is written. */
+bool ethash_regenhash_batch(struct work *work, const uint32_t *nonces, int count, uint8_t (*hashes)[32], uint8_t (*mixhashes)[32])
+{
+  uint64_t full[ETH_BATCH_LANES];
+  uint8_t out[ETH_BATCH_LANES][32];
+  eth_cache_entry_t *entry;
+
+  entry = eth_cache_get(work->eth_epoch);
+  if (entry == NULL) {
+    applog(LOG_DEBUG, "No ethash cache for epoch %u, cannot verify shares.", work->eth_epoch);
+    return false;
+  }
+  for (int i = 0; i < count; i += ETH_BATCH_LANES) {
+    int lanes = count - i < ETH_BATCH_LANES ? count - i : ETH_BATCH_LANES;
+
+    for (int l = 0; l < lanes; l++)
+      full[l] = work->Nonce + nonces[i + l];
+    LightEthashBatch(out, mixhashes + i, work->data, (Node *)entry->cache, work->eth_epoch, full, lanes);
+    for (int l = 0; l < lanes; l++)
+      for (int j = 0; j < 32; j++)
+        hashes[i + l][j] = out[l][31 - j];
+  }
+  eth_cache_release(entry);
+  return true;
+}
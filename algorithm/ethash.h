@@ -753,9 +753,27 @@ static const uint64_t cache_sizes[2048] =
 #define EthGetCacheSize(EpochNum)	cache_sizes[EpochNum]
 #define EthGetDAGSize(EpochNum)		dag_sizes[EpochNum]
 
+/* Light cache shared by every pool mining the same epoch */
+typedef struct _eth_cache_entry_t {
+  uint8_t seed_hash[32];
+  uint32_t epoch;
+  uint8_t *cache;     /* read-only once ready */
+  size_t size;
+  int refs;
+  bool ready;
+  bool failed;
+  struct _eth_cache_entry_t *next;
+} eth_cache_entry_t;
+
 struct work;
+extern char *opt_eth_cache_dir;
+eth_cache_entry_t *eth_cache_acquire(uint32_t epoch, const uint8_t *seed_hash);
+eth_cache_entry_t *eth_cache_get(uint32_t epoch);
+void eth_cache_release(eth_cache_entry_t *entry);
+void eth_cache_prefetch(uint32_t epoch, const uint8_t *seed_hash);
 void eth_gen_cache(struct pool *);
 void ethash_regenhash(struct work *work);
+bool ethash_regenhash_batch(struct work *work, const uint32_t *nonces, int count, uint8_t (*hashes)[32], uint8_t (*mixhashes)[32]);
 uint32_t EthCalcEpochNumber(uint8_t *SeedHash);
 
 #endif		// __ETHASH_H
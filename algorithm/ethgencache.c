@@ -1,9 +1,21 @@
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <utime.h>
+#endif
 
 #include "miner.h"
 #include "sph/sph_keccak.h"
 #include "algorithm/ethash.h"
-#include "algorithm/eth-sha3.h"
+#include "algorithm/keccakf.h"
 
 typedef union node
 {
@@ -12,16 +24,21 @@ typedef union node
   uint64_t double_words[16 / 2];
 } node;
 
+/* Directory holding generated caches, NULL to always regenerate */
+char *opt_eth_cache_dir = NULL;
+
 // Output (cache_nodes) MUST have at least cache_size bytes
+// Both the initial fill and the RandMemoHash rounds chain every node on the
+// one before it, so this cannot be split across threads or hash lanes.
 static void EthGenerateCache(uint8_t *cache_nodes_in, const uint8_t *seedhash, uint64_t cache_size)
 {
   uint32_t const num_nodes = (uint32_t)(cache_size / sizeof(node));
   node *cache_nodes = (node *)cache_nodes_in;
-  
-  SHA3_512(cache_nodes[0].bytes, seedhash, 32);
-  
+
+  keccak_512(cache_nodes[0].bytes, seedhash, 32);
+
   for(uint32_t i = 1; i != num_nodes; ++i) {
-    SHA3_512(cache_nodes[i].bytes, cache_nodes[i - 1].bytes, 64);
+    keccak_512(cache_nodes[i].bytes, cache_nodes[i - 1].bytes, 64);
   }
 
   for(uint32_t j = 0; j < 3; j++) { // this one can be unrolled entirely, ETHASH_CACHE_ROUNDS is constant
@@ -32,15 +49,384 @@ static void EthGenerateCache(uint8_t *cache_nodes_in, const uint8_t *seedhash, u
       for(uint32_t w = 0; w != 16; ++w) { // this one can be unrolled entirely as well
         data.words[w] ^= cache_nodes[idx].words[w];
       }
-      
-      SHA3_512(cache_nodes[i].bytes, data.bytes, sizeof(data));
+
+      keccak_512(cache_nodes[i].bytes, data.bytes, 64);
+    }
+  }
+}
+
+/* On-disk layout: this header followed by the raw cache nodes, so the file
+ * can also be mapped directly. */
+#define ETH_CACHE_FILE_MAGIC "SGETHC01"
+
+struct eth_cache_file_hdr {
+  char magic[8];
+  uint32_t epoch;
+  uint32_t node_size;
+  uint64_t cache_size;
+  uint8_t seed_hash[32];
+};
+
+static void eth_cache_path(char *buf, size_t bufsiz, uint32_t epoch, const uint8_t *seed_hash)
+{
+  char *seed = bin2hex(seed_hash, 32);
+
+  snprintf(buf, bufsiz, "%s/ethash-%u-%.16s.cache", opt_eth_cache_dir, epoch, seed);
+  free(seed);
+}
+
+static bool eth_cache_load(uint8_t *cache, uint32_t epoch, const uint8_t *seed_hash, uint64_t cache_size)
+{
+  struct eth_cache_file_hdr hdr;
+  char path[PATH_MAX];
+  bool ret = false;
+  FILE *fp;
+
+  eth_cache_path(path, sizeof(path), epoch, seed_hash);
+  fp = fopen(path, "rb");
+  if (!fp)
+    return false;
+
+  if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+      memcmp(hdr.magic, ETH_CACHE_FILE_MAGIC, sizeof(hdr.magic)) ||
+      hdr.epoch != epoch || hdr.node_size != sizeof(node) ||
+      hdr.cache_size != cache_size || memcmp(hdr.seed_hash, seed_hash, 32)) {
+    applog(LOG_WARNING, "Ignoring mismatched ethash cache file %s", path);
+    goto out;
+  }
+  if (fread(cache, 1, cache_size, fp) != cache_size) {
+    applog(LOG_WARNING, "Ignoring truncated ethash cache file %s", path);
+    goto out;
+  }
+  ret = true;
+  applog(LOG_INFO, "Loaded ethash cache for epoch %u from %s", epoch, path);
+out:
+  fclose(fp);
+  // Mark the file as recently used so eth_cache_prune() keeps it
+  if (ret)
+    utime(path, NULL);
+  return ret;
+}
+
+/* Most cache files kept in the cache directory. Every ethash coin uses the
+ * same seed sequence, so a file cannot be tied to a coin and the directory
+ * keeps the most recently used files whatever their epoch. */
+#define ETH_CACHE_KEEP_FILES 8
+
+struct eth_cache_dirent {
+  char path[PATH_MAX];
+  time_t mtime;
+};
+
+/* Newest first */
+static int eth_cache_dirent_cmp(const void *a, const void *b)
+{
+  time_t ma = ((const struct eth_cache_dirent *)a)->mtime;
+  time_t mb = ((const struct eth_cache_dirent *)b)->mtime;
+
+  return ma < mb ? 1 : ma > mb ? -1 : 0;
+}
+
+/* Add name to the list if it is a cache file */
+static void eth_cache_list_file(struct eth_cache_dirent **list, int *count, int *alloc, const char *name)
+{
+  struct eth_cache_dirent *ent;
+  struct stat st;
+  size_t len = strlen(name);
+  unsigned int epoch;
+
+  if (len < 6 || strcmp(name + len - 6, ".cache") || sscanf(name, "ethash-%u-", &epoch) != 1)
+    return;
+  if (*count == *alloc) {
+    int n = *alloc ? *alloc * 2 : 16;
+    struct eth_cache_dirent *l = (struct eth_cache_dirent *)realloc(*list, n * sizeof(*l));
+
+    if (!l)
+      return;
+    *list = l;
+    *alloc = n;
+  }
+  ent = &(*list)[*count];
+  snprintf(ent->path, sizeof(ent->path), "%s/%s", opt_eth_cache_dir, name);
+  if (stat(ent->path, &st))
+    return;
+  ent->mtime = st.st_mtime;
+  (*count)++;
+}
+
+/* Drop the least recently used files beyond ETH_CACHE_KEEP_FILES. Loading a
+ * file refreshes its modification time, so caches another coin or instance
+ * is still on stay. */
+static void eth_cache_prune(void)
+{
+  struct eth_cache_dirent *list = NULL;
+  int i, count = 0, alloc = 0;
+#ifdef WIN32
+  WIN32_FIND_DATAA fd;
+  char pattern[PATH_MAX];
+  HANDLE find;
+
+  snprintf(pattern, sizeof(pattern), "%s/ethash-*.cache", opt_eth_cache_dir);
+  if ((find = FindFirstFileA(pattern, &fd)) == INVALID_HANDLE_VALUE)
+    return;
+  do {
+    eth_cache_list_file(&list, &count, &alloc, fd.cFileName);
+  } while (FindNextFileA(find, &fd));
+  FindClose(find);
+#else
+  struct dirent *de;
+  DIR *dir;
+
+  if (!(dir = opendir(opt_eth_cache_dir)))
+    return;
+  while ((de = readdir(dir)) != NULL)
+    eth_cache_list_file(&list, &count, &alloc, de->d_name);
+  closedir(dir);
+#endif
+
+  if (count > ETH_CACHE_KEEP_FILES) {
+    qsort(list, count, sizeof(*list), eth_cache_dirent_cmp);
+    for (i = ETH_CACHE_KEEP_FILES; i < count; i++) {
+      if (!unlink(list[i].path))
+        applog(LOG_DEBUG, "Removed least recently used ethash cache %s", list[i].path);
+    }
+  }
+  free(list);
+}
+
+/* Write to a temporary file and rename it into place, so concurrent
+ * sgminer instances never see a partial cache. */
+static void eth_cache_store(const uint8_t *cache, uint32_t epoch, const uint8_t *seed_hash, uint64_t cache_size)
+{
+  struct eth_cache_file_hdr hdr;
+  char path[PATH_MAX], tmp[PATH_MAX + 32];
+  FILE *fp;
+
+  eth_cache_path(path, sizeof(path), epoch, seed_hash);
+  snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+
+  fp = fopen(tmp, "wb");
+  if (!fp) {
+    applog(LOG_WARNING, "Unable to write ethash cache file %s", tmp);
+    return;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, ETH_CACHE_FILE_MAGIC, sizeof(hdr.magic));
+  hdr.epoch = epoch;
+  hdr.node_size = sizeof(node);
+  hdr.cache_size = cache_size;
+  memcpy(hdr.seed_hash, seed_hash, 32);
+
+  if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 || fwrite(cache, 1, cache_size, fp) != cache_size) {
+    applog(LOG_WARNING, "Unable to write ethash cache file %s", tmp);
+    fclose(fp);
+    unlink(tmp);
+    return;
+  }
+  if (fclose(fp) || rename(tmp, path)) {
+    unlink(tmp);
+    return;
+  }
+  applog(LOG_DEBUG, "Saved ethash cache for epoch %u to %s", epoch, path);
+  eth_cache_prune();
+}
+
+/* Light caches are shared by every pool on the same seed hash. Entries are
+ * refcounted and read-only once ready; an entry nobody references is kept
+ * while a referenced entry is within one epoch of it, so shares from the
+ * previous epoch can still be verified and a prefetched next epoch survives
+ * until the pools roll over to it. */
+static eth_cache_entry_t *eth_caches;
+static pthread_mutex_t eth_caches_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t eth_caches_cond = PTHREAD_COND_INITIALIZER;
+
+static bool eth_cache_in_use_near(uint32_t epoch)
+{
+  eth_cache_entry_t *entry;
+
+  for (entry = eth_caches; entry; entry = entry->next) {
+    if (entry->refs > 0 && entry->epoch + 1 >= epoch && entry->epoch <= epoch + 1)
+      return true;
+  }
+  return false;
+}
+
+/* Called with eth_caches_lock held */
+static void eth_cache_prune_unused(void)
+{
+  eth_cache_entry_t **pentry = &eth_caches, *entry;
+
+  while ((entry = *pentry) != NULL) {
+    if (entry->refs == 0 && (entry->failed || !eth_cache_in_use_near(entry->epoch))) {
+      *pentry = entry->next;
+      applog(LOG_DEBUG, "Freeing ethash cache for epoch %u", entry->epoch);
+      free(entry->cache);
+      free(entry);
+    }
+    else
+      pentry = &entry->next;
+  }
+}
+
+static void eth_cache_fill(eth_cache_entry_t *entry)
+{
+  if (opt_eth_cache_dir && eth_cache_load(entry->cache, entry->epoch, entry->seed_hash, entry->size))
+    return;
+
+  EthGenerateCache(entry->cache, entry->seed_hash, entry->size);
+
+  if (opt_eth_cache_dir)
+    eth_cache_store(entry->cache, entry->epoch, entry->seed_hash, entry->size);
+}
+
+/* Returns a reference to the cache for seed_hash, generating it if no other
+ * thread has done so yet, or NULL if it could not be allocated. */
+eth_cache_entry_t *eth_cache_acquire(uint32_t epoch, const uint8_t *seed_hash)
+{
+  eth_cache_entry_t *entry;
+
+  mutex_lock(&eth_caches_lock);
+  for (entry = eth_caches; entry; entry = entry->next) {
+    if (!entry->failed && !memcmp(entry->seed_hash, seed_hash, 32))
+      break;
+  }
+
+  if (entry) {
+    entry->refs++;
+    while (!entry->ready && !entry->failed)
+      pthread_cond_wait(&eth_caches_cond, &eth_caches_lock);
+    if (entry->failed) {
+      entry->refs--;
+      eth_cache_prune_unused();
+      entry = NULL;
+    }
+    mutex_unlock(&eth_caches_lock);
+    return entry;
+  }
+
+  entry = (eth_cache_entry_t *)calloc(1, sizeof(*entry));
+  if (unlikely(!entry)) {
+    mutex_unlock(&eth_caches_lock);
+    return NULL;
+  }
+  memcpy(entry->seed_hash, seed_hash, 32);
+  entry->epoch = epoch;
+  entry->size = EthGetCacheSize(epoch);
+  entry->refs = 1;
+  entry->next = eth_caches;
+  eth_caches = entry;
+  mutex_unlock(&eth_caches_lock);
+
+  /* Generate without the registry lock so other epochs stay available */
+  entry->cache = (uint8_t *)malloc(entry->size);
+  if (entry->cache)
+    eth_cache_fill(entry);
+
+  mutex_lock(&eth_caches_lock);
+  if (entry->cache)
+    entry->ready = true;
+  else {
+    applog(LOG_ERR, "Failed to allocate %lu bytes for the ethash cache of epoch %u",
+           (unsigned long)entry->size, epoch);
+    entry->failed = true;
+    entry->refs--;
+    eth_cache_prune_unused();
+    entry = NULL;
+  }
+  pthread_cond_broadcast(&eth_caches_cond);
+  mutex_unlock(&eth_caches_lock);
+
+  return entry;
+}
+
+/* Returns a new reference to a ready cache for epoch, or NULL if the
+ * registry does not hold one. Never generates. */
+eth_cache_entry_t *eth_cache_get(uint32_t epoch)
+{
+  eth_cache_entry_t *entry;
+
+  mutex_lock(&eth_caches_lock);
+  for (entry = eth_caches; entry; entry = entry->next) {
+    if (entry->ready && entry->epoch == epoch) {
+      entry->refs++;
+      break;
     }
-  }  
+  }
+  mutex_unlock(&eth_caches_lock);
+  return entry;
+}
+
+void eth_cache_release(eth_cache_entry_t *entry)
+{
+  if (!entry)
+    return;
+  mutex_lock(&eth_caches_lock);
+  entry->refs--;
+  eth_cache_prune_unused();
+  mutex_unlock(&eth_caches_lock);
+}
+
+struct eth_prefetch_arg {
+  uint32_t epoch;
+  uint8_t seed_hash[32];
+};
+
+static void *eth_prefetch_thread(void *userdata)
+{
+  struct eth_prefetch_arg *arg = (struct eth_prefetch_arg *)userdata;
+  eth_cache_entry_t *entry;
+
+  pthread_detach(pthread_self());
+  RenameThread("EthPrefetch");
+
+  applog(LOG_DEBUG, "Prefetching ethash cache for epoch %u", arg->epoch);
+  entry = eth_cache_acquire(arg->epoch, arg->seed_hash);
+  eth_cache_release(entry);
+  free(arg);
+  return NULL;
 }
 
+/* Starts generating the cache of the epoch after this one in the background,
+ * so the rollover only has to take a reference to it. */
+void eth_cache_prefetch(uint32_t epoch, const uint8_t *seed_hash)
+{
+  struct eth_prefetch_arg *arg;
+  eth_cache_entry_t *entry;
+  pthread_t thr;
 
+  if (epoch + 1 >= sizeof(cache_sizes) / sizeof(cache_sizes[0]))
+    return;
+
+  arg = (struct eth_prefetch_arg *)malloc(sizeof(*arg));
+  if (unlikely(!arg))
+    return;
+  arg->epoch = epoch + 1;
+  keccak_256(arg->seed_hash, seed_hash, 32);
+
+  mutex_lock(&eth_caches_lock);
+  for (entry = eth_caches; entry; entry = entry->next) {
+    if (!entry->failed && !memcmp(entry->seed_hash, arg->seed_hash, 32))
+      break;
+  }
+  mutex_unlock(&eth_caches_lock);
+
+  if (entry || unlikely(pthread_create(&thr, NULL, eth_prefetch_thread, arg)))
+    free(arg);
+}
+
+/* Points the pool at the shared cache for its current seed hash. */
 void eth_gen_cache(struct pool *pool) {
-  size_t cache_size = EthGetCacheSize(pool->eth_cache.current_epoch);
-  pool->eth_cache.dag_cache = (uint8_t *) realloc(pool->eth_cache.dag_cache, cache_size);
-  EthGenerateCache(pool->eth_cache.dag_cache, pool->eth_cache.seed_hash, cache_size);
+  eth_cache_entry_t *entry, *old = pool->eth_cache.entry;
+
+  if (old && !memcmp(old->seed_hash, pool->eth_cache.seed_hash, 32))
+    return;
+
+  entry = eth_cache_acquire(pool->eth_cache.current_epoch, pool->eth_cache.seed_hash);
+  pool->eth_cache.entry = entry;
+  pool->eth_cache.dag_cache = entry ? entry->cache : NULL;
+  eth_cache_release(old);
+
+  if (entry)
+    eth_cache_prefetch(entry->epoch, entry->seed_hash);
 }
@@ -3,7 +3,7 @@
 #include "miner.h"
 
 #include "heavyhash-gate.h"
-#include "keccak_tiny.h"
+#include "keccakf.h"
 
 #include <inttypes.h>
 #include <string.h>
@@ -11,6 +11,10 @@
 #include <math.h>
 #include <stdbool.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define bswap_32(x) ((((x) << 24) & 0xff000000u) | (((x) << 8) & 0x00ff0000u) \
 	| (((x) >> 8) & 0x0000ff00u) | (((x) >> 24) & 0x000000ffu))
 
@@ -131,13 +135,33 @@ void heavyhash(const uint8_t matrix[64][64], uint8_t* pdata, size_t pdata_len, u
     uint16_t vector[64] __attribute__((aligned(64)));
     uint16_t product[64] __attribute__((aligned(64)));
 
-    kt_sha3_256((uint8_t*) hash_first, 32, pdata, pdata_len);
+    sha3_256((uint8_t*) hash_first, pdata, pdata_len);
 
     for (int i = 0; i < 32; ++i) {
         vector[2*i] = (hash_first[i] >> 4);
         vector[2*i+1] = hash_first[i] & 0xF;
     }
 
+#ifdef __SSE2__
+    /* Both operands are nibbles, so every row sum fits in 16 bits and the
+     * widening multiply-add gives the same result as the scalar loop. */
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v[8];
+    for (int j = 0; j < 8; ++j)
+        v[j] = _mm_load_si128((const __m128i *)(vector + 8*j));
+
+    for (int i = 0; i < 64; ++i) {
+        __m128i acc = zero;
+        for (int j = 0; j < 4; ++j) {
+            __m128i m = _mm_loadu_si128((const __m128i *)(matrix[i] + 16*j));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(m, zero), v[2*j]));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(m, zero), v[2*j+1]));
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        product[i] = (uint16_t)(_mm_cvtsi128_si32(acc) >> 10);
+    }
+#else
     for (int i = 0; i < 64; ++i) {
         uint16_t sum = 0;
         for (int j = 0; j < 64; ++j) {
@@ -145,6 +169,7 @@ void heavyhash(const uint8_t matrix[64][64], uint8_t* pdata, size_t pdata_len, u
         }
         product[i] = (sum >> 10);
     }
+#endif
 
     for (int i = 0; i < 32; ++i) {
         hash_second[i] = (product[2*i] << 4) | (product[2*i+1]);
@@ -153,10 +178,99 @@ void heavyhash(const uint8_t matrix[64][64], uint8_t* pdata, size_t pdata_len, u
     for (int i = 0; i < 32; ++i) {
         hash_xored[i] = hash_first[i] ^ hash_second[i];
     }
-    kt_sha3_256(output, 32, hash_xored, 32);
+    sha3_256(output, hash_xored, 32);
+}
+
+/* The matrix only depends on the prevhash, so it is generated once per
+ * block and kept in the pool's heavyhash_cache.  Readers copy it out and
+ * then check the sequence counter did not move; a single writer claims the
+ * slot by making the counter odd, and anyone losing that race just uses
+ * the matrix it generated itself. */
+void heavyhash_seed(const unsigned char *pdata, uint32_t seed[8])
+{
+    uint32_t prevhash[8];
+
+    be32enc_vect(prevhash, (const uint32_t *)pdata + 1, 8);
+    sha3_256((uint8_t *)seed, (uint8_t *)prevhash, 32);
+}
+
+static bool heavyhash_cache_read(heavyhash_cache_t *cache, const uint32_t seed[8],
+                                 uint8_t matrix[64][64])
+{
+    uint32_t seq = __atomic_load_n(&cache->seq, __ATOMIC_ACQUIRE);
+
+    if (seq & 1)
+        return false;
+    if (!cache->valid || memcmp(cache->seed, seed, 32))
+        return false;
+    memcpy(matrix, cache->matrix, 64 * 64);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&cache->seq, __ATOMIC_RELAXED) == seq;
+}
+
+static void heavyhash_cache_store(heavyhash_cache_t *cache, const uint32_t prevhash[8],
+                                  const uint32_t seed[8], const uint8_t matrix[64][64])
+{
+    uint32_t seq = __atomic_load_n(&cache->seq, __ATOMIC_RELAXED);
+
+    if ((seq & 1) || !__atomic_compare_exchange_n(&cache->seq, &seq, seq + 1, false,
+                                                  __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return;
+    if (prevhash)
+        memcpy(cache->prevhash, prevhash, 32);
+    memcpy(cache->seed, seed, 32);
+    memcpy(cache->matrix, matrix, 64 * 64);
+    cache->valid = true;
+    __atomic_store_n(&cache->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void heavyhash_get_matrix(heavyhash_cache_t *cache, const uint32_t seed[8], uint8_t matrix[64][64])
+{
+    struct xoshiro_state state;
+
+    if (cache && heavyhash_cache_read(cache, seed, matrix))
+        return;
+
+    for (int i = 0; i < 4; ++i) {
+        state.s[i] = le64dec(seed + 2*i);
+    }
+
+    generate_matrix(matrix, &state);
+
+    if (cache)
+        heavyhash_cache_store(cache, NULL, seed, matrix);
+}
+
+/* Called for every new stratum work item; regenerates the cached matrix
+ * only when the prevhash has changed. */
+void heavyhash_cache_update(struct pool *pool, const unsigned char *pdata)
+{
+    heavyhash_cache_t *cache = &pool->heavyhash_cache;
+    const uint32_t *prevhash = (const uint32_t *)pdata + 1;
+    uint8_t matrix[64][64];
+    struct xoshiro_state state;
+    uint32_t seed[8];
+    uint32_t seq;
+    bool same;
+
+    seq = __atomic_load_n(&cache->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1)
+        return;
+    same = cache->valid && !memcmp(cache->prevhash, prevhash, 32);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (same && __atomic_load_n(&cache->seq, __ATOMIC_RELAXED) == seq)
+        return;
+
+    heavyhash_seed(pdata, seed);
+    for (int i = 0; i < 4; ++i) {
+        state.s[i] = le64dec(seed + 2*i);
+    }
+    generate_matrix(matrix, &state);
+    heavyhash_cache_store(cache, prevhash, seed, matrix);
 }
 
 static const uint32_t diff1targ = 0x0000ffff;
+static heavyhash_cache_t test_cache;
 
 int heavyhash_test(unsigned char *pdata, const unsigned char *ptarget, uint32_t nonce)
 {
@@ -168,15 +282,9 @@ int heavyhash_test(unsigned char *pdata, const unsigned char *ptarget, uint32_t
     uint32_t seed[8];
 
     uint8_t matrix[64][64];
-    struct xoshiro_state state;
 
-    kt_sha3_256((uint8_t *)seed, 32, (uint8_t *)(data+1), 32);
-
-    for (int i = 0; i < 4; ++i) {
-        state.s[i] = le64dec(seed + 2*i);
-    }
-
-    generate_matrix(matrix, &state);
+    heavyhash_seed(pdata, seed);
+    heavyhash_get_matrix(&test_cache, seed, matrix);
 
     data[19] = htobe32(nonce);
 	heavyhash(matrix, (uint8_t *)data, 80, (uint8_t *)ohash);
@@ -201,15 +309,9 @@ void heavyhash_regenhash(struct work *work)
     uint32_t seed[8];
 
     uint8_t matrix[64][64];
-    struct xoshiro_state state;
 
-    kt_sha3_256((uint8_t *)seed, 32, (uint8_t*) (data+1), 32);
-
-    for (int i = 0; i < 4; ++i) {
-        state.s[i] = le64dec(seed + 2*i);
-    }
-
-    generate_matrix(matrix, &state);
+    heavyhash_seed(work->data, seed);
+    heavyhash_get_matrix(work->pool ? &work->pool->heavyhash_cache : NULL, seed, matrix);
 
     data[19] = htobe32(*nonce);
 	heavyhash(matrix, (uint8_t *)data, 80, (uint8_t *)ohash);
@@ -233,7 +335,7 @@ bool scanhash_heavyhash(struct thr_info *thr, const unsigned char *pmidstate,
 
     mm128_bswap32_80( edata, pdata );
 
-    kt_sha3_256((uint8_t *) seed, 32, (uint8_t *) (edata+1), 32);
+    sha3_256((uint8_t *) seed, (uint8_t *) (edata+1), 32);
 
     for (int i = 0; i < 4; ++i) {
         state.s[i] = le64dec(seed + 2*i);
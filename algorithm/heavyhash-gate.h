@@ -9,6 +9,10 @@ struct xoshiro_state {
 
 extern uint64_t le64dec(const void *pp);
 extern void generate_matrix(uint8_t matrix[64][64], struct xoshiro_state *state);
+extern void heavyhash_seed(const unsigned char *pdata, uint32_t seed[8]);
+extern void heavyhash_get_matrix(heavyhash_cache_t *cache, const uint32_t seed[8],
+			uint8_t matrix[64][64]);
+extern void heavyhash_cache_update(struct pool *pool, const unsigned char *pdata);
 extern int heavyhash_test(unsigned char *pdata, const unsigned char *ptarget,
 			uint32_t nonce);
 extern void heavyhash_regenhash(struct work *work);
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2013-2014 sgminer developers (see AUTHORS.md)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.  See COPYING for more details.
+ */
+
+/*
+ * Keccak sponge shared by every CPU side Keccak and SHA-3 user (ethash,
+ * heavyhash, maxcoin and the mb512 chain).
+ *
+ * The sponge is written once in keccakf_lanes.h. Its one lane instance
+ * runs on sph_keccak_f1600(), the permutation sph's Keccak contexts use;
+ * on x86 it is also instantiated over GCC vector types at 4 lanes (AVX2)
+ * and 8 lanes (AVX-512F), which hash that many messages in the time of
+ * about one or two scalar ones. Batches go through the widest backend
+ * the CPU supports.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sph/sph_keccak.h"
+#include "sph/sph_types.h"
+
+#include "keccakf.h"
+
+#define KF_LANES 1
+#define KF_NAME(x) x ## _1
+#define KF_ATTR
+#define KF_LABEL "scalar"
+#define KF_PERMUTE(a) sph_keccak_f1600((sph_u64 *)(a))
+#include "keccakf_lanes.h"
+#undef KF_LANES
+#undef KF_NAME
+#undef KF_ATTR
+#undef KF_LABEL
+#undef KF_PERMUTE
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KECCAKF_X86 1
+
+static const uint64_t keccakf_rc[24] = {
+  0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808AULL, 0x8000000080008000ULL,
+  0x000000000000808BULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+  0x000000000000008AULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000AULL,
+  0x000000008000808BULL, 0x800000000000008BULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+  0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800AULL, 0x800000008000000AULL,
+  0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+static const uint8_t keccakf_rotc[24] = {
+  1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44
+};
+
+static const uint8_t keccakf_piln[24] = {
+  10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1
+};
+
+#define KF_LANES 4
+#define KF_NAME(x) x ## _4
+#define KF_ATTR __attribute__((target("avx2")))
+#define KF_LABEL "avx2"
+#define KF_PERMUTE(a) KF_NAME(permute)(a)
+#include "keccakf_lanes.h"
+#undef KF_LANES
+#undef KF_NAME
+#undef KF_ATTR
+#undef KF_LABEL
+#undef KF_PERMUTE
+
+#define KF_LANES 8
+#define KF_NAME(x) x ## _8
+#define KF_ATTR __attribute__((target("avx512f")))
+#define KF_LABEL "avx512"
+#define KF_PERMUTE(a) KF_NAME(permute)(a)
+#include "keccakf_lanes.h"
+#undef KF_LANES
+#undef KF_NAME
+#undef KF_ATTR
+#undef KF_LABEL
+#undef KF_PERMUTE
+#endif
+
+const keccakf_backend *keccakf_backend_get(int n)
+{
+  const keccakf_backend *supported[3];
+  int count = 0;
+
+#ifdef KECCAKF_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    supported[count++] = &keccakf_8;
+  if (__builtin_cpu_supports("avx2"))
+    supported[count++] = &keccakf_4;
+#endif
+  supported[count++] = &keccakf_1;
+
+  return n >= 0 && n < count ? supported[n] : NULL;
+}
+
+void keccakf_hash(uint8_t *out, size_t outlen, const uint8_t *in, size_t inlen, size_t rate, uint8_t pad)
+{
+  sponge_1(&out, outlen, &in, inlen, rate, pad);
+}
+
+void keccakf_hash_multi(uint8_t *const *out, size_t outlen, const uint8_t *const *in, size_t inlen,
+                        size_t rate, uint8_t pad, int count)
+{
+  const keccakf_backend *kb;
+  int n = 0, done = 0;
+
+  while (done < count) {
+    kb = keccakf_backend_get(n);
+    /* the scalar backend, last, takes any remainder */
+    if (count - done < kb->lanes) {
+      n++;
+      continue;
+    }
+    kb->sponge(out + done, outlen, in + done, inlen, rate, pad);
+    done += kb->lanes;
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef KECCAKF_H
+#define KECCAKF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Domain padding byte of the original Keccak submission (ethash, maxcoin,
+ * the sph contexts) and of FIPS 202 SHA-3 (heavyhash) */
+#define KECCAK_PAD_KECCAK 0x01
+#define KECCAK_PAD_SHA3   0x06
+
+/* Most messages any backend hashes at once */
+#define KECCAKF_MAX_LANES 8
+
+/* A Keccak-f[1600] sponge over `lanes` messages of inlen bytes each, with
+ * outlen bytes of output per message. rate is the sponge rate in bytes, a
+ * multiple of 8 below 200, and pad the domain padding byte. All the input
+ * is absorbed before any output is written, so out[l] may alias in[l]. */
+typedef struct {
+  const char *name;
+  int lanes;
+  void (*sponge)(uint8_t *const *out, size_t outlen, const uint8_t *const *in, size_t inlen,
+                 size_t rate, uint8_t pad);
+} keccakf_backend;
+
+/* n-th backend this CPU can run, widest first; NULL past the last one,
+ * which is always the one lane scalar code */
+extern const keccakf_backend *keccakf_backend_get(int n);
+
+/* One message through the scalar backend */
+extern void keccakf_hash(uint8_t *out, size_t outlen, const uint8_t *in, size_t inlen,
+                         size_t rate, uint8_t pad);
+
+/* count messages of the same length, each group of them through the
+ * widest backend it fills */
+extern void keccakf_hash_multi(uint8_t *const *out, size_t outlen, const uint8_t *const *in,
+                               size_t inlen, size_t rate, uint8_t pad, int count);
+
+/* The fixed size hashes, whose rate is 200 bytes less twice the digest */
+static inline void keccak_256(uint8_t *out, const uint8_t *in, size_t len)
+{
+  keccakf_hash(out, 32, in, len, 136, KECCAK_PAD_KECCAK);
+}
+
+static inline void keccak_512(uint8_t *out, const uint8_t *in, size_t len)
+{
+  keccakf_hash(out, 64, in, len, 72, KECCAK_PAD_KECCAK);
+}
+
+static inline void sha3_256(uint8_t *out, const uint8_t *in, size_t len)
+{
+  keccakf_hash(out, 32, in, len, 136, KECCAK_PAD_SHA3);
+}
+
+#endif /* KECCAKF_H */
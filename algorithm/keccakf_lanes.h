@@ -0,0 +1,122 @@
+/*
+ * Lane-parallel Keccak sponge.
+ *
+ * Included by keccakf.c once per backend, with KF_LANES (messages per
+ * call), KF_NAME(x) (suffixes the width onto every symbol), KF_ATTR
+ * (function attributes, e.g. the target ISA), KF_LABEL (backend name) and
+ * KF_PERMUTE(a) (Keccak-f[1600] on a[25]) defined. Lane l of every state
+ * word holds the state of message l; with one lane the words are plain
+ * integers, so that instance builds without vector extensions.
+ */
+
+#if KF_LANES > 1
+typedef uint64_t KF_NAME(v64) __attribute__((vector_size(8 * KF_LANES)));
+#define KF_LANE(v, l)  ((v)[l])
+#else
+typedef uint64_t KF_NAME(v64);
+#define KF_LANE(v, l)  (v)
+#endif
+
+#define V64 KF_NAME(v64)
+
+#if KF_LANES > 1
+
+#define ROTL64(x, n)  (((x) << (n)) | ((x) >> (64 - (n))))
+
+/* Full unrolling turns the index tables into register names */
+#define KF_UNROLL     _Pragma("GCC unroll 32")
+
+KF_ATTR static void KF_NAME(permute)(V64 *a)
+{
+  V64 c[5], d, t;
+  int i, j, r;
+
+  for (r = 0; r < 24; r++) {
+    KF_UNROLL
+    for (i = 0; i < 5; i++)
+      c[i] = a[i] ^ a[i + 5] ^ a[i + 10] ^ a[i + 15] ^ a[i + 20];
+    KF_UNROLL
+    for (i = 0; i < 5; i++) {
+      d = c[(i + 4) % 5] ^ ROTL64(c[(i + 1) % 5], 1);
+      KF_UNROLL
+      for (j = 0; j < 25; j += 5)
+        a[j + i] ^= d;
+    }
+
+    t = a[1];
+    KF_UNROLL
+    for (i = 0; i < 24; i++) {
+      V64 tmp = a[keccakf_piln[i]];
+
+      a[keccakf_piln[i]] = ROTL64(t, keccakf_rotc[i]);
+      t = tmp;
+    }
+
+    KF_UNROLL
+    for (j = 0; j < 25; j += 5) {
+      KF_UNROLL
+      for (i = 0; i < 5; i++)
+        c[i] = a[j + i];
+      KF_UNROLL
+      for (i = 0; i < 5; i++)
+        a[j + i] ^= ~c[(i + 1) % 5] & c[(i + 2) % 5];
+    }
+
+    a[0] ^= (V64){ 0 } + keccakf_rc[r];
+  }
+}
+
+#undef ROTL64
+#undef KF_UNROLL
+
+#endif
+
+KF_ATTR static void KF_NAME(sponge)(uint8_t *const *out, size_t outlen, const uint8_t *const *in,
+                                    size_t inlen, size_t rate, uint8_t pad)
+{
+  V64 a[25];
+  uint8_t last[KF_LANES][200];
+  size_t words = rate / 8, off = 0, i;
+  int l;
+
+  memset(a, 0, sizeof(a));
+  for (; inlen >= rate; inlen -= rate, off += rate) {
+    for (i = 0; i < words; i++)
+      for (l = 0; l < KF_LANES; l++)
+        KF_LANE(a[i], l) ^= sph_dec64le(in[l] + off + 8 * i);
+    KF_PERMUTE(a);
+  }
+
+  /* The final block, padded; inlen < rate is left */
+  for (l = 0; l < KF_LANES; l++) {
+    memcpy(last[l], in[l] + off, inlen);
+    memset(last[l] + inlen, 0, rate - inlen);
+    last[l][inlen] ^= pad;
+    last[l][rate - 1] ^= 0x80;
+    for (i = 0; i < words; i++)
+      KF_LANE(a[i], l) ^= sph_dec64le(last[l] + 8 * i);
+  }
+  KF_PERMUTE(a);
+
+  for (off = 0;;) {
+    size_t n = outlen - off < rate ? outlen - off : rate;
+
+    for (l = 0; l < KF_LANES; l++) {
+      for (i = 0; i < (n + 7) / 8; i++)
+        sph_enc64le(last[l] + 8 * i, KF_LANE(a[i], l));
+      memcpy(out[l] + off, last[l], n);
+    }
+    off += n;
+    if (off == outlen)
+      break;
+    KF_PERMUTE(a);
+  }
+}
+
+static const keccakf_backend KF_NAME(keccakf) = {
+  KF_LABEL, KF_LANES,
+  KF_NAME(sponge)
+};
+
+#undef V64
+#undef KF_LANE
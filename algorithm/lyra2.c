@@ -21,9 +21,107 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 #include "lyra2.h"
 #include "sponge.h"
 
+/**
+ * Makes sure the workspace holds a zeroed nRows x rowLenBytes matrix and a row
+ * pointer table for it. Memory is only reallocated when the matrix grows, so a
+ * thread hashing the same variant over and over never touches the allocator.
+ *
+ * @return The start of the matrix, or NULL if the allocation failed
+ */
+static uint64_t *lyra2_workspace_reserve(lyra2_workspace_t *ws, uint64_t nRows, uint64_t rowLenBytes)
+{
+    const size_t size = (size_t) (nRows * rowLenBytes);
+    uint64_t *ptrWord;
+    uint64_t i;
+
+    if (ws->matrixSize < size) {
+      free(ws->matrix);
+      ws->matrix = (uint64_t*)malloc(size);
+      ws->matrixSize = ws->matrix ? size : 0;
+      ws->nRows = 0;
+      if (ws->matrix == NULL)
+        return NULL;
+    }
+    if (ws->rowsSize < nRows) {
+      free(ws->rows);
+      ws->rows = (uint64_t**)malloc(nRows * sizeof (uint64_t*));
+      ws->rowsSize = ws->rows ? nRows : 0;
+      ws->nRows = 0;
+      if (ws->rows == NULL)
+        return NULL;
+    }
+
+    //Places the pointers in the correct positions, unless the layout is unchanged
+    if (ws->nRows != nRows || ws->rowLenBytes != rowLenBytes) {
+      ptrWord = ws->matrix;
+      for (i = 0; i < nRows; i++) {
+        ws->rows[i] = ptrWord;
+        ptrWord += rowLenBytes / 8;
+      }
+      ws->nRows = nRows;
+      ws->rowLenBytes = rowLenBytes;
+    }
+
+    memset(ws->matrix, 0, size);
+    return ws->matrix;
+}
+
+void lyra2_workspace_init(lyra2_workspace_t *ws)
+{
+    memset(ws, 0, sizeof (*ws));
+}
+
+void lyra2_workspace_free(lyra2_workspace_t *ws)
+{
+    free(ws->rows);
+    free(ws->matrix);
+    lyra2_workspace_init(ws);
+}
+
+static pthread_key_t lyra2_ws_key;
+static pthread_once_t lyra2_ws_once = PTHREAD_ONCE_INIT;
+static int lyra2_ws_key_failed;
+
+static void lyra2_thread_workspace_free(void *ptr)
+{
+    lyra2_workspace_free((lyra2_workspace_t*)ptr);
+    free(ptr);
+}
+
+static void lyra2_ws_key_init(void)
+{
+    if (pthread_key_create(&lyra2_ws_key, lyra2_thread_workspace_free))
+      lyra2_ws_key_failed = 1;
+}
+
+/**
+ * Returns the calling thread's workspace, creating it on first use. It is
+ * released by the pthread key destructor when the thread exits.
+ */
+lyra2_workspace_t *lyra2_thread_workspace(void)
+{
+    lyra2_workspace_t *ws;
+
+    if (pthread_once(&lyra2_ws_once, lyra2_ws_key_init) || lyra2_ws_key_failed)
+      return NULL;
+
+    ws = (lyra2_workspace_t*)pthread_getspecific(lyra2_ws_key);
+    if (ws == NULL) {
+      ws = (lyra2_workspace_t*)calloc(1, sizeof (*ws));
+      if (ws == NULL)
+        return NULL;
+      if (pthread_setspecific(lyra2_ws_key, ws)) {
+        free(ws);
+        return NULL;
+      }
+    }
+    return ws;
+}
+
 /**
  * Executes Lyra2 based on the G function from Blake2b. This version supports salts and passwords
  * whose combined length is smaller than the size of the memory matrix, (i.e., (nRows x nCols x b) bits,
@@ -44,6 +142,18 @@
  * @return 0 if the key is generated correctly; -1 if there is an error (usually due to lack of memory for allocation)
  */
 int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+    lyra2_workspace_t *ws = lyra2_thread_workspace();
+
+    if (ws == NULL) {
+      return -1;
+    }
+    return LYRA2_ws(ws, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
+}
+
+/**
+ * Same as LYRA2(), but the memory matrix lives in the caller-provided workspace.
+ */
+int LYRA2_ws(lyra2_workspace_t *ws, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
 
     //============================= Basic variables ============================//
     int64_t row = 2; //index of row to be processed
@@ -64,24 +174,12 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     // for Lyra2REv2, nCols = 4, v1 was using 8, for Lyra2Z, timeCost = 8, for Lyra2h, nCols = 16
     const int64_t BLOCK_LEN = (nCols == 4 || nCols == 16 || timeCost == 8) ? BLOCK_LEN_BLAKE2_SAFE_INT64 : BLOCK_LEN_BLAKE2_SAFE_BYTES;
 	
-    i = (int64_t) ((int64_t) nRows * (int64_t) ROW_LEN_BYTES);
-	uint64_t *wholeMatrix = (uint64_t*)malloc(i);
+	uint64_t *wholeMatrix = lyra2_workspace_reserve(ws, nRows, ROW_LEN_BYTES);
     if (wholeMatrix == NULL) {
       return -1;
     }
-	memset(wholeMatrix, 0, i);
-
-    //Allocates pointers to each row of the matrix
-	uint64_t **memMatrix = (uint64_t**)malloc(nRows * sizeof (uint64_t*));
-    if (memMatrix == NULL) {
-      return -1;
-    }
-    //Places the pointers in the correct positions
-    uint64_t *ptrWord = wholeMatrix;
-    for (i = 0; i < nRows; i++) {
-      memMatrix[i] = ptrWord;
-      ptrWord += ROW_LEN_INT64;
-    }
+	uint64_t **memMatrix = ws->rows;
+    uint64_t *ptrWord;
     //==========================================================================/
 
     //============= Getting the password + salt + basil padded with 10*1 ===============//
@@ -124,10 +222,7 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 
     //======================= Initializing the Sponge State ====================//
     //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-	uint64_t *state = (uint64_t*)malloc(16 * sizeof (uint64_t));
-    if (state == NULL) {
-      return -1;
-    }
+	uint64_t state[16];
     initState(state);
     //==========================================================================/
 
@@ -201,19 +296,23 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     squeeze(state, (unsigned char*)K, kLen);
     //==========================================================================/
 
-    //========================= Freeing the memory =============================//
-    free(memMatrix);
-    free(wholeMatrix);
-
-    //Wiping out the sponge's internal state before freeing it
+    //Wiping out the sponge's internal state
     memset(state, 0, 16 * sizeof (uint64_t));
-    free(state);
-    //==========================================================================/
 
     return 0;
 }
 
 int LYRA2_3(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *salt, int32_t saltlen, int64_t timeCost, const int16_t nRows, const int16_t nCols)
+{
+	lyra2_workspace_t *ws = lyra2_thread_workspace();
+
+	if (ws == NULL) {
+		return -1;
+	}
+	return LYRA2_3_ws(ws, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
+}
+
+int LYRA2_3_ws(lyra2_workspace_t *ws, void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *salt, int32_t saltlen, int64_t timeCost, const int16_t nRows, const int16_t nCols)
 {
 	//============================= Basic variables ============================//
 	int64_t row = 2; //index of row to be processed
@@ -236,24 +335,12 @@ int LYRA2_3(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *
 	// for Lyra2REv2, nCols = 4, v1 was using 8
 	const int64_t BLOCK_LEN = (nCols == 4) ? BLOCK_LEN_BLAKE2_SAFE_INT64 : BLOCK_LEN_BLAKE2_SAFE_BYTES;
 
-	size_t sz = (size_t)ROW_LEN_BYTES * nRows;
-	uint64_t *wholeMatrix = (uint64_t *)malloc(sz);
+	uint64_t *wholeMatrix = lyra2_workspace_reserve(ws, nRows, ROW_LEN_BYTES);
 	if (wholeMatrix == NULL) {
 		return -1;
 	}
-	memset(wholeMatrix, 0, sz);
-
-	//Allocates pointers to each row of the matrix
-	uint64_t **memMatrix = (uint64_t **)malloc(sizeof(uint64_t*)* nRows);
-	if (memMatrix == NULL) {
-		return -1;
-	}
-	//Places the pointers in the correct positions
-	uint64_t *ptrWord = wholeMatrix;
-	for (i = 0; i < nRows; i++) {
-		memMatrix[i] = ptrWord;
-		ptrWord += ROW_LEN_INT64;
-	}
+	uint64_t **memMatrix = ws->rows;
+	uint64_t *ptrWord;
 	//==========================================================================/
 
 	//============= Getting the password + salt + basil padded with 10*1 ===============//
@@ -379,9 +466,5 @@ int LYRA2_3(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *
 	//Squeezes the key
 	squeeze(state, (unsigned char *) K, (unsigned int) kLen);
 
-	//========================= Freeing the memory =============================//
-	free(memMatrix);
-	free(wholeMatrix);
-
 	return 0;
 }
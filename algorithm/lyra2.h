@@ -21,6 +21,7 @@
 #define LYRA2_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
 typedef unsigned char byte;
 
@@ -37,6 +38,26 @@ typedef unsigned char byte;
         #define BLOCK_LEN_BYTES (BLOCK_LEN_INT64 * 8)    //Block length, in bytes
 #endif
 
+/**
+ * Memory matrix and row pointer table, kept between calls so hashing does not
+ * allocate. Use lyra2_workspace_init() before the first call and
+ * lyra2_workspace_free() when done; a workspace must not be shared by threads.
+ */
+typedef struct lyra2_workspace {
+        uint64_t *matrix;
+        uint64_t **rows;
+        size_t matrixSize;       //bytes allocated for matrix
+        uint64_t rowsSize;       //entries allocated for rows
+        uint64_t nRows;          //layout rows currently points into
+        uint64_t rowLenBytes;
+} lyra2_workspace_t;
+
+void lyra2_workspace_init(lyra2_workspace_t *ws);
+void lyra2_workspace_free(lyra2_workspace_t *ws);
+lyra2_workspace_t *lyra2_thread_workspace(void);
+
+int LYRA2_ws(lyra2_workspace_t *ws, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
+int LYRA2_3_ws(lyra2_workspace_t *ws, void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *salt, int32_t saltlen, int64_t timeCost, const int16_t nRows, const int16_t nCols);
 int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
 int LYRA2_3(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *salt, int32_t saltlen, int64_t timeCost, const int16_t nRows, const int16_t nCols);
 
@@ -0,0 +1,305 @@
+/*
+ * Copyright 2013-2014 sgminer developers (see AUTHORS.md)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.  See COPYING for more details.
+ */
+
+/*
+ * Multi-buffer X11 chain for CPU share verification.
+ *
+ * A result buffer holds several nonces of the same work, and every one of
+ * them runs through the same fixed-length chain of sph hashes. The 64 bit
+ * ARX and bitsliced stages (blake, bmw, skein, jh) and cubehash are
+ * written once over GCC vector types in mb512_lanes.h and instantiated at
+ * 2 lanes (baseline ISA), 4 lanes (AVX2) and 8 lanes (AVX-512F); the best
+ * one the CPU supports is picked at run time. Keccak goes through the
+ * shared multi-buffer engine in keccakf.c. The AES and table driven
+ * stages stay on sph, one lane at a time.
+ */
+
+#include "config.h"
+#include "miner.h"
+#include "findnonce.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sph/sph_groestl.h"
+#include "sph/sph_luffa.h"
+#include "sph/sph_shavite.h"
+#include "sph/sph_simd.h"
+#include "sph/sph_echo.h"
+
+#include "keccakf.h"
+#include "mb512.h"
+
+#if defined(__GNUC__)
+
+static const uint64_t blake_iv[8] = {
+  0x6A09E667F3BCC908ULL, 0xBB67AE8584CAA73BULL, 0x3C6EF372FE94F82BULL, 0xA54FF53A5F1D36F1ULL,
+  0x510E527FADE682D1ULL, 0x9B05688C2B3E6C1FULL, 0x1F83D9ABFB41BD6BULL, 0x5BE0CD19137E2179ULL
+};
+
+static const uint64_t blake_cb[16] = {
+  0x243F6A8885A308D3ULL, 0x13198A2E03707344ULL, 0xA4093822299F31D0ULL, 0x082EFA98EC4E6C89ULL,
+  0x452821E638D01377ULL, 0xBE5466CF34E90C6CULL, 0xC0AC29B7C97C50DDULL, 0x3F84D5B5B5470917ULL,
+  0x9216D5D98979FB1BULL, 0xD1310BA698DFB5ACULL, 0x2FFD72DBD01ADFB7ULL, 0xB8E1AFED6A267E96ULL,
+  0xBA7C9045F12C7F99ULL, 0x24A19947B3916CF7ULL, 0x0801F2E2858EFC16ULL, 0x636920D871574E69ULL
+};
+
+static const uint8_t blake_sigma[10][16] = {
+  {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+  { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+  { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+  {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+  {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+  {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+  { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+  { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+  {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+  { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 }
+};
+
+static const uint64_t bmw_iv[16] = {
+  0x8081828384858687ULL, 0x88898A8B8C8D8E8FULL, 0x9091929394959697ULL, 0x98999A9B9C9D9E9FULL,
+  0xA0A1A2A3A4A5A6A7ULL, 0xA8A9AAABACADAEAFULL, 0xB0B1B2B3B4B5B6B7ULL, 0xB8B9BABBBCBDBEBFULL,
+  0xC0C1C2C3C4C5C6C7ULL, 0xC8C9CACBCCCDCECFULL, 0xD0D1D2D3D4D5D6D7ULL, 0xD8D9DADBDCDDDEDFULL,
+  0xE0E1E2E3E4E5E6E7ULL, 0xE8E9EAEBECEDEEEFULL, 0xF0F1F2F3F4F5F6F7ULL, 0xF8F9FAFBFCFDFEFFULL
+};
+
+static const uint64_t skein_iv[8] = {
+  0x4903ADFF749C51CEULL, 0x0D95DE399746DF03ULL, 0x8FD1934127C79BCEULL, 0x9A255629FF352CB1ULL,
+  0x5DB62599DF6CA7B0ULL, 0xEABE394CA9D5C3F4ULL, 0x991112C71A75B523ULL, 0xAE18A40B660FCC33ULL
+};
+
+/* JH round constants, four words (even hi/lo, odd hi/lo) per round */
+static const uint64_t jh_c[168] = {
+  0x72d5dea2df15f867ULL, 0x7b84150ab7231557ULL, 0x81abd6904d5a87f6ULL, 0x4e9f4fc5c3d12b40ULL,
+  0xea983ae05c45fa9cULL, 0x03c5d29966b2999aULL, 0x660296b4f2bb538aULL, 0xb556141a88dba231ULL,
+  0x03a35a5c9a190edbULL, 0x403fb20a87c14410ULL, 0x1c051980849e951dULL, 0x6f33ebad5ee7cddcULL,
+  0x10ba139202bf6b41ULL, 0xdc786515f7bb27d0ULL, 0x0a2c813937aa7850ULL, 0x3f1abfd2410091d3ULL,
+  0x422d5a0df6cc7e90ULL, 0xdd629f9c92c097ceULL, 0x185ca70bc72b44acULL, 0xd1df65d663c6fc23ULL,
+  0x976e6c039ee0b81aULL, 0x2105457e446ceca8ULL, 0xeef103bb5d8e61faULL, 0xfd9697b294838197ULL,
+  0x4a8e8537db03302fULL, 0x2a678d2dfb9f6a95ULL, 0x8afe7381f8b8696cULL, 0x8ac77246c07f4214ULL,
+  0xc5f4158fbdc75ec4ULL, 0x75446fa78f11bb80ULL, 0x52de75b7aee488bcULL, 0x82b8001e98a6a3f4ULL,
+  0x8ef48f33a9a36315ULL, 0xaa5f5624d5b7f989ULL, 0xb6f1ed207c5ae0fdULL, 0x36cae95a06422c36ULL,
+  0xce2935434efe983dULL, 0x533af974739a4ba7ULL, 0xd0f51f596f4e8186ULL, 0x0e9dad81afd85a9fULL,
+  0xa7050667ee34626aULL, 0x8b0b28be6eb91727ULL, 0x47740726c680103fULL, 0xe0a07e6fc67e487bULL,
+  0x0d550aa54af8a4c0ULL, 0x91e3e79f978ef19eULL, 0x8676728150608dd4ULL, 0x7e9e5a41f3e5b062ULL,
+  0xfc9f1fec4054207aULL, 0xe3e41a00cef4c984ULL, 0x4fd794f59dfa95d8ULL, 0x552e7e1124c354a5ULL,
+  0x5bdf7228bdfe6e28ULL, 0x78f57fe20fa5c4b2ULL, 0x05897cefee49d32eULL, 0x447e9385eb28597fULL,
+  0x705f6937b324314aULL, 0x5e8628f11dd6e465ULL, 0xc71b770451b920e7ULL, 0x74fe43e823d4878aULL,
+  0x7d29e8a3927694f2ULL, 0xddcb7a099b30d9c1ULL, 0x1d1b30fb5bdc1be0ULL, 0xda24494ff29c82bfULL,
+  0xa4e7ba31b470bfffULL, 0x0d324405def8bc48ULL, 0x3baefc3253bbd339ULL, 0x459fc3c1e0298ba0ULL,
+  0xe5c905fdf7ae090fULL, 0x947034124290f134ULL, 0xa271b701e344ed95ULL, 0xe93b8e364f2f984aULL,
+  0x88401d63a06cf615ULL, 0x47c1444b8752afffULL, 0x7ebb4af1e20ac630ULL, 0x4670b6c5cc6e8ce6ULL,
+  0xa4d5a456bd4fca00ULL, 0xda9d844bc83e18aeULL, 0x7357ce453064d1adULL, 0xe8a6ce68145c2567ULL,
+  0xa3da8cf2cb0ee116ULL, 0x33e906589a94999aULL, 0x1f60b220c26f847bULL, 0xd1ceac7fa0d18518ULL,
+  0x32595ba18ddd19d3ULL, 0x509a1cc0aaa5b446ULL, 0x9f3d6367e4046bbaULL, 0xf6ca19ab0b56ee7eULL,
+  0x1fb179eaa9282174ULL, 0xe9bdf7353b3651eeULL, 0x1d57ac5a7550d376ULL, 0x3a46c2fea37d7001ULL,
+  0xf735c1af98a4d842ULL, 0x78edec209e6b6779ULL, 0x41836315ea3adba8ULL, 0xfac33b4d32832c83ULL,
+  0xa7403b1f1c2747f3ULL, 0x5940f034b72d769aULL, 0xe73e4e6cd2214ffdULL, 0xb8fd8d39dc5759efULL,
+  0x8d9b0c492b49ebdaULL, 0x5ba2d74968f3700dULL, 0x7d3baed07a8d5584ULL, 0xf5a5e9f0e4f88e65ULL,
+  0xa0b8a2f436103b53ULL, 0x0ca8079e753eec5aULL, 0x9168949256e8884fULL, 0x5bb05c55f8babc4cULL,
+  0xe3bb3b99f387947bULL, 0x75daf4d6726b1c5dULL, 0x64aeac28dc34b36dULL, 0x6c34a550b828db71ULL,
+  0xf861e2f2108d512aULL, 0xe3db643359dd75fcULL, 0x1cacbcf143ce3fa2ULL, 0x67bbd13c02e843b0ULL,
+  0x330a5bca8829a175ULL, 0x7f34194db416535cULL, 0x923b94c30e794d1eULL, 0x797475d7b6eeaf3fULL,
+  0xeaa8d4f7be1a3921ULL, 0x5cf47e094c232751ULL, 0x26a32453ba323cd2ULL, 0x44a3174a6da6d5adULL,
+  0xb51d3ea6aff2c908ULL, 0x83593d98916b3c56ULL, 0x4cf87ca17286604dULL, 0x46e23ecc086ec7f6ULL,
+  0x2f9833b3b1bc765eULL, 0x2bd666a5efc4e62aULL, 0x06f4b6e8bec1d436ULL, 0x74ee8215bcef2163ULL,
+  0xfdc14e0df453c969ULL, 0xa77d5ac406585826ULL, 0x7ec1141606e0fa16ULL, 0x7e90af3d28639d3fULL,
+  0xd2c9f2e3009bd20cULL, 0x5faace30b7d40c30ULL, 0x742a5116f2e03298ULL, 0x0deb30d8e3cef89aULL,
+  0x4bc59e7bb5f17992ULL, 0xff51e66e048668d3ULL, 0x9b234d57e6966731ULL, 0xcce6a6f3170a7505ULL,
+  0xb17681d913326cceULL, 0x3c175284f805a262ULL, 0xf42bcbb378471547ULL, 0xff46548223936a48ULL,
+  0x38df58074e5e6565ULL, 0xf2fc7c89fc86508eULL, 0x31702e44d00bca86ULL, 0xf04009a23078474eULL,
+  0x65a0ee39d1f73883ULL, 0xf75ee937e42c3abdULL, 0x2197b2260113f86fULL, 0xa344edd1ef9fdee7ULL,
+  0x8ba0df15762592d9ULL, 0x3c85f7f612dc42beULL, 0xd8a7ec7cab27b07eULL, 0x538d7ddaaa3ea8deULL,
+  0xaa25ce93bd0269d8ULL, 0x5af643fd1a7308f9ULL, 0xc05fefda174a19a5ULL, 0x974d66334cfd216aULL,
+  0x35b49831db411570ULL, 0xea1e0fbbedcd549bULL, 0x9ad063a151974072ULL, 0xf6759dbf91476fe2ULL
+};
+
+static const uint64_t jh_iv[16] = {
+  0x6fd14b963e00aa17ULL, 0x636a2e057a15d543ULL, 0x8a225e8d0c97ef0bULL, 0xe9341259f2b3c361ULL,
+  0x891da0c1536f801eULL, 0x2aa9056bea2b6d80ULL, 0x588eccdb2075baa6ULL, 0xa90f3a76baf83bf7ULL,
+  0x0169e60541e34a69ULL, 0x46b58a8e2e6fe65aULL, 0x1047a7d0c1843c24ULL, 0x3b6e71b12d5ac199ULL,
+  0xcf57f6ec9db1f856ULL, 0xa706887c5716b156ULL, 0xe3c2fcdfe68517fbULL, 0x545a4678cc8cdd4bULL
+};
+
+static const uint64_t jh_wmask[6] = {
+  0x5555555555555555ULL, 0x3333333333333333ULL, 0x0F0F0F0F0F0F0F0FULL,
+  0x00FF00FF00FF00FFULL, 0x0000FFFF0000FFFFULL, 0x00000000FFFFFFFFULL
+};
+
+static const uint32_t cubehash_iv[32] = {
+  0x2AEA2A61, 0x50F494D4, 0x2D538B8B, 0x4167D83E, 0x3FEE2313, 0xC701CF8C,
+  0xCC39968E, 0x50AC5695, 0x4D42C787, 0xA647A8B3, 0x97CF0BEF, 0x825B4537,
+  0xEEF864D2, 0xF22090C4, 0xD0E5CD33, 0xA23911AE, 0xFCD398D9, 0x148FE485,
+  0x1B017BEF, 0xB6444532, 0x6A536159, 0x2FF5781C, 0x91FA7934, 0x0DBADEA9,
+  0xD65C8A2B, 0xA5A70E75, 0xB1C62456, 0xBC796576, 0x1921C8F7, 0xE7989AF1,
+  0x7795D246, 0xD43E3B44
+};
+
+#define MB_LANES 2
+#define MB_NAME(x) x ## _2
+#define MB_ATTR
+#define MB_LABEL "generic"
+#include "mb512_lanes.h"
+#undef MB_LANES
+#undef MB_NAME
+#undef MB_ATTR
+#undef MB_LABEL
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MB512_X86 1
+
+#define MB_LANES 4
+#define MB_NAME(x) x ## _4
+#define MB_ATTR __attribute__((target("avx2")))
+#define MB_LABEL "avx2"
+#include "mb512_lanes.h"
+#undef MB_LANES
+#undef MB_NAME
+#undef MB_ATTR
+#undef MB_LABEL
+
+#define MB_LANES 8
+#define MB_NAME(x) x ## _8
+#define MB_ATTR __attribute__((target("avx512f")))
+#define MB_LABEL "avx512"
+#include "mb512_lanes.h"
+#undef MB_LANES
+#undef MB_NAME
+#undef MB_ATTR
+#undef MB_LABEL
+#endif
+
+const mb512_backend *mb512_backend_get(int n)
+{
+  const mb512_backend *supported[3];
+  int count = 0;
+
+#ifdef MB512_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    supported[count++] = &mb512_8;
+  if (__builtin_cpu_supports("avx2"))
+    supported[count++] = &mb512_4;
+#endif
+  supported[count++] = &mb512_2;
+
+  return n >= 0 && n < count ? supported[n] : NULL;
+}
+
+#else /* !__GNUC__ */
+
+/* Without vector extensions the chain runs lane by lane through sph */
+const mb512_backend *mb512_backend_get(int n)
+{
+  return NULL;
+}
+
+#endif
+
+#include "sph/sph_blake.h"
+#include "sph/sph_bmw.h"
+#include "sph/sph_skein.h"
+#include "sph/sph_jh.h"
+#include "sph/sph_keccak.h"
+#include "sph/sph_cubehash.h"
+
+typedef union {
+  sph_blake512_context blake;
+  sph_bmw512_context bmw;
+  sph_groestl512_context groestl;
+  sph_skein512_context skein;
+  sph_jh512_context jh;
+  sph_keccak512_context keccak;
+  sph_luffa512_context luffa;
+  sph_cubehash512_context cubehash;
+  sph_shavite512_context shavite;
+  sph_simd512_context simd;
+  sph_echo512_context echo;
+} mb512_sph_context;
+
+/* One 64 byte stage of the chain through sph, in place, for n lanes */
+static void sph_lanes(uint32_t (*hash)[16], int n, void (*init)(void *),
+                      void (*update)(void *, const void *, size_t), void (*close)(void *, void *))
+{
+  mb512_sph_context ctx;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    init(&ctx);
+    update(&ctx, hash[i], 64);
+    close(&ctx, hash[i]);
+  }
+}
+
+#define SPH_LANES(hash, n, algo) \
+  sph_lanes(hash, n, sph_ ## algo ## _init, sph_ ## algo, sph_ ## algo ## _close)
+
+void mb512_x11(const mb512_backend *mb, const uint32_t (*data)[20], int count, uint32_t (*hash)[16])
+{
+  uint32_t in[MB512_MAX_LANES][20], h[MB512_MAX_LANES][16];
+  int base, i, n = mb ? mb->lanes : 1;
+
+  for (base = 0; base < count; base += n) {
+    /* a short last group repeats its last header in the spare lanes */
+    for (i = 0; i < n; i++)
+      memcpy(in[i], data[base + i < count ? base + i : count - 1], 80);
+
+    if (mb)
+      mb->blake512_80((const uint32_t (*)[20])in, h);
+    else {
+      mb512_sph_context ctx;
+
+      sph_blake512_init(&ctx);
+      sph_blake512(&ctx, in[0], 80);
+      sph_blake512_close(&ctx, h[0]);
+    }
+    if (mb)
+      mb->bmw512(h);
+    else
+      SPH_LANES(h, n, bmw512);
+    SPH_LANES(h, n, groestl512);
+    if (mb) {
+      mb->skein512(h);
+      mb->jh512(h);
+      mb->keccak512(h);
+    } else {
+      SPH_LANES(h, n, skein512);
+      SPH_LANES(h, n, jh512);
+      SPH_LANES(h, n, keccak512);
+    }
+    SPH_LANES(h, n, luffa512);
+    if (mb)
+      mb->cubehash512(h);
+    else
+      SPH_LANES(h, n, cubehash512);
+    SPH_LANES(h, n, shavite512);
+    SPH_LANES(h, n, simd512);
+    SPH_LANES(h, n, echo512);
+
+    for (i = 0; i < n && base + i < count; i++)
+      memcpy(hash[base + i], h[i], 64);
+  }
+}
+
+void mb512_x11_work(struct work *work, const uint32_t *nonces, int count, uint32_t (*hash)[16])
+{
+  uint32_t data[MAXBUFFERS][20];
+  int i;
+
+  assert(count <= MAXBUFFERS);
+  be32enc_vect(data[0], (const uint32_t *)work->data, 19);
+  for (i = 0; i < count; i++) {
+    if (i)
+      memcpy(data[i], data[0], 76);
+    data[i][19] = htobe32(htole32(nonces[i]));
+  }
+  mb512_x11(mb512_backend_get(0), (const uint32_t (*)[20])data, count, hash);
+}
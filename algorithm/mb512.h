@@ -0,0 +1,36 @@
+#ifndef MB512_H
+#define MB512_H
+
+#include "miner.h"
+
+/* Most lanes any backend hashes at once */
+#define MB512_MAX_LANES 8
+
+/* Multi-buffer versions of the sph 512-bit hashes at the fixed message
+ * lengths of the X11 chain: an 80 byte header for blake, the previous
+ * 64 byte digest for the rest. Each call hashes exactly `lanes` messages;
+ * the 64 byte primitives hash in place. Input and output bytes are what
+ * the sph functions would read and write for every lane. */
+typedef struct {
+  const char *name;
+  int lanes;
+  void (*blake512_80)(const uint32_t (*in)[20], uint32_t (*out)[16]);
+  void (*bmw512)(uint32_t (*hash)[16]);
+  void (*skein512)(uint32_t (*hash)[16]);
+  void (*jh512)(uint32_t (*hash)[16]);
+  void (*keccak512)(uint32_t (*hash)[16]);
+  void (*cubehash512)(uint32_t (*hash)[16]);
+} mb512_backend;
+
+/* n-th backend this CPU can run, widest first; NULL past the last one.
+ * mb512_backend_get(0) is the one the batched regenhash functions use. */
+extern const mb512_backend *mb512_backend_get(int n);
+
+/* The 11 stages of X11 (blake ... echo) over count 80 byte headers, with
+ * the non-vectorised stages run lane by lane through sph */
+extern void mb512_x11(const mb512_backend *mb, const uint32_t (*data)[20], int count, uint32_t (*hash)[16]);
+
+/* mb512_x11() of the work's header with each of the nonces */
+extern void mb512_x11_work(struct work *work, const uint32_t *nonces, int count, uint32_t (*hash)[16]);
+
+#endif /* MB512_H */
@@ -0,0 +1,459 @@
+/*
+ * Lane-parallel bodies of the mb512 primitives.
+ *
+ * Included by mb512.c once per vector width, with MB_LANES (lanes per
+ * vector), MB_NAME(x) (suffixes the width onto every symbol), MB_ATTR
+ * (function attributes, e.g. the target ISA) and MB_LABEL (backend name)
+ * defined. Lane l of every vector holds the state of message l, so each
+ * primitive is the scalar algorithm written once over vectors.
+ */
+
+typedef uint64_t MB_NAME(v64) __attribute__((vector_size(8 * MB_LANES)));
+typedef uint32_t MB_NAME(v32) __attribute__((vector_size(4 * MB_LANES)));
+
+#define V64 MB_NAME(v64)
+#define V32 MB_NAME(v32)
+#define SPLAT64(c)    ((V64){ 0 } + (uint64_t)(c))
+#define SPLAT32(c)    ((V32){ 0 } + (uint32_t)(c))
+#define ROTL64(x, n)  (((x) << (n)) | ((x) >> (64 - (n))))
+#define ROTR64(x, n)  (((x) >> (n)) | ((x) << (64 - (n))))
+#define ROTL32(x, n)  (((x) << (n)) | ((x) >> (32 - (n))))
+
+/* Full unrolling turns the index tables below into register names */
+#define MB_UNROLL     _Pragma("GCC unroll 32")
+
+/* Word j of every lane's 64 byte state, in the byte order sph uses */
+#define LOAD64(v, in, n, dec)   do { \
+    int j_, l_; \
+    for (j_ = 0; j_ < (n); j_++) \
+      for (l_ = 0; l_ < MB_LANES; l_++) \
+        (v)[j_][l_] = dec((const unsigned char *)(in)[l_] + 8 * j_); \
+  } while (0)
+
+#define STORE64(out, v, n, enc)   do { \
+    int j_, l_; \
+    for (j_ = 0; j_ < (n); j_++) \
+      for (l_ = 0; l_ < MB_LANES; l_++) \
+        enc((unsigned char *)(out)[l_] + 8 * j_, (v)[j_][l_]); \
+  } while (0)
+
+/* BLAKE-512 of an 80 byte message: one block, counter 640 */
+#define BLAKE_G(a, b, c, d, x, y)   do { \
+    a += b + (m[sg[x]] ^ SPLAT64(blake_cb[sg[y]])); \
+    d = ROTR64(d ^ a, 32); \
+    c += d; \
+    b = ROTR64(b ^ c, 25); \
+    a += b + (m[sg[y]] ^ SPLAT64(blake_cb[sg[x]])); \
+    d = ROTR64(d ^ a, 16); \
+    c += d; \
+    b = ROTR64(b ^ c, 11); \
+  } while (0)
+
+MB_ATTR static void MB_NAME(blake512_80)(const uint32_t (*in)[20], uint32_t (*out)[16])
+{
+  V64 m[16], v[16], h[8];
+  int i, r;
+
+  LOAD64(m, in, 10, sph_dec64be);
+  m[10] = SPLAT64(0x8000000000000000ULL);
+  m[11] = m[12] = m[14] = SPLAT64(0);
+  m[13] = SPLAT64(1);
+  m[15] = SPLAT64(640);
+
+  for (i = 0; i < 8; i++) {
+    h[i] = v[i] = SPLAT64(blake_iv[i]);
+    v[i + 8] = SPLAT64(blake_cb[i]);
+  }
+  v[12] ^= SPLAT64(640);
+  v[13] ^= SPLAT64(640);
+
+  for (r = 0; r < 16; r++) {
+    const uint8_t *sg = blake_sigma[r % 10];
+
+    BLAKE_G(v[0], v[4], v[ 8], v[12],  0,  1);
+    BLAKE_G(v[1], v[5], v[ 9], v[13],  2,  3);
+    BLAKE_G(v[2], v[6], v[10], v[14],  4,  5);
+    BLAKE_G(v[3], v[7], v[11], v[15],  6,  7);
+    BLAKE_G(v[0], v[5], v[10], v[15],  8,  9);
+    BLAKE_G(v[1], v[6], v[11], v[12], 10, 11);
+    BLAKE_G(v[2], v[7], v[ 8], v[13], 12, 13);
+    BLAKE_G(v[3], v[4], v[ 9], v[14], 14, 15);
+  }
+
+  for (i = 0; i < 8; i++)
+    h[i] ^= v[i] ^ v[i + 8];
+  STORE64(out, h, 8, sph_enc64be);
+}
+
+#undef BLAKE_G
+
+/* BMW-512 compression */
+#define BMW_S0(x)  (((x) >> 1) ^ ((x) << 3) ^ ROTL64(x,  4) ^ ROTL64(x, 37))
+#define BMW_S1(x)  (((x) >> 1) ^ ((x) << 2) ^ ROTL64(x, 13) ^ ROTL64(x, 43))
+#define BMW_S2(x)  (((x) >> 2) ^ ((x) << 1) ^ ROTL64(x, 19) ^ ROTL64(x, 53))
+#define BMW_S3(x)  (((x) >> 2) ^ ((x) << 2) ^ ROTL64(x, 28) ^ ROTL64(x, 59))
+#define BMW_S4(x)  (((x) >> 1) ^ (x))
+#define BMW_S5(x)  (((x) >> 2) ^ (x))
+#define BMW_ROL(j) ROTL64(M[(j) & 15], ((j) & 15) + 1)
+
+MB_ATTR static void MB_NAME(bmw512_compress)(const V64 *M, const V64 *H, V64 *dh)
+{
+  V64 x[16], q[32], xl, xh;
+  int i;
+
+  for (i = 0; i < 16; i++)
+    x[i] = M[i] ^ H[i];
+
+  q[ 0] = BMW_S0(x[ 5] - x[ 7] + x[10] + x[13] + x[14]) + H[ 1];
+  q[ 1] = BMW_S1(x[ 6] - x[ 8] + x[11] + x[14] - x[15]) + H[ 2];
+  q[ 2] = BMW_S2(x[ 0] + x[ 7] + x[ 9] - x[12] + x[15]) + H[ 3];
+  q[ 3] = BMW_S3(x[ 0] - x[ 1] + x[ 8] - x[10] + x[13]) + H[ 4];
+  q[ 4] = BMW_S4(x[ 1] + x[ 2] + x[ 9] - x[11] - x[14]) + H[ 5];
+  q[ 5] = BMW_S0(x[ 3] - x[ 2] + x[10] - x[12] + x[15]) + H[ 6];
+  q[ 6] = BMW_S1(x[ 4] - x[ 0] - x[ 3] - x[11] + x[13]) + H[ 7];
+  q[ 7] = BMW_S2(x[ 1] - x[ 4] - x[ 5] - x[12] - x[14]) + H[ 8];
+  q[ 8] = BMW_S3(x[ 2] - x[ 5] - x[ 6] + x[13] - x[15]) + H[ 9];
+  q[ 9] = BMW_S4(x[ 0] - x[ 3] + x[ 6] - x[ 7] + x[14]) + H[10];
+  q[10] = BMW_S0(x[ 8] - x[ 1] - x[ 4] - x[ 7] + x[15]) + H[11];
+  q[11] = BMW_S1(x[ 8] - x[ 0] - x[ 2] - x[ 5] + x[ 9]) + H[12];
+  q[12] = BMW_S2(x[ 1] + x[ 3] - x[ 6] - x[ 9] + x[10]) + H[13];
+  q[13] = BMW_S3(x[ 2] + x[ 4] + x[ 7] + x[10] + x[11]) + H[14];
+  q[14] = BMW_S4(x[ 3] - x[ 5] + x[ 8] - x[11] - x[12]) + H[15];
+  q[15] = BMW_S0(x[12] - x[ 4] - x[ 6] - x[ 9] + x[13]) + H[ 0];
+
+  for (i = 16; i < 32; i++) {
+    int j = i - 16;
+    V64 e = ((BMW_ROL(j) + BMW_ROL(j + 3) - BMW_ROL(j + 10)
+              + SPLAT64((uint64_t)i * 0x0555555555555555ULL)) ^ H[(j + 7) & 15]);
+
+    if (i < 18)
+      e += BMW_S1(q[i - 16]) + BMW_S2(q[i - 15]) + BMW_S3(q[i - 14]) + BMW_S0(q[i - 13])
+         + BMW_S1(q[i - 12]) + BMW_S2(q[i - 11]) + BMW_S3(q[i - 10]) + BMW_S0(q[i -  9])
+         + BMW_S1(q[i -  8]) + BMW_S2(q[i -  7]) + BMW_S3(q[i -  6]) + BMW_S0(q[i -  5])
+         + BMW_S1(q[i -  4]) + BMW_S2(q[i -  3]) + BMW_S3(q[i -  2]) + BMW_S0(q[i -  1]);
+    else
+      e += q[i - 16] + ROTL64(q[i - 15],  5) + q[i - 14] + ROTL64(q[i - 13], 11)
+         + q[i - 12] + ROTL64(q[i - 11], 27) + q[i - 10] + ROTL64(q[i -  9], 32)
+         + q[i -  8] + ROTL64(q[i -  7], 37) + q[i -  6] + ROTL64(q[i -  5], 43)
+         + q[i -  4] + ROTL64(q[i -  3], 53) + BMW_S4(q[i - 2]) + BMW_S5(q[i - 1]);
+    q[i] = e;
+  }
+
+  xl = q[16] ^ q[17] ^ q[18] ^ q[19] ^ q[20] ^ q[21] ^ q[22] ^ q[23];
+  xh = xl ^ q[24] ^ q[25] ^ q[26] ^ q[27] ^ q[28] ^ q[29] ^ q[30] ^ q[31];
+  dh[ 0] = ((xh <<  5) ^ (q[16] >>  5) ^ M[ 0]) + (xl ^ q[24] ^ q[ 0]);
+  dh[ 1] = ((xh >>  7) ^ (q[17] <<  8) ^ M[ 1]) + (xl ^ q[25] ^ q[ 1]);
+  dh[ 2] = ((xh >>  5) ^ (q[18] <<  5) ^ M[ 2]) + (xl ^ q[26] ^ q[ 2]);
+  dh[ 3] = ((xh >>  1) ^ (q[19] <<  5) ^ M[ 3]) + (xl ^ q[27] ^ q[ 3]);
+  dh[ 4] = ((xh >>  3) ^ (q[20]      ) ^ M[ 4]) + (xl ^ q[28] ^ q[ 4]);
+  dh[ 5] = ((xh <<  6) ^ (q[21] >>  6) ^ M[ 5]) + (xl ^ q[29] ^ q[ 5]);
+  dh[ 6] = ((xh >>  4) ^ (q[22] <<  6) ^ M[ 6]) + (xl ^ q[30] ^ q[ 6]);
+  dh[ 7] = ((xh >> 11) ^ (q[23] <<  2) ^ M[ 7]) + (xl ^ q[31] ^ q[ 7]);
+  dh[ 8] = ROTL64(dh[4],  9) + (xh ^ q[24] ^ M[ 8]) + ((xl << 8) ^ q[23] ^ q[ 8]);
+  dh[ 9] = ROTL64(dh[5], 10) + (xh ^ q[25] ^ M[ 9]) + ((xl >> 6) ^ q[16] ^ q[ 9]);
+  dh[10] = ROTL64(dh[6], 11) + (xh ^ q[26] ^ M[10]) + ((xl << 6) ^ q[17] ^ q[10]);
+  dh[11] = ROTL64(dh[7], 12) + (xh ^ q[27] ^ M[11]) + ((xl << 4) ^ q[18] ^ q[11]);
+  dh[12] = ROTL64(dh[0], 13) + (xh ^ q[28] ^ M[12]) + ((xl >> 3) ^ q[19] ^ q[12]);
+  dh[13] = ROTL64(dh[1], 14) + (xh ^ q[29] ^ M[13]) + ((xl >> 4) ^ q[20] ^ q[13]);
+  dh[14] = ROTL64(dh[2], 15) + (xh ^ q[30] ^ M[14]) + ((xl >> 7) ^ q[21] ^ q[14]);
+  dh[15] = ROTL64(dh[3], 16) + (xh ^ q[31] ^ M[15]) + ((xl >> 2) ^ q[22] ^ q[15]);
+}
+
+#undef BMW_S0
+#undef BMW_S1
+#undef BMW_S2
+#undef BMW_S3
+#undef BMW_S4
+#undef BMW_S5
+#undef BMW_ROL
+
+/* BMW-512 of a 64 byte message: one padded block, then the final fold */
+MB_ATTR static void MB_NAME(bmw512)(uint32_t (*hash)[16])
+{
+  V64 m[16], h[16], t[16];
+  int i;
+
+  LOAD64(m, hash, 8, sph_dec64le);
+  m[8] = SPLAT64(0x80);
+  for (i = 9; i < 15; i++)
+    m[i] = SPLAT64(0);
+  m[15] = SPLAT64(512);
+  for (i = 0; i < 16; i++)
+    h[i] = SPLAT64(bmw_iv[i]);
+
+  MB_NAME(bmw512_compress)(m, h, t);
+  for (i = 0; i < 16; i++)
+    h[i] = SPLAT64(0xaaaaaaaaaaaaaaa0ULL + i);
+  MB_NAME(bmw512_compress)(t, h, m);
+  STORE64(hash, m + 8, 8, sph_enc64le);
+}
+
+/* Skein-512-512: one UBI call per block, the tweak shared by all lanes */
+#define SKEIN_MIX(a, b, r)   do { \
+    a += b; \
+    b = ROTL64(b, r) ^ a; \
+  } while (0)
+
+#define SKEIN_MIX8(a, b, c, d, e, f, g, h, r0, r1, r2, r3)   do { \
+    SKEIN_MIX(p[a], p[b], r0); \
+    SKEIN_MIX(p[c], p[d], r1); \
+    SKEIN_MIX(p[e], p[f], r2); \
+    SKEIN_MIX(p[g], p[h], r3); \
+  } while (0)
+
+#define SKEIN_ADDKEY(s)   do { \
+    int i_; \
+    MB_UNROLL \
+    for (i_ = 0; i_ < 8; i_++) \
+      p[i_] += k[((s) + i_) % 9]; \
+    p[5] += SPLAT64(t[(s) % 3]); \
+    p[6] += SPLAT64(t[((s) + 1) % 3]); \
+    p[7] += SPLAT64(s); \
+  } while (0)
+
+MB_ATTR static void MB_NAME(skein512_ubi)(V64 *h, const V64 *m, uint64_t t0, uint64_t t1)
+{
+  V64 k[9], p[8];
+  uint64_t t[3] = { t0, t1, t0 ^ t1 };
+  int i, s;
+
+  k[8] = SPLAT64(0x1BD11BDAA9FC1A22ULL);
+  for (i = 0; i < 8; i++) {
+    k[i] = h[i];
+    k[8] ^= h[i];
+    p[i] = m[i];
+  }
+
+  MB_UNROLL
+  for (s = 0; s < 18; s += 2) {
+    SKEIN_ADDKEY(s);
+    SKEIN_MIX8(0, 1, 2, 3, 4, 5, 6, 7, 46, 36, 19, 37);
+    SKEIN_MIX8(2, 1, 4, 7, 6, 5, 0, 3, 33, 27, 14, 42);
+    SKEIN_MIX8(4, 1, 6, 3, 0, 5, 2, 7, 17, 49, 36, 39);
+    SKEIN_MIX8(6, 1, 0, 7, 2, 5, 4, 3, 44,  9, 54, 56);
+    SKEIN_ADDKEY(s + 1);
+    SKEIN_MIX8(0, 1, 2, 3, 4, 5, 6, 7, 39, 30, 34, 24);
+    SKEIN_MIX8(2, 1, 4, 7, 6, 5, 0, 3, 13, 50, 10, 17);
+    SKEIN_MIX8(4, 1, 6, 3, 0, 5, 2, 7, 25, 29, 39, 43);
+    SKEIN_MIX8(6, 1, 0, 7, 2, 5, 4, 3,  8, 35, 56, 22);
+  }
+  SKEIN_ADDKEY(18);
+
+  for (i = 0; i < 8; i++)
+    h[i] = m[i] ^ p[i];
+}
+
+#undef SKEIN_MIX
+#undef SKEIN_MIX8
+#undef SKEIN_ADDKEY
+
+MB_ATTR static void MB_NAME(skein512)(uint32_t (*hash)[16])
+{
+  V64 m[8], h[8];
+  int i;
+
+  LOAD64(m, hash, 8, sph_dec64le);
+  for (i = 0; i < 8; i++)
+    h[i] = SPLAT64(skein_iv[i]);
+  /* message block: first and final, 64 bytes; then the output block */
+  MB_NAME(skein512_ubi)(h, m, 64, (uint64_t)480 << 55);
+  for (i = 0; i < 8; i++)
+    m[i] = SPLAT64(0);
+  MB_NAME(skein512_ubi)(h, m, 8, (uint64_t)510 << 55);
+  STORE64(hash, h, 8, sph_enc64le);
+}
+
+/* JH-512, bitsliced E8 over the 1024 bit state held as 16 words */
+#define JH_SB(x0, x1, x2, x3, c)   do { \
+    V64 tmp_; \
+    x3 = ~x3; \
+    x0 ^= (c) & ~x2; \
+    tmp_ = (c) ^ (x0 & x1); \
+    x0 ^= x2 & x3; \
+    x3 ^= ~x1 & x2; \
+    x1 ^= x0 & x2; \
+    x2 ^= x0 & ~x3; \
+    x0 ^= x1 | x3; \
+    x3 ^= x1 & x2; \
+    x1 ^= tmp_ & x0; \
+    x2 ^= tmp_; \
+  } while (0)
+
+#define JH_LB(x0, x1, x2, x3, x4, x5, x6, x7)   do { \
+    x4 ^= x1; \
+    x5 ^= x2; \
+    x6 ^= x3 ^ x0; \
+    x7 ^= x0; \
+    x0 ^= x5; \
+    x1 ^= x6; \
+    x2 ^= x7 ^ x4; \
+    x3 ^= x4; \
+  } while (0)
+
+MB_ATTR static void MB_NAME(jh512_e8)(V64 *H)
+{
+  int r, i, w;
+
+  for (r = 0; r < 42; r++) {
+    const uint64_t *c = jh_c + 4 * r;
+
+    for (i = 0; i < 2; i++) {
+      JH_SB(H[0 + i], H[4 + i], H[ 8 + i], H[12 + i], SPLAT64(c[i]));
+      JH_SB(H[2 + i], H[6 + i], H[10 + i], H[14 + i], SPLAT64(c[2 + i]));
+      JH_LB(H[0 + i], H[4 + i], H[8 + i], H[12 + i],
+            H[2 + i], H[6 + i], H[10 + i], H[14 + i]);
+    }
+    w = r % 7;
+    for (i = 2; i < 16; i += 4) {
+      if (w < 6) {
+        V64 mask = SPLAT64(jh_wmask[w]);
+        int n = 1 << w;
+
+        H[i] = ((H[i] >> n) & mask) | ((H[i] & mask) << n);
+        H[i + 1] = ((H[i + 1] >> n) & mask) | ((H[i + 1] & mask) << n);
+      } else {
+        V64 tmp = H[i];
+
+        H[i] = H[i + 1];
+        H[i + 1] = tmp;
+      }
+    }
+  }
+}
+
+#undef JH_SB
+#undef JH_LB
+
+MB_ATTR static void MB_NAME(jh512)(uint32_t (*hash)[16])
+{
+  V64 H[16], m[8];
+  int i, b;
+
+  for (i = 0; i < 16; i++)
+    H[i] = SPLAT64(jh_iv[i]);
+  LOAD64(m, hash, 8, sph_dec64be);
+  for (b = 0; b < 2; b++) {
+    if (b) {
+      /* padding block: the 0x80 marker and the 512 bit length */
+      m[0] = SPLAT64(0x8000000000000000ULL);
+      for (i = 1; i < 7; i++)
+        m[i] = SPLAT64(0);
+      m[7] = SPLAT64(512);
+    }
+    for (i = 0; i < 8; i++)
+      H[i] ^= m[i];
+    MB_NAME(jh512_e8)(H);
+    for (i = 0; i < 8; i++)
+      H[i + 8] ^= m[i];
+  }
+  STORE64(hash, H + 8, 8, sph_enc64be);
+}
+
+/* Keccak-512 of a 64 byte message, on the shared Keccak engine, whose
+ * widest backend that fits takes the lanes */
+MB_ATTR static void MB_NAME(keccak512)(uint32_t (*hash)[16])
+{
+  uint8_t *io[MB_LANES];
+  int l;
+
+  for (l = 0; l < MB_LANES; l++)
+    io[l] = (uint8_t *)hash[l];
+  keccakf_hash_multi(io, 64, (const uint8_t *const *)io, 64, 72, KECCAK_PAD_KECCAK, MB_LANES);
+}
+
+/* CubeHash16/32-512 of a 64 byte message, on 32 bit lanes */
+MB_ATTR static void MB_NAME(cubehash512_rounds)(V32 *x, int rounds)
+{
+  V32 t;
+  int i, r;
+
+  for (r = 0; r < rounds; r++) {
+    MB_UNROLL
+    for (i = 0; i < 16; i++) {
+      x[i + 16] += x[i];
+      x[i] = ROTL32(x[i], 7);
+    }
+    MB_UNROLL
+    for (i = 0; i < 8; i++) {
+      t = x[i];
+      x[i] = x[i + 8];
+      x[i + 8] = t;
+    }
+    MB_UNROLL
+    for (i = 0; i < 16; i++)
+      x[i] ^= x[i + 16];
+    MB_UNROLL
+    for (i = 16; i < 32; i += 4) {
+      t = x[i];
+      x[i] = x[i + 2];
+      x[i + 2] = t;
+      t = x[i + 1];
+      x[i + 1] = x[i + 3];
+      x[i + 3] = t;
+    }
+    MB_UNROLL
+    for (i = 0; i < 16; i++) {
+      x[i + 16] += x[i];
+      x[i] = ROTL32(x[i], 11);
+    }
+    MB_UNROLL
+    for (i = 0; i < 16; i += 8) {
+      t = x[i];     x[i]     = x[i + 4]; x[i + 4] = t;
+      t = x[i + 1]; x[i + 1] = x[i + 5]; x[i + 5] = t;
+      t = x[i + 2]; x[i + 2] = x[i + 6]; x[i + 6] = t;
+      t = x[i + 3]; x[i + 3] = x[i + 7]; x[i + 7] = t;
+    }
+    MB_UNROLL
+    for (i = 0; i < 16; i++)
+      x[i] ^= x[i + 16];
+    MB_UNROLL
+    for (i = 16; i < 32; i += 2) {
+      t = x[i];
+      x[i] = x[i + 1];
+      x[i + 1] = t;
+    }
+  }
+}
+
+MB_ATTR static void MB_NAME(cubehash512)(uint32_t (*hash)[16])
+{
+  V32 x[32];
+  int i, l;
+
+  for (i = 0; i < 32; i++)
+    x[i] = SPLAT32(cubehash_iv[i]);
+  for (i = 0; i < 16; i++) {
+    for (l = 0; l < MB_LANES; l++)
+      x[i & 7][l] ^= sph_dec32le((const unsigned char *)hash[l] + 4 * i);
+    if ((i & 7) == 7)
+      MB_NAME(cubehash512_rounds)(x, 16);
+  }
+  x[0] ^= SPLAT32(0x80);
+  MB_NAME(cubehash512_rounds)(x, 16);
+  x[31] ^= SPLAT32(1);
+  MB_NAME(cubehash512_rounds)(x, 160);
+  for (i = 0; i < 16; i++)
+    for (l = 0; l < MB_LANES; l++)
+      sph_enc32le((unsigned char *)hash[l] + 4 * i, x[i][l]);
+}
+
+static const mb512_backend MB_NAME(mb512) = {
+  MB_LABEL, MB_LANES,
+  MB_NAME(blake512_80),
+  MB_NAME(bmw512),
+  MB_NAME(skein512),
+  MB_NAME(jh512),
+  MB_NAME(keccak512),
+  MB_NAME(cubehash512)
+};
+
+#undef V64
+#undef V32
+#undef SPLAT64
+#undef SPLAT32
+#undef ROTL64
+#undef ROTR64
+#undef ROTL32
+#undef MB_UNROLL
+#undef LOAD64
+#undef STORE64
@@ -29,10 +29,20 @@
 
 #include "config.h"
 #include "miner.h"
+#include "findnonce.h"
+#include "algorithm/scrypt.h"
 
+#include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <pthread.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 typedef struct SHA256Context {
 	uint32_t state[8];
@@ -391,17 +401,277 @@ static void scrypt_n_1_1_256_sp(const uint32_t* input, char* scratchpad, uint32_
 	PBKDF2_SHA256_80_128_32(input, X, ostate);
 }
 
+#ifdef __SSE2__
+/**
+ * salsa20_8_x4(B, Bx):
+ * salsa20_8() on four independent blocks, word i of lane l in lane l of B[i].
+ */
+static inline void
+salsa20_8_x4(__m128i B[16], const __m128i Bx[16])
+{
+	__m128i x[16];
+	size_t i;
+
+	for (i = 0; i < 16; i++)
+		x[i] = B[i] = _mm_xor_si128(B[i], Bx[i]);
+	for (i = 0; i < 8; i += 2) {
+#define R(a,b) _mm_or_si128(_mm_slli_epi32(a, b), _mm_srli_epi32(a, 32 - (b)))
+#define Q(d,s,t,b) x[d] = _mm_xor_si128(x[d], R(_mm_add_epi32(x[s], x[t]), b))
+		/* Operate on columns. */
+		Q( 4, 0,12, 7);	Q( 9, 5, 1, 7);	Q(14,10, 6, 7);	Q( 3,15,11, 7);
+		Q( 8, 4, 0, 9);	Q(13, 9, 5, 9);	Q( 2,14,10, 9);	Q( 7, 3,15, 9);
+		Q(12, 8, 4,13);	Q( 1,13, 9,13);	Q( 6, 2,14,13);	Q(11, 7, 3,13);
+		Q( 0,12, 8,18);	Q( 5, 1,13,18);	Q(10, 6, 2,18);	Q(15,11, 7,18);
+
+		/* Operate on rows. */
+		Q( 1, 0, 3, 7);	Q( 6, 5, 4, 7);	Q(11,10, 9, 7);	Q(12,15,14, 7);
+		Q( 2, 1, 0, 9);	Q( 7, 6, 5, 9);	Q( 8,11,10, 9);	Q(13,12,15, 9);
+		Q( 3, 2, 1,13);	Q( 4, 7, 6,13);	Q( 9, 8,11,13);	Q(14,13,12,13);
+		Q( 0, 3, 2,18);	Q( 5, 4, 7,18);	Q(10, 9, 8,18);	Q(15,14,13,18);
+#undef Q
+#undef R
+	}
+	for (i = 0; i < 16; i++)
+		B[i] = _mm_add_epi32(B[i], x[i]);
+}
+
+/* Swaps between four words of one lane per vector and one word of four
+ * lanes per vector */
+#define TRANSPOSE4(r0, r1, r2, r3) do { \
+	__m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpacklo_epi32(r2, r3); \
+	__m128i t2 = _mm_unpackhi_epi32(r0, r1), t3 = _mm_unpackhi_epi32(r2, r3); \
+	r0 = _mm_unpacklo_epi64(t0, t1); r1 = _mm_unpackhi_epi64(t0, t1); \
+	r2 = _mm_unpacklo_epi64(t2, t3); r3 = _mm_unpackhi_epi64(t2, t3); \
+} while (0)
+
+/* scrypt_n_1_1_256_sp() on four inputs at once. Each lane keeps its own
+ * contiguous V, so the random reads of the second loop touch the same
+ * cache lines as the scalar code, but four of them are in flight at once.
+ * scratchpad size needs to be at least 63 + 4 * 128 * N bytes.
+ */
+static void scrypt_n_1_1_256_sp_x4(const uint32_t input[4][20], char* scratchpad, uint32_t ostate[4][8], uint32_t n)
+{
+	__m128i X[32], *V[4];
+	uint32_t L[4][32];
+	uint32_t i, j[4], k, l;
+
+	for (l = 0; l < 4; l++) {
+		V[l] = (__m128i *)(((uintptr_t)(scratchpad) + 63) & ~ (uintptr_t)(63)) + (size_t)l * n * 8;
+		PBKDF2_SHA256_80_128(input[l], L[l]);
+	}
+	for (k = 0; k < 32; k++)
+		X[k] = _mm_set_epi32(L[3][k], L[2][k], L[1][k], L[0][k]);
+
+	for (i = 0; i < n; i++) {
+		for (k = 0; k < 32; k += 4) {
+			__m128i a = X[k], b = X[k + 1], c = X[k + 2], d = X[k + 3];
+
+			TRANSPOSE4(a, b, c, d);
+			_mm_store_si128(&V[0][i * 8 + k / 4], a);
+			_mm_store_si128(&V[1][i * 8 + k / 4], b);
+			_mm_store_si128(&V[2][i * 8 + k / 4], c);
+			_mm_store_si128(&V[3][i * 8 + k / 4], d);
+		}
+
+		salsa20_8_x4(&X[0], &X[16]);
+		salsa20_8_x4(&X[16], &X[0]);
+	}
+	for (i = 0; i < n; i++) {
+		_mm_storeu_si128((__m128i *)j, X[16]);
+		for (l = 0; l < 4; l++)
+			j[l] = (j[l] & (n-1)) * 8;
+		for (k = 0; k < 32; k += 4) {
+			__m128i a = _mm_load_si128(&V[0][j[0] + k / 4]);
+			__m128i b = _mm_load_si128(&V[1][j[1] + k / 4]);
+			__m128i c = _mm_load_si128(&V[2][j[2] + k / 4]);
+			__m128i d = _mm_load_si128(&V[3][j[3] + k / 4]);
+
+			TRANSPOSE4(a, b, c, d);
+			X[k] = _mm_xor_si128(X[k], a);
+			X[k + 1] = _mm_xor_si128(X[k + 1], b);
+			X[k + 2] = _mm_xor_si128(X[k + 2], c);
+			X[k + 3] = _mm_xor_si128(X[k + 3], d);
+		}
+
+		salsa20_8_x4(&X[0], &X[16]);
+		salsa20_8_x4(&X[16], &X[0]);
+	}
+
+	for (k = 0; k < 32; k++) {
+		uint32_t w[4];
+
+		_mm_storeu_si128((__m128i *)w, X[k]);
+		for (l = 0; l < 4; l++)
+			L[l][k] = w[l];
+	}
+	for (l = 0; l < 4; l++)
+		PBKDF2_SHA256_80_128_32(input[l], L[l], ostate[l]);
+}
+#undef TRANSPOSE4
+#endif /* __SSE2__ */
+
+/* Only interleave while the four scratchpads stay reasonably small, past
+ * that memory bandwidth dominates and the footprint is not worth it */
+#define SCRYPT_BATCH_MAX_BYTES (64UL << 20)
+
+/* Every thread that verifies scrypt shares keeps its scratchpad between
+ * calls instead of putting up to 128 * N bytes on its stack each time.
+ * Large pads are mapped on huge pages when the system has them. */
+typedef struct {
+	char *buf;
+	size_t size;
+	int mapped;
+} scrypt_scratch_t;
+
+static pthread_key_t scrypt_scratch_key;
+static pthread_once_t scrypt_scratch_once = PTHREAD_ONCE_INIT;
+static int scrypt_scratch_key_failed;
+
+static void scrypt_scratch_release(scrypt_scratch_t *sp)
+{
+	if (!sp->buf)
+		return;
+#ifndef WIN32
+	if (sp->mapped)
+		munmap(sp->buf, sp->size);
+	else
+#endif
+		free(sp->buf);
+	sp->buf = NULL;
+	sp->size = 0;
+}
+
+static void scrypt_scratch_free(void *ptr)
+{
+	scrypt_scratch_release((scrypt_scratch_t *)ptr);
+	free(ptr);
+}
+
+static void scrypt_scratch_key_init(void)
+{
+	if (pthread_key_create(&scrypt_scratch_key, scrypt_scratch_free))
+		scrypt_scratch_key_failed = 1;
+}
+
+static char *scrypt_thread_scratch(size_t size)
+{
+	scrypt_scratch_t *sp;
+
+	if (pthread_once(&scrypt_scratch_once, scrypt_scratch_key_init) || scrypt_scratch_key_failed)
+		return NULL;
+
+	sp = (scrypt_scratch_t *)pthread_getspecific(scrypt_scratch_key);
+	if (sp == NULL) {
+		sp = (scrypt_scratch_t *)calloc(1, sizeof(*sp));
+		if (sp == NULL)
+			return NULL;
+		if (pthread_setspecific(scrypt_scratch_key, sp)) {
+			free(sp);
+			return NULL;
+		}
+	}
+	if (sp->size >= size)
+		return sp->buf;
+
+	scrypt_scratch_release(sp);
+#if !defined(WIN32) && defined(MAP_ANONYMOUS)
+	{
+		size_t len = (size + (2UL << 20) - 1) & ~((2UL << 20) - 1);
+		void *p = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+		if (len >= (2UL << 20))
+			p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+		if (p == MAP_FAILED) {
+			p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+			if (p != MAP_FAILED)
+				madvise(p, len, MADV_HUGEPAGE);
+#endif
+		}
+		if (p != MAP_FAILED) {
+			sp->buf = (char *)p;
+			sp->size = len;
+			sp->mapped = 1;
+			return sp->buf;
+		}
+	}
+#endif
+	sp->buf = (char *)malloc(size);
+	if (sp->buf == NULL)
+		return NULL;
+	sp->size = size;
+	sp->mapped = 0;
+	return sp->buf;
+}
+
+void scrypt_hash(const uint32_t data[20], uint32_t n, uint32_t hash[8])
+{
+	char *scratchbuf = scrypt_thread_scratch((size_t)n * 128 + 63);
+
+	if (scratchbuf == NULL) {
+		memset(hash, 0xff, 32);
+		return;
+	}
+	scrypt_n_1_1_256_sp(data, scratchbuf, hash, n);
+}
+
+void scrypt_hash_batch(const uint32_t data[][20], int count, uint32_t n, uint32_t hash[][8])
+{
+	int i = 0;
+
+#ifdef __SSE2__
+	if ((size_t)n * 128 * 4 <= SCRYPT_BATCH_MAX_BYTES) {
+		/* A group of at least two pays for the idle lanes */
+		for (; count - i >= 2; i += 4) {
+			uint32_t in[4][20], out[4][8];
+			char *scratchbuf = scrypt_thread_scratch((size_t)n * 128 * 4 + 63);
+			int l, lanes = count - i < 4 ? count - i : 4;
+
+			if (scratchbuf == NULL)
+				break;
+			for (l = 0; l < 4; l++)
+				memcpy(in[l], data[i + (l < lanes ? l : 0)], 80);
+			scrypt_n_1_1_256_sp_x4((const uint32_t (*)[20])in, scratchbuf, out, n);
+			for (l = 0; l < lanes; l++)
+				memcpy(hash[i + l], out[l], 32);
+		}
+	}
+#endif
+	for (; i < count; i++)
+		scrypt_hash(data[i], n, hash[i]);
+}
+
 void scrypt_regenhash(struct work *work)
 {
 	uint32_t data[20];
-	char *scratchbuf;
 	uint32_t *nonce = (uint32_t *)(work->data + 76);
 	uint32_t *ohash = (uint32_t *)(work->hash);
 
 	be32enc_vect(data, (const uint32_t *)work->data, 19);
 	data[19] = htobe32(*nonce);
 
-	scratchbuf = (char *)alloca(work->pool->algorithm.n * 128 + 512);
-	scrypt_n_1_1_256_sp(data, scratchbuf, ohash, work->pool->algorithm.n);
+	scrypt_hash(data, work->pool->algorithm.n, ohash);
 	flip32(ohash, ohash);
 }
+
+/* scrypt_regenhash() for several nonces of the same work. hashes[i] gets
+ * what work->hash would hold after regenerating with nonces[i]. */
+void scrypt_regenhash_batch(struct work *work, const uint32_t *nonces, int count, uint32_t (*hashes)[8])
+{
+	uint32_t data[MAXBUFFERS][20];
+	int i;
+
+	assert(count <= MAXBUFFERS);
+	be32enc_vect(data[0], (const uint32_t *)work->data, 19);
+	for (i = 0; i < count; i++) {
+		if (i)
+			memcpy(data[i], data[0], 76);
+		data[i][19] = htobe32(htole32(nonces[i]));
+	}
+
+	scrypt_hash_batch((const uint32_t (*)[20])data, count, work->pool->algorithm.n, hashes);
+	for (i = 0; i < count; i++)
+		flip32(hashes[i], hashes[i]);
+}
@@ -6,5 +6,11 @@
 /* extern int scrypt_test(unsigned char *pdata, const unsigned char *ptarget, */
 /* 			uint32_t nonce); */
 extern void scrypt_regenhash(struct work *work);
+extern void scrypt_regenhash_batch(struct work *work, const uint32_t *nonces, int count, uint32_t (*hashes)[8]);
+
+/* Raw scrypt(N, 1, 1) of 80 byte big-endian headers, using a per-thread
+ * scratchpad. The batch variant interleaves up to four inputs. */
+extern void scrypt_hash(const uint32_t data[20], uint32_t n, uint32_t hash[8]);
+extern void scrypt_hash_batch(const uint32_t data[][20], int count, uint32_t n, uint32_t hash[][8]);
 
 #endif /* SCRYPT_H */
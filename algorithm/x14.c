@@ -29,7 +29,9 @@
 
 #include "config.h"
 #include "miner.h"
+#include "findnonce.h"
 
+#include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -50,6 +52,8 @@
 #include "sph/sph_fugue.h"
 #include "sph/sph_shabal.h"
 
+#include "mb512.h"
+
 /* Move init out of loop, so init once externally, and then use one single memcpy with that bigger memory block */
 typedef struct {
   sph_blake512_context    blake1;
@@ -184,6 +188,33 @@ void x14_regenhash(struct work *work)
   x14hash(ohash, data);
 }
 
+/* x14_regenhash() for several nonces of the same work, the X11 part
+ * of the chain running across nonces. hashes[i] gets what work->hash
+ * would hold after regenerating with nonces[i]. */
+void x14_regenhash_batch(struct work *work, const uint32_t *nonces, int count, uint32_t (*hashes)[8])
+{
+  uint32_t hash[MAXBUFFERS][16];
+  sph_hamsi512_context hamsi;
+  sph_fugue512_context fugue;
+  sph_shabal512_context shabal;
+  int i;
+
+  assert(count <= MAXBUFFERS);
+  mb512_x11_work(work, nonces, count, hash);
+  for (i = 0; i < count; i++) {
+    sph_hamsi512_init(&hamsi);
+    sph_hamsi512(&hamsi, hash[i], 64);
+    sph_hamsi512_close(&hamsi, hash[i]);
+    sph_fugue512_init(&fugue);
+    sph_fugue512(&fugue, hash[i], 64);
+    sph_fugue512_close(&fugue, hash[i]);
+    sph_shabal512_init(&shabal);
+    sph_shabal512(&shabal, hash[i], 64);
+    sph_shabal512_close(&shabal, hash[i]);
+    memcpy(hashes[i], hash[i], 32);
+  }
+}
+
 bool scanhash_x14(struct thr_info *thr, const unsigned char __maybe_unused *pmidstate,
          unsigned char *pdata, unsigned char __maybe_unused *phash1,
          unsigned char __maybe_unused *phash, const unsigned char *ptarget,
@@ -28,15 +28,20 @@
  * online backup system.
  */
 
+#ifndef __SSE2__
 #ifdef __i386__
 #warning "This implementation does not use SIMD, and thus it runs a lot slower than the SIMD-enabled implementation. Enable at least SSE2 in the C compiler and use yescrypt-best.c instead unless you're building this SIMD-less implementation on purpose (portability to older CPUs or testing)."
 #elif defined(__x86_64__)
 #warning "This implementation does not use SIMD, and thus it runs a lot slower than the SIMD-enabled implementation. Use yescrypt-best.c instead unless you're building this SIMD-less implementation on purpose (for testing only)."
 #endif
+#endif
 
 #include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "algorithm/yescrypt_core.h"
 #include "sph/sha256_Y.h"
 #include "algorithm/sysendian.h"
@@ -279,6 +284,61 @@ salsa20_simd_unshuffle(const salsa20_blk_t * Bin, salsa20_blk_t * Bout)
  * Apply the salsa20/8 core to the provided block.
  */
 
+#ifdef __SSE2__
+/*
+ * B is kept in the SIMD-shuffled layout above, so each 128-bit lane already
+ * holds one salsa20 diagonal and the rounds can run without unshuffling.
+ */
+#define ARX(out, in1, in2, s) \
+	{ \
+		__m128i T = _mm_add_epi32(in1, in2); \
+		out = _mm_xor_si128(out, _mm_slli_epi32(T, s)); \
+		out = _mm_xor_si128(out, _mm_srli_epi32(T, 32 - s)); \
+	}
+
+static void
+salsa20_8(uint64_t B[8])
+{
+	__m128i *b = (__m128i *)B;
+	__m128i X0, X1, X2, X3;
+	size_t i;
+
+	X0 = _mm_loadu_si128(&b[0]);
+	X1 = _mm_loadu_si128(&b[1]);
+	X2 = _mm_loadu_si128(&b[2]);
+	X3 = _mm_loadu_si128(&b[3]);
+
+	for (i = 0; i < 8; i += 2) {
+		/* Operate on "columns" */
+		ARX(X1, X0, X3, 7)
+		ARX(X2, X1, X0, 9)
+		ARX(X3, X2, X1, 13)
+		ARX(X0, X3, X2, 18)
+
+		/* Rearrange data */
+		X1 = _mm_shuffle_epi32(X1, 0x93);
+		X2 = _mm_shuffle_epi32(X2, 0x4E);
+		X3 = _mm_shuffle_epi32(X3, 0x39);
+
+		/* Operate on "rows" */
+		ARX(X3, X0, X1, 7)
+		ARX(X2, X3, X0, 9)
+		ARX(X1, X2, X3, 13)
+		ARX(X0, X1, X2, 18)
+
+		/* Rearrange data */
+		X1 = _mm_shuffle_epi32(X1, 0x39);
+		X2 = _mm_shuffle_epi32(X2, 0x4E);
+		X3 = _mm_shuffle_epi32(X3, 0x93);
+	}
+
+	_mm_storeu_si128(&b[0], _mm_add_epi32(_mm_loadu_si128(&b[0]), X0));
+	_mm_storeu_si128(&b[1], _mm_add_epi32(_mm_loadu_si128(&b[1]), X1));
+	_mm_storeu_si128(&b[2], _mm_add_epi32(_mm_loadu_si128(&b[2]), X2));
+	_mm_storeu_si128(&b[3], _mm_add_epi32(_mm_loadu_si128(&b[3]), X3));
+}
+#undef ARX
+#else
 static void
 salsa20_8(uint64_t B[8])
 {
@@ -331,6 +391,7 @@ salsa20_8(uint64_t B[8])
 		}
 	}
 }
+#endif
 
 /**
  * blockmix_salsa8(Bin, Bout, X, r):
@@ -109,12 +109,6 @@ void yescryptr16_regenhash(struct work *work)
         data[19] = htobe32(*nonce);	
 
 		yescryptr16_hash((unsigned char*)data, (unsigned char*)ohash);
-#if 1
-        memcpy(work->hash, work->target, 32);
-		work->hash[0] = 0;
-		work->hash[1] = 0;
-#endif
-        
 }
 
 bool scanhash_yescrypt(struct thr_info *thr, const unsigned char __maybe_unused *pmidstate,
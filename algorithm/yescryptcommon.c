@@ -21,6 +21,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
 #include "algorithm/yescrypt_core.h"
 
 #define BYTES2CHARS(bytes) \
@@ -326,47 +327,78 @@ yescrypt_gensalt(uint32_t N_log2, uint32_t r, uint32_t p,
 	    buf, sizeof(buf));
 }
 
+/*
+ * The shared region carries no ROM and is only read by yescrypt_kdf(), so one
+ * copy serves every thread.  The local region holds V and the S-boxes and is
+ * kept per thread, so GPU verification threads can hash concurrently and
+ * reuse their allocation instead of mapping it again for every share.
+ */
+static yescrypt_shared_t bsty_shared;
+static pthread_key_t bsty_local_key;
+static pthread_once_t bsty_once = PTHREAD_ONCE_INIT;
+static int bsty_init_failed;
+
+static void bsty_free_local(void *ptr)
+{
+	yescrypt_local_t *local = (yescrypt_local_t *)ptr;
+
+	yescrypt_free_local(local);
+	free(local);
+}
+
+static void bsty_init(void)
+{
+	if (yescrypt_init_shared(&bsty_shared, NULL, 0,
+	    0, 0, 0, YESCRYPT_SHARED_DEFAULTS, 0, NULL, 0) ||
+	    pthread_key_create(&bsty_local_key, bsty_free_local))
+		bsty_init_failed = 1;
+}
+
+static yescrypt_local_t *bsty_get_local(void)
+{
+	yescrypt_local_t *local;
+
+	if (pthread_once(&bsty_once, bsty_init) || bsty_init_failed)
+		return NULL;
+
+	local = (yescrypt_local_t *)pthread_getspecific(bsty_local_key);
+	if (local)
+		return local;
+
+	local = (yescrypt_local_t *)malloc(sizeof(*local));
+	if (!local)
+		return NULL;
+	if (yescrypt_init_local(local)) {
+		free(local);
+		return NULL;
+	}
+	if (pthread_setspecific(bsty_local_key, local)) {
+		bsty_free_local(local);
+		return NULL;
+	}
+	return local;
+}
+
 static int
 yescrypt_bsty(const uint8_t * passwd, size_t passwdlen,
     const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
     uint8_t * buf, size_t buflen)
 {
-	static  int initialized = 0;
-	static  yescrypt_shared_t shared;
-	static  yescrypt_local_t local;
-
-//		static __declspec(thread) int initialized = 0;
-//		static __declspec(thread) yescrypt_shared_t shared;
-//		static  __declspec(thread) yescrypt_local_t local;
-
-	int retval;
-	if (!initialized) {
-/* "shared" could in fact be shared, but it's simpler to keep it private
- * along with "local".  It's dummy and tiny anyway. */
-#ifndef WIN32
-		if (yescrypt_init_shared(&shared, NULL, 0,
-		    0, 0, 0, YESCRYPT_SHARED_DEFAULTS, 0, NULL, 0))
-			return -1;
-		if (yescrypt_init_local(&local)) {
-			yescrypt_free_shared(&shared);
-			return -1;
-		}
-#endif
-		initialized = 1;
- 	}
-#ifndef WIN32
-	retval = yescrypt_kdf(&shared, &local,
-		passwd, passwdlen, salt, saltlen, N, r, p, 0, (yescrypt_flags_t)YESCRYPT_FLAGS,
-	    buf, buflen);	
-#endif	
+	yescrypt_local_t *local = bsty_get_local();
 
-	return retval;
+	if (!local)
+		return -1;
+
+	return yescrypt_kdf(&bsty_shared, local,
+		passwd, passwdlen, salt, saltlen, N, r, p, 0, (yescrypt_flags_t)YESCRYPT_FLAGS,
+	    buf, buflen);
 }
 
 void yescrypt_hash(const unsigned char *input, unsigned char *output)
 {
-
-   yescrypt_bsty((const uint8_t *)input, 80, (const uint8_t *) input, 80, 2048, 8, 1, (uint8_t *)output, 32);
+   /* A failed hash must never pass the target check */
+   if (yescrypt_bsty((const uint8_t *)input, 80, (const uint8_t *) input, 80, 2048, 8, 1, (uint8_t *)output, 32))
+      memset(output, 0xff, 32);
 }
 
 void yescryptr16_hash(const unsigned char *input, unsigned char *output)
@@ -377,5 +409,6 @@ void yescryptr16_hash(const unsigned char *input, unsigned char *output)
 		client_key = "Client Key";
 		client_key_len = 10;
 	}*/
-   yescrypt_bsty((const uint8_t *)input, 80, (const uint8_t *) input, 80, 4096, 16, 1, (uint8_t *)output, 32);
+   if (yescrypt_bsty((const uint8_t *)input, 80, (const uint8_t *) input, 80, 4096, 16, 1, (uint8_t *)output, 32))
+      memset(output, 0xff, 32);
 }
@@ -32,6 +32,7 @@
 #include "util.h"
 #include "pool.h"
 #include "algorithm.h"
+#include "findnonce.h"
 
 #include "config_parser.h"
 
@@ -230,7 +231,7 @@ static const char *BLANK = "";
 static const char *COMMA = ",";
 static const char SEPARATOR = '|';
 static const char GPUSEP = ',';
-static const char *APIVERSION = "4.0";
+static const char *APIVERSION = "4.1";
 static const char *DEAD = "Dead";
 static const char *SICK = "Sick";
 static const char *NOSTART = "NoStart";
@@ -2716,6 +2717,8 @@ static int itemstats(struct io_data *io_data, int i, char *id, struct sgminer_st
 static void minerstats(struct io_data *io_data, __maybe_unused SOCKETTYPE c, __maybe_unused char *param, bool isjson, __maybe_unused char group)
 {
   struct cgpu_info *cgpu;
+  struct api_data *root = NULL;
+  char buf[TMPBUFSIZ];
   bool io_open = false;
   struct api_data *extra;
   char id[20];
@@ -2748,6 +2751,21 @@ static void minerstats(struct io_data *io_data, __maybe_unused SOCKETTYPE c, __m
     i = itemstats(io_data, i, id, &(pool->sgminer_stats), &(pool->sgminer_pool_stats), NULL, NULL, isjson);
   }
 
+  root = api_add_int(root, "STATS", &i, false);
+  root = api_add_const(root, "ID", "VERIFY", false);
+  root = api_add_elapsed(root, "Elapsed", &(total_secs), false);
+  root = postcalc_api_stats(root);
+  root = print_data(root, buf, isjson, isjson && (i > 0));
+  io_add(io_data, buf);
+  i++;
+
+  root = api_add_int(root, "STATS", &i, false);
+  root = api_add_const(root, "ID", "STAGED", false);
+  root = api_add_elapsed(root, "Elapsed", &(total_secs), false);
+  root = staged_api_stats(root);
+  root = print_data(root, buf, isjson, isjson);
+  io_add(io_data, buf);
+
   if (isjson && io_open)
     io_close(io_data);
 }
@@ -0,0 +1,317 @@
+/*
+ * Copyright 2013-2014 sgminer developers (see AUTHORS.md)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.  See COPYING for more details.
+ */
+
+/*
+ * Intensity autotuner, see --gpu-autotune.
+ *
+ * For every worksize candidate the device is started with its buffers
+ * sized for the largest rawintensity candidate, then rawintensity is
+ * stepped up from a quarter of the configured thread count to four times
+ * it. Each step is timed over a few batches with the OpenCL timestamps
+ * the driver collects. The worksize is compiled into the kernels, so
+ * moving to the next one restarts the device. The fastest setting whose
+ * batches finish within the target is kept and saved to the profile file
+ * under the device name, driver version and algorithm, which the next
+ * start picks up without tuning again.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "miner.h"
+#include "autotune.h"
+
+int opt_autotune_ms;
+char *opt_autotune_file = "sgminer-autotune.txt";
+
+static pthread_mutex_t autotune_file_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const int autotune_worksizes[] = { 64, 128, 256 };
+
+/* Fractions of the configured thread count, in quarters */
+static const int autotune_quarters[AUTOTUNE_MAX_RAWS] = { 1, 2, 4, 8, 16 };
+
+/* Key fields are tab separated, so keep tabs and newlines out of them */
+static void autotune_key_add(char *key, size_t size, const char *field)
+{
+  size_t len = strlen(key);
+
+  if (len && len + 1 < size)
+    key[len++] = '\t';
+  for (; *field && len + 1 < size; field++)
+    key[len++] = (*field == '\t' || *field == '\n' || *field == '\r') ? ' ' : *field;
+  key[len] = '\0';
+}
+
+static bool autotune_load(gpu_autotune_t *at)
+{
+  size_t keylen = strlen(at->key);
+  char line[1024];
+  bool found = false;
+  FILE *fp;
+
+  mutex_lock(&autotune_file_lock);
+  fp = fopen(opt_autotune_file, "r");
+  if (fp) {
+    while (!found && fgets(line, sizeof(line), fp)) {
+      if (strncmp(line, at->key, keylen) || line[keylen] != '\t')
+        continue;
+      found = sscanf(line + keylen + 1, "%d\t%d\t%lf\t%lf", &at->best_ws, &at->best_raw,
+        &at->best_rate, &at->best_ms) == 4 && at->best_ws > 0 && at->best_raw > 0;
+    }
+    fclose(fp);
+  }
+  mutex_unlock(&autotune_file_lock);
+
+  if (found)
+    at->best_rate *= 1e6;
+  return found;
+}
+
+/* Rewrite the profile file with this device's entry replaced */
+static void autotune_save(gpu_autotune_t *at)
+{
+  size_t keylen = strlen(at->key);
+  char tmpname[PATH_MAX], line[1024];
+  FILE *in, *out;
+
+  snprintf(tmpname, sizeof(tmpname), "%s.tmp", opt_autotune_file);
+
+  mutex_lock(&autotune_file_lock);
+  out = fopen(tmpname, "w");
+  if (!out) {
+    mutex_unlock(&autotune_file_lock);
+    applog(LOG_WARNING, "Failed to write autotune profiles to %s", tmpname);
+    return;
+  }
+
+  in = fopen(opt_autotune_file, "r");
+  if (in) {
+    while (fgets(line, sizeof(line), in)) {
+      if (!strncmp(line, at->key, keylen) && line[keylen] == '\t')
+        continue;
+      fputs(line, out);
+    }
+    fclose(in);
+  }
+  else
+    fprintf(out, "# device\tdriver\talgorithm\tworksize\trawintensity\tMH/s\tms per batch\n");
+  fprintf(out, "%s\t%d\t%d\t%.3f\t%.2f\n", at->key, at->best_ws, at->best_raw, at->best_rate / 1e6, at->best_ms);
+
+  if (fclose(out)) {
+    remove(tmpname);
+    applog(LOG_WARNING, "Failed to write autotune profiles to %s", tmpname);
+  }
+  else {
+#ifdef WIN32
+    remove(opt_autotune_file);
+#endif
+    if (rename(tmpname, opt_autotune_file))
+      applog(LOG_WARNING, "Failed to replace autotune profiles in %s", opt_autotune_file);
+  }
+  mutex_unlock(&autotune_file_lock);
+}
+
+/* Threads the configured intensity gives, as set_threads_hashes() works it out */
+static unsigned int autotune_base(struct cgpu_info *gpu, unsigned int compute_shaders)
+{
+  algorithm_t *algorithm = &gpu->algorithm;
+
+  if (gpu->rawintensity > 0)
+    return gpu->rawintensity;
+  if (gpu->xintensity > 0)
+    return compute_shaders * ((algorithm->xintensity_shift) ? (1U << (algorithm->xintensity_shift + gpu->xintensity)) : gpu->xintensity);
+  return 1U << (algorithm->intensity_shift + gpu->intensity);
+}
+
+/* Rawintensity candidates for a worksize, whole work groups, ascending */
+static void autotune_raws(gpu_autotune_t *at, int ws)
+{
+  int i;
+
+  at->n_raws = 0;
+  for (i = 0; i < AUTOTUNE_MAX_RAWS; i++) {
+    int raw = (int)(((uint64_t)at->base * autotune_quarters[i] / 4) / ws * ws);
+
+    if (raw < ws)
+      raw = ws;
+    if (!at->n_raws || raw > at->raws[at->n_raws - 1])
+      at->raws[at->n_raws++] = raw;
+  }
+}
+
+static void autotune_next(gpu_autotune_t *at)
+{
+  at->batches = 0;
+  at->hashes = 0;
+  at->ns = 0;
+}
+
+/* Called from initCl() before the buffers are sized and the kernels built.
+ * Applies a saved profile, or sets up the next worksize to sweep. */
+void autotune_prepare(struct cgpu_info *gpu, const char *device, const char *driver, unsigned int compute_shaders,
+  size_t max_work_size)
+{
+  gpu_autotune_t *at = gpu->autotune;
+  char key[sizeof(at->key)] = "";
+  size_t i;
+
+  /* dynamic intensity is tuned by its own loop, MTP and argon2d set their
+   * own thread counts */
+  if (!opt_autotune_ms || gpu->dynamic ||
+      gpu->algorithm.type == ALGO_MTP || gpu->algorithm.type == ALGO_ARGON2D)
+    return;
+
+  autotune_key_add(key, sizeof(key), device);
+  autotune_key_add(key, sizeof(key), driver);
+  autotune_key_add(key, sizeof(key), gpu->algorithm.name);
+
+  /* the algorithm changed, start over */
+  if (at && strcmp(at->key, key)) {
+    free(at);
+    at = gpu->autotune = NULL;
+  }
+
+  if (!at) {
+    at = (gpu_autotune_t *)calloc(1, sizeof(*at));
+    if (!at) {
+      applog(LOG_ERR, "Failed to calloc in autotune_prepare");
+      return;
+    }
+    strcpy(at->key, key);
+    gpu->autotune = at;
+
+    if (autotune_load(at)) {
+      at->state = AUTOTUNE_DONE;
+      applog(LOG_NOTICE, "GPU %d: using autotuned worksize %d, rawintensity %d for %s",
+        gpu->device_id, at->best_ws, at->best_raw, gpu->algorithm.name);
+    }
+    else {
+      /* the configured worksize first, so it is always measured */
+      at->worksizes[at->n_worksizes++] = (gpu->work_size && gpu->work_size <= max_work_size) ? (int)gpu->work_size : 256;
+      for (i = 0; i < sizeof(autotune_worksizes) / sizeof(autotune_worksizes[0]); i++) {
+        if ((size_t)autotune_worksizes[i] <= max_work_size && autotune_worksizes[i] != at->worksizes[0] &&
+            at->n_worksizes < AUTOTUNE_MAX_WORKSIZES)
+          at->worksizes[at->n_worksizes++] = autotune_worksizes[i];
+      }
+      at->base = autotune_base(gpu, compute_shaders);
+      at->state = AUTOTUNE_SWEEP;
+      applog(LOG_NOTICE, "GPU %d: autotuning %s for %d ms batches", gpu->device_id, gpu->algorithm.name, opt_autotune_ms);
+    }
+  }
+
+  if (at->state == AUTOTUNE_DONE) {
+    gpu->work_size = at->best_ws;
+    gpu->rawintensity = at->best_raw;
+    return;
+  }
+
+  at->state = AUTOTUNE_SWEEP;
+  gpu->work_size = at->worksizes[at->ws_index];
+  autotune_raws(at, gpu->work_size);
+  at->raw_index = 0;
+  at->started = false;
+  autotune_next(at);
+  /* size the buffers for the largest candidate */
+  gpu->rawintensity = at->raws[at->n_raws - 1];
+}
+
+bool autotune_sweeping(struct cgpu_info *gpu)
+{
+  return gpu->autotune && gpu->autotune->state == AUTOTUNE_SWEEP;
+}
+
+/* Within the target beats over it, then the faster, or if both are over
+ * it the quicker batch */
+static bool autotune_better(gpu_autotune_t *at, double rate, double ms)
+{
+  bool fits = ms <= opt_autotune_ms, best_fits = at->best_ms <= opt_autotune_ms;
+
+  if (!at->best_raw)
+    return true;
+  if (fits != best_fits)
+    return fits;
+  return fits ? rate > at->best_rate : ms < at->best_ms;
+}
+
+static void autotune_finish(struct cgpu_info *gpu, gpu_autotune_t *at)
+{
+  at->state = AUTOTUNE_DONE;
+  applog(LOG_NOTICE, "GPU %d: autotuned %s to worksize %d, rawintensity %d: %.3f MH/s, %.2f ms per batch",
+    gpu->device_id, gpu->algorithm.name, at->best_ws, at->best_raw, at->best_rate / 1e6, at->best_ms);
+  autotune_save(at);
+
+  gpu->rawintensity = at->best_raw;
+  if ((int)gpu->work_size != at->best_ws) {
+    gpu->work_size = at->best_ws;
+    gpu->drv->reinit_device(gpu);
+  }
+}
+
+/* Account one batch of the device's first thread, timed on the device */
+void autotune_batch(struct cgpu_info *gpu, int64_t hashes, uint64_t ns)
+{
+  gpu_autotune_t *at = gpu->autotune;
+  double rate, ms;
+  bool over;
+
+  if (!at || at->state != AUTOTUNE_SWEEP || !ns)
+    return;
+
+  /* initCl() may have cut the thread count down to what fits */
+  if (!at->started) {
+    while (at->n_raws > 1 && at->raws[at->n_raws - 1] > gpu->rawintensity)
+      at->n_raws--;
+    at->started = true;
+    gpu->rawintensity = at->raws[0];
+    return;
+  }
+
+  if (at->batches++ < AUTOTUNE_WARMUP)
+    return;
+  at->hashes += hashes;
+  at->ns += ns;
+  if (at->batches < AUTOTUNE_WARMUP + AUTOTUNE_SAMPLES)
+    return;
+
+  rate = (double)at->hashes * 1e9 / at->ns;
+  ms = (double)at->ns / 1e6 / AUTOTUNE_SAMPLES;
+  applog(LOG_INFO, "GPU %d: autotune worksize %d, rawintensity %d: %.3f MH/s, %.2f ms per batch",
+    gpu->device_id, at->worksizes[at->ws_index], at->raws[at->raw_index], rate / 1e6, ms);
+  if (autotune_better(at, rate, ms)) {
+    at->best_ws = at->worksizes[at->ws_index];
+    at->best_raw = at->raws[at->raw_index];
+    at->best_rate = rate;
+    at->best_ms = ms;
+  }
+
+  /* larger batches only take longer */
+  over = ms > opt_autotune_ms;
+  autotune_next(at);
+  if (!over && ++at->raw_index < at->n_raws) {
+    gpu->rawintensity = at->raws[at->raw_index];
+    return;
+  }
+
+  if (++at->ws_index < at->n_worksizes) {
+    at->state = AUTOTUNE_RESTART;
+    gpu->work_size = at->worksizes[at->ws_index];
+    applog(LOG_NOTICE, "GPU %d: restarting to autotune worksize %d", gpu->device_id, (int)gpu->work_size);
+    gpu->drv->reinit_device(gpu);
+    return;
+  }
+
+  autotune_finish(gpu, at);
+}
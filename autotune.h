@@ -0,0 +1,49 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "miner.h"
+
+/* Batches thrown away after a setting changes, then batches averaged */
+#define AUTOTUNE_WARMUP   2
+#define AUTOTUNE_SAMPLES  8
+
+#define AUTOTUNE_MAX_WORKSIZES 3
+#define AUTOTUNE_MAX_RAWS      5
+
+enum autotune_state {
+  AUTOTUNE_SWEEP,   /* timing candidates */
+  AUTOTUNE_RESTART, /* waiting for the device to come back with a new worksize */
+  AUTOTUNE_DONE     /* running the chosen profile */
+};
+
+/* Per device tuner state, kept across device restarts */
+typedef struct gpu_autotune {
+  char key[512];    /* device, driver and algorithm, tab separated */
+  enum autotune_state state;
+
+  int worksizes[AUTOTUNE_MAX_WORKSIZES];
+  int n_worksizes, ws_index;
+  unsigned int base;  /* threads the configured intensity gives */
+  int raws[AUTOTUNE_MAX_RAWS];
+  int n_raws, raw_index;
+  bool started;       /* raws trimmed to what the device could allocate */
+
+  /* batches timed for the current candidate */
+  int batches;
+  int64_t hashes;
+  uint64_t ns;
+
+  /* best candidate so far */
+  int best_ws, best_raw;
+  double best_rate, best_ms;
+} gpu_autotune_t;
+
+extern int opt_autotune_ms;
+extern char *opt_autotune_file;
+
+extern void autotune_prepare(struct cgpu_info *gpu, const char *device, const char *driver, unsigned int compute_shaders,
+  size_t max_work_size);
+extern bool autotune_sweeping(struct cgpu_info *gpu);
+extern void autotune_batch(struct cgpu_info *gpu, int64_t hashes, uint64_t ns);
+
+#endif /* AUTOTUNE_H */
@@ -34,6 +34,8 @@
 #include "ocl.h"
 #include "adl.h"
 #include "util.h"
+#include "api.h"
+#include "autotune.h"
 
 #include "algorithm/argon2d/argon2d.h"
 
@@ -217,6 +219,31 @@ char *set_thread_concurrency(const char *arg)
   return NULL;
 }
 
+static char resident_algos[MAX_RESIDENT_ALGOS][sizeof(((algorithm_t *)0)->name)];
+static int n_resident_algos;
+
+char *set_gpu_resident(const char *_arg)
+{
+  algorithm_t algorithm;
+  char *nextptr;
+  char *arg = (char *)alloca(strlen(_arg) + 1);
+  strcpy(arg, _arg);
+
+  n_resident_algos = 0;
+  for (nextptr = strtok(arg, ","); nextptr; nextptr = strtok(NULL, ",")) {
+    if (n_resident_algos >= MAX_RESIDENT_ALGOS)
+      return "Too many algorithms passed to set_gpu_resident";
+
+    memset(&algorithm, 0, sizeof(algorithm));
+    set_algorithm(&algorithm, nextptr);
+    if (empty_string(algorithm.name))
+      return "Unknown algorithm passed to set_gpu_resident";
+    strcpy(resident_algos[n_resident_algos++], algorithm.name);
+  }
+
+  return NULL;
+}
+
 #ifdef HAVE_ADL
 /* This function allows us to map an adl device to an opencl device for when
  * simple enumeration has failed to match them. */
@@ -1264,12 +1291,206 @@ static void get_opencl_statline(char *buf, size_t bufsiz, struct cgpu_info *gpu)
     tailsprintf(buf, bufsiz, " I:%2d", gpu->intensity);
 }
 
+/* A batch whose results are still on their way back from the GPU */
+struct opencl_batch {
+  uint32_t *res;      /* host copy of outputBuffer */
+  struct work *work;  /* copy of the work the batch hashed */
+  cl_event begin;     /* marker queued ahead of the batch's kernels */
+  cl_event done;      /* read of outputBuffer behind them */
+  int64_t hashes;
+  bool pending;
+};
+
 struct opencl_thread_data {
   cl_int(*queue_kernel_parameters)(_clState *, dev_blk_ctx *, cl_uint);
   uint32_t *res;
+  int depth;          /* batches in flight, 1 when not pipelined */
+  int next;           /* slot the next batch goes to */
+  cl_ulong last_end;  /* device time the previous batch finished */
+  struct opencl_batch batch[MAX_PIPELINE_DEPTH];
 };
 
 static uint32_t *blank_res;
+static pthread_mutex_t blank_res_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Batches a thread may keep in flight for its algorithm. Ethash holds the
+ * DAG lock until its batch is read back, MTP reads its own results and
+ * an out-of-order queue does not keep the result read behind the
+ * kernels, so those run one batch at a time. */
+static int opencl_pipeline_depth(struct cgpu_info *gpu)
+{
+  if (gpu->algorithm.type == ALGO_ETHASH || gpu->algorithm.type == ALGO_MTP ||
+      (gpu->algorithm.cq_properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE))
+    return 1;
+  return opt_gpu_pipeline;
+}
+
+static void opencl_free_batches(struct opencl_thread_data *thrdata)
+{
+  int i;
+
+  for (i = 0; i < MAX_PIPELINE_DEPTH; i++) {
+    struct opencl_batch *b = &thrdata->batch[i];
+
+    if (b->begin)
+      clReleaseEvent(b->begin);
+    if (b->done)
+      clReleaseEvent(b->done);
+    if (b->work)
+      free_work(b->work);
+    free(b->res);
+    memset(b, 0, sizeof(*b));
+  }
+}
+
+static void opencl_release_state(_clState *clState)
+{
+  unsigned int i;
+
+  clFinish(clState->commandQueue);
+  clReleaseMemObject(clState->outputBuffer);
+  clReleaseMemObject(clState->CLbuffer0);
+  if (clState->buffer1)
+    clReleaseMemObject(clState->buffer1);
+  if (clState->buffer2)
+    clReleaseMemObject(clState->buffer2);
+  if (clState->buffer3)
+    clReleaseMemObject(clState->buffer3);
+  if (clState->buffer4)
+    clReleaseMemObject(clState->buffer4);
+  if (clState->buffer5)
+    clReleaseMemObject(clState->buffer5);
+  if (clState->MidstateBuf)
+    clReleaseMemObject(clState->MidstateBuf);
+  if (clState->MatrixBuf)
+    clReleaseMemObject(clState->MatrixBuf);
+  if (clState->padbuffer8)
+    clReleaseMemObject(clState->padbuffer8);
+  clReleaseKernel(clState->kernel);
+  if (clState->GenerateDAG)
+    clReleaseKernel(clState->GenerateDAG);
+  for (i = 0; i < clState->n_extra_kernels; i++)
+    clReleaseKernel(clState->extra_kernels[i]);
+  clReleaseProgram(clState->program);
+  clReleaseCommandQueue(clState->commandQueue);
+  clReleaseContext(clState->context);
+  if (clState->extra_kernels)
+    free(clState->extra_kernels);
+  free(clState);
+}
+
+/* The device settings initCl() sizes buffers and kernels from, and may
+ * adjust */
+struct opencl_settings {
+  int intensity, xintensity, rawintensity;
+  cl_uint vwidth;
+  size_t work_size;
+  int opt_lg, lookup_gap;
+  size_t opt_tc, thread_concurrency;
+  size_t shaders;
+  unsigned int throughput;
+};
+
+/* A thread's _clState for one algorithm, see --gpu-resident */
+struct opencl_resident {
+  _clState *clState;
+  algorithm_t algorithm;  /* as the pool set it */
+  algorithm_t built;      /* as initCl() left it, e.g. with _navi */
+  struct opencl_settings in, out;
+};
+
+/* What each thread runs now, and what it keeps for later */
+static struct opencl_resident running[MAX_GPUDEVICES];
+static struct opencl_resident resident[MAX_GPUDEVICES][MAX_RESIDENT_ALGOS];
+
+static void opencl_get_settings(struct cgpu_info *cgpu, struct opencl_settings *s)
+{
+  memset(s, 0, sizeof(*s));
+  s->intensity = cgpu->intensity;
+  s->xintensity = cgpu->xintensity;
+  s->rawintensity = cgpu->rawintensity;
+  s->vwidth = cgpu->vwidth;
+  s->work_size = cgpu->work_size;
+  s->opt_lg = cgpu->opt_lg;
+  s->lookup_gap = cgpu->lookup_gap;
+  s->opt_tc = cgpu->opt_tc;
+  s->thread_concurrency = cgpu->thread_concurrency;
+  s->shaders = cgpu->shaders;
+  s->throughput = cgpu->throughput;
+}
+
+static void opencl_set_settings(struct cgpu_info *cgpu, const struct opencl_settings *s)
+{
+  cgpu->intensity = s->intensity;
+  cgpu->xintensity = s->xintensity;
+  cgpu->rawintensity = s->rawintensity;
+  cgpu->vwidth = s->vwidth;
+  cgpu->work_size = s->work_size;
+  cgpu->opt_lg = s->opt_lg;
+  cgpu->lookup_gap = s->lookup_gap;
+  cgpu->opt_tc = s->opt_tc;
+  cgpu->thread_concurrency = s->thread_concurrency;
+  cgpu->shaders = s->shaders;
+  cgpu->throughput = s->throughput;
+}
+
+/* Slot the algorithm is kept in, -1 if it is not kept. The ethash DAG
+ * belongs to the device rather than to _clState, so it is always
+ * rebuilt. */
+static int opencl_resident_slot(const algorithm_t *algorithm)
+{
+  int i;
+
+  if (algorithm->type == ALGO_ETHASH)
+    return -1;
+  for (i = 0; i < n_resident_algos; i++) {
+    if (!strcmp(resident_algos[i], algorithm->name))
+      return i;
+  }
+  return -1;
+}
+
+static void opencl_release_resident(int thr_id)
+{
+  int i;
+
+  for (i = 0; i < MAX_RESIDENT_ALGOS; i++) {
+    struct opencl_resident *r = &resident[thr_id][i];
+
+    if (r->clState)
+      opencl_release_state(r->clState);
+    memset(r, 0, sizeof(*r));
+  }
+}
+
+/* Take the kept state for the algorithm the device is set to, if it was
+ * built from the same settings */
+static _clState *opencl_take_resident(int thr_id, struct cgpu_info *cgpu)
+{
+  struct opencl_settings in;
+  struct opencl_resident *r;
+  _clState *clState;
+  int slot = opencl_resident_slot(&cgpu->algorithm);
+
+  if (slot < 0 || !resident[thr_id][slot].clState)
+    return NULL;
+
+  r = &resident[thr_id][slot];
+  opencl_get_settings(cgpu, &in);
+  if (!cmp_algorithm(&r->algorithm, &cgpu->algorithm) || memcmp(&r->in, &in, sizeof(in))) {
+    applog(LOG_DEBUG, "GPU %d: settings for %s changed, rebuilding", cgpu->device_id, cgpu->algorithm.name);
+    opencl_release_state(r->clState);
+    memset(r, 0, sizeof(*r));
+    return NULL;
+  }
+
+  clState = r->clState;
+  cgpu->algorithm = r->built;
+  opencl_set_settings(cgpu, &r->out);
+  running[thr_id] = *r;
+  memset(r, 0, sizeof(*r));
+  return clState;
+}
 
 static bool opencl_thread_prepare(struct thr_info *thr)
 {
@@ -1282,16 +1503,29 @@ static bool opencl_thread_prepare(struct thr_info *thr)
   static bool failmessage = false;
   int buffersize = BUFFERSIZE;
 
+  /* devices are prepared concurrently, see --gpu-init-threads */
+  mutex_lock(&blank_res_lock);
   if (!blank_res)
     blank_res = (uint32_t *)calloc(buffersize, 1);
+  mutex_unlock(&blank_res_lock);
   if (!blank_res) {
     applog(LOG_ERR, "Failed to calloc in opencl_thread_init");
     return false;
   }
 
+  memset(&running[i], 0, sizeof(running[i]));
+  if ((clStates[i] = opencl_take_resident(i, cgpu))) {
+    applog(LOG_INFO, "GPU thread %i GPU %i: using resident %s kernels", i, gpu, cgpu->algorithm.name);
+    if (thr->device_thread == 0)
+      cgpu->warm_switches++;
+    return true;
+  }
+
   strcpy(name, "");
   applog(LOG_INFO, "Init GPU thread %i GPU %i virtual GPU %i", i, gpu, virtual_gpu);
 
+  running[i].algorithm = cgpu->algorithm;
+  opencl_get_settings(cgpu, &running[i].in);
   clStates[i] = initCl(virtual_gpu, name, sizeof(name), &cgpu->algorithm);
   if (!clStates[i]) {
 #ifdef HAVE_CURSES
@@ -1322,6 +1556,10 @@ static bool opencl_thread_prepare(struct thr_info *thr)
   if (!cgpu->name)
     cgpu->name = strdup(name);
 
+  running[i].clState = clStates[i];
+  running[i].built = cgpu->algorithm;
+  opencl_get_settings(cgpu, &running[i].out);
+
   applog(LOG_INFO, "initCl() finished. Found %s", name);
   cgtime(&now);
   get_datestamp(cgpu->init, sizeof(cgpu->init), &now);
@@ -1354,10 +1592,28 @@ static bool opencl_thread_init(struct thr_info *thr)
     return false;
   }
 
+  thrdata->depth = opencl_pipeline_depth(gpu);
+  gpu->pipeline_depth = thrdata->depth;
+  if (thrdata->depth > 1) {
+    int i;
+
+    for (i = 0; i < thrdata->depth; i++) {
+      thrdata->batch[i].res = (uint32_t *)calloc(buffersize, 1);
+      if (!thrdata->batch[i].res) {
+        opencl_free_batches(thrdata);
+        free(thrdata->res);
+        free(thrdata);
+        applog(LOG_ERR, "Failed to calloc in opencl_thread_init");
+        return false;
+      }
+    }
+  }
+
   if (clState != NULL)
     status |= clEnqueueWriteBuffer(clState->commandQueue, clState->outputBuffer, CL_TRUE, 0,
       buffersize, blank_res, 0, NULL, NULL);
   if (unlikely(status != CL_SUCCESS)) {
+    opencl_free_batches(thrdata);
     free(thrdata->res);
     free(thrdata);
     applog(LOG_ERR, "Error: clEnqueueWriteBuffer failed.");
@@ -1379,6 +1635,120 @@ static bool opencl_prepare_work(struct thr_info __maybe_unused *thr, struct work
   return true;
 }
 
+/* Whether this batch is timed, for the API or the autotuner. Only a
+ * device's first thread feeds the autotuner. */
+static bool opencl_batch_timed(struct thr_info *thr, struct opencl_thread_data *thrdata)
+{
+  return thrdata->depth > 1 || (thr->device_thread == 0 && autotune_sweeping(thr->cgpu));
+}
+
+/* Record the OpenCL timestamps of a completed batch for the API and the
+ * autotuner */
+static void opencl_batch_profile(struct thr_info *thr, struct opencl_thread_data *thrdata, struct opencl_batch *b)
+{
+  struct cgpu_info *gpu = thr->cgpu;
+  cl_ulong queued, submit, start, end;
+
+  if (!b->begin ||
+      clGetEventProfilingInfo(b->begin, CL_PROFILING_COMMAND_QUEUED, sizeof(queued), &queued, NULL) != CL_SUCCESS ||
+      clGetEventProfilingInfo(b->begin, CL_PROFILING_COMMAND_SUBMIT, sizeof(submit), &submit, NULL) != CL_SUCCESS ||
+      clGetEventProfilingInfo(b->begin, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL) != CL_SUCCESS ||
+      clGetEventProfilingInfo(b->done, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL) != CL_SUCCESS)
+    return;
+
+  gpu->batch_queued = queued;
+  gpu->batch_submit = submit;
+  gpu->batch_start = start;
+  gpu->batch_end = end;
+  /* how long the GPU sat idle between this thread's batches */
+  if (thrdata->last_end && start > thrdata->last_end)
+    gpu->batch_gap_ms = (double)(start - thrdata->last_end) / 1e6;
+  else if (thrdata->last_end)
+    gpu->batch_gap_ms = 0;
+  thrdata->last_end = end;
+
+  if (thr->device_thread == 0 && end > start)
+    autotune_batch(gpu, b->hashes, end - start);
+}
+
+/* Wait for a batch in flight and hand its results to the verifiers */
+static int opencl_batch_drain(struct thr_info *thr, struct opencl_thread_data *thrdata, struct opencl_batch *b)
+{
+  struct cgpu_info *gpu = thr->cgpu;
+  cl_int status;
+
+  status = clWaitForEvents(1, &b->done);
+  b->pending = false;
+  if (status == CL_SUCCESS) {
+    opencl_batch_profile(thr, thrdata, b);
+    gpu->batches++;
+  }
+  if (b->begin)
+    clReleaseEvent(b->begin);
+  clReleaseEvent(b->done);
+  b->begin = b->done = NULL;
+  if (unlikely(status != CL_SUCCESS)) {
+    applog(LOG_ERR, "Error %d: waiting for the results of a pipelined batch.", status);
+    return -1;
+  }
+
+  if (b->res[gpu->algorithm.found_idx]) {
+    applog(LOG_DEBUG, "GPU %d found something?", gpu->device_id);
+    postcalc_hash_async(thr, b->work, b->res);
+    memset(b->res, 0, BUFFERSIZE);
+  }
+  return 0;
+}
+
+/* Queue the read of outputBuffer and the reset of its nonce count behind
+ * the batch just enqueued, then finish the oldest batch in flight. The GPU
+ * goes on to the next batch while the host verifies this one's results.
+ * Only the count needs clearing: the host never reads slots past it. */
+static int64_t opencl_pipeline_batch(struct thr_info *thr, struct work *work, int64_t hashes)
+{
+  struct opencl_thread_data *thrdata = (struct opencl_thread_data *)thr->cgpu_data;
+  struct opencl_batch *b = &thrdata->batch[thrdata->next];
+  _clState *clState = clStates[thr->id];
+  size_t found_offset = thr->cgpu->algorithm.found_idx * sizeof(uint32_t);
+  cl_int status;
+
+  status = clEnqueueReadBuffer(clState->commandQueue, clState->outputBuffer, CL_FALSE, 0,
+    BUFFERSIZE, b->res, 0, NULL, &b->done);
+  if (likely(status == CL_SUCCESS))
+    status = clEnqueueWriteBuffer(clState->commandQueue, clState->outputBuffer, CL_FALSE, found_offset,
+      sizeof(uint32_t), blank_res, 0, NULL, NULL);
+  if (unlikely(status != CL_SUCCESS)) {
+    applog(LOG_ERR, "Error %d: queueing the results of a pipelined batch.", status);
+    clFinish(clState->commandQueue);
+    if (b->begin)
+      clReleaseEvent(b->begin);
+    if (b->done)
+      clReleaseEvent(b->done);
+    b->begin = b->done = NULL;
+    return -1;
+  }
+  clFlush(clState->commandQueue);
+
+  /* The work may be gone by the time the results are back. A thread hashes
+   * the same work over many batches, so only copy it when it changes. */
+  if (!b->work || b->work->id != work->id) {
+    if (b->work)
+      free_work(b->work);
+    b->work = copy_work(work);
+  }
+  b->hashes = hashes;
+  b->pending = true;
+  work->blk.nonce += thr->cgpu->max_hashes;
+
+  /* the next slot holds the oldest batch in flight */
+  thrdata->next = (thrdata->next + 1) % thrdata->depth;
+  b = &thrdata->batch[thrdata->next];
+  if (b->pending && opencl_batch_drain(thr, thrdata, b) < 0)
+    return -1;
+
+  return hashes;
+}
+
 extern int opt_dynamic_interval;
 
 static int64_t opencl_scanhash(struct thr_info *thr, struct work *work,
@@ -1395,6 +1765,7 @@ static int64_t opencl_scanhash(struct thr_info *thr, struct work *work,
   size_t localThreads[1] = { clState->wsize };
   size_t *p_global_work_offset = NULL;
   int64_t hashes;
+  struct opencl_batch *timed;
   int found = gpu->algorithm.found_idx;
   int buffersize = BUFFERSIZE;
   unsigned int i;
@@ -1432,6 +1803,17 @@ static int64_t opencl_scanhash(struct thr_info *thr, struct work *work,
     return -1;
   }
 
+  /* its timestamps mark when the batch was queued and when the GPU got to it */
+  if (opencl_batch_timed(thr, thrdata)) {
+    struct opencl_batch *b = &thrdata->batch[thrdata->next];
+
+    /* left over from a batch whose kernels failed to queue */
+    if (b->begin)
+      clReleaseEvent(b->begin);
+    b->begin = NULL;
+    clEnqueueMarker(clState->commandQueue, &b->begin);
+  }
+
   size_t temp_goffset = 0;
   if (clState->goffset)
     p_global_work_offset = (size_t *)&work->blk.nonce;
@@ -1978,8 +2360,13 @@ if (gpu->algorithm.type == ALGO_NEOSCRYPT_NAVI || gpu->algorithm.type == ALGO_NE
 	    }
 }
 
+  if (thrdata->depth > 1)
+    return opencl_pipeline_batch(thr, work, hashes);
+
+  /* a batch being timed for the autotuner ends with the read */
+  timed = &thrdata->batch[0];
   status = clEnqueueReadBuffer(clState->commandQueue, clState->outputBuffer, CL_FALSE, 0,
-    buffersize, thrdata->res, 0, NULL, NULL);
+    buffersize, thrdata->res, 0, NULL, timed->begin ? &timed->done : NULL);
   if (unlikely(status != CL_SUCCESS)) {
     if (gpu->algorithm.type == ALGO_ETHASH)
       cg_runlock(&gpu->eth_dag.lock);
@@ -1997,6 +2384,14 @@ if (gpu->algorithm.type == ALGO_NEOSCRYPT_NAVI || gpu->algorithm.type == ALGO_NE
   if (gpu->algorithm.type == ALGO_ETHASH)
     cg_runlock(&gpu->eth_dag.lock);
 
+  if (timed->done) {
+    timed->hashes = hashes;
+    opencl_batch_profile(thr, thrdata, timed);
+    clReleaseEvent(timed->begin);
+    clReleaseEvent(timed->done);
+    timed->begin = timed->done = NULL;
+  }
+
   /* found entry is used as a counter to say how many nonces exist */
   if (thrdata->res[found]) {
     /* Clear the buffer again */
@@ -2019,6 +2414,14 @@ if (gpu->algorithm.type == ALGO_NEOSCRYPT_NAVI || gpu->algorithm.type == ALGO_NE
   return hashes;
 }
 
+static void opencl_free_thread_data(struct thr_info *thr)
+{
+  opencl_free_batches((struct opencl_thread_data *)thr->cgpu_data);
+  free(((struct opencl_thread_data *)thr->cgpu_data)->res);
+  free(thr->cgpu_data);
+  thr->cgpu_data = NULL;
+}
+
 // Cleanup OpenCL memory on the GPU
 // Note: This function is not thread-safe (clStates modification not atomic)
 static void opencl_thread_shutdown(struct thr_info *thr)
@@ -2026,46 +2429,75 @@ static void opencl_thread_shutdown(struct thr_info *thr)
   const int thr_id = thr->id;
   _clState *clState = clStates[thr_id];
   clStates[thr_id] = NULL;
-  unsigned int i;
 
   if (clState) {
-    clFinish(clState->commandQueue);
-    clReleaseMemObject(clState->outputBuffer);
-    clReleaseMemObject(clState->CLbuffer0);
-	if (clState->buffer1)
-	clReleaseMemObject(clState->buffer1);
-	if (clState->buffer2)
-	clReleaseMemObject(clState->buffer2);
-	if (clState->buffer3)
-	clReleaseMemObject(clState->buffer3);
-  if (clState->buffer4)
-	clReleaseMemObject(clState->buffer4);
-  if (clState->buffer5)
-	clReleaseMemObject(clState->buffer5);
-  if (clState->MidstateBuf)
-	clReleaseMemObject(clState->MidstateBuf);
-  if (clState->MatrixBuf)
-	clReleaseMemObject(clState->MatrixBuf);
-    if (clState->padbuffer8)
-      clReleaseMemObject(clState->padbuffer8);
-    clReleaseKernel(clState->kernel);
-  if (clState->GenerateDAG) {
-    clReleaseKernel(clState->GenerateDAG);
-  }
-  if (thr->cgpu->eth_dag.dag_buffer)
-	  clReleaseMemObject(thr->cgpu->eth_dag.dag_buffer);
-    for (i = 0; i < clState->n_extra_kernels; i++)
-      clReleaseKernel(clState->extra_kernels[i]);
-    clReleaseProgram(clState->program);
-    clReleaseCommandQueue(clState->commandQueue);
-    clReleaseContext(clState->context);
-    if (clState->extra_kernels)
-      free(clState->extra_kernels);
-    free(clState);
+    opencl_release_state(clState);
+    if (thr->cgpu->eth_dag.dag_buffer)
+      clReleaseMemObject(thr->cgpu->eth_dag.dag_buffer);
+  }
+  memset(&running[thr_id], 0, sizeof(running[thr_id]));
+  /* thread ids are handed out again when mining restarts */
+  opencl_release_resident(thr_id);
+  opencl_free_thread_data(thr);
+}
+
+/* Stop the thread for an algorithm switch. With --gpu-resident the
+ * programs and buffers of a listed algorithm are kept, so switching back
+ * to it only swaps them in again. */
+void opencl_thread_park(struct thr_info *thr)
+{
+  const int thr_id = thr->id;
+  struct opencl_resident *r;
+  int slot = opencl_resident_slot(&running[thr_id].algorithm);
+
+  if (!clStates[thr_id] || running[thr_id].clState != clStates[thr_id] || slot < 0 ||
+      autotune_sweeping(thr->cgpu)) {
+    opencl_thread_shutdown(thr);
+    return;
   }
-  free(((struct opencl_thread_data *)thr->cgpu_data)->res);
-  free(thr->cgpu_data);
-  thr->cgpu_data = NULL;
+
+  r = &resident[thr_id][slot];
+  if (r->clState)
+    opencl_release_state(r->clState);
+  clFinish(clStates[thr_id]->commandQueue);
+  *r = running[thr_id];
+  clStates[thr_id] = NULL;
+  memset(&running[thr_id], 0, sizeof(running[thr_id]));
+  applog(LOG_DEBUG, "GPU thread %d: keeping %s kernels resident", thr_id, r->algorithm.name);
+  opencl_free_thread_data(thr);
+}
+
+/* How long the device took to initialise and to switch algorithms, how
+ * many nonces its result buffers dropped, and the OpenCL timestamps of
+ * its latest pipelined batch */
+static struct api_data *get_opencl_api_stats(struct cgpu_info *gpu)
+{
+  struct api_data *root = NULL;
+  double exec_ms = 0;
+
+  root = api_add_double(root, "Init Devices ms", &gpu->init_devices_ms, false);
+  root = api_add_double(root, "Init Setup ms", &gpu->init_setup_ms, false);
+  root = api_add_double(root, "Init Kernel ms", &gpu->init_kernel_ms, false);
+  root = api_add_double(root, "Init Buffers ms", &gpu->init_buffers_ms, false);
+  root = api_add_int(root, "Algo Switches", &gpu->algo_switches, false);
+  root = api_add_int(root, "Warm Switches", &gpu->warm_switches, false);
+  root = api_add_double(root, "Switch ms", &gpu->switch_ms, false);
+  root = api_add_uint64(root, "Result Overflows", &gpu->result_overflows, false);
+  root = api_add_uint64(root, "Lost Nonces", &gpu->lost_nonces, false);
+  root = api_add_int(root, "Pipeline Depth", &gpu->pipeline_depth, false);
+  if (gpu->pipeline_depth < 2)
+    return root;
+
+  if (gpu->batch_end > gpu->batch_start)
+    exec_ms = (double)(gpu->batch_end - gpu->batch_start) / 1e6;
+  root = api_add_uint64(root, "Batches", &gpu->batches, false);
+  root = api_add_uint64(root, "Batch Queued", &gpu->batch_queued, false);
+  root = api_add_uint64(root, "Batch Submit", &gpu->batch_submit, false);
+  root = api_add_uint64(root, "Batch Start", &gpu->batch_start, false);
+  root = api_add_uint64(root, "Batch End", &gpu->batch_end, false);
+  root = api_add_double(root, "Batch Exec ms", &exec_ms, true);
+  root = api_add_double(root, "Batch Gap ms", &gpu->batch_gap_ms, false);
+  return root;
 }
 
 struct device_drv opencl_drv = {
@@ -2080,7 +2512,7 @@ struct device_drv opencl_drv = {
   NULL,
 #endif
   /*.get_statline = */    get_opencl_statline,
-  /*.api_data = */    NULL,
+  /*.api_data = */    get_opencl_api_stats,
   /*.get_stats = */   NULL,
   /*.identify_device = */   NULL,
   /*.set_device = */    NULL,
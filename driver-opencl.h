@@ -8,6 +8,7 @@ extern void print_ndevs(int *ndevs);
 extern void *reinit_gpu(void *userdata);
 extern char *set_gpu_map(char *arg);
 extern char *set_gpu_threads(const char *arg);
+extern char *set_gpu_resident(const char *arg);
 extern char *set_gpu_engine(const char *arg);
 extern char *set_gpu_fan(const char *arg);
 extern char *set_gpu_memclock(const char *arg);
@@ -26,8 +27,17 @@ extern char *set_lookup_gap(char *arg);
 extern char *set_thread_concurrency(const char *arg);
 void manage_gpu(void);
 extern void pause_dynamic_threads(int gpu);
+extern void opencl_thread_park(struct thr_info *thr);
 
 extern int opt_platform_id;
+extern int opt_gpu_pipeline;
+extern bool opt_opencl_cpu;
+
+/* Most batches a thread keeps in flight with --gpu-pipeline */
+#define MAX_PIPELINE_DEPTH 2
+
+/* Most algorithms --gpu-resident keeps built per GPU thread */
+#define MAX_RESIDENT_ALGOS 8
 
 extern struct device_drv opencl_drv;
 
@@ -8,9 +8,13 @@
  * any later version.  See COPYING for more details.
  */
 
+#include "config.h"
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <pthread.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "findnonce.h"
 #include "algorithm/scrypt.h"
@@ -171,31 +175,196 @@ struct pc_data {
   struct thr_info *thr;
   struct work *work;
   uint32_t res[MAXBUFFERS];
-  pthread_t pth;
-  int found;
+  struct timeval tv_queued;
+};
+
+/* Verification worker pool.
+ *
+ * Output buffers with hits used to be handed to a freshly created detached
+ * thread each. They are now copied into one of a fixed number of
+ * preallocated pc_data slots and passed to a small set of long lived
+ * workers through a bounded lock-free MPMC ring (Vyukov style: every cell
+ * carries a sequence number telling producers and consumers whose turn it
+ * is). A second ring of the same size holds the free slots, so nothing is
+ * allocated on the hot path apart from the work copy. */
+int opt_verify_threads = 0;
+int opt_verify_queue = 64;
+char *opt_verify_affinity = NULL;
+
+struct pc_cell {
+  uint32_t seq;
+  struct pc_data *pcd;
+};
+
+struct pc_ring {
+  struct pc_cell *cells;
+  uint32_t mask;
+  /* Keep producer and consumer indices on separate cache lines */
+  uint32_t enqueue_pos __attribute__((aligned(64)));
+  uint32_t dequeue_pos __attribute__((aligned(64)));
 };
 
-static void *postcalc_hash(void *userdata)
+static struct pc_ring pc_free_ring;
+static struct pc_ring pc_ready_ring;
+static struct pc_data *pc_slots;
+static cgsem_t pc_ready_sem;
+static pthread_t *pc_workers;
+static int pc_nworkers;
+static bool pc_initialised;
+
+/* Counters are only touched with atomic builtins */
+static struct {
+  uint64_t queued;
+  uint64_t processed;
+  uint64_t inline_runs;
+  uint64_t nonces;
+  uint64_t latency_us;
+  uint64_t latency_max_us;
+  uint64_t work_us;
+  uint64_t overflows;
+  uint64_t lost;
+  uint64_t depth_max;
+} pc_stats;
+
+static bool pc_ring_init(struct pc_ring *ring, uint32_t size)
+{
+  uint32_t i;
+
+  ring->cells = (struct pc_cell *)calloc(size, sizeof(struct pc_cell));
+  if (unlikely(!ring->cells))
+    return false;
+  for (i = 0; i < size; i++)
+    ring->cells[i].seq = i;
+  ring->mask = size - 1;
+  ring->enqueue_pos = 0;
+  ring->dequeue_pos = 0;
+  return true;
+}
+
+static bool pc_ring_push(struct pc_ring *ring, struct pc_data *pcd)
+{
+  struct pc_cell *cell;
+  uint32_t pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+
+  while (42) {
+    uint32_t seq;
+    int32_t dif;
+
+    cell = &ring->cells[pos & ring->mask];
+    seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    dif = (int32_t)(seq - pos);
+    if (dif == 0) {
+      if (__atomic_compare_exchange_n(&ring->enqueue_pos, &pos, pos + 1, true,
+          __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    }
+    else if (dif < 0) {
+      return false;
+    }
+    else {
+      pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  cell->pcd = pcd;
+  __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+static struct pc_data *pc_ring_pop(struct pc_ring *ring)
+{
+  struct pc_cell *cell;
+  struct pc_data *pcd;
+  uint32_t pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+
+  while (42) {
+    uint32_t seq;
+    int32_t dif;
+
+    cell = &ring->cells[pos & ring->mask];
+    seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    dif = (int32_t)(seq - (pos + 1));
+    if (dif == 0) {
+      if (__atomic_compare_exchange_n(&ring->dequeue_pos, &pos, pos + 1, true,
+          __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    }
+    else if (dif < 0) {
+      return NULL;
+    }
+    else {
+      pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  pcd = cell->pcd;
+  __atomic_store_n(&cell->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+  return pcd;
+}
+
+static uint32_t pc_ring_depth(struct pc_ring *ring)
+{
+  return __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED) -
+         __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+}
+
+static void pc_stat_max(uint64_t *stat, uint64_t val)
+{
+  uint64_t cur = __atomic_load_n(stat, __ATOMIC_RELAXED);
+
+  while (val > cur) {
+    if (__atomic_compare_exchange_n(stat, &cur, val, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+}
+
+static void postcalc_hash(struct pc_data *pcd)
 {
-  struct pc_data *pcd = (struct pc_data *)userdata;
   struct thr_info *thr = pcd->thr;
   unsigned int entry = 0;
+  struct timeval tv_start, tv_end;
+  uint64_t latency;
 
   int found = thr->cgpu->algorithm.found_idx;
 
-  pthread_detach(pthread_self());
-
-  /* To prevent corrupt values in FOUND from trying to read beyond the
-   * end of the res[] array */
-  if (unlikely(pcd->res[found] & ~found)) {
-    applog(LOG_WARNING, "%s%d: invalid nonce count - HW error",
-      thr->cgpu->drv->name, thr->cgpu->device_id);
-    hw_errors++;
-    thr->cgpu->hw_errors++;
-    pcd->res[found] &= found;
+  cgtime(&tv_start);
+
+  /* The kernels keep counting once the buffer is full (see
+   * kernel/results.cl), so a count past the last slot is the number of
+   * nonces the device had no room for */
+  if (unlikely(pcd->res[found] > (uint32_t)found)) {
+    uint32_t lost = pcd->res[found] - found;
+
+    applog(LOG_INFO, "%s%d: result buffer full, %u nonces lost",
+      thr->cgpu->drv->name, thr->cgpu->device_id, lost);
+    __atomic_add_fetch(&thr->cgpu->result_overflows, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&thr->cgpu->lost_nonces, lost, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pc_stats.overflows, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pc_stats.lost, lost, __ATOMIC_RELAXED);
+    pcd->res[found] = found;
   }
 
-  for (entry = 0; entry < pcd->res[found]; entry++) {
+  /* Ethash verification is dominated by the light DAG lookups, so check
+   * all of the buffer's nonces together */
+  if (pcd->work->pool->algorithm.type == ALGO_ETHASH && pcd->res[found] > 1) {
+    entry = pcd->res[found];
+    submit_eth_nonces(thr, pcd->work, pcd->res, entry);
+  }
+  /* Same for algorithms with a batched CPU hash (scrypt, the X11 family),
+   * which verify the buffer's nonces side by side */
+  else if (pcd->work->pool->algorithm.regenhash_batch && found != 0x0F && pcd->res[found] > 1) {
+    uint32_t hashes[MAXBUFFERS][8];
+    unsigned int i;
+
+    entry = pcd->res[found];
+    pcd->work->pool->algorithm.regenhash_batch(pcd->work, pcd->res, entry, hashes);
+    for (i = 0; i < entry; i++)
+      submit_nonce_hash(thr, pcd->work, pcd->res[i], (const unsigned char *)hashes[i]);
+  }
+  else for (entry = 0; entry < pcd->res[found]; entry++) {
     uint32_t nonce = pcd->res[entry];
     if (found == 0x0F)
       nonce = swab32(nonce);
@@ -205,30 +374,227 @@ static void *postcalc_hash(void *userdata)
   }
 
   discard_work(pcd->work);
-  free(pcd);
+  pcd->work = NULL;
+
+  cgtime(&tv_end);
+  latency = (uint64_t)us_tdiff(&tv_end, &pcd->tv_queued);
+  __atomic_add_fetch(&pc_stats.processed, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&pc_stats.nonces, entry, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&pc_stats.latency_us, latency, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&pc_stats.work_us, (uint64_t)us_tdiff(&tv_end, &tv_start), __ATOMIC_RELAXED);
+  pc_stat_max(&pc_stats.latency_max_us, latency);
+}
+
+static void *postcalc_worker(void *userdata)
+{
+  int id = (int)(intptr_t)userdata;
+  char threadname[16];
+
+  snprintf(threadname, sizeof(threadname), "Verify/%d", id);
+  RenameThread(threadname);
+
+  while (42) {
+    struct pc_data *pcd;
+
+    cgsem_wait(&pc_ready_sem);
+    pcd = pc_ring_pop(&pc_ready_ring);
+    if (unlikely(!pcd)) {
+      continue;
+    }
+
+    postcalc_hash(pcd);
+
+    /* Cannot fail: there are never more slots than cells in the ring */
+    pc_ring_push(&pc_free_ring, pcd);
+  }
 
   return NULL;
 }
 
+/* Parses a CPU list such as "0-3,6" into a mask of up to 64 CPUs */
+static uint64_t parse_cpu_list(const char *arg)
+{
+  uint64_t mask = 0;
+  char *buf, *nextptr, *saveptr = NULL;
+
+  buf = strdup(arg);
+  if (unlikely(!buf))
+    return 0;
+
+  for (nextptr = strtok_r(buf, ",", &saveptr); nextptr; nextptr = strtok_r(NULL, ",", &saveptr)) {
+    int start = -1, end = -1, i;
+
+    if (sscanf(nextptr, "%d-%d", &start, &end) < 2)
+      end = start;
+    if (start < 0 || end < start || end > 63) {
+      applog(LOG_ERR, "Invalid CPU range '%s' in verify-affinity, ignoring", nextptr);
+      continue;
+    }
+    for (i = start; i <= end; i++)
+      mask |= 1ULL << i;
+  }
+
+  free(buf);
+  return mask;
+}
+
+static void set_worker_affinity(pthread_t pth, int id, uint64_t mask)
+{
+  int cpu, n = 0, target;
+
+  for (cpu = 0; cpu < 64; cpu++) {
+    if (mask & (1ULL << cpu))
+      n++;
+  }
+  if (!n)
+    return;
+
+  /* Spread workers round robin over the listed CPUs */
+  target = id % n;
+  for (cpu = 0; cpu < 64; cpu++) {
+    if ((mask & (1ULL << cpu)) && !target--)
+      break;
+  }
+
+#if defined(__linux__)
+  {
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pth, sizeof(set), &set))
+      applog(LOG_WARNING, "Failed to bind verify thread %d to CPU %d", id, cpu);
+  }
+#elif defined(WIN32)
+  if (!SetThreadAffinityMask(pthread_gethandle(pth), (DWORD_PTR)1 << cpu))
+    applog(LOG_WARNING, "Failed to bind verify thread %d to CPU %d", id, cpu);
+#else
+  applog(LOG_WARNING, "CPU affinity for verify threads is not supported on this platform");
+#endif
+}
+
+/* Called once by main() before any mining thread starts */
+void init_postcalc_workers(void)
+{
+  uint32_t size = 1;
+  uint64_t mask = 0;
+  int i;
+
+  if (pc_initialised)
+    return;
+
+  pc_nworkers = opt_verify_threads;
+  if (pc_nworkers <= 0) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    pc_nworkers = (ncpu > 0) ? MIN((int)ncpu, 8) : 2;
+  }
+
+  /* Rings need a power of two number of cells */
+  while (size < (uint32_t)opt_verify_queue)
+    size <<= 1;
+
+  pc_slots = (struct pc_data *)calloc(size, sizeof(struct pc_data));
+  pc_workers = (pthread_t *)calloc(pc_nworkers, sizeof(pthread_t));
+  if (unlikely(!pc_slots || !pc_workers || !pc_ring_init(&pc_free_ring, size) ||
+      !pc_ring_init(&pc_ready_ring, size)))
+    quit(1, "Failed to allocate verify queue");
+
+  for (i = 0; i < (int)size; i++)
+    pc_ring_push(&pc_free_ring, &pc_slots[i]);
+
+  cgsem_init(&pc_ready_sem);
+
+  if (opt_verify_affinity)
+    mask = parse_cpu_list(opt_verify_affinity);
+
+  for (i = 0; i < pc_nworkers; i++) {
+    if (unlikely(pthread_create(&pc_workers[i], NULL, postcalc_worker, (void *)(intptr_t)i)))
+      quit(1, "Failed to create verify thread %d", i);
+    if (mask)
+      set_worker_affinity(pc_workers[i], i, mask);
+  }
+
+  __atomic_store_n(&pc_initialised, true, __ATOMIC_RELEASE);
+  applog(LOG_INFO, "Started %d verify threads, queue depth %u", pc_nworkers, size);
+}
+
 void postcalc_hash_async(struct thr_info *thr, struct work *work, uint32_t *res)
 {
-	
-  struct pc_data *pcd = (struct pc_data *)malloc(sizeof(struct pc_data));
-  int buffersize;
+  struct pc_data *pcd;
+  uint32_t depth;
 
+  pcd = pc_ring_pop(&pc_free_ring);
   if (unlikely(!pcd)) {
-    applog(LOG_ERR, "Failed to malloc pc_data in postcalc_hash_async");
+    struct pc_data local;
+
+    /* Every slot is in flight, verify on this thread rather than drop the
+     * nonces. This naturally throttles the GPU thread. */
+    local.thr = thr;
+    local.work = copy_work(work);
+    memcpy(&local.res, res, BUFFERSIZE);
+    cgtime(&local.tv_queued);
+    __atomic_add_fetch(&pc_stats.inline_runs, 1, __ATOMIC_RELAXED);
+    postcalc_hash(&local);
     return;
   }
 
   pcd->thr = thr;
   pcd->work = copy_work(work);
-  buffersize = BUFFERSIZE;
-   memcpy(&pcd->res, res, buffersize);
+  memcpy(&pcd->res, res, BUFFERSIZE);
+  cgtime(&pcd->tv_queued);
+
+  pc_ring_push(&pc_ready_ring, pcd);
+  __atomic_add_fetch(&pc_stats.queued, 1, __ATOMIC_RELAXED);
+  depth = pc_ring_depth(&pc_ready_ring);
+  pc_stat_max(&pc_stats.depth_max, depth);
+  cgsem_post(&pc_ready_sem);
+}
 
-  if (pthread_create(&pcd->pth, NULL, postcalc_hash, (void *)pcd)) {
-    applog(LOG_ERR, "Failed to create postcalc_hash thread");
-    discard_work(pcd->work);
-    free(pcd);
-  }
+struct api_data *postcalc_api_stats(struct api_data *root)
+{
+  uint64_t processed = __atomic_load_n(&pc_stats.processed, __ATOMIC_RELAXED);
+  uint64_t latency = __atomic_load_n(&pc_stats.latency_us, __ATOMIC_RELAXED);
+  uint64_t work_us = __atomic_load_n(&pc_stats.work_us, __ATOMIC_RELAXED);
+  uint64_t latency_max = __atomic_load_n(&pc_stats.latency_max_us, __ATOMIC_RELAXED);
+  uint64_t queued = __atomic_load_n(&pc_stats.queued, __ATOMIC_RELAXED);
+  uint64_t inline_runs = __atomic_load_n(&pc_stats.inline_runs, __ATOMIC_RELAXED);
+  uint64_t nonces = __atomic_load_n(&pc_stats.nonces, __ATOMIC_RELAXED);
+  uint64_t overflows = __atomic_load_n(&pc_stats.overflows, __ATOMIC_RELAXED);
+  uint64_t lost = __atomic_load_n(&pc_stats.lost, __ATOMIC_RELAXED);
+  bool initialised = __atomic_load_n(&pc_initialised, __ATOMIC_ACQUIRE);
+  uint32_t depth = initialised ? pc_ring_depth(&pc_ready_ring) : 0;
+  uint32_t depth_max = (uint32_t)__atomic_load_n(&pc_stats.depth_max, __ATOMIC_RELAXED);
+  uint32_t size = initialised ? pc_ready_ring.mask + 1 : 0;
+  double avg_latency = processed ? (double)latency / processed / 1000.0 : 0;
+  double avg_work = processed ? (double)work_us / processed / 1000.0 : 0;
+  double max_latency = (double)latency_max / 1000.0;
+
+  root = api_add_int(root, "Verify Threads", &pc_nworkers, true);
+  root = api_add_uint32(root, "Queue Size", &size, true);
+  root = api_add_uint32(root, "Queue Depth", &depth, true);
+  root = api_add_uint32(root, "Queue Max Depth", &depth_max, true);
+  root = api_add_uint64(root, "Queued", &queued, true);
+  root = api_add_uint64(root, "Processed", &processed, true);
+  root = api_add_uint64(root, "Inline", &inline_runs, true);
+  root = api_add_uint64(root, "Nonces", &nonces, true);
+  root = api_add_uint64(root, "Overflows", &overflows, true);
+  root = api_add_uint64(root, "Lost Nonces", &lost, true);
+  root = api_add_double(root, "Latency Av ms", &avg_latency, true);
+  root = api_add_double(root, "Latency Max ms", &max_latency, true);
+  root = api_add_double(root, "Verify Av ms", &avg_work, true);
+
+  return root;
+}
+
+/* Average queueing and hashing time per verified result buffer, for the
+ * benchmark summary. Returns the number of buffers verified. */
+uint64_t postcalc_timings(double *latency_ms, double *verify_ms)
+{
+  uint64_t processed = __atomic_load_n(&pc_stats.processed, __ATOMIC_RELAXED);
+  uint64_t latency = __atomic_load_n(&pc_stats.latency_us, __ATOMIC_RELAXED);
+  uint64_t work_us = __atomic_load_n(&pc_stats.work_us, __ATOMIC_RELAXED);
+
+  *latency_ms = processed ? (double)latency / processed / 1000.0 : 0;
+  *verify_ms = processed ? (double)work_us / processed / 1000.0 : 0;
+  return processed;
 }
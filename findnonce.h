@@ -7,7 +7,14 @@
 #define MAXBUFFERS (0x100)
 #define BUFFERSIZE (sizeof(uint32_t) * MAXBUFFERS)
 
+extern int opt_verify_threads;
+extern int opt_verify_queue;
+extern char *opt_verify_affinity;
+
 extern void precalc_hash(dev_blk_ctx *blk, uint32_t *state, uint32_t *data);
+extern void init_postcalc_workers(void);
 extern void postcalc_hash_async(struct thr_info *thr, struct work *work, uint32_t *res);
+extern struct api_data *postcalc_api_stats(struct api_data *root);
+extern uint64_t postcalc_timings(double *latency_ms, double *verify_ms);
 
 #endif /*FINDNONCE_H*/
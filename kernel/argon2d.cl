@@ -16,6 +16,8 @@
  */
  
 
+#include "results.cl"
+
 #define ARGON2_BLOCK_SIZE 1024
 #define ARGON2_QWORDS_IN_BLOCK (ARGON2_BLOCK_SIZE / 8)
 #define BLAKE2B_BLOCKBYTES 128
@@ -1767,6 +1769,6 @@ __kernel void search2(
 
     if ( ((uint*)&state.a)[1] <= target && idx==3) {
         uint32_t ret = SWAP4(nonce);
-		 output[output[0xFF]++] = ret;
+		 RESULT_PUSH(output, 0xFF, ret);
 	}
 }
\ No newline at end of file
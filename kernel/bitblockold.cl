@@ -33,6 +33,8 @@
 #ifndef BITBLOCK_CL
 #define BITBLOCK_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
 #else
@@ -1165,7 +1167,7 @@ __kernel void search10(__global hash_t* hashes, __global uint* output, const ulo
 
     bool result = (hash.h8[3] <= target);
     if (result)
-      output[atomic_inc(output+0xFF)] = SWAP4(gid);
+      RESULT_PUSH(output, 0xFF, SWAP4(gid));
 
     barrier(CLK_GLOBAL_MEM_FENCE);
 }
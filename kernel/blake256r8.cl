@@ -1,5 +1,7 @@
 // (c) 2013 originally written by smolen, modified by kr105
 
+#include "results.cl"
+
 #define SPH_ROTR32(v,n) rotate((uint)(v),(uint)(32-(n)))
 
 __attribute__((reqd_work_group_size(WORKSIZE, 1, 1)))
@@ -73,5 +75,5 @@ __kernel void search(
 
 	if(pre7 ^ V7 ^ VF)
 		return;
-	output[output[0xFF]++] = nonce;
+	RESULT_PUSH(output, 0xFF, nonce);
 }
\ No newline at end of file
@@ -29,6 +29,8 @@
  */
 
 /* N (nfactor), CPU/Memory cost parameter */
+#include "results.cl"
+
 __constant uint N[] = {
   0x00000001U,  /* never used, padding */
   0x00000002U,
@@ -664,7 +666,7 @@ void scrypt_core(uint4 X[8], __global uint4* const restrict lookup)
 
 #pragma OPENCL EXTENSION cl_khr_global_int32_base_atomics : enable
 #define SCRYPT_FOUND (0xFF)
-#define SETFOUND(Xnonce) output[atomic_add(&output[SCRYPT_FOUND], 1)] = Xnonce;
+#define SETFOUND(Xnonce) RESULT_PUSH(output, SCRYPT_FOUND, Xnonce);
 
 __attribute__((reqd_work_group_size(WORKSIZE, 1, 1)))
 __attribute__((max_work_group_size(WORKSIZE, 1, 1)))
@@ -37,6 +37,8 @@
 #ifndef DARKCOIN_MOD_CL
 #define DARKCOIN_MOD_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
   #define SPH_LITTLE_ENDIAN 1
 #else
@@ -1024,7 +1026,7 @@ __kernel void search10(__global hash_t* hashes, __global uint* output, const ulo
   bool result = (Vb11 <= target);
 
   if (result)
-  output[atomic_inc(output+0xFF)] = SWAP4(gid);
+  RESULT_PUSH(output, 0xFF, SWAP4(gid));
 }
 
 #endif// DARKCOIN_MOD_CL
\ No newline at end of file
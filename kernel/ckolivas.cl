@@ -29,6 +29,8 @@
  */
 
 /* N (nfactor), CPU/Memory cost parameter */
+#include "results.cl"
+
 __constant uint N[] = {
   0x00000001U,  /* never used, padding */
   0x00000002U,
@@ -839,7 +841,7 @@ void scrypt_core(uint4 X[8], __global uint4*restrict lookup)
 }
 
 #define FOUND (0xFF)
-#define SETFOUND(Xnonce) output[output[FOUND]++] = Xnonce
+#define SETFOUND(Xnonce) RESULT_PUSH(output, FOUND, Xnonce)
 
 __attribute__((reqd_work_group_size(WORKSIZE, 1, 1)))
 __kernel void search(__global const uint4 * restrict input,
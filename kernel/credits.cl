@@ -28,6 +28,8 @@
 *
 * @author   djm34
 */
+#include "results.cl"
+
 #if !defined(cl_khr_byte_addressable_store)
 #error "Device does not support unaligned stores"
 #endif
@@ -226,7 +228,7 @@ __kernel void search(__global const uchar* restrict input, __global uint* restri
 	state1 = sha256_Transform(in,H256);
 
 if (SWAP64(state1.s67) <= target)  
-		output[atomic_inc(output + 0xFF)] = nonce;
+		RESULT_PUSH(output, 0xFF, nonce);
 
 }
 
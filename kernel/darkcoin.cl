@@ -32,6 +32,8 @@
 #ifndef DARKCOIN_CL
 #define DARKCOIN_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
 #else
@@ -725,7 +727,7 @@ __kernel void search(__global unsigned char* block, volatile __global uint* outp
 
     bool result = (Vb11 <= target);
     if (result)
-      output[output[0xFF]++] = SWAP4(gid);
+      RESULT_PUSH(output, 0xFF, SWAP4(gid));
   }
 }
 
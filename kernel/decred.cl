@@ -15,6 +15,8 @@
  * GTX 960 | (5s):875.0M (avg):899.2Mh/s
  * GTX 750 | (5s):523.1M (avg):536.8Mh/s
  */
+#include "results.cl"
+
 #define ROTR(v,n) rotate(v,(uint)(32U-n))
 #define ROTL(v,n) rotate(v, n)
 
@@ -157,5 +159,5 @@ __kernel void search(
 	if (pre7 ^ V7 ^ VF) return;
 
 	/* Push this share */
-	output[output[0xFF]++] = M3;
+	RESULT_PUSH(output, 0xFF, M3);
 }
@@ -32,6 +32,8 @@
 #ifndef GROESTLCOIN_CL
 #define GROESTLCOIN_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
 #else
@@ -281,7 +283,7 @@ __kernel void search(__global unsigned char* block, volatile __global uint* outp
 
   bool result = (hash.h8[3] <= target);
   if (result)
-    output[output[0xFF]++] = SWAP4(gid);
+    RESULT_PUSH(output, 0xFF, SWAP4(gid));
 }
 
 #endif // GROESTLCOIN_CL
@@ -32,6 +32,8 @@
 #ifndef FRESH_CL
 #define FRESH_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
   #define SPH_LITTLE_ENDIAN 1
 #else
@@ -590,7 +592,7 @@ __kernel void search4(__global hash_t* hashes, __global uint* output, const ulon
 
   bool result = (Vb11 <= target);
   if (result)
-      output[output[0xFF]++] = SWAP4(gid);
+      RESULT_PUSH(output, 0xFF, SWAP4(gid));
 }
 
 #endif // FRESH_CL
\ No newline at end of file
@@ -32,6 +32,8 @@
 #ifndef FUGUECOIN_CL
 #define FUGUECOIN_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
 #else
@@ -223,7 +225,7 @@ __kernel void search(__global unsigned char* input, volatile __global uint* outp
 
   bool result = ((((sph_u64) SWAP4(S19) << 32) | SWAP4(S18)) <= target);
   if (result)
-    output[output[0xFF]++] = SWAP4(gid);
+    RESULT_PUSH(output, 0xFF, SWAP4(gid));
 }
 
 #endif // FUGUECOIN_CL
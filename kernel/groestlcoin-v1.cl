@@ -32,6 +32,8 @@
 #ifndef GROESTLCOIN_CL
 #define GROESTLCOIN_CL
 
+#include "results.cl"
+
 #define DC64(x)     ((ulong)(x ## UL))
 #define DEC64E(x)   (*(const __global ulong *) (x));
 #define H15         (((ulong)(512 & 0xFF) << 56) | ((ulong)(512 & 0xFF00) << 40))
@@ -1847,7 +1849,7 @@ round:
   goto perm;
 
 end:
-  if ((g[3 + 8] ^ m[3]) <= target) output[output[0xFF]++] = as_uint(as_uchar4(gid).wzyx);
+  if ((g[3 + 8] ^ m[3]) <= target) RESULT_PUSH(output, 0xFF, as_uint(as_uchar4(gid).wzyx));
 }
 
 #endif
@@ -32,6 +32,8 @@
 #ifndef GROESTLCOIN_CL
 #define GROESTLCOIN_CL
 
+#include "results.cl"
+
 #ifdef __gfx900__
 #else
 
@@ -114,7 +116,7 @@ __kernel void search(__global unsigned char* block, __global uint* output, __glo
     }
 
     if(rc)
-      output[output[0xFF]++] = (nounce);
+      RESULT_PUSH(output, 0xFF, (nounce));
   }
 
   barrier(CLK_GLOBAL_MEM_FENCE);
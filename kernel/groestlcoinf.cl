@@ -32,6 +32,8 @@
 #ifndef GROESTLCOIN_CL
 #define GROESTLCOIN_CL
 
+#include "results.cl"
+
 #define SWAP32(a)    (as_uint(as_uchar4(a).wzyx))
 
 #include "groestlf.cl"
@@ -111,7 +113,7 @@ __kernel void search(__global unsigned char* block, __global uint* output, __glo
     }
 
     if(rc)
-      output[output[0xFF]++] = (nounce);
+      RESULT_PUSH(output, 0xFF, (nounce));
   }
 
   barrier(CLK_GLOBAL_MEM_FENCE);
@@ -1,3 +1,5 @@
+#include "results.cl"
+
 typedef unsigned int sph_u32;
 typedef int sph_s32;
 #ifndef __OPENCL_VERSION__
@@ -286,7 +288,7 @@ __kernel void search(__constant uint *header, __constant uchar* gmatrix, __globa
 
     bool result = ( ((ulong *) pdata)[3] <= target);
     if (result) {
-		output[atomic_inc(output + 0xFF)] = SWAP4(gid);
+		RESULT_PUSH(output, 0xFF, SWAP4(gid));
 	}
 
     barrier(CLK_GLOBAL_MEM_FENCE);
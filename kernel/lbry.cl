@@ -1,3 +1,5 @@
+#include "results.cl"
+
 #include "sha256.cl"
 #include "wolf-sha512.cl"
 #include "ripemd160.cl"
@@ -175,5 +177,5 @@ __kernel void search2(__global uint8 *ctx, __global uint *output, ulong target)
   outbuf.s7 = SWAP32(outbuf.s7);
 
   if(as_ulong(outbuf.s67) <= target)
-    output[atomic_inc(output+0xFF)] = SWAP32(gid);
+    RESULT_PUSH(output, 0xFF, SWAP32(gid));
 }
@@ -38,6 +38,8 @@
 #ifndef LYRA2Z_CL
 #define LYRA2Z_CL
 
+#include "results.cl"
+
 
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
@@ -396,7 +398,7 @@ __kernel void search4(__global uchar* hashes, __global uint* output, const ulong
 
   bool result = (hash->h8[3] <= target);
   if (result) {
-	output[atomic_inc(output + 0xFF)] = SWAP4(gid);
+	RESULT_PUSH(output, 0xFF, SWAP4(gid));
   }
 }
 
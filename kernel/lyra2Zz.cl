@@ -37,6 +37,8 @@
 #ifndef LYRA2ZZ_CL
 #define LYRA2ZZ_CL
 
+#include "results.cl"
+
 
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
@@ -412,7 +414,7 @@ __kernel void search4(__global uchar* hashes, __global uint* output, const ulong
 
   bool result = (hash->h8[3] <= target);
   if (result) {
-	output[atomic_inc(output + 0xFF)] = SWAP4(gid);
+	RESULT_PUSH(output, 0xFF, SWAP4(gid));
   }
 }
 
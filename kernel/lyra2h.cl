@@ -42,6 +42,8 @@
 #ifndef LYRA2Z_CL
 #define LYRA2Z_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
 #else
@@ -376,7 +378,7 @@ __kernel void search1(__global uchar* hashes,__global uchar* matrix, __global ui
 
 bool result = (((ulong*)state)[3] <= target);
 if (result) {
-	output[atomic_inc(output + 0xFF)] = SWAP4(gid);
+	RESULT_PUSH(output, 0xFF, SWAP4(gid));
 }
 
 }
@@ -34,6 +34,8 @@
 #ifndef LYRA2RE_CL
 #define LYRA2RE_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
 #else
@@ -463,7 +465,7 @@ barrier(CLK_LOCAL_MEM_FENCE);
 
 	bool result = ( state[7] <= target);
 	if (result) {
-		output[atomic_inc(output + 0xFF)] = SWAP4(gid);
+		RESULT_PUSH(output, 0xFF, SWAP4(gid));
 	}
 }
 
@@ -36,6 +36,8 @@
 #ifndef LYRA2REV3_CL
 #define LYRA2REV3_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
 #else
@@ -937,7 +939,7 @@ __kernel void search8(__global uchar* hashes, __global uint* output, const ulong
 
 	bool result = ( ((ulong*)final_s)[7] <= target);
 	if (result) {
-		output[atomic_inc(output + 0xFF)] = SWAP4(gid);
+		RESULT_PUSH(output, 0xFF, SWAP4(gid));
 	}
 
 }
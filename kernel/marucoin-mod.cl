@@ -33,6 +33,8 @@
 #ifndef X13MOD_CL
 #define X13MOD_CL
 
+#include "results.cl"
+
 #define DEBUG(x)
 
 #if __ENDIAN_LITTLE__
@@ -1284,7 +1286,7 @@ __kernel void search12(__global hash_t* hashes, __global uint* output, const ulo
 
   bool result = (hash->h8[3] <= target);
   if (result)
-    output[atomic_inc(output+0xFF)] = SWAP4(gid);
+    RESULT_PUSH(output, 0xFF, SWAP4(gid));
 
   barrier(CLK_GLOBAL_MEM_FENCE);
 }
@@ -1,3 +1,5 @@
+#include "results.cl"
+
 #define ARGS_25(x) x ## 0, x ## 1, x ## 2, x ## 3, x ## 4, x ## 5, x ## 6, x ## 7, x ## 8, x ## 9, x ## 10, x ## 11, x ## 12, x ## 13, x ## 14, x ## 15, x ## 16, x ## 17, x ## 18, x ## 19, x ## 20, x ## 21, x ## 22, x ## 23, x ## 24
 
 __constant uint2 keccak_round_constants[24] =
@@ -118,7 +120,7 @@ __kernel void search(__global const uint2*restrict in, __global uint*restrict ou
   keccak_block_noabsorb(ARGS_25(&state));
 
 #define FOUND (0x0F)
-#define SETFOUND(Xnonce) output[output[FOUND]++] = Xnonce
+#define SETFOUND(Xnonce) RESULT_PUSH(output, FOUND, Xnonce)
 
   if ((state3.y & 0xFFFFFFF0U) == 0)
   {
@@ -26,6 +26,8 @@
 
 // kernel code from Nanashi Meiyo-Meijin 1.7.6-r10 (July 2016)
 
+#include "results.cl"
+
 #pragma OPENCL EXTENSION cl_amd_media_ops : enable
 
 /*
@@ -890,11 +892,7 @@ __kernel void neoscrypt_gpu_hash_ending(__global uint *c_data, __global uint8 *T
 	uint outbuf = fastkdf32_v3(thread, ZNonce, (uint*)Z, s_data, c_data);
 
 #define NEOSCRYPT_FOUND (0xFF)
-#ifdef cl_khr_global_int32_base_atomics
-    #define SETFOUND(nonce) output[atomic_add(&output[NEOSCRYPT_FOUND], 1)] = nonce
-#else
-    #define SETFOUND(nonce) output[output[NEOSCRYPT_FOUND]++] = nonce
-#endif
+    #define SETFOUND(nonce) RESULT_PUSH(output, NEOSCRYPT_FOUND, nonce)
 
     if(outbuf <= target) SETFOUND(nonce);
 }
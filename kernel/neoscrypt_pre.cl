@@ -30,6 +30,8 @@
  * v8b, 26-Dec-2017 */
 
 
+#include "results.cl"
+
 #if (__ATI_RV770__) || (__ATI_RV730__) || (__ATI_RV710__)
 /* AMD TeraScale with OpenCL / VLIW5 (all HD4000 series) */
 #define OLD_VLIW 1
@@ -1147,11 +1149,7 @@ __kernel void search(__global const uint4 *restrict input, __global uint *restri
     neoscrypt_fastkdf_comp(XZ);
 
 #define NEOSCRYPT_FOUND (0xFF)
-#ifdef cl_khr_global_int32_base_atomics
-    #define SETFOUND(nonce) output[atomic_add(&output[NEOSCRYPT_FOUND], 1)] = nonce
-#else
-    #define SETFOUND(nonce) output[output[NEOSCRYPT_FOUND]++] = nonce
-#endif
+    #define SETFOUND(nonce) RESULT_PUSH(output, NEOSCRYPT_FOUND, nonce)
 
     if(XZi[87] <= target) SETFOUND(glbid);
 
@@ -27,6 +27,8 @@
  * @author tpruvot 2016
  */
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
   #define SPH_LITTLE_ENDIAN 1
 #else
@@ -600,5 +602,5 @@ __kernel void search5(__global hash_t* hashes, __global uint* output, const ulon
   bool result = (Vb11 <= target);
 
   if (result)
-      output[atomic_inc(output+0xFF)] = gid;
+      RESULT_PUSH(output, 0xFF, gid);
 }
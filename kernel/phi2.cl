@@ -29,6 +29,8 @@
  * @author fancyIX 2018
  */
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
   #define SPH_LITTLE_ENDIAN 1
 #else
@@ -856,7 +858,7 @@ __kernel void search11(__global hash_t* hashes, __global uint* output, const ulo
 
   bool result = ((hash->h8[3]) <= target);
   if (result)
-    output[atomic_inc(output+0xFF)] = SWAP4(gid);
+    RESULT_PUSH(output, 0xFF, SWAP4(gid));
 
   barrier(CLK_GLOBAL_MEM_FENCE);
 }
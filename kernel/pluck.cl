@@ -28,6 +28,8 @@
 *
 * @author   djm34
 */
+#include "results.cl"
+
 #if !defined(cl_khr_byte_addressable_store)
 #error "Device does not support unaligned stores"
 #endif
@@ -452,7 +454,7 @@ __kernel void search(__global const uchar* restrict input, __global uint* restri
 	} // main loop
 
 	
-	if( ((__global uint *)hashbuffer)[7] <= (target)) {output[atomic_inc(output + 0xFF)] = SWAP32(get_global_id(0));
+	if( ((__global uint *)hashbuffer)[7] <= (target)) {RESULT_PUSH(output, 0xFF, SWAP32(get_global_id(0)));
 //printf("gpu hashbuffer %08x nonce %08x\n",((__global uint *)hashbuffer)[7] ,SWAP32(get_global_id(0)));
 }
 
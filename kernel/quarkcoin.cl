@@ -32,6 +32,8 @@
 #ifndef QUARKCOIN_CL
 #define QUARKCOIN_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
 #else
@@ -1093,7 +1095,7 @@ XH64 =  XL64^q[24]^q[25]^q[26]^q[27]^q[28]^q[29]^q[30]^q[31];
 
   bool result = (SWAP8(hash.h8[3]) <= target);
   if (result)
-    output[output[0xFF]++] = SWAP4(gid);
+    RESULT_PUSH(output, 0xFF, SWAP4(gid));
 }
 
 #endif // QUARKCOIN_CL
\ No newline at end of file
@@ -0,0 +1,19 @@
+/*
+ * Candidate nonces of a batch, shared by the kernels.
+ *
+ * output[0 .. found - 1] hold the nonces and output[found] counts them.
+ * Every candidate takes its slot with one atomic increment. The count
+ * keeps going once the slots are full, so the host can tell how many
+ * nonces a full buffer dropped instead of reading a corrupt count.
+ */
+
+#ifndef RESULTS_CL
+#define RESULTS_CL
+
+#define RESULT_PUSH(output, found, nonce) do { \
+    uint result_slot = atomic_inc((output) + (found)); \
+    if (result_slot < (found)) \
+      (output)[result_slot] = (nonce); \
+  } while (0)
+
+#endif // RESULTS_CL
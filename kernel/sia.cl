@@ -1,4 +1,6 @@
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
   #define SPH_LITTLE_ENDIAN 1
 #else
@@ -116,5 +118,5 @@ __kernel void search(__global unsigned char* block, volatile __global uint* outp
 
 	bool result = (SWAP8(0x6a09e667f2bdc928 ^ v[0] ^ v[8]) <= target);
 	if (result)
-		output[output[0xFF]++] = SWAP4(gid);
+		RESULT_PUSH(output, 0xFF, SWAP4(gid));
 }
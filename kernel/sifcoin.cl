@@ -32,6 +32,8 @@
 #ifndef SIFCOIN_CL
 #define SIFCOIN_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
 #else
@@ -631,7 +633,7 @@ __kernel void search(__global unsigned char* block, volatile __global uint* outp
 
   bool result = (SWAP8(hash.h8[3]) <= target);
   if (result)
-    output[output[0xFF]++] = SWAP4(gid);
+    RESULT_PUSH(output, 0xFF, SWAP4(gid));
 }
 
 #endif // SIFCOIN_CL
\ No newline at end of file
@@ -32,6 +32,8 @@
 #ifndef TALKCOIN_MOD_CL
 #define TALKCOIN_MOD_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
   #define SPH_LITTLE_ENDIAN 1
 #else
@@ -397,7 +399,7 @@ __kernel void search4(__global hash_t* hashes, __global uint* output, const ulon
 
   bool result = (SWAP8(hash.h8[3]) <= target);
   if (result)
-  output[atomic_inc(output+0xFF)] = SWAP4(gid);
+  RESULT_PUSH(output, 0xFF, SWAP4(gid));
 }
 
 #endif // TALKCOIN_MOD_CL
\ No newline at end of file
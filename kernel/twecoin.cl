@@ -1,3 +1,5 @@
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
 #else
@@ -431,6 +433,6 @@ __kernel void search(__global unsigned char* block, volatile __global uint* outp
 
     bool result = ((((sph_u64) state[16] << 32) | state[15]) <= target);
     if (result)
-      output[output[0xFF]++] = SWAP4(gid);
+      RESULT_PUSH(output, 0xFF, SWAP4(gid));
   }
 }
\ No newline at end of file
@@ -33,6 +33,8 @@
 #ifndef W_CL
 #define W_CL
 
+#include "results.cl"
+
 #if __ENDIAN_LITTLE__
 #define SPH_LITTLE_ENDIAN 1
 #else
@@ -1352,7 +1354,7 @@ __kernel void search3(__global hash_t* hashes, __global uint* output, const ulon
 
     bool result = (hash->h8[3] <= target);
     if (result)
-        output[atomic_inc(output+0xFF)] = SWAP4(gid);
+        RESULT_PUSH(output, 0xFF, SWAP4(gid));
 }
 
 #endif // W_CL
\ No newline at end of file
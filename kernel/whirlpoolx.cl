@@ -1,6 +1,8 @@
 #ifndef WHIRLPOOLX_CL
 #define WHIRLPOOLX_CL
 
+#include "results.cl"
+
 /*
 	Where are the other tables? You'll probably feel stupid when I tell you, but the T1 - T7
 	tables are all copies of the T0 table, with every ulong rotated left by the table number
@@ -309,7 +311,7 @@ __kernel void search(const ulong8 midstate, const ulong input0, const ulong inpu
 		Therefore, explicit OpenCL cast to uchar4, reverse bytes, and explicit cast back to uint should be quicker, not that it matters much.
 	*/
 	
-	if((midstate.s3 ^ n.s3 ^ midstate.s5 ^ n.s5) <= target) output[atomic_inc(output+0xFF)] = as_uint(as_uchar4(gid).s3210);
+	if((midstate.s3 ^ n.s3 ^ midstate.s5 ^ n.s5) <= target) RESULT_PUSH(output, 0xFF, as_uint(as_uchar4(gid).s3210));
 }
 
 #endif	// WHIRLPOOLX_CL
\ No newline at end of file
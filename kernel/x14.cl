@@ -33,6 +33,8 @@
 #ifndef X14_CL
 #define X14_CL
 
+#include "results.cl"
+
 #define DEBUG(x)
 
 #if __ENDIAN_LITTLE__
@@ -1363,7 +1365,7 @@ __kernel void search13(__global hash_t* hashes, __global uint* output, const ulo
 
   bool result = (hash->h8[3] <= target);
   if (result)
-    output[atomic_inc(output+0xFF)] = SWAP4(gid);
+    RESULT_PUSH(output, 0xFF, SWAP4(gid));
 
   barrier(CLK_GLOBAL_MEM_FENCE);
 }
@@ -37,6 +37,8 @@
 #ifndef X22I_CL
 #define X22I_CL
 
+#include "results.cl"
+
 #define DEBUG(x)
 
 #if __ENDIAN_LITTLE__
@@ -2372,7 +2374,7 @@ __kernel void search23(__global hash_t* hashes, volatile __global uint* output,
 
   bool result = (hash->h8[3] <= target);
   if (result)
-    output[output[0xFF]++] = SWAP4(gid);
+    RESULT_PUSH(output, 0xFF, SWAP4(gid));
 }
 
 #endif // X22I_CL
\ No newline at end of file
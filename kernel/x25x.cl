@@ -37,6 +37,8 @@
 #ifndef X25X_CL
 #define X25X_CL
 
+#include "results.cl"
+
 #define DEBUG(x)
 
 #if __ENDIAN_LITTLE__
@@ -2635,7 +2637,7 @@ __kernel void search27(__global uint* hashes, volatile __global uint* output, co
 	gpu_blake2s_final(&blake2_ctx, hash);
 
 	if (hash[7] <= as_uint2(target).y && hash[6] <= as_uint2(target).x) {
-      output[output[0xFF]++] = SWAP32(gid);
+      RESULT_PUSH(output, 0xFF, SWAP32(gid));
 	}
 }
 
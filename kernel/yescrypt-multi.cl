@@ -28,6 +28,8 @@
 *
 * @author   djm34
 */
+#include "results.cl"
+
 #if !defined(cl_khr_byte_addressable_store)
 #error "Device does not support unaligned stores"
 #endif
@@ -309,6 +311,6 @@ __kernel void search4(__global const uchar* restrict input, __global uint* restr
 
 
 	if (SWAP32(res.s7) <= (target)) 
-		output[atomic_inc(output + 0xFF)] = (nonce);
+		RESULT_PUSH(output, 0xFF, (nonce));
 	
 }
@@ -29,6 +29,8 @@
 * @author   fancyIX
 */
 
+#include "results.cl"
+
 #define YES_TID (get_local_id(1) % (get_local_size(1) >> 1))
 #define YES_GID (get_local_id(1) / (get_local_size(1) >> 1))
 
@@ -371,7 +373,7 @@ __kernel void yescrypt_gpu_hash_k5(__global const uint* restrict input, __global
     sha256_round_body(in, buf);	// length = 32 * 8 = 256 = 0x100
 
     if (SWAP32(buf[7]) <= (target))
-		output[atomic_inc(output + 0xFF)] = (nonce);
+		RESULT_PUSH(output, 0xFF, (nonce));
 
 }
 
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2013-2014 sgminer developers (see AUTHORS.md)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.  See COPYING for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "linebuf.h"
+
+bool linebuf_init(struct linebuf *lb, size_t size)
+{
+  lb->buf = (char *)calloc(size, 1);
+  if (!lb->buf)
+    return false;
+  lb->size = size;
+  lb->head = lb->tail = lb->scan = 0;
+  return true;
+}
+
+void linebuf_free(struct linebuf *lb)
+{
+  free(lb->buf);
+  memset(lb, 0, sizeof(*lb));
+}
+
+void linebuf_clear(struct linebuf *lb)
+{
+  lb->head = lb->tail = lb->scan = 0;
+  if (lb->buf)
+    lb->buf[0] = '\0';
+}
+
+/* Returns room for at least len more bytes behind the unread data, or NULL
+ * if the buffer could not be grown. Views handed out by linebuf_line() are
+ * invalidated. */
+char *linebuf_space(struct linebuf *lb, size_t len)
+{
+  size_t used = lb->tail - lb->head;
+
+  /* Drained buffers start over at the front. This is done here rather than
+   * when the last line is handed out, as that line may start at buf[0]. */
+  if (!used && lb->head) {
+    lb->head = lb->tail = lb->scan = 0;
+    lb->buf[0] = '\0';
+  }
+
+  if (lb->tail + len + 1 <= lb->size)
+    return lb->buf + lb->tail;
+
+  if (lb->head) {
+    memmove(lb->buf, lb->buf + lb->head, used);
+    lb->scan -= lb->head;
+    lb->head = 0;
+    lb->tail = used;
+    lb->buf[used] = '\0';
+    if (used + len + 1 <= lb->size)
+      return lb->buf + lb->tail;
+  }
+
+  if (used + len + 1 > lb->size) {
+    size_t newsize = lb->size ? lb->size : 64;
+    char *newbuf;
+
+    while (newsize < used + len + 1)
+      newsize <<= 1;
+    newbuf = (char *)realloc(lb->buf, newsize);
+    if (!newbuf)
+      return NULL;
+    lb->buf = newbuf;
+    lb->size = newsize;
+  }
+  return lb->buf + lb->tail;
+}
+
+/* Accounts for len bytes written to the space returned by linebuf_space() */
+void linebuf_commit(struct linebuf *lb, size_t len)
+{
+  lb->tail += len;
+  lb->buf[lb->tail] = '\0';
+}
+
+/* Returns the next complete line, without its newline and 0 terminated in
+ * place, or NULL if there is none yet. Empty lines are skipped. The view is
+ * valid until the next linebuf_space() or linebuf_clear(). */
+char *linebuf_line(struct linebuf *lb, size_t *len)
+{
+  while (lb->scan < lb->tail) {
+    char *start = lb->buf + lb->head;
+    char *nl = (char *)memchr(lb->buf + lb->scan, '\n', lb->tail - lb->scan);
+
+    if (!nl) {
+      lb->scan = lb->tail;
+      break;
+    }
+
+    *nl = '\0';
+    *len = nl - start;
+    lb->head = lb->scan = nl - lb->buf + 1;
+    if (*len)
+      return start;
+  }
+  return NULL;
+}
+
+/* Hands out whatever unterminated data is left, emptying the buffer */
+char *linebuf_rest(struct linebuf *lb, size_t *len)
+{
+  char *start = lb->buf + lb->head;
+
+  if (linebuf_empty(lb))
+    return NULL;
+  *len = lb->tail - lb->head;
+  lb->head = lb->scan = lb->tail;
+  return start;
+}
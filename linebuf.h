@@ -0,0 +1,35 @@
+#ifndef LINEBUF_H
+#define LINEBUF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Receive buffer for newline terminated protocols such as stratum.
+ *
+ * Unread data lives in buf[head, tail) and buf[tail] is always 0. Data is
+ * received straight into the free space behind tail, lines are found with
+ * memchr() starting from where the previous scan stopped, and the unread
+ * part is only moved to the front of the buffer when the free space runs
+ * out. The buffer grows by doubling, so long lines cost amortised O(n). */
+struct linebuf {
+  char *buf;
+  size_t size;
+  size_t head;
+  size_t tail;
+  size_t scan;  /* buf[head, scan) is known to hold no newline */
+};
+
+extern bool linebuf_init(struct linebuf *lb, size_t size);
+extern void linebuf_free(struct linebuf *lb);
+extern void linebuf_clear(struct linebuf *lb);
+extern char *linebuf_space(struct linebuf *lb, size_t len);
+extern void linebuf_commit(struct linebuf *lb, size_t len);
+extern char *linebuf_line(struct linebuf *lb, size_t *len);
+extern char *linebuf_rest(struct linebuf *lb, size_t *len);
+
+static inline bool linebuf_empty(const struct linebuf *lb)
+{
+  return lb->head == lb->tail;
+}
+
+#endif /* LINEBUF_H */
@@ -0,0 +1,76 @@
+/*
+ * Lane-parallel Merkle tree node hash: the 4 round BLAKE2b-128 of two
+ * 16 byte children, exactly what gen_layer() computed through
+ * amtp_blake2b4rounds_update()/final().
+ *
+ * Included by merkle-tree.cpp once per backend, with ML_LANES (nodes per
+ * call), ML_NAME(x) (suffixes the width onto every symbol) and ML_ATTR
+ * (function attributes, e.g. the target ISA) defined. Lane l of every
+ * state word belongs to node l; with one lane the words are plain
+ * integers, so that instance builds without vector extensions.
+ */
+
+#if ML_LANES > 1
+typedef uint64_t ML_NAME(v64) __attribute__((vector_size(8 * ML_LANES)));
+#define ML_LANE(v, l)  ((v)[l])
+#else
+typedef uint64_t ML_NAME(v64);
+#define ML_LANE(v, l)  (v)
+#endif
+
+#define V64 ML_NAME(v64)
+#define ROTR64(x, n)  (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define ML_G(a, b, c, d, x, y) do { \
+        a = a + b + (x); d = ROTR64(d ^ a, 32); \
+        c = c + d;       b = ROTR64(b ^ c, 24); \
+        a = a + b + (y); d = ROTR64(d ^ a, 16); \
+        c = c + d;       b = ROTR64(b ^ c, 63); \
+    } while (0)
+
+/* Hash the ML_LANES child pairs at in (32 bytes each) into the nodes at
+ * out (16 bytes each) */
+ML_ATTR static void ML_NAME(merkle_hash_nodes)(const uint8_t *in, uint8_t *out)
+{
+    V64 v[16], m[16];
+    int i, l, r;
+
+    for (i = 0; i < 16; i++)
+        m[i] = v[i] = V64();
+    for (i = 0; i < 4; i++)
+        for (l = 0; l < ML_LANES; l++)
+            ML_LANE(m[i], l) = merkle_load64(in + 32 * l + 8 * i);
+
+    for (i = 0; i < 8; i++) {
+        v[i] += merkle_h0[i];
+        v[i + 8] += merkle_iv[i];
+    }
+    v[12] ^= (uint64_t)2 * MERKLE_TREE_ELEMENT_SIZE_B;   /* t[0] */
+    v[14] = ~v[14];                                         /* f[0] */
+
+    MERKLE_UNROLL
+    for (r = 0; r < 4; r++) {
+        const uint8_t *s = merkle_sigma[r];
+
+        ML_G(v[0], v[4], v[8],  v[12], m[s[0]],  m[s[1]]);
+        ML_G(v[1], v[5], v[9],  v[13], m[s[2]],  m[s[3]]);
+        ML_G(v[2], v[6], v[10], v[14], m[s[4]],  m[s[5]]);
+        ML_G(v[3], v[7], v[11], v[15], m[s[6]],  m[s[7]]);
+        ML_G(v[0], v[5], v[10], v[15], m[s[8]],  m[s[9]]);
+        ML_G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+        ML_G(v[2], v[7], v[8],  v[13], m[s[12]], m[s[13]]);
+        ML_G(v[3], v[4], v[9],  v[14], m[s[14]], m[s[15]]);
+    }
+
+    for (i = 0; i < 2; i++) {
+        V64 h = v[i] ^ v[i + 8];
+
+        for (l = 0; l < ML_LANES; l++)
+            merkle_store64(out + 16 * l + 8 * i, ML_LANE(h, l) ^ merkle_h0[i]);
+    }
+}
+
+#undef V64
+#undef ROTR64
+#undef ML_G
+#undef ML_LANE
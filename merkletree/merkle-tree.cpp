@@ -3,9 +3,110 @@
 #include <iomanip>
 #include <algorithm>
 #include <iterator>
+#include <atomic>
+#include <thread>
+#include <system_error>
+#include <cstdlib>
+#include <cstring>
 //#include "mtp_blake2/blake2.h"
 #include "../mtp_argon2ref/mtp_blake2.h"
 
+/* Layers of the 4M leaf MTP tree, leaves and root included */
+#define MERKLE_TREE_LEAVES (4 * 1024 * 1024)
+#define MERKLE_TREE_LAYERS 23
+
+/* The tree is built as independent subtrees of this many leaves, small
+ * enough for a core's cache, then the few layers above them */
+#define MERKLE_TREE_CHUNK_LEAVES (64 * 1024)
+#define MERKLE_TREE_CHUNK_LAYERS 16
+
+static const uint64_t merkle_iv[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+/* The IV with the unkeyed BLAKE2b-128 parameter block folded in */
+static const uint64_t merkle_h0[8] = {
+    0x6a09e667f3bcc908ULL ^ 0x01010000ULL ^ MERKLE_TREE_ELEMENT_SIZE_B, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL, 0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static const uint8_t merkle_sigma[4][16] = {
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
+    { 11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4 },
+    { 7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8 }
+};
+
+/* Little endian, like the rest of the MTP code */
+static inline uint64_t merkle_load64(const uint8_t *p)
+{
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+static inline void merkle_store64(uint8_t *p, uint64_t w)
+{
+    memcpy(p, &w, sizeof(w));
+}
+
+#if defined(__GNUC__)
+/* Full unrolling turns the sigma lookups into register names */
+#define MERKLE_UNROLL _Pragma("GCC unroll 4")
+#else
+#define MERKLE_UNROLL
+#endif
+
+#define ML_LANES 1
+#define ML_NAME(x) x ## _1
+#define ML_ATTR
+#include "merkle-tree-lanes.h"
+#undef ML_LANES
+#undef ML_NAME
+#undef ML_ATTR
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MERKLE_X86 1
+
+#define ML_LANES 4
+#define ML_NAME(x) x ## _4
+#define ML_ATTR __attribute__((target("avx2")))
+#include "merkle-tree-lanes.h"
+#undef ML_LANES
+#undef ML_NAME
+#undef ML_ATTR
+
+#define ML_LANES 8
+#define ML_NAME(x) x ## _8
+#define ML_ATTR __attribute__((target("avx512f")))
+#include "merkle-tree-lanes.h"
+#undef ML_LANES
+#undef ML_NAME
+#undef ML_ATTR
+#endif
+
+/* Hash count child pairs at in into count nodes at out, through the
+ * widest node hash the CPU supports */
+static void merkle_hash_layer(const uint8_t *in, uint8_t *out, size_t count)
+{
+    size_t i = 0;
+
+#ifdef MERKLE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        for (; i + 8 <= count; i += 8)
+            merkle_hash_nodes_8(in + 32 * i, out + 16 * i);
+    } else if (__builtin_cpu_supports("avx2")) {
+        for (; i + 4 <= count; i += 4)
+            merkle_hash_nodes_4(in + 32 * i, out + 16 * i);
+    }
+#endif
+    for (; i < count; i++)
+        merkle_hash_nodes_1(in + 32 * i, out + 16 * i);
+}
+
 std::ostream& operator<<(std::ostream& os, const MerkleTree::Buffer& buffer)
 {
     for (   MerkleTree::Buffer::const_iterator it = buffer.begin();
@@ -17,7 +118,7 @@ std::ostream& operator<<(std::ostream& os, const MerkleTree::Buffer& buffer)
 }
 
 MerkleTree::MerkleTree(uint8_t * elements, bool preserveOrder)
-    : preserveOrder_(preserveOrder)//, elements_(elements)
+    : preserveOrder_(preserveOrder), arena_(NULL)//, elements_(elements)
 {
 //   mem[0]=(elements);
 //	uint8_t* Truc(elements);
@@ -73,6 +174,7 @@ printf("Init layer addr %lx\n",elements);
 }
 
 MerkleTree::MerkleTree()
+    : arena_(NULL)
 {
 }
 MerkleTree::~MerkleTree()
@@ -83,9 +185,11 @@ MerkleTree::~MerkleTree()
 }
 void MerkleTree::Destructor()
 {
-	for(int i=1;i<mem.size();i++) { // element 0 is.... aaahh !!!
-		free(mem[i]);
-		};
+	// element 0 is the caller's leaves, the other layers live in the arena
+	free(arena_);
+	arena_ = NULL;
+	if (!mem.empty())
+		mem.resize(1);
 //	mem.clear();
 //	mem.shrink_to_fit();
 
@@ -96,23 +200,12 @@ MerkleTree::Buffer MerkleTree::hash(const Buffer& data)
     amtp_blake2b_state state;
     amtp_blake2b_init(&state, MERKLE_TREE_ELEMENT_SIZE_B);
   //  printf("%x %x %x %x\n",state.t[0],state.t[1],state.f[0],state.f[1]);
-    for (Buffer::const_iterator it = data.begin(); it != data.end(); ++it) {
-        amtp_blake2b4rounds_update(&state, &(*it), sizeof(*it));
-    }
+    amtp_blake2b4rounds_update(&state, data.data(), data.size());
     uint8_t digest[MERKLE_TREE_ELEMENT_SIZE_B];
     amtp_blake2b4rounds_final(&state, digest, sizeof(digest));
     return Buffer(digest, digest + sizeof(digest));
 }
 
-void gen_layer(uint8_t* o, uint8_t* n, int size){
-	for(int i=0;i<size;i++){
-		amtp_blake2b_state state;
-	        amtp_blake2b_init(&state, MERKLE_TREE_ELEMENT_SIZE_B);
-		amtp_blake2b4rounds_update(&state, &o[32*i], 32);
-		amtp_blake2b4rounds_final(&state, &n[16*i], 16);
-	}
-}
-
 MerkleTree::Buffer MerkleTree::combinedHash(const Buffer& first,
         const Buffer& second, bool preserveOrder)
 {
@@ -128,8 +221,6 @@ MerkleTree::Buffer MerkleTree::combinedHash(const Buffer& first,
     }
 //    printf("buf %lx\n",buffer[0]);
 
-        Buffer x = hash(buffer);
-
 //	for(int i=0;i<32;i++)
 //		printf("%x ",x[i]);
 //	printf("%d \n", preserveOrder);
@@ -257,69 +348,68 @@ bool MerkleTree::checkProofOrdered(const Elements& proof,
     return tempHash == root;
 }
 
-void MerkleTree::getLayers()
+void MerkleTree::rebuild(uint8_t* elements)
 {
-
-	while (mem.size() < 23){
-		getNextLayer();
-	}
-
-//for(;;);
-/*
-    layers_.clear();
-
-    // The first layer is the elements themselves
-    layers_.push_back(elements_);
-
-    if (elements_.empty()) {
-        return; // nothing left to do
+    if (mem.empty()) {
+        mem.push_back(elements);
+    } else {
+        mem[0] = elements;
     }
-
-    // For subsequent layers, combine each pair of hashes in the previous
-    // layer to build the current layer. Repeat until the current layer has
-    // only one hash (this will be the root of the tree).
-    while (layers_.back().size() > 1) {
-        getNextLayer();
-    }*/
+    getLayers();
 }
 
-void MerkleTree::getNextLayer()
+void MerkleTree::getLayers()
 {
+    // Every layer above the leaves goes into one allocation, layer i
+    // (MERKLE_TREE_LEAVES >> i nodes) right after layer i - 1. A rebuild
+    // hashes into the allocation it already has.
+    if (!arena_) {
+        arena_ = (uint8_t *)malloc((MERKLE_TREE_LEAVES - 1) * MERKLE_TREE_ELEMENT_SIZE_B);
+        if (!arena_) {
+            throw std::bad_alloc();
+        }
+        for (size_t nodes = MERKLE_TREE_LEAVES / 2, offset = 0; nodes;
+                offset += nodes * MERKLE_TREE_ELEMENT_SIZE_B, nodes /= 2) {
+            mem.push_back(arena_ + offset);
+        }
+    }
 
-uint8_t *prev_mem= mem.back();
-
-int size=1024*1024*4*16;
-for(int i=0;i<mem.size();i++)
-	size/=2;
-//printf("size %d %d %d\n",size, mem.size(), 1024*1024*4*16);
-uint8_t *new_mem=(uint8_t *)malloc(size);
-
-gen_layer(prev_mem, new_mem, size/16);
-mem.push_back(new_mem);
-
+    // The subtrees are independent; the threads take them in turn
+    const size_t chunks = MERKLE_TREE_LEAVES / MERKLE_TREE_CHUNK_LEAVES;
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    auto build = [this, &next, chunks]() {
+        for (size_t chunk; (chunk = next++) < chunks; ) {
+            buildSubtree(chunk);
+        }
+    };
+    size_t nthreads = std::min<size_t>(std::thread::hardware_concurrency(), chunks);
+
+    for (size_t i = 1; i < nthreads; i++) {
+        try {
+            workers.emplace_back(build);
+        } catch (const std::system_error&) {
+            break; // the threads that did start, and this one, do the rest
+        }
+    }
+    build();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
 
-//for(;;);
-/*
-    const Elements& previous_layer = layers_.back();
+    for (size_t i = MERKLE_TREE_CHUNK_LAYERS + 1; i < MERKLE_TREE_LAYERS; i++) {
+        merkle_hash_layer(mem[i - 1], mem[i], MERKLE_TREE_LEAVES >> i);
+    }
+}
 
-    // Create a new empty layer
-    layers_.push_back(Elements());
-    Elements& current_layer = layers_.back();
+void MerkleTree::buildSubtree(size_t chunk)
+{
+    for (size_t i = 1; i <= MERKLE_TREE_CHUNK_LAYERS; i++) {
+        size_t nodes = MERKLE_TREE_CHUNK_LEAVES >> i, first = chunk * nodes;
 
-    // For each pair of elements in the previous layer
-    // NB: If there is an odd number of elements, we ignore the last one for now
-    for (size_t i = 0; i < (previous_layer.size() / 2); ++i) {
-        current_layer.push_back(combinedHash(previous_layer[2*i],
-                    previous_layer[2*i + 1], preserveOrder_));
+        merkle_hash_layer(mem[i - 1] + 2 * MERKLE_TREE_ELEMENT_SIZE_B * first,
+                mem[i] + MERKLE_TREE_ELEMENT_SIZE_B * first, nodes);
     }
-
-//	printf("size %d %d\n",sizeof(current_layer.back()), sizeof(current_layer));
-//for(;;);
-    // If there is an odd one out at the end, process it
-    // NB: It's on its own, so we don't combine it with anything
-    if (previous_layer.size() & 1) {
-        current_layer.push_back(previous_layer.back());
-    }*/
 }
 
 MerkleTree::Elements MerkleTree::getProof(size_t index) const
@@ -366,15 +456,11 @@ bool MerkleTree::getPair(const Elements& layer, size_t index, Buffer& pair)
     return true;
 }*/
 
-size_t get_chunk_size(size_t index){
-size_t  size=1024*1024*4*16;
-for(int i=0;i<index;i++)
-        size/=2;
-size/=16;
-return size;
+static size_t get_chunk_size(size_t index){
+return MERKLE_TREE_LEAVES >> index;
 }
 
-bool MerkleTree::getPair2(std::vector<uint8_t*> m, size_t chunk_index, size_t index, Buffer& pair)
+bool MerkleTree::getPair2(const std::vector<uint8_t*>& m, size_t chunk_index, size_t index, Buffer& pair)
 {
     size_t pairIndex;
     if (index & 1) {
@@ -428,6 +514,10 @@ MerkleTree *call_new_MerkleTree(uint8_t* elements, bool preserveOrder) {
     return new MerkleTree(elements, preserveOrder);
 }
 
+void call_MerkleTree_rebuild(MerkleTree* mt, uint8_t* elements) {
+    mt->rebuild(elements);
+}
+
 void call_MerkleTree_getRoot(MerkleTree* mt, unsigned char *TheMerkleRoot) {
     MerkleTree::Buffer root = mt->getRoot();
 	std::copy(root.begin(), root.end(), TheMerkleRoot);
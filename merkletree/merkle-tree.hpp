@@ -59,6 +59,12 @@ public :
     MerkleTree(uint8_t* elements, bool preserveOrder = true);
 	MerkleTree();
 	void Destructor();
+
+    /** Rebuild the tree over new leaves, reusing the layers' memory
+     *
+     * \param elements [in] The new leaves, laid out like the constructor's
+     */
+    void rebuild(uint8_t* elements);
     /** Destructor */
     virtual ~MerkleTree();
 
@@ -233,11 +239,13 @@ private :
 
      std::vector<uint8_t*> mem;
 //    uint8_t *mem[64];
+     uint8_t *arena_; /**< Every layer but the leaves, in one allocation */
+
     /** Build the Merkle Tree layers */
     void getLayers();
 
-    /** Build the next Merkle Tree layer */
-    void getNextLayer();
+    /** Build the layers above one chunk of leaves, up to its subtree root */
+    void buildSubtree(size_t chunk);
 
     /** Get proof given the index of the element
      *
@@ -258,7 +266,7 @@ private :
      *         for the last one, which obviously has no peer)
      */
 //    static bool getPair(const Elements& layer, size_t index, Buffer& pair);
-    static bool getPair2(std::vector<uint8_t*> m, size_t chunk_index, size_t index, Buffer& pair);
+    static bool getPair2(const std::vector<uint8_t*>& m, size_t chunk_index, size_t index, Buffer& pair);
 
     /** Converts a list of hashes into a hexadecimal string */
     static std::string elementsToHex(const Elements& elements);
@@ -287,4 +295,9 @@ extern "C"
 #endif
 void call_MerkleTree_getRoot(MerkleTree* mt, unsigned char *TheMerkleRoot);
 
+#ifdef __cplusplus
+extern "C"
+#endif
+void call_MerkleTree_rebuild(MerkleTree* mt, uint8_t* elements);
+
 #endif // MERKLE_TREE_HPP_
@@ -11,6 +11,7 @@
 #include <ios>
 #include <stdio.h>
 #include <iostream>
+#include <chrono>
 #if defined __STDC_LIB_EXT1__
 #define __STDC_WANT_LIB_EXT1__ 1
 #endif
@@ -28,7 +29,14 @@ extern
 #else
 extern "C" 
 #endif
-void get_argon_block(cl_command_queue Queue,cl_mem block, cl_mem block2, uint8_t* clblock,  uint32_t index);
+cl_int get_argon_blocks(cl_command_queue Queue, cl_mem block, cl_mem block2, uint8_t *const *dst, const uint32_t *index, int count);
+#ifndef _MSC_VER
+extern "C" {
+#endif
+#include "logging.h"
+#ifndef _MSC_VER
+}
+#endif
 uint32_t index_beta(const mtp_argon2_instance_t *instance,
 	const mtp_argon2_position_t *position, uint32_t pseudo_rand,
 	int same_lane) {
@@ -96,7 +104,8 @@ uint32_t index_beta(const mtp_argon2_instance_t *instance,
 
 
 
-void getargon_blockindex_orig(uint32_t ij, mtp_argon2_instance_t *instance, uint32_t *out_ij_prev, uint32_t *out_computed_ref_argon_block)
+/* Index of the block argon2 filled just before block ij */
+static uint32_t argon_block_prev_index(uint32_t ij, const mtp_argon2_instance_t *instance)
 {
 	uint32_t ij_prev = 0;
 	if (ij%instance->lane_length == 0)
@@ -107,47 +116,13 @@ void getargon_blockindex_orig(uint32_t ij, mtp_argon2_instance_t *instance, uint
 	if (ij % instance->lane_length == 1)
 		ij_prev = ij - 1;
 
-	uint64_t prev_argon_block_opening = instance->memory[ij_prev].v[0];
-	uint32_t ref_lane = (uint32_t)((prev_argon_block_opening >> 32) % instance->lanes);
-
-	uint32_t pseudo_rand = (uint32_t)(prev_argon_block_opening & 0xFFFFFFFF);
-
-	uint32_t Lane = ((ij) / instance->lane_length);
-	uint32_t Slice = (ij - (Lane * instance->lane_length)) / instance->segment_length;
-	uint32_t posIndex = ij - Lane * instance->lane_length - Slice * instance->segment_length;
-
-
-	uint32_t rec_ij = Slice*instance->segment_length + Lane *instance->lane_length + (ij % instance->segment_length);
-
-	if (Slice == 0)
-		ref_lane = Lane;
-
-
-	mtp_argon2_position_t position = { 0, Lane , (uint8_t)Slice, posIndex };
-
-	uint32_t ref_index = index_beta(instance, &position, pseudo_rand, ref_lane == position.lane);
-
-	uint32_t computed_ref_argon_block = instance->lane_length * ref_lane + ref_index;
-
-	*out_ij_prev = ij_prev;
-	*out_computed_ref_argon_block = computed_ref_argon_block;
+	return ij_prev;
 }
 
-
-void getargon_blockindex(int thr_id, cl_command_queue Queue, cl_mem block, cl_mem block2, uint32_t ij, mtp_argon2_instance_t *instance, uint32_t *out_ij_prev, uint32_t *out_computed_ref_argon_block)
+/* Index of the block argon2 referenced when filling block ij, from the
+ * first word of the block before it */
+static uint32_t argon_block_ref_index(uint32_t ij, const mtp_argon2_instance_t *instance, uint64_t prev_argon_block_opening)
 {
-	uint32_t ij_prev = 0;
-	if (ij%instance->lane_length == 0)
-		ij_prev = ij + instance->lane_length - 1;
-	else
-		ij_prev = ij - 1;
-
-	if (ij % instance->lane_length == 1)
-		ij_prev = ij - 1;
-
-	argon_block b;
-	get_argon_block(/*thr_id,*/Queue,block, block2, (uint8_t*)&b.v, ij_prev);
-	uint64_t prev_argon_block_opening = b.v[0];//instance->memory[ij_prev].v[0];
 	uint32_t ref_lane = (uint32_t)((prev_argon_block_opening >> 32) % instance->lanes);
 
 	uint32_t pseudo_rand = (uint32_t)(prev_argon_block_opening & 0xFFFFFFFF);
@@ -156,21 +131,22 @@ void getargon_blockindex(int thr_id, cl_command_queue Queue, cl_mem block, cl_me
 	uint32_t Slice = (ij - (Lane * instance->lane_length)) / instance->segment_length;
 	uint32_t posIndex = ij - Lane * instance->lane_length - Slice * instance->segment_length;
 
-
-	uint32_t rec_ij = Slice*instance->segment_length + Lane *instance->lane_length + (ij % instance->segment_length);
-
 	if (Slice == 0)
 		ref_lane = Lane;
 
-
 	mtp_argon2_position_t position = { 0, Lane , (uint8_t)Slice, posIndex };
 
 	uint32_t ref_index = index_beta(instance, &position, pseudo_rand, ref_lane == position.lane);
 
-	uint32_t computed_ref_argon_block = instance->lane_length * ref_lane + ref_index;
+	return instance->lane_length * ref_lane + ref_index;
+}
+
+void getargon_blockindex_orig(uint32_t ij, mtp_argon2_instance_t *instance, uint32_t *out_ij_prev, uint32_t *out_computed_ref_argon_block)
+{
+	uint32_t ij_prev = argon_block_prev_index(ij, instance);
 
 	*out_ij_prev = ij_prev;
-	*out_computed_ref_argon_block = computed_ref_argon_block;
+	*out_computed_ref_argon_block = argon_block_ref_index(ij, instance, instance->memory[ij_prev].v[0]);
 }
 
 
@@ -669,204 +645,149 @@ int mtp_solver_c(int thr_id, cl_command_queue Queue, cl_mem clblock, cl_mem clbl
 	                      *pTheTree, input, TheUint256Target[0]);
 	}
 
-int mtp_solver(int thr_id, cl_command_queue Queue, cl_mem clblock, cl_mem clblock2, uint32_t TheNonce, mtp_argon2_instance_t *instance,
-	argon_blockS *nargon_blockMTP /*[72 * 2][128]*/, unsigned char* nProofMTP, unsigned char* resultMerkleRoot, unsigned char* mtpHashValue,
-	MerkleTree TheTree, uint32_t* input, uint256 hashTarget) {
-
-
-	if (instance != NULL) {
-		//		input[19]=0x01000000;
-		uint256 Y[L + 1];
-		//		std::string proof_argon_blocks[L * 3];
-		memset(&Y, 0, sizeof(Y));
-		uint8_t zero[32] = { 0 };
-		amtp_blake2b_state BlakeHash;
-		amtp_blake2b_init(&BlakeHash, 32);
-
-
-
-
-		amtp_blake2b_update(&BlakeHash, (unsigned char*)&input[0], 80);
-		amtp_blake2b_update(&BlakeHash, (unsigned char*)&resultMerkleRoot[0], 16);
-		amtp_blake2b_update(&BlakeHash, &TheNonce, sizeof(unsigned int));
-		amtp_blake2b_final(&BlakeHash, (unsigned char*)&Y[0], 32);
-
-		argon_blockS argon_blocks[L * 2];
-
-		///////////////////////////////
-		bool init_argon_blocks = false;
-		bool unmatch_argon_block = false;
-		unsigned char proof_ser[1000] = { 0 };
-		unsigned int proof_size;
-		for (uint8_t j = 1; j <= L; j++) {
-
-			uint32_t ij = (((uint32_t*)(&Y[j - 1]))[0]) % (instance->context_ptr->m_cost);
-			uint32_t except_index = (uint32_t)(instance->context_ptr->m_cost / instance->context_ptr->lanes);
-			if (ij %except_index == 0 || ij%except_index == 1) {
-				init_argon_blocks = true;
-				break;
-			}
-
-			uint32_t prev_index;
-			uint32_t ref_index;
-			getargon_blockindex(thr_id, Queue, clblock, clblock2, ij, instance, &prev_index, &ref_index);
-
-			//			static_copy_argon_blockS(&nargon_blockMTP[j * 2 - 2], &instance->memory[prev_index]);
-			get_argon_block(/*thr_id,*/Queue,clblock, clblock2, (uint8_t*)nargon_blockMTP[j * 2 - 2].v, prev_index);
-			//ref argon_block
-			//			static_copy_argon_blockS(&nargon_blockMTP[j * 2 - 1], &instance->memory[ref_index]);
-			get_argon_block(/*thr_id,*/Queue, clblock, clblock2, (uint8_t*)nargon_blockMTP[j * 2 - 1].v, ref_index);
-			argon_block argon_blockhash;
-			uint8_t argon_blockhash_bytes[MTP_ARGON2_argon_block_SIZE];
-			//			static_copy_argon_block(&argon_blockhash, &instance->memory[ij]);
-			get_argon_block(/*thr_id,*/Queue, clblock, clblock2, (uint8_t*)&argon_blockhash.v, ij);
-
-
-			store_argon_block(&argon_blockhash_bytes, &argon_blockhash);
-
-			amtp_blake2b_state BlakeHash2;
-			amtp_blake2b_init(&BlakeHash2, 32);
-			amtp_blake2b_update(&BlakeHash2, &Y[j - 1], sizeof(uint256));
-			amtp_blake2b_update(&BlakeHash2, argon_blockhash_bytes, MTP_ARGON2_argon_block_SIZE);
-			amtp_blake2b_final(&BlakeHash2, (unsigned char*)&Y[j], 32);
-			////////////////////////////////////////////////////////////////
-			// current argon_block
-			static_clear_internal_memory(argon_blockhash.v, MTP_ARGON2_argon_block_SIZE);
-			static_clear_internal_memory(argon_blockhash_bytes, MTP_ARGON2_argon_block_SIZE);
-
-			unsigned char curr[32] = { 0 };
-			argon_block argon_blockhash_curr;
-			uint8_t argon_blockhash_curr_bytes[MTP_ARGON2_argon_block_SIZE];
-			//			static_copy_argon_block(&argon_blockhash_curr, &instance->memory[ij]);
-			get_argon_block(/*thr_id,*/Queue, clblock, clblock2, (uint8_t*)&argon_blockhash_curr.v, ij);
-			store_argon_block(&argon_blockhash_curr_bytes, &argon_blockhash_curr);
-			amtp_blake2b_state state_curr;
-			amtp_blake2b_init(&state_curr, MERKLE_TREE_ELEMENT_SIZE_B);
-			amtp_blake2b4rounds_update(&state_curr, argon_blockhash_curr_bytes, MTP_ARGON2_argon_block_SIZE);
-			uint8_t digest_curr[MERKLE_TREE_ELEMENT_SIZE_B];
-			amtp_blake2b4rounds_final(&state_curr, digest_curr, sizeof(digest_curr));
-			MerkleTree::Buffer hash_curr = MerkleTree::Buffer(digest_curr, digest_curr + sizeof(digest_curr));
-			static_clear_internal_memory(argon_blockhash_curr.v, MTP_ARGON2_argon_block_SIZE);
-			static_clear_internal_memory(argon_blockhash_curr_bytes, MTP_ARGON2_argon_block_SIZE);
-
-
-			std::deque<std::vector<uint8_t> > zProofMTP = TheTree.getProofOrdered(hash_curr, ij + 1);
-
-			nProofMTP[(j * 3 - 3) * 353] = (unsigned char)(zProofMTP.size());
-
-			/* int k1 = 0;
-			for (const std::vector<uint8_t> &mtpData : zProofMTP) {
-				std::copy(mtpData.begin(), mtpData.end(), nProofMTP + ((j * 3 - 3) * 353 + 1 + k1 * mtpData.size()));
-				k1++;
-			}*/
-                        for (int k1 = 0; k1 < zProofMTP.size(); k1++) {
-                            const std::vector<uint8_t> &mtpData = zProofMTP[k1];
-                            std::copy(mtpData.begin(), mtpData.end(), nProofMTP + ((j * 3 - 3) * 353 + 1 + k1 * mtpData.size()));
-                        }
-
-			//prev proof
-			unsigned char prev[32] = { 0 };
-			argon_block argon_blockhash_prev;
-			uint8_t argon_blockhash_prev_bytes[MTP_ARGON2_argon_block_SIZE];
-			//			static_copy_argon_block(&argon_blockhash_prev, &instance->memory[prev_index]);
-			get_argon_block(/*thr_id,*/Queue, clblock, clblock2, (uint8_t*)&argon_blockhash_prev.v, prev_index);
-			store_argon_block(&argon_blockhash_prev_bytes, &argon_blockhash_prev);
-			amtp_blake2b_state state_prev;
-			amtp_blake2b_init(&state_prev, MERKLE_TREE_ELEMENT_SIZE_B);
-			amtp_blake2b4rounds_update(&state_prev, argon_blockhash_prev_bytes, MTP_ARGON2_argon_block_SIZE);
-			uint8_t digest_prev[MERKLE_TREE_ELEMENT_SIZE_B];
-
-
-			amtp_blake2b4rounds_final(&state_prev, digest_prev, sizeof(digest_prev));
-
-
-			MerkleTree::Buffer hash_prev = MerkleTree::Buffer(digest_prev, digest_prev + sizeof(digest_prev));
-			static_clear_internal_memory(argon_blockhash_prev.v, MTP_ARGON2_argon_block_SIZE);
-			static_clear_internal_memory(argon_blockhash_prev_bytes, MTP_ARGON2_argon_block_SIZE);
-
-			std::deque<std::vector<uint8_t> > zProofMTP2 = TheTree.getProofOrdered(hash_prev, prev_index + 1);
-
-			nProofMTP[(j * 3 - 2) * 353] = (unsigned char)(zProofMTP2.size());
-
-			/* int k2 = 0;
-			for (const std::vector<uint8_t> &mtpData : zProofMTP2) {
-				std::copy(mtpData.begin(), mtpData.end(), nProofMTP + ((j * 3 - 2) * 353 + 1 + k2 * mtpData.size()));
-				k2++;
-			} */
-                        for (int k1 = 0; k1 < zProofMTP2.size(); k1++) {
-                            const std::vector<uint8_t> &mtpData = zProofMTP2[k1];
-                            std::copy(mtpData.begin(), mtpData.end(), nProofMTP + ((j * 3 - 2) * 353 + 1 + k1 * mtpData.size()));
-                        }
-
-
-			//ref proof
-			unsigned char ref[32] = { 0 };
-			argon_block argon_blockhash_ref;
-			uint8_t argon_blockhash_ref_bytes[MTP_ARGON2_argon_block_SIZE];
-			//			static_copy_argon_block(&argon_blockhash_ref, &instance->memory[ref_index]);
-			get_argon_block(/*thr_id,*/Queue, clblock, clblock2, (uint8_t*)&argon_blockhash_ref.v, ref_index);
-			store_argon_block(&argon_blockhash_ref_bytes, &argon_blockhash_ref);
-			amtp_blake2b_state state_ref;
-			amtp_blake2b_init(&state_ref, MERKLE_TREE_ELEMENT_SIZE_B);
-			amtp_blake2b4rounds_update(&state_ref, argon_blockhash_ref_bytes, MTP_ARGON2_argon_block_SIZE);
-			uint8_t digest_ref[MERKLE_TREE_ELEMENT_SIZE_B];
-			amtp_blake2b4rounds_final(&state_ref, digest_ref, sizeof(digest_ref));
-			MerkleTree::Buffer hash_ref = MerkleTree::Buffer(digest_ref, digest_ref + sizeof(digest_ref));
-			static_clear_internal_memory(argon_blockhash_ref.v, MTP_ARGON2_argon_block_SIZE);
-			static_clear_internal_memory(argon_blockhash_ref_bytes, MTP_ARGON2_argon_block_SIZE);
-
-			std::deque<std::vector<uint8_t> > zProofMTP3 = TheTree.getProofOrdered(hash_ref, ref_index + 1);
-
-			nProofMTP[(j * 3 - 1) * 353] = (unsigned char)(zProofMTP3.size());
-
-			/* int k3 = 0;
-			for (const std::vector<uint8_t> &mtpData : zProofMTP3) {
-				std::copy(mtpData.begin(), mtpData.end(), nProofMTP + ((j * 3 - 1) * 353 + 1 + k3 * mtpData.size()));
-				k3++;
-			}*/
-                        for (int k1 = 0; k1 < zProofMTP3.size(); k1++) {
-                            const std::vector<uint8_t> &mtpData = zProofMTP3[k1];
-                            std::copy(mtpData.begin(), mtpData.end(), nProofMTP + ((j * 3 - 1) * 353 + 1 + k1 * mtpData.size()));
-                        }
+/* Serialize one argon block the way the Merkle leaves were hashed */
+static void mtp_block_bytes(uint8_t bytes[MTP_ARGON2_argon_block_SIZE], const uint64_t *v)
+{
+	for (unsigned i = 0; i < MTP_ARGON2_QWORDS_IN_argon_block; ++i)
+		mtp_store64(bytes + i * sizeof(v[i]), v[i]);
+}
 
+static void mtp_block_digest(uint8_t digest[MERKLE_TREE_ELEMENT_SIZE_B], const uint8_t bytes[MTP_ARGON2_argon_block_SIZE])
+{
+	amtp_blake2b_state state;
+	amtp_blake2b_init(&state, MERKLE_TREE_ELEMENT_SIZE_B);
+	amtp_blake2b4rounds_update(&state, bytes, MTP_ARGON2_argon_block_SIZE);
+	amtp_blake2b4rounds_final(&state, digest, MERKLE_TREE_ELEMENT_SIZE_B);
+}
 
+/* Write the Merkle path of leaf `index` (hashing to `digest`) into proof
+ * slot `slot` of nProofMTP */
+static void mtp_store_proof(unsigned char *nProofMTP, int slot, const MerkleTree &TheTree,
+	const uint8_t digest[MERKLE_TREE_ELEMENT_SIZE_B], uint32_t index)
+{
+	MerkleTree::Buffer hash = MerkleTree::Buffer(digest, digest + MERKLE_TREE_ELEMENT_SIZE_B);
+	MerkleTree::Elements zProofMTP = TheTree.getProofOrdered(hash, index + 1);
 
-			/////////////////////////////////////////////////////////////////////
-			/////////////////////////////////////////////////////////////////////
-		}
+	nProofMTP[slot * 353] = (unsigned char)(zProofMTP.size());
+	for (size_t k = 0; k < zProofMTP.size(); k++) {
+		const std::vector<uint8_t> &mtpData = zProofMTP[k];
+		std::copy(mtpData.begin(), mtpData.end(), nProofMTP + (slot * 353 + 1 + k * mtpData.size()));
+	}
+}
 
-		if (init_argon_blocks) {
+static double mtp_ms(std::chrono::steady_clock::duration d)
+{
+	return std::chrono::duration<double, std::milli>(d).count();
+}
 
+/*
+ * Check a nonce the GPU found and build its proof from the argon blocks
+ * still on the device.
+ *
+ * Round j needs block ij, which depends on Y[j-1], so the chain costs one
+ * device round trip per round; block ij and the block before it go out as
+ * one batch. The block ij referenced is only needed for the proof, and
+ * its index only depends on the block before ij, so all L of them are
+ * fetched in a single batch once the nonce is known to be a solution.
+ */
+int mtp_solver(int thr_id, cl_command_queue Queue, cl_mem clblock, cl_mem clblock2, uint32_t TheNonce, mtp_argon2_instance_t *instance,
+	argon_blockS *nargon_blockMTP /*[72 * 2][128]*/, unsigned char* nProofMTP, unsigned char* resultMerkleRoot, unsigned char* mtpHashValue,
+	const MerkleTree &TheTree, uint32_t* input, uint256 hashTarget) {
+
+	typedef std::chrono::steady_clock clock;
+
+	if (instance == NULL)
+		return 0;
+
+	clock::time_point start = clock::now(), t;
+	clock::duration fetch_time = clock::duration::zero(), proof_time;
+	int reads = 0, batches = 0;
+
+	uint256 Y[L + 1];
+	memset(&Y, 0, sizeof(Y));
+	amtp_blake2b_state BlakeHash;
+	amtp_blake2b_init(&BlakeHash, 32);
+	amtp_blake2b_update(&BlakeHash, (unsigned char*)&input[0], 80);
+	amtp_blake2b_update(&BlakeHash, (unsigned char*)&resultMerkleRoot[0], 16);
+	amtp_blake2b_update(&BlakeHash, &TheNonce, sizeof(unsigned int));
+	amtp_blake2b_final(&BlakeHash, (unsigned char*)&Y[0], 32);
+
+	uint32_t curr_index[L], prev_index[L], ref_index[L];
+	uint8_t digest_curr[L][MERKLE_TREE_ELEMENT_SIZE_B];
+	argon_blockS argon_blockhash;
+	uint8_t argon_blockhash_bytes[MTP_ARGON2_argon_block_SIZE];
+	uint32_t except_index = (uint32_t)(instance->context_ptr->m_cost / instance->context_ptr->lanes);
+	cl_int status;
+
+	for (int j = 1; j <= L; j++) {
+		uint32_t ij = (((uint32_t*)(&Y[j - 1]))[0]) % (instance->context_ptr->m_cost);
+		if (ij %except_index == 0 || ij%except_index == 1)
 			return 0;
-		}
-
-
-		char hex_tmp[64];
 
-		if (Y[L] > hashTarget) {
+		curr_index[j - 1] = ij;
+		prev_index[j - 1] = argon_block_prev_index(ij, instance);
+
+		uint8_t *dst[2] = { (uint8_t*)argon_blockhash.v, (uint8_t*)nargon_blockMTP[j * 2 - 2].v };
+		uint32_t index[2] = { curr_index[j - 1], prev_index[j - 1] };
+		t = clock::now();
+		status = get_argon_blocks(Queue, clblock, clblock2, dst, index, 2);
+		fetch_time += clock::now() - t;
+		reads += 2;
+		batches++;
+		if (status != CL_SUCCESS)
+			return 0;
 
-		}
-		else {
-			for (int i = 0; i<32; i++)
-				mtpHashValue[i] = (((unsigned char*)(&Y[L]))[i]);
+		ref_index[j - 1] = argon_block_ref_index(ij, instance, nargon_blockMTP[j * 2 - 2].v[0]);
 
-			// Found a solution
-/*
-			printf("Found a solution. Nonce=%08x Hash:", TheNonce);
-			for (int n = 0; n < 32; n++) {
-				printf("%02x", ((unsigned char*)&Y[0])[n]);
-			}
-			printf("\n");
-*/
-			return 1;
+		mtp_block_bytes(argon_blockhash_bytes, argon_blockhash.v);
+		amtp_blake2b_state BlakeHash2;
+		amtp_blake2b_init(&BlakeHash2, 32);
+		amtp_blake2b_update(&BlakeHash2, &Y[j - 1], sizeof(uint256));
+		amtp_blake2b_update(&BlakeHash2, argon_blockhash_bytes, MTP_ARGON2_argon_block_SIZE);
+		amtp_blake2b_final(&BlakeHash2, (unsigned char*)&Y[j], 32);
+		mtp_block_digest(digest_curr[j - 1], argon_blockhash_bytes);
+	}
+	static_clear_internal_memory(argon_blockhash.v, MTP_ARGON2_argon_block_SIZE);
+	static_clear_internal_memory(argon_blockhash_bytes, MTP_ARGON2_argon_block_SIZE);
 
+	if (Y[L] > hashTarget) {
+		applog(LOG_DEBUG, "MTP nonce %08x is not a solution: %d argon blocks in %d batches, %.3f ms waiting, %.3f ms total",
+			TheNonce, reads, batches, mtp_ms(fetch_time), mtp_ms(clock::now() - start));
+		return 0;
+	}
 
-		}
+	uint8_t *dst[L];
+	for (int j = 0; j < L; j++)
+		dst[j] = (uint8_t*)nargon_blockMTP[j * 2 + 1].v;
+	t = clock::now();
+	status = get_argon_blocks(Queue, clblock, clblock2, dst, ref_index, L);
+	fetch_time += clock::now() - t;
+	reads += L;
+	batches++;
+	if (status != CL_SUCCESS)
+		return 0;
+
+	t = clock::now();
+	for (int j = 0; j < L; j++) {
+		uint8_t digest[MERKLE_TREE_ELEMENT_SIZE_B];
 
+		mtp_store_proof(nProofMTP, j * 3, TheTree, digest_curr[j], curr_index[j]);
+		mtp_block_bytes(argon_blockhash_bytes, nargon_blockMTP[j * 2].v);
+		mtp_block_digest(digest, argon_blockhash_bytes);
+		mtp_store_proof(nProofMTP, j * 3 + 1, TheTree, digest, prev_index[j]);
+		mtp_block_bytes(argon_blockhash_bytes, nargon_blockMTP[j * 2 + 1].v);
+		mtp_block_digest(digest, argon_blockhash_bytes);
+		mtp_store_proof(nProofMTP, j * 3 + 2, TheTree, digest, ref_index[j]);
 	}
+	static_clear_internal_memory(argon_blockhash_bytes, MTP_ARGON2_argon_block_SIZE);
+	proof_time = clock::now() - t;
 
+	for (int i = 0; i<32; i++)
+		mtpHashValue[i] = (((unsigned char*)(&Y[L]))[i]);
 
-	return 0;
+	applog(LOG_DEBUG, "MTP nonce %08x solved: %d argon blocks in %d batches, %.3f ms waiting, %.3f ms proofs, %.3f ms total",
+		TheNonce, reads, batches, mtp_ms(fetch_time), mtp_ms(proof_time), mtp_ms(clock::now() - start));
+	return 1;
 }
 
 
@@ -955,6 +876,7 @@ void  mtp_init3(mtp_argon2_instance_t *instance, int thr_id, MerkleTree &ThatTre
 void mtp_hash(char* output, const char* input, unsigned int d,uint32_t TheNonce) {
     mtp_argon2_context context = init_mtp_argon2d_param(input);
     mtp_argon2_instance_t instance;
+    instance.memory = NULL;
     mtp_argon2_ctx_from_mtp(&context, &instance);
 //    mtp_prover(TheNonce, &instance, d, output);
 //    static_free_memory(&context, (uint8_t *)instance.memory, instance.memory_argon_blocks, sizeof(argon_block));
@@ -36,10 +36,12 @@ extern char *curly;
 #endif
 
 #include "elist.h"
+#include "linebuf.h"
 #include "uthash.h"
 #include "logging.h"
 #include "util.h"
 #include "algorithm.h"
+#include "sph/sph_sha2.h"
 #include "merkletree/mtp.h"
 
 #include <sys/types.h>
@@ -575,6 +577,7 @@ typedef struct _mtp_cache_t {
 typedef struct _mtp_gpu_t {
 	cglock_t lock;
 	char* prev_job_id;
+	cl_context context; /* the buffers below belong to it */
 	cl_mem hblock;
 	cl_mem hblock2;
 	cl_mem blockheader;
@@ -588,19 +591,32 @@ typedef struct _mtp_gpu_t {
 } mtp_gpu_t;
 
 struct _eth_dag_t;
+struct _eth_cache_entry_t;
 typedef struct _eth_cache_t {
   uint8_t seed_hash[32];
-  uint8_t *dag_cache;
+  uint8_t *dag_cache;   /* entry->cache, shared and read-only */
+  struct _eth_cache_entry_t *entry;
   struct _eth_dag_t **dags;
   uint32_t current_epoch;
   uint32_t nDevs;
   bool disabled;
 } eth_cache_t;
 
+/* Heavyhash matrix for the current prevhash, keyed by its SHA3 seed.
+ * Readers copy it out under a sequence counter (odd while a writer is
+ * filling it in) so verification never takes a lock. */
+typedef struct _heavyhash_cache_t {
+  uint32_t seq;
+  uint32_t prevhash[8];
+  uint32_t seed[8];
+  uint8_t matrix[64][64];
+  bool valid;
+} heavyhash_cache_t;
+
 typedef struct _eth_dag_t {
   cglock_t lock;
   cl_mem dag_buffer;
-  struct pool *pool;
+  struct _eth_cache_entry_t *cache;   /* light cache the DAG was built from */
   uint32_t current_epoch;
   uint32_t max_epoch;
 } eth_dag_t;
@@ -694,6 +710,35 @@ struct cgpu_info {
   eth_dag_t eth_dag;
   mtp_gpu_t mtp_buffer;
 
+  /* OpenCL profile of the last batch a pipelined thread completed, in
+   * device nanoseconds, see --gpu-pipeline */
+  int pipeline_depth;
+  uint64_t batches;
+  uint64_t batch_queued;
+  uint64_t batch_submit;
+  uint64_t batch_start;
+  uint64_t batch_end;
+  double batch_gap_ms;
+
+  /* --gpu-autotune state, kept across restarts of the device */
+  struct gpu_autotune *autotune;
+
+  /* time the last initCl() took per phase, in ms */
+  double init_devices_ms;
+  double init_setup_ms;
+  double init_kernel_ms;
+  double init_buffers_ms;
+
+  /* algorithm switches, how many reused --gpu-resident kernels, and how
+   * long the last one kept the device from hashing, in ms */
+  int algo_switches;
+  int warm_switches;
+  double switch_ms;
+
+  /* result buffers that filled up, and the nonces they could not hold */
+  uint64_t result_overflows;
+  uint64_t lost_nonces;
+
   bool shutdown;
 
   struct timeval dev_start_tv;
@@ -1440,6 +1485,10 @@ struct stratum_work {
   size_t header_len;
   int merkles;
   double diff;
+
+  /* SHA-256 state over the coinbase up to nonce2, see coinbase_midstate() */
+  sph_sha256_context cb_midstate;
+  bool cb_midstate_valid;
 };
 
 #define RBUFSIZE 8192
@@ -1469,6 +1518,8 @@ struct pool {
   //MTP stuff
   mtp_cache_t mtp_cache;
 
+  heavyhash_cache_t heavyhash_cache;
+
   double diff_accepted;
   double diff_rejected;
   double diff_stale;
@@ -1551,8 +1602,7 @@ struct pool {
   char *stratum_port;
   struct addrinfo stratum_hints;
   SOCKETTYPE sock;
-  char *sockbuf;
-  size_t sockbuf_size;
+  struct linebuf sockbuf;
   size_t sockbuf_bossize;
   char *sockaddr_url; /* stripped url used for sockaddr */
   char *sockaddr_proxy_url;
@@ -1660,7 +1710,7 @@ struct work {
 
   unsigned int  work_block;
   int   id;
-  UT_hash_handle  hh;
+  struct list_head staged;
 
   double    work_difficulty;
 
@@ -1696,6 +1746,8 @@ extern void inc_hw_errors(struct thr_info *thr);
 extern bool test_nonce(struct work *work, uint32_t nonce);
 extern bool submit_tested_work(struct thr_info *thr, struct work *work);
 extern bool submit_nonce(struct thr_info *thr, struct work *work, uint32_t nonce);
+extern bool submit_nonce_hash(struct thr_info *thr, struct work *work, uint32_t nonce, const unsigned char *hash);
+extern int submit_eth_nonces(struct thr_info *thr, struct work *work, const uint32_t *nonces, int count);
 extern struct work *get_work(struct thr_info *thr, const int thr_id);
 extern void _wlog(const char *str);
 extern void _wlogprint(const char *str);
@@ -1805,4 +1857,6 @@ extern struct api_data *api_add_diff(struct api_data *root, char *name, double *
 extern struct api_data *api_add_percent(struct api_data *root, char *name, double *data, bool copy_data);
 extern struct api_data *api_add_avg(struct api_data *root, char *name, float *data, bool copy_data);
 
+extern struct api_data *staged_api_stats(struct api_data *root);
+
 #endif /* MINER_H */
@@ -120,7 +120,6 @@ int mtp_argon2_ctx_from_mtp(mtp_argon2_context *context, mtp_argon2_instance_t *
 	memory_argon_blocks = segment_length * (context->lanes * MTP_ARGON2_SYNC_POINTS);
 
 	instance->version = context->version;
-	instance->memory = NULL;
 	instance->passes = context->t_cost;
 	instance->memory_argon_blocks = memory_argon_blocks;
 	instance->segment_length = segment_length;
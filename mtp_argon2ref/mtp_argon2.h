@@ -276,6 +276,10 @@ MTP_ARGON2_PUBLIC const char *mtp_argon2_type2string(mtp_argon2_type type, int u
 MTP_ARGON2_PUBLIC int mtp_argon2_ctx(mtp_argon2_context *context, mtp_argon2_type type);
 
 
+/*
+ * Set up @instance for MTP and fill its first argon_blocks. @instance->memory
+ * must be NULL or the memory of an earlier call, which is then reused.
+ */
 MTP_ARGON2_PUBLIC int mtp_argon2_ctx_from_mtp(mtp_argon2_context *context, mtp_argon2_instance_t *instance);
 /**
  * Hashes a password with MTPArgon2i, producing an encoded hash
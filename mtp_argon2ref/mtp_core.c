@@ -697,11 +697,13 @@ int mtp_initialize(mtp_argon2_instance_t *instance, mtp_argon2_context *context)
         return MTP_ARGON2_INCORRECT_PARAMETER;
     instance->context_ptr = context;
 
-    /* 1. Memory allocation */
-    result = mtp_allocate_memory(context, (uint8_t **)&(instance->memory),
-                             instance->memory_argon_blocks, sizeof(argon_block));
-    if (result != MTP_ARGON2_OK) {
-        return result;
+    /* 1. Memory allocation, unless the caller kept the previous one */
+    if (instance->memory == NULL) {
+        result = mtp_allocate_memory(context, (uint8_t **)&(instance->memory),
+                                 instance->memory_argon_blocks, sizeof(argon_block));
+        if (result != MTP_ARGON2_OK) {
+            return result;
+        }
     }
 
     /* 2. Initial hashing */
@@ -201,7 +201,8 @@ void mtp_fill_first_argon_blocks(uint8_t *argon_blockhash, const mtp_argon2_inst
  * mtp_initialized
  * @param  context  Pointer to the MTPArgon2 internal structure containing memory
  * pointer, and parameters for time and space requirements.
- * @param  instance Current MTPArgon2 instance
+ * @param  instance Current MTPArgon2 instance; its memory is allocated only
+ * if @instance->memory is NULL, otherwise it is reused
  * @return Zero if successful, -1 if memory failed to allocate. @context->state
  * will be modified if successful.
  */
@@ -46,6 +46,7 @@
 #include "algorithm/x22i.h"
 #include "algorithm/x25x.h"
 #include "algorithm/argon2d/argon2d.h"
+#include "autotune.h"
 
 /* FIXME: only here for global config vars, replace with configuration.h
  * or similar as soon as config is in a struct instead of littered all
@@ -54,6 +55,11 @@
 #include "miner.h"
 
 int opt_platform_id = -1;
+int opt_gpu_pipeline = 1;
+bool opt_opencl_cpu;
+
+/* OpenCL CPU runtimes such as pocl can stand in for a GPU with --opencl-cpu */
+#define OPENCL_DEVICE_TYPE (opt_opencl_cpu ? (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU) : CL_DEVICE_TYPE_GPU)
 
 bool get_opencl_platform(int preferred_platform_id, cl_platform_id *platform) {
   cl_int status;
@@ -124,7 +130,7 @@ int clDevicesNum(void) {
   status = clGetPlatformInfo(platform, CL_PLATFORM_VERSION, sizeof(pbuff), pbuff, NULL);
   if (status == CL_SUCCESS)
     applog(LOG_INFO, "CL Platform version: %s", pbuff);
-  status = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 0, NULL, &numDevices);
+  status = clGetDeviceIDs(platform, OPENCL_DEVICE_TYPE, 0, NULL, &numDevices);
   if (status != CL_SUCCESS) {
     applog(LOG_INFO, "Error %d: Getting Device IDs (num)", status);
     goto out;
@@ -134,7 +140,7 @@ int clDevicesNum(void) {
     unsigned int j;
     cl_device_id *devices = (cl_device_id *)malloc(numDevices*sizeof(cl_device_id));
 
-    clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, numDevices, devices, NULL);
+    clGetDeviceIDs(platform, OPENCL_DEVICE_TYPE, numDevices, devices, NULL);
     for (j = 0; j < numDevices; j++) {
       clGetDeviceInfo(devices[j], CL_DEVICE_NAME, sizeof(pbuff), pbuff, NULL);
       applog(LOG_INFO, "\t%i\t%s", j, pbuff);
@@ -152,7 +158,7 @@ static cl_int create_opencl_context(cl_context *context, cl_platform_id *platfor
   cl_context_properties cps[3] = { CL_CONTEXT_PLATFORM, (cl_context_properties)*platform, 0 };
   cl_int status;
 
-  *context = clCreateContextFromType(cps, CL_DEVICE_TYPE_GPU, NULL, NULL, &status);
+  *context = clCreateContextFromType(cps, OPENCL_DEVICE_TYPE, NULL, NULL, &status);
   return status;
 }
 
@@ -178,6 +184,50 @@ static float get_opencl_version(cl_device_id device)
   return version;
 }
 
+/* Kernel cache names being built right now. Identical devices initialised
+ * at the same time share one build: the first one builds and saves the
+ * binary, the others wait for it and load it from the cache. */
+static pthread_mutex_t kernel_build_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t kernel_build_cond = PTHREAD_COND_INITIALIZER;
+static char kernel_building[MAX_GPUDEVICES][sizeof(((build_kernel_data *)0)->cache_filename)];
+
+static int claim_kernel_build(const char *cache_filename)
+{
+  int i, slot;
+
+  if (!*cache_filename)
+    return -1;
+
+  mutex_lock(&kernel_build_lock);
+  for (;;) {
+    slot = -1;
+    for (i = 0; i < MAX_GPUDEVICES; i++) {
+      if (!strcmp(kernel_building[i], cache_filename))
+        break;
+      if (slot < 0 && !*kernel_building[i])
+        slot = i;
+    }
+    if (i == MAX_GPUDEVICES)
+      break;
+    applog(LOG_DEBUG, "Waiting for another device to build %s", cache_filename);
+    pthread_cond_wait(&kernel_build_cond, &kernel_build_lock);
+  }
+  if (slot >= 0)
+    strcpy(kernel_building[slot], cache_filename);
+  mutex_unlock(&kernel_build_lock);
+  return slot;
+}
+
+static void release_kernel_build(int slot)
+{
+  if (slot < 0)
+    return;
+  mutex_lock(&kernel_build_lock);
+  kernel_building[slot][0] = '\0';
+  pthread_cond_broadcast(&kernel_build_cond);
+  mutex_unlock(&kernel_build_lock);
+}
+
 static cl_int create_opencl_command_queue(cl_command_queue *command_queue, cl_context *context, cl_device_id *device, cl_command_queue_properties cq_properties)
 {
   cl_int status;
@@ -195,7 +245,12 @@ _clState *initCl(unsigned int gpu, char *name, size_t nameSize, algorithm_t *alg
 	cl_platform_id platform = NULL;
 	struct cgpu_info *cgpu = &gpus[gpu];
 	_clState *clState = (_clState *)calloc(1, sizeof(_clState));
-	cl_uint preferred_vwidth, numDevices = clDevicesNum();
+	cl_uint preferred_vwidth, numDevices;
+	struct timeval tv_start, tv_selected, tv_load, tv_built, tv_kernels, tv_end;
+	int build_slot;
+
+  cgtime(&tv_start);
+  numDevices = clDevicesNum();
 	cl_device_id *devices = (cl_device_id *)alloca(numDevices * sizeof(cl_device_id));
 	build_kernel_data *build_data = (build_kernel_data *)alloca(sizeof(struct _build_kernel_data));
 	char **pbuff = (char **)alloca(sizeof(char *) * numDevices), filename[256];
@@ -217,7 +272,7 @@ _clState *initCl(unsigned int gpu, char *name, size_t nameSize, algorithm_t *alg
 
   /* Now, get the device list data */
 
-  status = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, numDevices, devices, NULL);
+  status = clGetDeviceIDs(platform, OPENCL_DEVICE_TYPE, numDevices, devices, NULL);
   if (status != CL_SUCCESS) {
     applog(LOG_ERR, "Error %d: Getting Device IDs (list)", status);
     return NULL;
@@ -244,6 +299,7 @@ _clState *initCl(unsigned int gpu, char *name, size_t nameSize, algorithm_t *alg
 	
 	applog(LOG_INFO, "Selected %d: %s", gpu, pbuff[gpu]);
   strncpy(name, pbuff[gpu], nameSize);
+  cgtime(&tv_selected);
 
   if (strstr(name, "gfx10") != NULL) {
     if (strstr(cgpu->algorithm.name, "_navi") == NULL) {
@@ -260,7 +316,9 @@ _clState *initCl(unsigned int gpu, char *name, size_t nameSize, algorithm_t *alg
     return NULL;
   }
 
-  status = create_opencl_command_queue(&clState->commandQueue, &clState->context, &devices[gpu], cgpu->algorithm.cq_properties);
+  /* pipelined and autotuned threads time their batches with OpenCL timestamps */
+  status = create_opencl_command_queue(&clState->commandQueue, &clState->context, &devices[gpu],
+    cgpu->algorithm.cq_properties | ((opt_gpu_pipeline > 1 || opt_autotune_ms) ? CL_QUEUE_PROFILING_ENABLE : 0));
   if (status != CL_SUCCESS) {
     applog(LOG_ERR, "Error %d: Creating Command Queue. (clCreateCommandQueue)", status);
     return NULL;
@@ -329,6 +387,13 @@ _clState *initCl(unsigned int gpu, char *name, size_t nameSize, algorithm_t *alg
 
   clState->goffset = true;
 
+  /* part of both the kernel cache key and the autotune profile key */
+  memset(build_data, 0, sizeof(*build_data));
+  clGetDeviceInfo(devices[gpu], CL_DRIVER_VERSION, sizeof(build_data->driver_version) - 1, build_data->driver_version, NULL);
+
+  if (opt_autotune_ms)
+    autotune_prepare(cgpu, name, build_data->driver_version, clState->compute_shaders, clState->max_work_size);
+
   clState->wsize = (cgpu->work_size && cgpu->work_size <= clState->max_work_size) ? cgpu->work_size : 256;
 
   if (!cgpu->opt_lg) {
@@ -768,19 +833,37 @@ _clState *initCl(unsigned int gpu, char *name, size_t nameSize, algorithm_t *alg
   }
 
   strcat(build_data->binary_filename, ".bin");
-  applog(LOG_DEBUG, "Using binary file %s", build_data->binary_filename);
+  set_kernel_cache_filename(build_data);
+  applog(LOG_DEBUG, "Using binary file %s", build_data->cache_filename);
 
   // Load program from file or build it if it doesn't exist
-  if (!(clState->program = load_opencl_binary_kernel(build_data))) {
-    applog(LOG_NOTICE, "Building binary %s", build_data->binary_filename);
+  cgtime(&tv_load);
+  clState->program = load_opencl_binary_kernel(build_data);
+  if (!clState->program) {
+    // Only a cache miss waits for the build slot; retry the load once we
+    // hold it in case another device saved the binary while we waited
+    build_slot = claim_kernel_build(build_data->cache_filename);
+    clState->program = load_opencl_binary_kernel(build_data);
+    if (clState->program)
+      release_kernel_build(build_slot);
+  }
+  if (!clState->program) {
+    applog(LOG_NOTICE, "Kernel cache miss, building binary %s", build_data->cache_filename);
 
     if (!(clState->program = build_opencl_kernel(build_data, filename))) {
+      release_kernel_build(build_slot);
       return NULL;
     }
+    cgtime(&tv_built);
+    applog(LOG_NOTICE, "Built binary %s in %.1f s", build_data->cache_filename, us_tdiff(&tv_built, &tv_load) / 1e6);
 
 	// If it doesn't work, oh well, build it again next run
     save_opencl_kernel(build_data, clState->program);
+    release_kernel_build(build_slot);
   } else {
+    cgtime(&tv_built);
+    applog(LOG_INFO, "Kernel cache hit, loaded binary %s in %.0f ms",
+      build_data->prebuilt ? build_data->binary_filename : build_data->cache_filename, us_tdiff(&tv_built, &tv_load) / 1e3);
     if (build_data->prebuilt) {
       clState->prebuilt = true;
     }
@@ -934,6 +1017,8 @@ if (algorithm->type == ALGO_MTP) {
     }
   }
 
+  cgtime(&tv_kernels);
+
   size_t bufsize;
   size_t buf1size;
   size_t buf3size;
@@ -1246,6 +1331,15 @@ if (algorithm->type == ALGO_YESCRYPTR16_NAVI || algorithm->type == ALGO_YESCRYPT
     return NULL;
   }
 
+  cgtime(&tv_end);
+  cgpu->init_devices_ms = us_tdiff(&tv_selected, &tv_start) / 1e3;
+  cgpu->init_setup_ms = us_tdiff(&tv_load, &tv_selected) / 1e3;
+  cgpu->init_kernel_ms = us_tdiff(&tv_kernels, &tv_load) / 1e3;
+  cgpu->init_buffers_ms = us_tdiff(&tv_end, &tv_kernels) / 1e3;
+  applog(LOG_NOTICE, "GPU %d: initialised in %.0f ms (devices %.0f, setup %.0f, kernel %.0f, buffers %.0f)",
+    gpu, us_tdiff(&tv_end, &tv_start) / 1e3, cgpu->init_devices_ms, cgpu->init_setup_ms,
+    cgpu->init_kernel_ms, cgpu->init_buffers_ms);
+
   return clState;
 }
 
@@ -26,7 +26,8 @@ cl_program load_opencl_binary_kernel(build_kernel_data *data)
   if (!binaryfile) {
     applog(LOG_DEBUG, "No prebuilt binary found, search more");
     data->prebuilt = false;
-    binaryfile = fopen(data->binary_filename, "rb");
+    if (*data->cache_filename)
+      binaryfile = fopen(data->cache_filename, "rb");
   } else {
     applog(LOG_DEBUG, "Prebuilt binary found");
     data->prebuilt = true;
@@ -43,7 +44,7 @@ cl_program load_opencl_binary_kernel(build_kernel_data *data)
         goto out;
       }
     } else {
-      if (unlikely(stat(data->binary_filename, &binary_stat))) {
+      if (unlikely(stat(data->cache_filename, &binary_stat))) {
         applog(LOG_DEBUG, "Unable to stat binary, generating from source");
         goto out;
       }
@@ -69,7 +70,7 @@ cl_program load_opencl_binary_kernel(build_kernel_data *data)
       goto out;
     }
 
-    applog(LOG_DEBUG, "Loaded binary image %s", data->binary_filename);
+    applog(LOG_DEBUG, "Loaded binary image %s", data->prebuilt ? prebuilt_bin_path : data->cache_filename);
 
     /* create a cl program executable for all the devices specified */
     status = clBuildProgram(program, 1, data->device, NULL, NULL, NULL);
@@ -1,6 +1,8 @@
 #include <stdio.h>
+#include <unistd.h>
 
 #include "miner.h"
+#include "sha2.h"
 #include "build_kernel.h"
 
 static char *file_contents(const char *filename, int *length)
@@ -76,6 +78,164 @@ void set_base_compiler_options(build_kernel_data *data)
   }
 }
 
+/* Kernel sources hashed into the cache key, each once */
+#define KERNEL_CACHE_MAX_FILES 64
+
+struct kernel_hash {
+  sha256_ctx ctx;
+  char *files[KERNEL_CACHE_MAX_FILES];
+  int nfiles;
+};
+
+/* Find an included file the way the compiler does, through the -I paths
+ * set_base_compiler_options() passes, in the same order */
+static bool find_kernel_include(build_kernel_data *data, const char *name, char *path)
+{
+  char kernel_dir[PATH_MAX];
+  const char *dirs[4];
+  int i;
+
+  snprintf(kernel_dir, sizeof(kernel_dir), "%s/kernel", data->sgminer_path);
+  dirs[0] = data->sgminer_path;
+  dirs[1] = kernel_dir;
+  dirs[2] = ".";
+  dirs[3] = data->kernel_path;
+
+  for (i = 0; i < 4; i++) {
+    if (!dirs[i])
+      continue;
+    snprintf(path, PATH_MAX, "%s/%s", dirs[i], name);
+    if (!access(path, R_OK))
+      return true;
+  }
+  return false;
+}
+
+static char *read_kernel_include(const char *path, int *length)
+{
+  FILE *f = fopen(path, "rb");
+  char *buffer = NULL;
+  long size;
+
+  if (!f)
+    return NULL;
+  if (!fseek(f, 0, SEEK_END) && (size = ftell(f)) >= 0 && !fseek(f, 0, SEEK_SET)) {
+    buffer = (char *)malloc(size + 1);
+    if (buffer) {
+      *length = fread(buffer, 1, size, f);
+      buffer[*length] = '\0';
+    }
+  }
+  fclose(f);
+  return buffer;
+}
+
+/* Hash a source and every file it includes, as the preprocessor would
+ * see them. Includes inside #if blocks are hashed too, which can only
+ * cause an unneeded rebuild. */
+static void hash_kernel_source(struct kernel_hash *kh, build_kernel_data *data, const char *path,
+  const char *source, int length)
+{
+  const char *p = source, *end = source + length;
+  int i;
+
+  for (i = 0; i < kh->nfiles; i++)
+    if (!strcmp(kh->files[i], path))
+      return;
+  if (kh->nfiles == KERNEL_CACHE_MAX_FILES) {
+    applog(LOG_DEBUG, "Too many kernel includes to hash, not following %s", path);
+    return;
+  }
+  kh->files[kh->nfiles++] = strdup(path);
+  sha256_update(&kh->ctx, (const unsigned char *)source, length + 1);
+
+  while (p < end) {
+    const char *line = p, *name, *close;
+
+    while (p < end && *p != '\n')
+      p++;
+    p++;
+
+    while (line < p && (*line == ' ' || *line == '\t'))
+      line++;
+    if (*line++ != '#')
+      continue;
+    while (line < p && (*line == ' ' || *line == '\t'))
+      line++;
+    if (strncmp(line, "include", 7))
+      continue;
+    line += 7;
+    while (line < p && (*line == ' ' || *line == '\t'))
+      line++;
+    if (*line != '"' && *line != '<')
+      continue;
+    name = line + 1;
+    close = (const char *)memchr(name, *line == '"' ? '"' : '>', p - name);
+    if (close && close - name < 256) {
+      char include[256], include_path[PATH_MAX];
+      char *text;
+      int len;
+
+      memcpy(include, name, close - name);
+      include[close - name] = '\0';
+      /* an include it cannot find is left to the compiler to report */
+      if (!find_kernel_include(data, include, include_path))
+        continue;
+      text = read_kernel_include(include_path, &len);
+      if (text) {
+        sha256_update(&kh->ctx, (const unsigned char *)include, strlen(include) + 1);
+        hash_kernel_source(kh, data, include_path, text, len);
+        free(text);
+      }
+    }
+  }
+}
+
+/* Name the cached binary after a hash of everything that goes into it:
+ * the kernel source with its includes, the compiler options, the device
+ * and the driver. Editing a kernel or upgrading the driver then misses
+ * the cache instead of loading a stale binary. */
+void set_kernel_cache_filename(build_kernel_data *data)
+{
+  struct kernel_hash *kh;
+  unsigned char digest[SHA256_DIGEST_SIZE];
+  char *source;
+  size_t base;
+  int length, i;
+
+  data->cache_filename[0] = '\0';
+  source = file_contents(data->source_filename, &length);
+  if (!source)
+    return;
+  kh = (struct kernel_hash *)calloc(1, sizeof(*kh));
+  if (!kh) {
+    free(source);
+    return;
+  }
+
+  sha256_init(&kh->ctx);
+  hash_kernel_source(kh, data, data->source_filename, source, length);
+  sha256_update(&kh->ctx, (const unsigned char *)data->compiler_options, strlen(data->compiler_options) + 1);
+  sha256_update(&kh->ctx, (const unsigned char *)data->platform, strlen(data->platform) + 1);
+  sha256_update(&kh->ctx, (const unsigned char *)data->driver_version, strlen(data->driver_version) + 1);
+  sha256_final(&kh->ctx, digest);
+
+  /* the readable name, minus .bin, then the key */
+  base = strlen(data->binary_filename);
+  if (base >= 4 && !strcmp(data->binary_filename + base - 4, ".bin"))
+    base -= 4;
+  snprintf(data->cache_filename, sizeof(data->cache_filename), "%.*s-", (int)base, data->binary_filename);
+  for (i = 0; i < 8; i++)
+    sprintf(data->cache_filename + strlen(data->cache_filename), "%02x", digest[i]);
+  strcat(data->cache_filename, ".bin");
+
+  applog(LOG_DEBUG, "Kernel cache key over %d source files: %s", kh->nfiles, data->cache_filename);
+  for (i = 0; i < kh->nfiles; i++)
+    free(kh->files[i]);
+  free(kh);
+  free(source);
+}
+
 cl_program build_opencl_kernel(build_kernel_data *data, const char *filename)
 {
   int pl;
@@ -123,6 +283,7 @@ bool save_opencl_kernel(build_kernel_data *data, cl_program program)
   char **binaries = NULL;
   cl_int status;
   FILE *binaryfile;
+  char tmpname[sizeof(data->cache_filename) + 32];
   bool ret = false;
 
   #ifdef __APPLE__
@@ -168,18 +329,31 @@ bool save_opencl_kernel(build_kernel_data *data, cl_program program)
     goto out;
   }
 
-  /* Save the binary to be loaded next time */
-  binaryfile = fopen(data->binary_filename, "wb");
+  if (!*data->cache_filename)
+    goto out;
+
+  /* Save the binary to be loaded next time. It goes to a temporary file
+   * renamed into place, so another sgminer starting at the same time never
+   * loads half a binary. */
+  snprintf(tmpname, sizeof(tmpname), "%s.%d.tmp", data->cache_filename, (int)getpid());
+  binaryfile = fopen(tmpname, "wb");
   if (!binaryfile) {
     /* Not fatal, just means we build it again next time */
-    applog(LOG_DEBUG, "Unable to create file %s", data->binary_filename);
+    applog(LOG_DEBUG, "Unable to create file %s", tmpname);
     goto out;
   } else {
     if (unlikely(fwrite(binaries[slot], 1, binary_sizes[slot], binaryfile) != binary_sizes[slot])) {
       applog(LOG_ERR, "Unable to fwrite to binaryfile");
+      fclose(binaryfile);
+      unlink(tmpname);
+      goto out;
+    }
+    /* the name is the content's hash, so if another instance got there
+     * first its binary is as good as ours */
+    if (fclose(binaryfile) || rename(tmpname, data->cache_filename)) {
+      unlink(tmpname);
       goto out;
     }
-    fclose(binaryfile);
   }
 
   ret = true;
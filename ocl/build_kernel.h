@@ -12,6 +12,7 @@
 typedef struct _build_kernel_data {
   char source_filename[255];
   char binary_filename[255];
+  char cache_filename[300];
   char compiler_options[512];
 
   cl_context context;
@@ -20,6 +21,7 @@ typedef struct _build_kernel_data {
 
 // for compiler options
   char platform[64];
+  char driver_version[128];
   char sgminer_path[255];
   const char *kernel_path;
   size_t work_size;
@@ -29,5 +31,6 @@ typedef struct _build_kernel_data {
 cl_program build_opencl_kernel(build_kernel_data *data, const char *filename);
 bool save_opencl_kernel(build_kernel_data *data, cl_program program);
 void set_base_compiler_options(build_kernel_data *data);
+void set_kernel_cache_filename(build_kernel_data *data);
 
 #endif /* BUILD_KERNEL_H */
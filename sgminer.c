@@ -60,9 +60,11 @@ char *curly = ":D";
 
 #include "algorithm.h"
 #include "algorithm/ethash.h"
+#include "algorithm/heavyhash-gate.h"
 #include "pool.h"
 #include "config_parser.h"
 #include "events.h"
+#include "autotune.h"
 
 #if defined(unix) || defined(__APPLE__)
   #include <errno.h>
@@ -108,6 +110,7 @@ time_t last_getwork;
 int nDevs;
 int opt_dynamic_interval = 7;
 int opt_g_threads = -1;
+int opt_init_threads = 4;
 bool opt_restart = true;
 int opt_vote = 0;
 
@@ -138,11 +141,17 @@ bool use_curses;
 
 static bool opt_submit_stale = true;
 int opt_shares;
+static bool opt_benchmark;
+static double opt_benchmark_diff = 1.0;
+static bool opt_benchmark_random;
+static double opt_benchmark_rate;
+static int opt_benchmark_time;
 bool opt_fail_only;
 int opt_fail_switch_delay = 60;
 int opt_watchpool_refresh = 30;
 static bool opt_fix_protocol;
 static bool opt_lowmem;
+static bool opt_gpu_share_target;
 static bool opt_morenotices;
 uint8_t entropy[32];
 uint32_t eth_nonce;
@@ -230,6 +239,7 @@ static void *restart_mining_threads_thread(void *userdata);
 static void apply_initial_gpu_settings(struct pool *pool);
 static unsigned long compare_pool_settings(struct pool *oldpool, struct pool *newpool);
 static void apply_switcher_options(unsigned long options, struct pool *pool);
+static void prepare_devices(bool init);
 static void restart_mining_threads(unsigned int new_n_threads);
 static void probe_pools(void);
 static bool test_pool(struct pool *pool);
@@ -322,7 +332,21 @@ struct sigaction termhandler, inthandler;
 struct thread_q *getq;
 
 static int total_work;
-struct work *staged_work = NULL;
+
+/* Staged work sits in two FIFO lanes, one for masters that can still be
+ * rolled and one for clones and unrollable work, so pushing and popping never
+ * has to sort or search. Both lanes are protected by stgd_lock. */
+static LIST_HEAD(staged_roll_lane);
+static LIST_HEAD(staged_clone_lane);
+static int staged_count;
+
+static struct {
+  uint64_t pushes;
+  uint64_t pops;
+  uint64_t contended;   /* stgd_lock was already held when we wanted it */
+  uint64_t waits;       /* blocking pops that found the queue empty */
+  uint64_t wait_us;
+} stgd_stats;
 
 struct schedtime schedstart;
 struct schedtime schedstop;
@@ -740,6 +764,28 @@ static char *set_rotate(const char *arg, int *i)
   return set_int_range(arg, i, 0, 9999);
 }
 
+static char *set_benchmark_diff(const char *arg)
+{
+  if (!strcasecmp(arg, "random")) {
+    opt_benchmark_random = true;
+    return NULL;
+  }
+
+  opt_benchmark_random = false;
+  opt_benchmark_diff = atof(arg);
+  if (opt_benchmark_diff <= 0)
+    return "Invalid value passed to benchmark-diff";
+  return NULL;
+}
+
+static char *set_benchmark_rate(const char *arg)
+{
+  opt_benchmark_rate = atof(arg);
+  if (opt_benchmark_rate < 0)
+    return "Invalid value passed to benchmark-rate";
+  return NULL;
+}
+
 static char *set_rr(enum pool_strategy *strategy)
 {
   *strategy = POOL_ROUNDROBIN;
@@ -1305,6 +1351,26 @@ static char *set_api_mcast_des(const char *arg)
   return NULL;
 }
 
+static char *set_verify_queue(const char *arg, int *i)
+{
+  return set_int_range(arg, i, 1, 4096);
+}
+
+static char *set_verify_threads(const char *arg, int *i)
+{
+  return set_int_range(arg, i, 0, 64);
+}
+
+static char *set_gpu_autotune(const char *arg, int *i)
+{
+  return set_int_range(arg, i, 0, 10000);
+}
+
+static char *set_gpu_pipeline(const char *arg, int *i)
+{
+  return set_int_range(arg, i, 1, MAX_PIPELINE_DEPTH);
+}
+
 static char *set_null(const char __maybe_unused *arg)
 {
   return NULL;
@@ -1371,6 +1437,18 @@ struct opt_table opt_config_table[] = {
   OPT_WITHOUT_ARG("--balance",
       set_balance, &pool_strategy,
       "Change multipool strategy from failover to even share balance"),
+  OPT_WITHOUT_ARG("--benchmark",
+      opt_set_bool, &opt_benchmark,
+      "Mine synthetic work from a built-in block without connecting to any pool"),
+  OPT_WITH_ARG("--benchmark-diff",
+      set_benchmark_diff, NULL, NULL,
+      "Share difficulty of benchmark work, or 'random' to vary it per work item (default: 1)"),
+  OPT_WITH_ARG("--benchmark-rate",
+      set_benchmark_rate, NULL, NULL,
+      "Retarget benchmark work for N shares per minute at the measured hashrate (default: 0 = off)"),
+  OPT_WITH_ARG("--benchmark-time",
+      opt_set_intval, NULL, &opt_benchmark_time,
+      "Quit benchmark mode after N seconds (default: 0 = unlimited)"),
   OPT_WITHOUT_ARG("--blake-compact",
       opt_set_bool, &opt_blake_compact,
       "Set SPH_COMPACT_BLAKE64 for Xn derived algorithms (Can give better hashrate for some GPUs)"),
@@ -1397,6 +1475,9 @@ struct opt_table opt_config_table[] = {
   OPT_WITHOUT_ARG("--disable-rejecting",
       opt_set_bool, &opt_disable_pool,
       "Automatically disable pools that continually reject shares"),
+  OPT_WITH_ARG("--eth-cache-dir",
+      opt_set_charp, NULL, &opt_eth_cache_dir,
+      "Directory where ethash caches are kept between runs and shared by pools, default: regenerate"),
   OPT_WITH_ARG("--expiry|-E",
       set_int_0_to_9999, opt_show_intval, &opt_expiry,
       "Upper bound on how many seconds after getting work we consider a share from it stale"),
@@ -1430,12 +1511,30 @@ struct opt_table opt_config_table[] = {
   OPT_WITHOUT_ARG("--fix-protocol",
       opt_set_bool, &opt_fix_protocol,
       "Do not redirect to a different getwork protocol (eg. stratum)"),
+  OPT_WITH_ARG("--gpu-autotune",
+      set_gpu_autotune, opt_show_intval, &opt_autotune_ms,
+      "Tune worksize and raw intensity for batches of at most this many ms, 0 to disable"),
+  OPT_WITH_ARG("--gpu-autotune-file",
+      opt_set_charp, opt_show_charp, &opt_autotune_file,
+      "File the tuned settings are saved to and loaded from"),
   OPT_WITH_ARG("--gpu-dyninterval",
       set_int_1_to_65535, opt_show_intval, &opt_dynamic_interval,
       "Set the refresh interval in ms for GPUs using dynamic intensity"),
+  OPT_WITH_ARG("--gpu-init-threads",
+      set_int_1_to_65535, opt_show_intval, &opt_init_threads,
+      "Number of GPUs initialised at the same time"),
+  OPT_WITH_ARG("--gpu-pipeline",
+      set_gpu_pipeline, opt_show_intval, &opt_gpu_pipeline,
+      "Batches each GPU thread keeps in flight (1 - 2)"),
   OPT_WITH_ARG("--gpu-platform",
       set_int_0_to_9999, opt_show_intval, &opt_platform_id,
       "Select OpenCL platform ID to use for GPU mining"),
+  OPT_WITH_ARG("--gpu-resident",
+      set_gpu_resident, NULL, NULL,
+      "Comma separated list of algorithms whose kernels and buffers stay on the GPUs between switches"),
+  OPT_WITHOUT_ARG("--gpu-share-target",
+      opt_set_bool, &opt_gpu_share_target,
+      "Have the GPUs check candidates against the pool's share target instead of a lower working difficulty"),
 #ifndef HAVE_ADL
   // gpu-threads can only be set per-card if ADL is available
   OPT_WITH_ARG("--gpu-threads|-g",
@@ -1564,6 +1663,9 @@ struct opt_table opt_config_table[] = {
   OPT_WITHOUT_ARG("--no-extranonce|--pool-no-extranonce",
       set_no_extranonce_subscribe, NULL,
       "Disable 'extranonce' stratum subscribe for pool"),
+  OPT_WITHOUT_ARG("--opencl-cpu",
+      opt_set_bool, &opt_opencl_cpu,
+      "Also mine on OpenCL CPU devices, for testing without a GPU"),
   OPT_WITH_ARG("--pass|--pool-pass|-p",
       set_pass, NULL, NULL,
       "Password for bitcoin JSON-RPC server"),
@@ -1809,6 +1911,15 @@ struct opt_table opt_config_table[] = {
   OPT_WITHOUT_ARG("--verbose|-v",
       opt_set_bool, &opt_verbose,
       "Log verbose output to stderr as well as status output"),
+  OPT_WITH_ARG("--verify-affinity",
+      opt_set_charp, NULL, &opt_verify_affinity,
+      "CPUs to bind share verification threads to, range and/or comma separated (e.g. 0-3,6)"),
+  OPT_WITH_ARG("--verify-queue",
+      set_verify_queue, opt_show_intval, &opt_verify_queue,
+      "Number of result buffers that can wait for share verification (1 - 4096)"),
+  OPT_WITH_ARG("--verify-threads",
+      set_verify_threads, opt_show_intval, &opt_verify_threads,
+      "Number of share verification threads, 0 for one per CPU up to 8 (0 - 64)"),
   OPT_WITH_ARG("--vote",
       set_int_1_to_65535, opt_show_intval, &opt_vote,
       "Optional vote value for decred blocks"),
@@ -1929,14 +2040,82 @@ static struct work *make_work(void)
   return w;
 }
 
+/* job_id, nonce1 and ntime are duplicated into every work item, so they come
+ * from a slab of small blocks instead of a malloc each. The byte in front of
+ * the string says whether it lives in the slab or was too long for it. */
+#define WORK_STR_SIZE 64
+#define WORK_STR_CHUNK 256
+
+typedef union work_str {
+  union work_str *next;
+  char buf[WORK_STR_SIZE];
+} work_str_t;
+
+static pthread_mutex_t work_str_lock;
+static work_str_t *work_str_free;
+
+static char *work_strdup(const char *str)
+{
+  size_t len = strlen(str) + 1;
+  work_str_t *blk;
+  char *ret;
+
+  if (unlikely(len + 1 > WORK_STR_SIZE)) {
+    ret = (char *)malloc(len + 1);
+    if (unlikely(!ret))
+      quit(1, "Failed to malloc in work_strdup");
+    ret[0] = 0;
+    memcpy(ret + 1, str, len);
+    return ret + 1;
+  }
+
+  mutex_lock(&work_str_lock);
+  if (unlikely(!work_str_free)) {
+    work_str_t *chunk = (work_str_t *)malloc(sizeof(work_str_t) * WORK_STR_CHUNK);
+    int i;
+
+    if (unlikely(!chunk))
+      quit(1, "Failed to malloc in work_strdup");
+    for (i = 0; i < WORK_STR_CHUNK - 1; i++)
+      chunk[i].next = &chunk[i + 1];
+    chunk[i].next = NULL;
+    work_str_free = chunk;
+  }
+  blk = work_str_free;
+  work_str_free = blk->next;
+  mutex_unlock(&work_str_lock);
+
+  blk->buf[0] = 1;
+  memcpy(blk->buf + 1, str, len);
+  return blk->buf + 1;
+}
+
+static void work_strfree(char *str)
+{
+  work_str_t *blk;
+
+  if (!str)
+    return;
+  if (!str[-1]) {
+    free(str - 1);
+    return;
+  }
+
+  blk = (work_str_t *)(str - 1);
+  mutex_lock(&work_str_lock);
+  blk->next = work_str_free;
+  work_str_free = blk;
+  mutex_unlock(&work_str_lock);
+}
+
 /* This is the central place all work that is about to be retired should be
  * cleaned to remove any dynamically allocated arrays within the struct */
 void clean_work(struct work *w)
 {
-  free(w->job_id);
-  free(w->ntime);
+  work_strfree(w->job_id);
+  work_strfree(w->ntime);
   free(w->coinbase);
-  free(w->nonce1);
+  work_strfree(w->nonce1);
   memset(w, 0, sizeof(struct work));
 }
 
@@ -2142,7 +2321,7 @@ static void gen_gbt_work(struct pool *pool, struct work *work)
   work->gbt_txns = pool->gbt_txns + 1;
 
   if (pool->gbt_workid)
-    work->job_id = strdup(pool->gbt_workid);
+    work->job_id = work_strdup(pool->gbt_workid);
   cg_runlock(&pool->gbt_lock);
 
   flip32(work->data + 4 + 32, merkleroot);
@@ -2456,22 +2635,55 @@ void decay_time(double *f, double fadd, double fsecs)
   *f /= ftotal;
 }
 
+/* Take stgd_lock, counting how often somebody else already held it */
+static void staged_lock(void)
+{
+  if (unlikely(mutex_trylock(stgd_lock))) {
+    __atomic_add_fetch(&stgd_stats.contended, 1, __ATOMIC_RELAXED);
+    mutex_lock(stgd_lock);
+  }
+}
+
 static int __total_staged(void)
 {
-  return HASH_COUNT(staged_work);
+  return staged_count;
 }
 
 static int total_staged(void)
 {
   int ret;
 
-  mutex_lock(stgd_lock);
+  staged_lock();
   ret = __total_staged();
   mutex_unlock(stgd_lock);
 
   return ret;
 }
 
+struct api_data *staged_api_stats(struct api_data *root)
+{
+  uint64_t pushes = __atomic_load_n(&stgd_stats.pushes, __ATOMIC_RELAXED);
+  uint64_t pops = __atomic_load_n(&stgd_stats.pops, __ATOMIC_RELAXED);
+  uint64_t contended = __atomic_load_n(&stgd_stats.contended, __ATOMIC_RELAXED);
+  uint64_t waits = __atomic_load_n(&stgd_stats.waits, __ATOMIC_RELAXED);
+  uint64_t wait_us = __atomic_load_n(&stgd_stats.wait_us, __ATOMIC_RELAXED);
+  int staged = __atomic_load_n(&staged_count, __ATOMIC_RELAXED);
+  int rollable = __atomic_load_n(&staged_rollable, __ATOMIC_RELAXED);
+  double wait_ms = (double)wait_us / 1000.0;
+  double avg_wait = waits ? wait_ms / waits : 0;
+
+  root = api_add_int(root, "Staged", &staged, true);
+  root = api_add_int(root, "Rollable", &rollable, true);
+  root = api_add_uint64(root, "Pushes", &pushes, true);
+  root = api_add_uint64(root, "Pops", &pops, true);
+  root = api_add_uint64(root, "Lock Contended", &contended, true);
+  root = api_add_uint64(root, "Empty Waits", &waits, true);
+  root = api_add_double(root, "Wait Total ms", &wait_ms, true);
+  root = api_add_double(root, "Wait Av ms", &avg_wait, true);
+
+  return root;
+}
+
 #ifdef HAVE_CURSES
 WINDOW *mainwin, *statuswin, *logwin;
 #endif
@@ -3915,16 +4127,30 @@ static struct work *make_clone(struct work *work)
 
 static void stage_work(struct work *work);
 
+static bool work_rollable(struct work *work)
+{
+  return (!work->clone && work->rolltime);
+}
+
+/* Unlink a work item from its staged lane, stgd_lock held */
+static void __staged_del(struct work *work)
+{
+  list_del(&work->staged);
+  staged_count--;
+  if (work_rollable(work))
+    staged_rollable--;
+}
+
 static bool clone_available(void)
 {
   struct work *work_clone = NULL, *work, *tmp;
   bool cloned = false;
 
-  mutex_lock(stgd_lock);
+  staged_lock();
   if (!staged_rollable)
     goto out_unlock;
 
-  HASH_ITER(hh, staged_work, work, tmp) {
+  list_for_each_entry_safe(work, tmp, &staged_roll_lane, staged) {
     if (can_roll(work) && should_roll(work)) {
       roll_work(work);
       work_clone = make_clone(work);
@@ -4013,9 +4239,9 @@ static void _copy_work(struct work *work, const struct work *base_work, int noff
    * work from having the same id. */
   work->id = id;
   if (base_work->job_id)
-    work->job_id = strdup(base_work->job_id);
+    work->job_id = work_strdup(base_work->job_id);
   if (base_work->nonce1)
-    work->nonce1 = strdup(base_work->nonce1);
+    work->nonce1 = work_strdup(base_work->nonce1);
   if (base_work->ntime) {
     /* If we are passed an noffset the binary work->data ntime and
      * the work->ntime hex string need to be adjusted. */
@@ -4024,9 +4250,12 @@ static void _copy_work(struct work *work, const struct work *base_work, int noff
       uint32_t ntime = be32toh(work_ntime);
       ntime += noffset;
       _set_work_time(work, htobe32(ntime));
-      work->ntime = offset_ntime(base_work->ntime, noffset);
+      char *ntime_str = offset_ntime(base_work->ntime, noffset);
+
+      work->ntime = work_strdup(ntime_str);
+      free(ntime_str);
     } else
-      work->ntime = strdup(base_work->ntime);
+      work->ntime = work_strdup(base_work->ntime);
   } else if (noffset) {
     uint32_t work_ntime = _get_work_time(work);
     uint32_t ntime = be32toh(work_ntime);
@@ -4326,7 +4555,7 @@ void discard_work(struct work *work)
 
 static void wake_gws(void)
 {
-  mutex_lock(stgd_lock);
+  staged_lock();
   pthread_cond_signal(&gws_cond);
   mutex_unlock(stgd_lock);
 }
@@ -4336,10 +4565,17 @@ static void discard_stale(void)
   struct work *work, *tmp;
   int stale = 0;
 
-  mutex_lock(stgd_lock);
-  HASH_ITER(hh, staged_work, work, tmp) {
+  staged_lock();
+  list_for_each_entry_safe(work, tmp, &staged_roll_lane, staged) {
+    if (stale_work(work, false)) {
+      __staged_del(work);
+      discard_work(work);
+      stale++;
+    }
+  }
+  list_for_each_entry_safe(work, tmp, &staged_clone_lane, staged) {
     if (stale_work(work, false)) {
-      HASH_DEL(staged_work, work);
+      __staged_del(work);
       discard_work(work);
       stale++;
     }
@@ -4573,26 +4809,19 @@ out:
   return ret;
 }
 
-static int tv_sort(struct work *worka, struct work *workb)
-{
-  return worka->tv_staged.tv_sec - workb->tv_staged.tv_sec;
-}
-
-static bool work_rollable(struct work *work)
-{
-  return (!work->clone && work->rolltime);
-}
-
 static bool hash_push(struct work *work)
 {
   bool rc = true;
 
-  mutex_lock(stgd_lock);
-  if (work_rollable(work))
-    staged_rollable++;
+  staged_lock();
   if (likely(!getq->frozen)) {
-    HASH_ADD_INT(staged_work, id, work);
-    HASH_SORT(staged_work, tv_sort);
+    if (work_rollable(work)) {
+      list_add_tail(&work->staged, &staged_roll_lane);
+      staged_rollable++;
+    } else
+      list_add_tail(&work->staged, &staged_clone_lane);
+    staged_count++;
+    __atomic_add_fetch(&stgd_stats.pushes, 1, __ATOMIC_RELAXED);
   } else
     rc = false;
   pthread_cond_broadcast(&getq->cond);
@@ -5550,10 +5779,17 @@ void clear_pool_work(struct pool *pool)
   struct work *work, *tmp;
   int cleared = 0;
 
-  mutex_lock(stgd_lock);
-  HASH_ITER(hh, staged_work, work, tmp) {
+  staged_lock();
+  list_for_each_entry_safe(work, tmp, &staged_roll_lane, staged) {
+    if (work->pool == pool) {
+      __staged_del(work);
+      free_work(work);
+      cleared++;
+    }
+  }
+  list_for_each_entry_safe(work, tmp, &staged_clone_lane, staged) {
     if (work->pool == pool) {
-      HASH_DEL(staged_work, work);
+      __staged_del(work);
       free_work(work);
       cleared++;
     }
@@ -6380,13 +6616,14 @@ static void pool_resus(struct pool *pool)
  * be handled. */
 static struct work *hash_pop(bool blocking)
 {
-  struct work *work = NULL, *tmp;
-  int hc;
+  struct work *work = NULL;
+  struct timeval wait_start, wait_end;
 
-  mutex_lock(stgd_lock);
-  if (!HASH_COUNT(staged_work)) {
+  staged_lock();
+  if (!staged_count) {
     if (!blocking)
       goto out_unlock;
+    cgtime(&wait_start);
     do {
       struct timespec then;
       struct timeval now;
@@ -6405,7 +6642,10 @@ static struct work *hash_pop(bool blocking)
         applog(LOG_WARNING, "Waiting for work to be available from pools.");
         event_notify("idle");
       }
-    } while (!HASH_COUNT(staged_work));
+    } while (!staged_count);
+    cgtime(&wait_end);
+    __atomic_add_fetch(&stgd_stats.waits, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stgd_stats.wait_us, (uint64_t)us_tdiff(&wait_end, &wait_start), __ATOMIC_RELAXED);
   }
 
   if (no_work) {
@@ -6413,18 +6653,13 @@ static struct work *hash_pop(bool blocking)
     no_work = false;
   }
 
-  hc = HASH_COUNT(staged_work);
-  /* Find clone work if possible, to allow masters to be reused */
-  if (hc > staged_rollable) {
-    HASH_ITER(hh, staged_work, work, tmp) {
-      if (!work_rollable(work))
-        break;
-    }
-  } else
-    work = staged_work;
-  HASH_DEL(staged_work, work);
-  if (work_rollable(work))
-    staged_rollable--;
+  /* Take clone work if possible, to allow masters to be reused */
+  if (!list_empty(&staged_clone_lane))
+    work = list_entry(staged_clone_lane.next, struct work *, staged);
+  else
+    work = list_entry(staged_roll_lane.next, struct work *, staged);
+  __staged_del(work);
+  __atomic_add_fetch(&stgd_stats.pops, 1, __ATOMIC_RELAXED);
 
   /* Signal the getwork scheduler to look for more work */
   pthread_cond_signal(&gws_cond);
@@ -6556,7 +6791,7 @@ static void gen_stratum_work_eth(struct pool *pool, struct work *work)
     mutex_unlock(&eth_nonce_lock);
   }
   else {
-    work->nonce1 = strdup(pool->nonce1);
+    work->nonce1 = work_strdup(pool->nonce1);
     cg_ulock(&pool->data_lock);
     work->nonce2 = pool->nonce2++;
     cg_dwlock(&pool->data_lock);
@@ -6565,7 +6800,7 @@ static void gen_stratum_work_eth(struct pool *pool, struct work *work)
   work->Nonce = (uint64_t) be32toh(nonce2be) << 32;
   work->nonce2_len = pool->n2size;
   work->eth_epoch = pool->eth_cache.current_epoch;
-  work->job_id = strdup(pool->swork.job_id);
+  work->job_id = work_strdup(pool->swork.job_id);
   memcpy(work->data, pool->EthWork, 32);
   memcpy(work->target, pool->Target, 32);
   work->sdiff = pool->swork.diff;
@@ -6625,7 +6860,7 @@ static void gen_stratum_work(struct pool *pool, struct work *work)
 
   if (pool->algorithm.type != ALGO_DECRED && pool->algorithm.type != ALGO_SIA && pool->algorithm.type != ALGO_PASCAL) {
     /* Generate merkle root */
-    pool->algorithm.gen_hash(pool->coinbase, pool->swork.cb_len, merkle_root);
+    gen_coinbase_hash(pool, merkle_root);
     memcpy(merkle_sha, merkle_root, 32);
     for (i = 0; i < pool->swork.merkles; i++) {
       memcpy(merkle_sha + 32, pool->swork.merkle_bin[i], 32);
@@ -6772,11 +7007,15 @@ static void gen_stratum_work(struct pool *pool, struct work *work)
   work->sdiff = pool->swork.diff;
 
   /* Copy parameters required for share submission */
-  work->job_id = strdup(pool->swork.job_id);
-  work->nonce1 = strdup(pool->nonce1);
-  work->ntime = strdup(pool->swork.ntime);
+  work->job_id = work_strdup(pool->swork.job_id);
+  work->nonce1 = work_strdup(pool->nonce1);
+  work->ntime = work_strdup(pool->swork.ntime);
   cg_runlock(&pool->data_lock);
 
+  /* Heavyhash matrix only changes with the prevhash */
+  if (pool->algorithm.type == ALGO_HEAVYHASH)
+    heavyhash_cache_update(pool, work->data);
+
   if (opt_debug) {
     char *header, *merkle_hash;
     int datasize = 128;
@@ -7381,8 +7620,10 @@ static void get_work_prepare_thread(struct thr_info *mythr, struct work *work)
   if(algo_switch_n >= active_threads)
   {
     const char *opt;
+    struct timeval tv_switch, tv_switched;
 
     applog(LOG_DEBUG, "Applying pool settings for %s...", isnull(get_pool_name(work->pool), ""));
+    cgtime(&tv_switch);
     rd_lock(&mining_thr_lock);
 
     // Shutdown all threads first (necessary)
@@ -7392,7 +7633,12 @@ static void get_work_prepare_thread(struct thr_info *mythr, struct work *work)
       for (i = 0; i < mining_threads; i++)
       {
         struct thr_info *thr = mining_thr[i];
-        thr->cgpu->drv->thread_shutdown(thr);
+
+        // keeps --gpu-resident kernels for switching back
+        if (thr->cgpu->drv->drv_id == DRIVER_opencl)
+          opencl_thread_park(thr);
+        else
+          thr->cgpu->drv->thread_shutdown(thr);
       }
     }
 
@@ -7552,16 +7798,29 @@ static void get_work_prepare_thread(struct thr_info *mythr, struct work *work)
       if(opt_isset(pool_switch_options, SWITCHER_APPLY_ALGO))
         thr->cgpu->algorithm = work->pool->algorithm;
 
-      if(opt_isset(pool_switch_options, SWITCHER_SOFT_RESET))
-      {
-        thr->cgpu->drv->thread_prepare(thr);
-        thr->cgpu->drv->thread_init(thr);
-      }
-
       // Necessary because algorithms can have dramatically different diffs
       thr->cgpu->drv->working_diff = 1;
     }
 
+    if(opt_isset(pool_switch_options, SWITCHER_SOFT_RESET))
+    {
+      rd_lock(&devices_lock);
+      prepare_devices(true);
+      cgtime(&tv_switched);
+      if(opt_isset(pool_switch_options, SWITCHER_APPLY_ALGO))
+      {
+        for (i = 0; i < total_devices; i++)
+        {
+          if (!devices[i]->threads)
+            continue;
+          devices[i]->algo_switches++;
+          devices[i]->switch_ms = ms_tdiff(&tv_switched, &tv_switch);
+        }
+        applog(LOG_NOTICE, "Switched to %s in %d ms", work->pool->algorithm.name, ms_tdiff(&tv_switched, &tv_switch));
+      }
+      rd_unlock(&devices_lock);
+    }
+
     rd_unlock(&mining_thr_lock);
     mutex_unlock(&algo_switch_lock);
 
@@ -7637,6 +7896,165 @@ static void get_work_prepare_thread(struct thr_info *mythr, struct work *work)
   pthread_cleanup_pop(1);
 }
 
+static const unsigned char bench_block[] = { SGMINER_BENCHMARK_BLOCK };
+
+/* Per-stage timings of benchmark mode. Counters are only touched with atomic
+ * builtins. */
+static struct {
+  uint64_t works;
+  uint64_t gen_us;
+  uint64_t pops;
+  uint64_t queue_us;
+  uint64_t shares;
+  uint64_t submit_us;
+} bench_stats;
+
+static double benchmark_diff(struct pool *pool)
+{
+  double diff = opt_benchmark_diff, min_diff;
+
+  /* A share at diff d takes d * 2^32 / diff_multiplier2 hashes on average */
+  if (opt_benchmark_rate > 0 && total_rolling > 0) {
+    diff = total_rolling * 1000000.0 * 60.0 / opt_benchmark_rate;
+    diff *= pool->algorithm.diff_multiplier2 / 4294967296.0;
+  }
+
+  /* Random targets spread over 1/64 to 64 times the base difficulty */
+  if (opt_benchmark_random)
+    diff *= pow(2.0, (double)(rand() % 13) - 6.0);
+
+  /* Keep the target below 2^256 */
+  min_diff = pool->algorithm.diff_multiplier2 / 2147483648.0;
+  if (diff < min_diff)
+    diff = min_diff;
+  return diff;
+}
+
+/* Generates work from the built-in benchmark block. Every item gets its own
+ * merkle root so devices never search the same header twice. */
+static void gen_benchmark_work(struct pool *pool, struct work *work)
+{
+  static uint32_t bench_seq;
+  struct timeval tv_start;
+  char job_id[12], ntime[12];
+  uint32_t seq = ++bench_seq;
+
+  cgtime(&tv_start);
+
+  memcpy(work->data, bench_block, 128);
+  ((uint32_t *)work->data)[9] ^= htobe32(seq);
+  work->nonce2 = seq;
+  work->nonce2_len = 4;
+
+  snprintf(job_id, sizeof(job_id), "%x", seq);
+  __bin2hex(ntime, work->data + 68, 4);
+  work->job_id = work_strdup(job_id);
+  work->ntime = work_strdup(ntime);
+
+  work->sdiff = benchmark_diff(pool);
+  if (pool->algorithm.type == ALGO_NEOSCRYPT || pool->algorithm.type == ALGO_NEOSCRYPT_XAYA ||
+      pool->algorithm.type == ALGO_NEOSCRYPT_NAVI || pool->algorithm.type == ALGO_NEOSCRYPT_XAYA_NAVI ||
+      pool->algorithm.type == ALGO_YESCRYPTR16 || pool->algorithm.type == ALGO_YESCRYPTR16_NAVI) {
+    set_target_neoscrypt(work->target, work->sdiff, work->thr_id);
+  } else {
+    if (pool->algorithm.calc_midstate) pool->algorithm.calc_midstate(work);
+    set_target(work->target, work->sdiff, pool->algorithm.diff_multiplier2, work->thr_id);
+  }
+
+  local_work++;
+  work->pool = pool;
+  work->blk.nonce = 0;
+  work->id = total_work++;
+  work->longpoll = false;
+  work->getwork_mode = GETWORK_MODE_BENCHMARK;
+  work->drv_rolllimit = 0;
+  calc_diff(work, work->sdiff);
+
+  cgtime(&work->tv_staged);
+  __atomic_add_fetch(&bench_stats.works, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&bench_stats.gen_us, (uint64_t)us_tdiff(&work->tv_staged, &tv_start), __ATOMIC_RELAXED);
+}
+
+/* Accounts for a benchmark share where submit_work_async() would hand it to
+ * the network, after building the same mining.submit line stratum would */
+static void submit_benchmark_work(struct work *work)
+{
+  struct pool *pool = work->pool;
+  struct cgpu_info *cgpu = get_thr_cgpu(work->thr_id);
+  char noncehex[12], nonce2hex[20], s[1024];
+  uint64_t nonce2le = htole64(work->nonce2);
+  struct timeval tv_end;
+
+  __bin2hex(noncehex, work->data + 76, 4);
+  __bin2hex(nonce2hex, (const unsigned char *)&nonce2le, work->nonce2_len);
+  snprintf(s, sizeof(s),
+    "{\"params\": [\"%s\", \"%s\", \"%s\", \"%s\", \"%s\"], \"id\": %d, \"method\": \"mining.submit\"}",
+    pool->rpc_user, work->job_id, nonce2hex, work->ntime, noncehex, work->id);
+
+  mutex_lock(&stats_lock);
+  cgpu->accepted++;
+  total_accepted++;
+  pool->accepted++;
+  cgpu->diff_accepted += work->work_difficulty;
+  total_diff_accepted += work->work_difficulty;
+  pool->diff_accepted += work->work_difficulty;
+  mutex_unlock(&stats_lock);
+
+  cgpu->last_share_pool = pool->pool_no;
+  cgpu->last_share_pool_time = time(NULL);
+  cgpu->last_share_diff = work->work_difficulty;
+  pool->last_share_time = cgpu->last_share_pool_time;
+  pool->last_share_diff = work->work_difficulty;
+  applog(LOG_DEBUG, "Benchmark share %s", s);
+
+  cgtime(&tv_end);
+  __atomic_add_fetch(&bench_stats.shares, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&bench_stats.submit_us, (uint64_t)us_tdiff(&tv_end, &work->tv_work_found), __ATOMIC_RELAXED);
+  free_work(work);
+}
+
+/* Benchmark mode mines on a single pool that never connects anywhere. The
+ * first configured pool, if any, lends it its profile and algorithm. */
+static void setup_benchmark_pool(void)
+{
+  struct pool *pool;
+
+  if (total_pools > 1)
+    applog(LOG_WARNING, "Benchmark mode ignores all but the first of %d configured pools", total_pools);
+  pool = total_pools ? pools[0] : add_pool();
+  total_pools = 1;
+
+  pool->rpc_url = strdup("Benchmark");
+  pool->rpc_user = pool->rpc_url;
+  pool->rpc_pass = pool->rpc_url;
+  pool->rpc_userpass = pool->rpc_url;
+  pool->sockaddr_url = pool->rpc_url;
+  pool->prio = 0;
+  pool->state = POOL_ENABLED;
+}
+
+static void benchmark_report(void)
+{
+  uint64_t works = __atomic_load_n(&bench_stats.works, __ATOMIC_RELAXED);
+  uint64_t gen_us = __atomic_load_n(&bench_stats.gen_us, __ATOMIC_RELAXED);
+  uint64_t pops = __atomic_load_n(&bench_stats.pops, __ATOMIC_RELAXED);
+  uint64_t queue_us = __atomic_load_n(&bench_stats.queue_us, __ATOMIC_RELAXED);
+  uint64_t shares = __atomic_load_n(&bench_stats.shares, __ATOMIC_RELAXED);
+  uint64_t submit_us = __atomic_load_n(&bench_stats.submit_us, __ATOMIC_RELAXED);
+  double latency_ms, verify_ms;
+  uint64_t verified = postcalc_timings(&latency_ms, &verify_ms);
+
+  applog(LOG_WARNING, "Benchmark stage timings:");
+  applog(LOG_WARNING, " Generate: %"PRIu64" work items, %.2f us each", works,
+         works ? (double)gen_us / works : 0.0);
+  applog(LOG_WARNING, " Staged: %"PRIu64" work items, %.2f ms until popped", pops,
+         pops ? (double)queue_us / pops / 1000.0 : 0.0);
+  applog(LOG_WARNING, " Verify: %"PRIu64" result buffers, %.3f ms queued, %.3f ms hashing", verified,
+         latency_ms, verify_ms);
+  applog(LOG_WARNING, " Submit: %"PRIu64" shares, %.2f us each\n", shares,
+         shares ? (double)submit_us / shares : 0.0);
+}
+
 struct work *get_work(struct thr_info *thr, const int thr_id)
 {
   struct work *work = NULL;
@@ -7655,6 +8073,14 @@ struct work *get_work(struct thr_info *thr, const int thr_id)
     }
   }
 
+  if (work->getwork_mode == GETWORK_MODE_BENCHMARK) {
+    struct timeval now;
+
+    cgtime(&now);
+    __atomic_add_fetch(&bench_stats.pops, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&bench_stats.queue_us, (uint64_t)us_tdiff(&now, &work->tv_staged), __ATOMIC_RELAXED);
+  }
+
   applog(LOG_DEBUG, "[THR%d] preparing thread...", thr_id);
   get_work_prepare_thread(thr, work);
 
@@ -7684,6 +8110,11 @@ static void submit_work_async(struct work *work)
 
   cgtime(&work->tv_work_found);
 
+  if (work->getwork_mode == GETWORK_MODE_BENCHMARK) {
+    submit_benchmark_work(work);
+    return;
+  }
+
   if (stale_work(work, true)) {
     if (opt_submit_stale)
       applog(LOG_NOTICE, "%s stale share detected, submitting (user)", get_pool_name(pool));
@@ -7732,8 +8163,8 @@ void inc_hw_errors(struct thr_info *thr)
   thr->cgpu->drv->hw_error(thr);
 }
 
-/* Fills in the work nonce and builds the output data in work->hash */
-static void rebuild_nonce(struct work *work, uint32_t nonce)
+/* Fills in the work nonce */
+static void set_work_nonce(struct work *work, uint32_t nonce)
 {
   uint32_t nonce_pos = 76;
   if (work->pool->algorithm.type == ALGO_CRE) nonce_pos = 140;
@@ -7749,18 +8180,21 @@ static void rebuild_nonce(struct work *work, uint32_t nonce)
 
     *work_nonce = htole32(nonce);
   }
+}
 
+/* Fills in the work nonce and builds the output data in work->hash */
+static void rebuild_nonce(struct work *work, uint32_t nonce)
+{
+  set_work_nonce(work, nonce);
   work->pool->algorithm.regenhash(work);
 }
 
-/* For testing a nonce against diff 1 */
-bool test_nonce(struct work *work, uint32_t nonce)
+/* Tests the hash already in work->hash against diff 1 */
+static bool test_hash(struct work *work)
 {
   uint32_t *hash_32 = (uint32_t *)(work->hash + 28);
   uint32_t diff1targ;
 
-  rebuild_nonce(work, nonce);
-
   // for Neoscrypt, the diff1targ value is in work->target
   if (work->pool->algorithm.type == ALGO_NEOSCRYPT || work->pool->algorithm.type == ALGO_NEOSCRYPT_XAYA ||
       work->pool->algorithm.type == ALGO_NEOSCRYPT_NAVI || work->pool->algorithm.type == ALGO_NEOSCRYPT_XAYA_NAVI || work->pool->algorithm.type == ALGO_PLUCK
@@ -7781,6 +8215,13 @@ bool test_nonce(struct work *work, uint32_t nonce)
   return (le32toh(*hash_32) <= diff1targ);
 }
 
+/* For testing a nonce against diff 1 */
+bool test_nonce(struct work *work, uint32_t nonce)
+{
+  rebuild_nonce(work, nonce);
+  return test_hash(work);
+}
+
 static void update_work_stats(struct thr_info *thr, struct work *work)
 {
   double test_diff = current_diff;
@@ -7849,6 +8290,49 @@ bool submit_nonce(struct thr_info *thr, struct work *work, uint32_t nonce)
   return false;
 }
 
+/* submit_nonce() for a nonce whose hash was already regenerated, e.g. by a
+ * batched regenhash */
+bool submit_nonce_hash(struct thr_info *thr, struct work *work, uint32_t nonce, const unsigned char *hash)
+{
+  set_work_nonce(work, nonce);
+  memcpy(work->hash, hash, 32);
+  if (test_hash(work)) {
+    submit_tested_work(thr, work);
+    return true;
+  }
+
+  inc_hw_errors(thr);
+  return false;
+}
+
+/* Ethash variant of submit_nonce() for all the nonces of one result buffer:
+ * they are hashed together, each relative to the work's base nonce. Returns
+ * the number of valid shares. */
+int submit_eth_nonces(struct thr_info *thr, struct work *work, const uint32_t *nonces, int count)
+{
+  uint8_t hashes[MAXBUFFERS][32], mixhashes[MAXBUFFERS][32];
+  uint64_t base = work->Nonce;
+  int i, valid = 0;
+
+  assert(count <= MAXBUFFERS);
+  if (!ethash_regenhash_batch(work, nonces, count, hashes, mixhashes))
+    memset(hashes, 0xff, sizeof(hashes));
+
+  for (i = 0; i < count; i++) {
+    work->Nonce = base + nonces[i];
+    memcpy(work->hash, hashes[i], 32);
+    memcpy(work->mixhash, mixhashes[i], 32);
+    if (fulltest(work->hash, work->device_target)) {
+      submit_tested_work(thr, work);
+      valid++;
+    } else
+      inc_hw_errors(thr);
+  }
+  work->Nonce = base;
+
+  return valid;
+}
+
 static inline bool abandon_work(struct work *work, struct timeval *wdiff, uint64_t hashes)
 {
   if (wdiff->tv_sec > opt_scantime ||
@@ -7939,6 +8423,14 @@ static void hash_sole_work(struct thr_info *mythr)
 
     if (work->pool->algorithm.type == ALGO_MTP)
 		  memcpy(work->device_target, work->pool->Target, 32);
+    /* Only shares leave the device, so verification scales with the
+     * pool difficulty. Argon2d shares skip the target check and ethash
+     * sets its own device target above. */
+    else if (opt_gpu_share_target && work->pool->algorithm.type != ALGO_ETHASH &&
+             work->pool->algorithm.type != ALGO_ARGON2D) {
+      memcpy(work->device_target, work->target, 32);
+      work->device_diff = work->work_difficulty;
+    }
 
     do {
       cgtime(&tv_start);
@@ -8676,6 +9168,9 @@ void print_summary(void)
   applog(LOG_WARNING, "Submitting work remotely delay occasions: %d", total_ro);
   applog(LOG_WARNING, "New blocks detected on network: %d\n", new_blocks);
 
+  if (opt_benchmark)
+    benchmark_report();
+
   if (total_pools > 1) {
     for (i = 0; i < total_pools; i++) {
       struct pool *pool = pools[i];
@@ -9189,6 +9684,92 @@ static void probe_pools(void)
   }
 }
 
+/* Devices handed out to the --gpu-init-threads workers */
+struct prepare_queue {
+  struct cgpu_info **cgpus;
+  int count;
+  int next;
+  bool init;
+  pthread_mutex_t lock;
+};
+
+static void prepare_device_threads(struct cgpu_info *cgpu, bool init)
+{
+  int j;
+
+  /* a device's threads share its settings, so they are set up in turn */
+  for (j = 0; j < cgpu->threads; j++) {
+    struct thr_info *thr = cgpu->thr[j];
+
+    if (!cgpu->drv->thread_prepare(thr)) {
+      applog(LOG_ERR, "thread_prepare failed for thread %d", thr->id);
+      continue;
+    }
+    if (init)
+      cgpu->drv->thread_init(thr);
+  }
+}
+
+static void *prepare_devices_thread(void *userdata)
+{
+  struct prepare_queue *queue = (struct prepare_queue *)userdata;
+  int i;
+
+  for (;;) {
+    mutex_lock(&queue->lock);
+    i = queue->next++;
+    mutex_unlock(&queue->lock);
+    if (i >= queue->count)
+      break;
+    prepare_device_threads(queue->cgpus[i], queue->init);
+  }
+  return NULL;
+}
+
+/* Run thread_prepare (and thread_init if asked) for every thread of every
+ * device. Most of the time goes to the OpenCL driver and compiler, so up
+ * to --gpu-init-threads devices are set up at once. */
+static void prepare_devices(bool init)
+{
+  struct prepare_queue queue;
+  pthread_t *workers;
+  struct timeval tv_start, tv_end;
+  int i, nworkers, started = 0;
+
+  memset(&queue, 0, sizeof(queue));
+  queue.init = init;
+  queue.cgpus = (struct cgpu_info **)calloc(total_devices, sizeof(struct cgpu_info *));
+  if (!queue.cgpus)
+    quit(1, "Failed to calloc in prepare_devices");
+  for (i = 0; i < total_devices; i++) {
+    if (devices[i]->threads && devices[i]->thr)
+      queue.cgpus[queue.count++] = devices[i];
+  }
+
+  cgtime(&tv_start);
+  /* this thread is one of the workers */
+  nworkers = MIN(opt_init_threads, queue.count) - 1;
+  workers = (pthread_t *)calloc(nworkers > 0 ? nworkers : 1, sizeof(pthread_t));
+  mutex_init(&queue.lock);
+  if (workers) {
+    for (started = 0; started < nworkers; started++) {
+      if (pthread_create(&workers[started], NULL, prepare_devices_thread, &queue))
+        break;
+    }
+  }
+  prepare_devices_thread(&queue);
+  for (i = 0; i < started; i++)
+    pthread_join(workers[i], NULL);
+  cgtime(&tv_end);
+
+  applog(LOG_NOTICE, "Initialised %d devices in %.1f s, %d at a time", queue.count,
+    us_tdiff(&tv_end, &tv_start) / 1e6, started + 1);
+
+  mutex_destroy(&queue.lock);
+  free(workers);
+  free(queue.cgpus);
+}
+
 static void restart_mining_threads(unsigned int new_n_threads)
 {
   struct thr_info *thr;
@@ -9293,13 +9874,9 @@ static void restart_mining_threads(unsigned int new_n_threads)
 
       cgtime(&thr->last);
       cgpu->thr[j] = thr;
-
-      if (!cgpu->drv->thread_prepare(thr)) {
-        applog(LOG_ERR, "thread_prepare failed for thread %d", thr->id);
-        continue;
-      }
     }
   }
+  prepare_devices(false);
   rd_unlock(&devices_lock);
   wr_unlock(&mining_thr_lock);
 
@@ -9353,7 +9930,8 @@ static void set_current_pool(struct pool *pool) {
       if (cache->dags[i]->dag_buffer != NULL)
         clReleaseMemObject(cache->dags[i]->dag_buffer);
       cache->dags[i]->dag_buffer = NULL;
-      cache->dags[i]->pool = NULL;
+      eth_cache_release(cache->dags[i]->cache);
+      cache->dags[i]->cache = NULL;
       cache->dags[i]->max_epoch = UINT32_MAX;
       cache->dags[i]->current_epoch = UINT32_MAX;
       cg_wunlock(&cache->dags[i]->lock);
@@ -9420,6 +9998,7 @@ int main(int argc, char *argv[])
   mutex_init(&sharelog_lock);
   cglock_init(&ch_lock);
   mutex_init(&sshare_lock);
+  mutex_init(&work_str_lock);
   rwlock_init(&blk_lock);
   rwlock_init(&netacc_lock);
   rwlock_init(&mining_thr_lock);
@@ -9579,9 +10158,15 @@ int main(int argc, char *argv[])
   //apply default settings to GPUs
   apply_defaults();
 
+  if (opt_benchmark)
+    setup_benchmark_pool();
+
   //apply pool-specific config from profiles
   apply_pool_profiles();
 
+  if (opt_benchmark && (pools[0]->algorithm.type == ALGO_ETHASH || pools[0]->algorithm.type == ALGO_MTP))
+    quit(1, "Benchmark mode does not support the %s algorithm", pools[0]->algorithm.name);
+
   most_devices = 0;
   mining_threads = 0;
   if (opt_devs_enabled) {
@@ -9697,6 +10282,18 @@ int main(int argc, char *argv[])
     pool->idle = true;
   }
 
+  /* Share verification workers must be up before any device returns results */
+  init_postcalc_workers();
+
+  if (opt_benchmark) {
+    applog(LOG_NOTICE, "Benchmarking %s on synthetic work, no pool will be contacted", pools[0]->algorithm.name);
+    pools_active = true;
+    successful_connect = true;
+    pool_tclear(pools[0], &pools[0]->idle);
+    switch_pools(pools[0]);
+    goto begin_bench;
+  }
+
   applog(LOG_NOTICE, "Probing for an alive pool");
   int slept = 0;
   do {
@@ -9732,6 +10329,7 @@ int main(int argc, char *argv[])
     }
   } while (!pools_active);
 
+begin_bench:
   //wait for GPUs to be initialized after first alive pool is found
   slept = 0;
   do {
@@ -9823,7 +10421,12 @@ int main(int argc, char *argv[])
     then.tv_sec = now.tv_sec + 2;
     then.tv_nsec = now.tv_usec * 1000;
 
-    mutex_lock(stgd_lock);
+    if (opt_benchmark && opt_benchmark_time && now.tv_sec - total_tv_start.tv_sec >= opt_benchmark_time) {
+      applog(LOG_WARNING, "Benchmarked for %d seconds as requested, exiting", opt_benchmark_time);
+      kill_work();
+    }
+
+    staged_lock();
     ts = __total_staged();
 
     if (!pool_localgen(cp) && !ts && !opt_fail_only)
@@ -9852,6 +10455,13 @@ int main(int argc, char *argv[])
 
     work = make_work();
 
+    if (opt_benchmark) {
+      gen_benchmark_work(cp, work);
+      applog(LOG_DEBUG, "Generated benchmark work");
+      stage_work(work);
+      continue;
+    }
+
     if (lagging && !pool_tset(cp, &cp->lagging)) {
       applog(LOG_WARNING, "%s not providing work fast enough", cp->name);
       cp->getfail_occasions++;
@@ -0,0 +1,50 @@
+/*
+ * Runtime selection of the AES round code, see sph_aesni.h.
+ */
+
+#include "sph_aesni.h"
+
+static int aes_impl = -1;
+
+static int
+aes_supported(void)
+{
+#if SPH_AESNI
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("aes")
+		|| !__builtin_cpu_supports("sse4.1"))
+		return SPH_AES_TABLE;
+	if (__builtin_cpu_supports("vaes")
+		&& __builtin_cpu_supports("avx512f")
+		&& __builtin_cpu_supports("avx512bw"))
+		return SPH_AES_VAES;
+	return SPH_AES_NI;
+#else
+	return SPH_AES_TABLE;
+#endif
+}
+
+/* see sph_aesni.h */
+int
+sph_aes_impl(void)
+{
+	/*
+	 * Racing first calls all store the same value.
+	 */
+	if (aes_impl < 0)
+		aes_impl = aes_supported();
+	return aes_impl;
+}
+
+/* see sph_aesni.h */
+int
+sph_aes_set_impl(int impl)
+{
+	int best;
+
+	best = aes_supported();
+	if (impl < SPH_AES_TABLE)
+		impl = SPH_AES_TABLE;
+	aes_impl = impl < best ? impl : best;
+	return aes_impl;
+}
@@ -690,8 +690,12 @@ bmw32_close(sph_bmw_small_context *sc, unsigned ub, unsigned n,
 	}
 	memset(buf + ptr, 0, (sizeof sc->buf) - 8 - ptr);
 #if SPH_64
-	sph_enc64le_aligned(buf + (sizeof sc->buf) - 8,
-		SPH_T64(sc->bit_count + n));
+	/* compress_small() reads the buffer as 32-bit words; a 64-bit store
+	   here would be reordered past those loads under strict aliasing */
+	sph_enc32le_aligned(buf + (sizeof sc->buf) - 8,
+		SPH_T32(sc->bit_count + n));
+	sph_enc32le_aligned(buf + (sizeof sc->buf) - 4,
+		SPH_T32((sc->bit_count + n) >> 32));
 #else
 	sph_enc32le_aligned(buf + (sizeof sc->buf) - 8,
 		sc->bit_count_low + n);
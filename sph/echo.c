@@ -35,6 +35,7 @@
 #include <limits.h>
 
 #include "sph_echo.h"
+#include "sph_aesni.h"
 
 #if SPH_SMALL_FOOTPRINT && !defined SPH_SMALL_FOOTPRINT_ECHO
 #define SPH_SMALL_FOOTPRINT_ECHO   1
@@ -707,11 +708,212 @@ echo_big_init(sph_echo_big_context *sc, unsigned out_len)
 	sc->C0 = sc->C1 = sc->C2 = sc->C3 = 0;
 }
 
+#if SPH_AESNI
+
+#include <immintrin.h>
+
+#define ECHO_AESNI   __attribute__((target("aes,sse4.1")))
+#define ECHO_VAES    __attribute__((target("aes,sse4.1,avx512f,avx512bw,vaes")))
+
+/*
+ * With AES-NI, each ECHO word is one __m128i and BIG_SUB_WORDS is two
+ * AESENC per word. The salt is kept as a 128-bit counter split in two
+ * 64-bit halves.
+ */
+
+static inline ECHO_AESNI __m128i
+echo_xtime_aesni(__m128i x)
+{
+	return _mm_xor_si128(_mm_add_epi8(x, x),
+		_mm_and_si128(_mm_cmpgt_epi8(_mm_setzero_si128(), x),
+		_mm_set1_epi8(0x1B)));
+}
+
+static ECHO_AESNI void
+echo_rounds_aesni(__m128i W[16], sph_u64 lo, sph_u64 hi, unsigned rounds)
+{
+	__m128i zero = _mm_setzero_si128();
+	unsigned r, n;
+
+	for (r = 0; r < rounds; r ++) {
+		__m128i t;
+
+		for (n = 0; n < 16; n ++) {
+			W[n] = _mm_aesenc_si128(_mm_aesenc_si128(W[n],
+				_mm_set_epi64x((long long)hi, (long long)lo)),
+				zero);
+			if (++ lo == 0)
+				hi ++;
+		}
+		t = W[1]; W[1] = W[5]; W[5] = W[9]; W[9] = W[13]; W[13] = t;
+		t = W[2]; W[2] = W[10]; W[10] = t;
+		t = W[6]; W[6] = W[14]; W[14] = t;
+		t = W[15]; W[15] = W[11]; W[11] = W[7]; W[7] = W[3]; W[3] = t;
+		for (n = 0; n < 16; n += 4) {
+			__m128i a = W[n + 0];
+			__m128i b = W[n + 1];
+			__m128i c = W[n + 2];
+			__m128i d = W[n + 3];
+			__m128i ab = _mm_xor_si128(a, b);
+			__m128i bc = _mm_xor_si128(b, c);
+			__m128i cd = _mm_xor_si128(c, d);
+			__m128i abx = echo_xtime_aesni(ab);
+			__m128i bcx = echo_xtime_aesni(bc);
+			__m128i cdx = echo_xtime_aesni(cd);
+
+			W[n + 0] = _mm_xor_si128(_mm_xor_si128(abx, bc), d);
+			W[n + 1] = _mm_xor_si128(_mm_xor_si128(bcx, a), cd);
+			W[n + 2] = _mm_xor_si128(_mm_xor_si128(cdx, ab), d);
+			W[n + 3] = _mm_xor_si128(_mm_xor_si128(abx, bcx),
+				_mm_xor_si128(_mm_xor_si128(cdx, ab), c));
+		}
+	}
+}
+
+static inline ECHO_VAES __m512i
+echo_xtime_vaes(__m512i x)
+{
+	return _mm512_xor_si512(_mm512_add_epi8(x, x),
+		_mm512_maskz_mov_epi8(_mm512_movepi8_mask(x),
+		_mm512_set1_epi8(0x1B)));
+}
+
+/*
+ * Same rounds with the state as four rows of four words, so that
+ * BIG_SHIFT_ROWS rotates within a register and BIG_MIX_COLUMNS works
+ * on whole registers. The salts of a round are computed with 64-bit
+ * additions, which is only done when the low half of the counter cannot
+ * wrap; otherwise this returns 0 and the caller uses the AES-NI code.
+ */
+static ECHO_VAES int
+echo_rounds_vaes(__m128i W[16], sph_u64 lo, sph_u64 hi, unsigned rounds)
+{
+	__m512i R[4], kb, zero = _mm512_setzero_si512();
+	__m128i out[4][4];
+	unsigned r, n;
+
+	if (lo > ~(sph_u64)0 - 16 * rounds)
+		return 0;
+	for (r = 0; r < 4; r ++) {
+		R[r] = _mm512_castsi128_si512(W[r]);
+		R[r] = _mm512_inserti32x4(R[r], W[r + 4], 1);
+		R[r] = _mm512_inserti32x4(R[r], W[r + 8], 2);
+		R[r] = _mm512_inserti32x4(R[r], W[r + 12], 3);
+	}
+	kb = _mm512_broadcast_i32x4(
+		_mm_set_epi64x((long long)hi, (long long)lo));
+	for (n = 0; n < rounds; n ++) {
+		__m512i a, b, c, d, ab, bc, cd, abx, bcx, cdx;
+
+		for (r = 0; r < 4; r ++) {
+			__m512i k = _mm512_add_epi64(kb,
+				_mm512_set_epi64(0, 12 + r, 0, 8 + r,
+				0, 4 + r, 0, r));
+
+			R[r] = _mm512_aesenc_epi128(
+				_mm512_aesenc_epi128(R[r], k), zero);
+		}
+		kb = _mm512_add_epi64(kb,
+			_mm512_set_epi64(0, 16, 0, 16, 0, 16, 0, 16));
+		a = R[0];
+		b = _mm512_alignr_epi64(R[1], R[1], 2);
+		c = _mm512_alignr_epi64(R[2], R[2], 4);
+		d = _mm512_alignr_epi64(R[3], R[3], 6);
+		ab = _mm512_xor_si512(a, b);
+		bc = _mm512_xor_si512(b, c);
+		cd = _mm512_xor_si512(c, d);
+		abx = echo_xtime_vaes(ab);
+		bcx = echo_xtime_vaes(bc);
+		cdx = echo_xtime_vaes(cd);
+		R[0] = _mm512_xor_si512(_mm512_xor_si512(abx, bc), d);
+		R[1] = _mm512_xor_si512(_mm512_xor_si512(bcx, a), cd);
+		R[2] = _mm512_xor_si512(_mm512_xor_si512(cdx, ab), d);
+		R[3] = _mm512_xor_si512(_mm512_xor_si512(abx, bcx),
+			_mm512_xor_si512(_mm512_xor_si512(cdx, ab), c));
+	}
+	for (r = 0; r < 4; r ++)
+		_mm512_storeu_si512((void *)out[r], R[r]);
+	for (n = 0; n < 16; n ++)
+		W[n] = out[n & 3][n >> 2];
+	return 1;
+}
+
+static ECHO_AESNI void
+echo_rounds(__m128i W[16], sph_u32 C0, sph_u32 C1, sph_u32 C2, sph_u32 C3,
+	unsigned rounds)
+{
+	sph_u64 lo = (sph_u64)C0 | ((sph_u64)C1 << 32);
+	sph_u64 hi = (sph_u64)C2 | ((sph_u64)C3 << 32);
+
+	if (sph_aes_impl() >= SPH_AES_VAES
+		&& echo_rounds_vaes(W, lo, hi, rounds))
+		return;
+	echo_rounds_aesni(W, lo, hi, rounds);
+}
+
+/*
+ * The contexts hold V and the buffer in the byte order the words have
+ * in the state, whichever of Vb and Vs is used.
+ */
+
+static ECHO_AESNI void
+echo_small_compress_aesni(sph_echo_small_context *sc)
+{
+	__m128i W[16];
+	__m128i *V = (__m128i *)(void *)&sc->u;
+	const __m128i *M = (const __m128i *)(const void *)sc->buf;
+	unsigned u;
+
+	for (u = 0; u < 4; u ++)
+		W[u] = _mm_loadu_si128(V + u);
+	for (u = 0; u < 12; u ++)
+		W[u + 4] = _mm_loadu_si128(M + u);
+	echo_rounds(W, sc->C0, sc->C1, sc->C2, sc->C3, 8);
+	for (u = 0; u < 4; u ++) {
+		__m128i x = _mm_xor_si128(_mm_loadu_si128(M + u),
+			_mm_loadu_si128(M + u + 4));
+
+		x = _mm_xor_si128(x, _mm_loadu_si128(M + u + 8));
+		x = _mm_xor_si128(x, _mm_xor_si128(W[u], W[u + 4]));
+		x = _mm_xor_si128(x, _mm_xor_si128(W[u + 8], W[u + 12]));
+		_mm_storeu_si128(V + u, _mm_xor_si128(_mm_loadu_si128(V + u), x));
+	}
+}
+
+static ECHO_AESNI void
+echo_big_compress_aesni(sph_echo_big_context *sc)
+{
+	__m128i W[16];
+	__m128i *V = (__m128i *)(void *)&sc->u;
+	const __m128i *M = (const __m128i *)(const void *)sc->buf;
+	unsigned u;
+
+	for (u = 0; u < 8; u ++) {
+		W[u] = _mm_loadu_si128(V + u);
+		W[u + 8] = _mm_loadu_si128(M + u);
+	}
+	echo_rounds(W, sc->C0, sc->C1, sc->C2, sc->C3, 10);
+	for (u = 0; u < 8; u ++) {
+		__m128i x = _mm_xor_si128(_mm_loadu_si128(M + u),
+			_mm_xor_si128(W[u], W[u + 8]));
+
+		_mm_storeu_si128(V + u, _mm_xor_si128(_mm_loadu_si128(V + u), x));
+	}
+}
+
+#endif
+
 static void
 echo_small_compress(sph_echo_small_context *sc)
 {
 	DECL_STATE_SMALL
 
+#if SPH_AESNI
+	if (sph_aes_impl() >= SPH_AES_NI) {
+		echo_small_compress_aesni(sc);
+		return;
+	}
+#endif
 	COMPRESS_SMALL(sc);
 }
 
@@ -720,6 +922,12 @@ echo_big_compress(sph_echo_big_context *sc)
 {
 	DECL_STATE_BIG
 
+#if SPH_AESNI
+	if (sph_aes_impl() >= SPH_AES_NI) {
+		echo_big_compress_aesni(sc);
+		return;
+	}
+#endif
 	COMPRESS_BIG(sc);
 }
 
@@ -34,6 +34,7 @@
 #include <string.h>
 
 #include "sph_fugue.h"
+#include "sph_aesni.h"
 
 #ifdef _MSC_VER
 #pragma warning (disable: 4146)
@@ -1170,6 +1171,223 @@ fugue4_close(sph_fugue_context *sc, unsigned ub, unsigned n, void *dst)
 	sph_fugue512_init(sc);
 }
 
+#if SPH_AESNI
+
+#include <immintrin.h>
+
+#define FUGUE_TARGET   __attribute__((target("aes,sse4.1")))
+#define FUGUE_UNROLL   _Pragma("GCC unroll 9")
+
+/*
+ * Fugue-512 with AES-NI keeps the 36-word state in nine registers, word
+ * i in lane i % 4 of G[i / 4], and rotates it for real: a ROR is one
+ * PALIGNR per register, after which TIX, CMIX and SMIX always work on
+ * the same lanes. SMIX is an AESENCLAST with a zero key on the columns
+ * pre-permuted to cancel its ShiftRows (SubBytes), then SuperMix on the
+ * S-box output s. With C the column mix of s and row m in byte 3 - m of
+ * the words, the table code computes
+ *   out[m][k] = C[m][m + k] ^ coef[k] * (rowsum(s, m) ^ s[m][m])
+ * for coef = { 1, 1, 7, 4 }; the column mix and the row shifts fold
+ * into four PSHUFB masks. The state is saved in the layout of the table
+ * code. Fugue-224, -256 and -384 only have the table code.
+ */
+
+static inline FUGUE_TARGET __m128i
+fugue_xtime(__m128i x)
+{
+	return _mm_xor_si128(_mm_add_epi8(x, x),
+		_mm_and_si128(_mm_cmpgt_epi8(_mm_setzero_si128(), x),
+		_mm_set1_epi8(0x1B)));
+}
+
+static inline FUGUE_TARGET __m128i
+fugue_smix_aesni(__m128i x)
+{
+	__m128i s, s2, s4, e, e2, e4, c;
+
+	s = _mm_aesenclast_si128(_mm_shuffle_epi8(x, _mm_setr_epi8(
+		0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3)),
+		_mm_setzero_si128());
+	s2 = fugue_xtime(s);
+	s4 = fugue_xtime(s2);
+
+	/* rowsum(s, m) ^ s[m][m], in every column */
+	e = _mm_xor_si128(s, _mm_shuffle_epi32(s, 0x4E));
+	e = _mm_xor_si128(e, _mm_shuffle_epi32(e, 0xB1));
+	e = _mm_xor_si128(e, _mm_shuffle_epi8(s, _mm_setr_epi8(
+		12, 9, 6, 3, 12, 9, 6, 3, 12, 9, 6, 3, 12, 9, 6, 3)));
+	e2 = fugue_xtime(e);
+	e4 = fugue_xtime(e2);
+	e = _mm_blend_epi16(e, _mm_xor_si128(e, _mm_xor_si128(e2, e4)), 0x30);
+	e = _mm_blend_epi16(e, e4, 0xC0);
+
+	/* C = s + s[r-1] + 7 * s[r-2] + 4 * s[r-3], rows shifted */
+	c = _mm_xor_si128(_mm_shuffle_epi8(s, _mm_setr_epi8(
+		12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15)),
+		_mm_shuffle_epi8(s, _mm_setr_epi8(
+		13, 10, 7, 0, 1, 14, 11, 4, 5, 2, 15, 8, 9, 6, 3, 12)));
+	c = _mm_xor_si128(c, _mm_shuffle_epi8(
+		_mm_xor_si128(s, _mm_xor_si128(s2, s4)), _mm_setr_epi8(
+		14, 11, 4, 1, 2, 15, 8, 5, 6, 3, 12, 9, 10, 7, 0, 13)));
+	c = _mm_xor_si128(c, _mm_shuffle_epi8(s4, _mm_setr_epi8(
+		15, 8, 5, 2, 3, 12, 9, 6, 7, 0, 13, 10, 11, 4, 1, 14)));
+	return _mm_xor_si128(c, e);
+}
+
+/*
+ * ROR(n, 36) on G[]: with n = 4 * q + r and 1 <= r <= 4, G[k] takes
+ * the words of G[k - q - 1] and G[k - q] from lane 4 - r on.
+ */
+#define FUGUE_ROR_Q(n)   (((n) - 1) / 4)
+#define FUGUE_ROR_B(n)   (16 - 4 * ((n) - 4 * FUGUE_ROR_Q(n)))
+
+#define FUGUE_ROR_AESNI(n)   do { \
+		__m128i T[9]; \
+		unsigned k; \
+ \
+		FUGUE_UNROLL \
+		for (k = 0; k < 9; k ++) \
+			T[k] = _mm_alignr_epi8(G[(k + 9 - FUGUE_ROR_Q(n)) % 9], \
+				G[(k + 8 - FUGUE_ROR_Q(n)) % 9], FUGUE_ROR_B(n)); \
+		memcpy(G, T, sizeof T); \
+	} while (0)
+
+/*
+ * TIX4 on the first words: S22 ^= S00, S00 = q, S08 ^= q, S01 ^= S24,
+ * S04 ^= S27, S07 ^= S30.
+ */
+#define FUGUE4_TIX_AESNI(q)   do { \
+		__m128i lane0 = _mm_setr_epi32(-1, 0, 0, 0); \
+		__m128i vq = _mm_cvtsi32_si128((int)(q)); \
+ \
+		G[5] = _mm_xor_si128(G[5], \
+			_mm_slli_si128(_mm_and_si128(G[0], lane0), 8)); \
+		G[0] = _mm_blend_epi16(G[0], vq, 0x03); \
+		G[2] = _mm_xor_si128(G[2], vq); \
+		G[0] = _mm_xor_si128(G[0], \
+			_mm_slli_si128(_mm_and_si128(G[6], lane0), 4)); \
+		G[1] = _mm_xor_si128(G[1], _mm_xor_si128( \
+			_mm_srli_si128(G[6], 12), \
+			_mm_slli_si128(_mm_srli_si128(G[7], 8), 12))); \
+	} while (0)
+
+/*
+ * CMIX36 (S00..S02 and S18..S20 ^= S04..S06), then SMIX on S00..S03.
+ */
+#define FUGUE4_MIX_AESNI   do { \
+		__m128i v = _mm_and_si128(G[1], _mm_setr_epi32(-1, -1, -1, 0)); \
+ \
+		G[4] = _mm_xor_si128(G[4], _mm_slli_si128(v, 8)); \
+		G[5] = _mm_xor_si128(G[5], _mm_srli_si128(v, 8)); \
+		G[0] = fugue_smix_aesni(_mm_xor_si128(G[0], v)); \
+	} while (0)
+
+/*
+ * S04, S[a], S[b] and S[c] ^= S00.
+ */
+#define FUGUE4_XS0_AESNI(a, b, c)   do { \
+		__m128i x0 = _mm_and_si128(G[0], _mm_setr_epi32(-1, 0, 0, 0)); \
+ \
+		G[1] = _mm_xor_si128(G[1], x0); \
+		G[(a) / 4] = _mm_xor_si128(G[(a) / 4], \
+			_mm_slli_si128(x0, 4 * ((a) % 4))); \
+		G[(b) / 4] = _mm_xor_si128(G[(b) / 4], \
+			_mm_slli_si128(x0, 4 * ((b) % 4))); \
+		G[(c) / 4] = _mm_xor_si128(G[(c) / 4], \
+			_mm_slli_si128(x0, 4 * ((c) % 4))); \
+	} while (0)
+
+static FUGUE_TARGET void
+fugue4_core_aesni(sph_fugue_context *sc, const void *data, size_t len)
+{
+	__m128i G[9];
+	unsigned k;
+
+	CORE_ENTRY
+	rshift = sc->round_shift;
+	FUGUE_UNROLL
+	for (k = 0; k < 9; k ++)
+		G[k] = _mm_loadu_si128((const __m128i *)
+			(sc->S + (4 * k + 36 - 12 * rshift) % 36));
+	for (;;) {
+		FUGUE4_TIX_AESNI(p);
+		FUGUE_ROR_AESNI(3);
+		FUGUE4_MIX_AESNI;
+		FUGUE_ROR_AESNI(3);
+		FUGUE4_MIX_AESNI;
+		FUGUE_ROR_AESNI(3);
+		FUGUE4_MIX_AESNI;
+		FUGUE_ROR_AESNI(3);
+		FUGUE4_MIX_AESNI;
+		rshift = rshift == 2 ? 0 : rshift + 1;
+		if (len <= 4)
+			break;
+		p = sph_dec32be(data);
+		data = (const unsigned char *)data + 4;
+		len -= 4;
+	}
+	FUGUE_UNROLL
+	for (k = 0; k < 9; k ++)
+		_mm_storeu_si128((__m128i *)
+			(sc->S + (4 * k + 36 - 12 * rshift) % 36), G[k]);
+	CORE_EXIT
+}
+
+static FUGUE_TARGET void
+fugue4_close_aesni(sph_fugue_context *sc, unsigned ub, unsigned n, void *dst)
+{
+	__m128i G[9];
+	unsigned k;
+	int i;
+
+	CLOSE_ENTRY(36, 12, fugue4_core_aesni)
+	FUGUE_UNROLL
+	for (k = 0; k < 9; k ++)
+		G[k] = _mm_loadu_si128((const __m128i *)(S + 4 * k));
+	for (i = 0; i < 32; i ++) {
+		FUGUE_ROR_AESNI(3);
+		FUGUE4_MIX_AESNI;
+	}
+	for (i = 0; i < 13; i ++) {
+		FUGUE4_XS0_AESNI(9, 18, 27);
+		FUGUE_ROR_AESNI(9);
+		G[0] = fugue_smix_aesni(G[0]);
+		FUGUE4_XS0_AESNI(10, 18, 27);
+		FUGUE_ROR_AESNI(9);
+		G[0] = fugue_smix_aesni(G[0]);
+		FUGUE4_XS0_AESNI(10, 19, 27);
+		FUGUE_ROR_AESNI(9);
+		G[0] = fugue_smix_aesni(G[0]);
+		FUGUE4_XS0_AESNI(10, 19, 28);
+		FUGUE_ROR_AESNI(8);
+		G[0] = fugue_smix_aesni(G[0]);
+	}
+	FUGUE4_XS0_AESNI(9, 18, 27);
+	FUGUE_UNROLL
+	for (k = 0; k < 9; k ++)
+		_mm_storeu_si128((__m128i *)(S + 4 * k), G[k]);
+	out = (unsigned char *)dst;
+	sph_enc32be(out +  0, S[ 1]);
+	sph_enc32be(out +  4, S[ 2]);
+	sph_enc32be(out +  8, S[ 3]);
+	sph_enc32be(out + 12, S[ 4]);
+	sph_enc32be(out + 16, S[ 9]);
+	sph_enc32be(out + 20, S[10]);
+	sph_enc32be(out + 24, S[11]);
+	sph_enc32be(out + 28, S[12]);
+	sph_enc32be(out + 32, S[18]);
+	sph_enc32be(out + 36, S[19]);
+	sph_enc32be(out + 40, S[20]);
+	sph_enc32be(out + 44, S[21]);
+	sph_enc32be(out + 48, S[27]);
+	sph_enc32be(out + 52, S[28]);
+	sph_enc32be(out + 56, S[29]);
+	sph_enc32be(out + 60, S[30]);
+	sph_fugue512_init(sc);
+}
+
+#endif
+
 /* see sph_fugue.h */
 void
 sph_fugue224_init(void *cc)
@@ -1265,6 +1483,11 @@ sph_fugue512_init(void *cc)
 void
 sph_fugue512(void *cc, const void *data, size_t len)
 {
+#if SPH_AESNI
+	if (sph_aes_impl() >= SPH_AES_NI)
+		fugue4_core_aesni((sph_fugue_context *)cc, data, len);
+	else
+#endif
 	fugue4_core((sph_fugue_context *)cc, data, len);
 }
 
@@ -1272,6 +1495,11 @@ sph_fugue512(void *cc, const void *data, size_t len)
 void
 sph_fugue512_close(void *cc, void *dst)
 {
+#if SPH_AESNI
+	if (sph_aes_impl() >= SPH_AES_NI)
+		fugue4_close_aesni((sph_fugue_context *)cc, 0, 0, dst);
+	else
+#endif
 	fugue4_close((sph_fugue_context *)cc, 0, 0, dst);
 }
 
@@ -1279,5 +1507,10 @@ sph_fugue512_close(void *cc, void *dst)
 void
 sph_fugue512_addbits_and_close(void *cc, unsigned ub, unsigned n, void *dst)
 {
+#if SPH_AESNI
+	if (sph_aes_impl() >= SPH_AES_NI)
+		fugue4_close_aesni((sph_fugue_context *)cc, ub, n, dst);
+	else
+#endif
 	fugue4_close((sph_fugue_context *)cc, ub, n, dst);
 }
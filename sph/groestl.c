@@ -34,6 +34,7 @@
 #include <string.h>
 
 #include "sph_groestl.h"
+#include "sph_aesni.h"
 
 #if SPH_SMALL_FOOTPRINT && !defined SPH_SMALL_FOOTPRINT_GROESTL
 #define SPH_SMALL_FOOTPRINT_GROESTL   1
@@ -2897,6 +2898,225 @@ groestl_big_init(sph_groestl_big_context *sc, unsigned out_size)
 #endif
 }
 
+#if SPH_AESNI && SPH_GROESTL_64 && USE_LE
+
+#define GROESTL_AESNI   1
+
+#include <immintrin.h>
+
+#define GROESTL_TARGET   __attribute__((target("aes,sse4.1")))
+
+/*
+ * The row arrays only stay in registers if the loops over them are
+ * unrolled, which -O2 does not do by itself.
+ */
+#define GROESTL_UNROLL   _Pragma("GCC unroll 8")
+
+/*
+ * Groestl-512 with AES-NI works on the state as 8 rows of 16 bytes, one
+ * __m128i per row, instead of 16 columns. ShiftBytesWide is then a byte
+ * rotation of each row and SubBytes is an AESENCLAST with a zero key
+ * on a row pre-permuted to cancel the AES ShiftRows, the two permutations
+ * being a single PSHUFB. MixBytes is computed on whole rows as
+ *   t[i] = a[i] ^ a[i+1]
+ *   y[i] = t[i] ^ t[i+2] ^ a[i+6]
+ *   b[i] = 2 * (2 * (t[i+3] ^ t[i+6]) ^ y[i+7]) ^ y[i+4]
+ * (indices mod 8). With USE_LE the H words hold the column bytes in
+ * order, so the state and the message block are transposed on entry
+ * and the state on exit.
+ */
+
+static inline GROESTL_TARGET __m128i
+groestl_xtime(__m128i x)
+{
+	return _mm_xor_si128(_mm_add_epi8(x, x),
+		_mm_and_si128(_mm_cmpgt_epi8(_mm_setzero_si128(), x),
+		_mm_set1_epi8(0x1B)));
+}
+
+/*
+ * Transpose the 8x8 matrix of 16-bit words in x[] into y[].
+ */
+static inline GROESTL_TARGET void
+groestl_transpose(const __m128i x[8], __m128i y[8])
+{
+	__m128i t0, t1, t2, t3, t4, t5, t6, t7;
+	__m128i u0, u1, u2, u3, u4, u5, u6, u7;
+
+	t0 = _mm_unpacklo_epi16(x[0], x[1]);
+	t1 = _mm_unpackhi_epi16(x[0], x[1]);
+	t2 = _mm_unpacklo_epi16(x[2], x[3]);
+	t3 = _mm_unpackhi_epi16(x[2], x[3]);
+	t4 = _mm_unpacklo_epi16(x[4], x[5]);
+	t5 = _mm_unpackhi_epi16(x[4], x[5]);
+	t6 = _mm_unpacklo_epi16(x[6], x[7]);
+	t7 = _mm_unpackhi_epi16(x[6], x[7]);
+	u0 = _mm_unpacklo_epi32(t0, t2);
+	u1 = _mm_unpackhi_epi32(t0, t2);
+	u2 = _mm_unpacklo_epi32(t1, t3);
+	u3 = _mm_unpackhi_epi32(t1, t3);
+	u4 = _mm_unpacklo_epi32(t4, t6);
+	u5 = _mm_unpackhi_epi32(t4, t6);
+	u6 = _mm_unpacklo_epi32(t5, t7);
+	u7 = _mm_unpackhi_epi32(t5, t7);
+	y[0] = _mm_unpacklo_epi64(u0, u4);
+	y[1] = _mm_unpackhi_epi64(u0, u4);
+	y[2] = _mm_unpacklo_epi64(u1, u5);
+	y[3] = _mm_unpackhi_epi64(u1, u5);
+	y[4] = _mm_unpacklo_epi64(u2, u6);
+	y[5] = _mm_unpackhi_epi64(u2, u6);
+	y[6] = _mm_unpacklo_epi64(u3, u7);
+	y[7] = _mm_unpackhi_epi64(u3, u7);
+}
+
+/*
+ * 128 bytes of columns to rows: interleaving the two columns of each
+ * 16-byte load makes row i the i-th 16-bit word of every load.
+ */
+static inline GROESTL_TARGET void
+groestl_rows_in(__m128i a[8], const void *src)
+{
+	const __m128i *s = (const __m128i *)src;
+	__m128i il = _mm_setr_epi8(0, 8, 1, 9, 2, 10, 3, 11,
+		4, 12, 5, 13, 6, 14, 7, 15);
+	__m128i x[8];
+	int u;
+
+	GROESTL_UNROLL
+	for (u = 0; u < 8; u ++)
+		x[u] = _mm_shuffle_epi8(_mm_loadu_si128(s + u), il);
+	groestl_transpose(x, a);
+}
+
+static inline GROESTL_TARGET void
+groestl_rows_out(void *dst, const __m128i a[8])
+{
+	__m128i *d = (__m128i *)dst;
+	__m128i dl = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14,
+		1, 3, 5, 7, 9, 11, 13, 15);
+	__m128i x[8];
+	int u;
+
+	groestl_transpose(a, x);
+	GROESTL_UNROLL
+	for (u = 0; u < 8; u ++)
+		_mm_storeu_si128(d + u, _mm_shuffle_epi8(x[u], dl));
+}
+
+/*
+ * SubBytes, ShiftBytesWide and MixBytes; sb[i] is the PSHUFB mask of
+ * row i.
+ */
+static inline GROESTL_TARGET void
+groestl_round_aesni(__m128i a[8], const __m128i sb[8])
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i t[8], y[8];
+	int i;
+
+	GROESTL_UNROLL
+	for (i = 0; i < 8; i ++)
+		a[i] = _mm_aesenclast_si128(_mm_shuffle_epi8(a[i], sb[i]), zero);
+	GROESTL_UNROLL
+	for (i = 0; i < 8; i ++)
+		t[i] = _mm_xor_si128(a[i], a[(i + 1) & 7]);
+	GROESTL_UNROLL
+	for (i = 0; i < 8; i ++)
+		y[i] = _mm_xor_si128(_mm_xor_si128(t[i], t[(i + 2) & 7]),
+			a[(i + 6) & 7]);
+	GROESTL_UNROLL
+	for (i = 0; i < 8; i ++)
+		a[i] = _mm_xor_si128(groestl_xtime(_mm_xor_si128(
+			groestl_xtime(_mm_xor_si128(t[(i + 3) & 7],
+			t[(i + 6) & 7])), y[(i + 7) & 7])), y[(i + 4) & 7]);
+}
+
+/*
+ * Row rotations of P and Q, applied after AESENCLAST's ShiftRows has
+ * been undone.
+ */
+static const unsigned char groestl_shift_p[8] = { 0, 1, 2, 3, 4, 5, 6, 11 };
+static const unsigned char groestl_shift_q[8] = { 1, 3, 5, 11, 0, 2, 4, 6 };
+
+static inline GROESTL_TARGET void
+groestl_masks(__m128i sb[8], const unsigned char *shift)
+{
+	__m128i isr = _mm_setr_epi8(0, 13, 10, 7, 4, 1, 14, 11,
+		8, 5, 2, 15, 12, 9, 6, 3);
+	int i;
+
+	GROESTL_UNROLL
+	for (i = 0; i < 8; i ++)
+		sb[i] = _mm_and_si128(_mm_add_epi8(isr,
+			_mm_set1_epi8((char)shift[i])), _mm_set1_epi8(15));
+}
+
+/*
+ * P on p[] and, unless q is NULL, Q on q[], interleaved.
+ */
+static GROESTL_TARGET void
+groestl_perm_aesni(__m128i p[8], __m128i q[8])
+{
+	__m128i sbp[8], sbq[8];
+	__m128i pc = _mm_setr_epi8(0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60,
+		0x70, (char)0x80, (char)0x90, (char)0xA0, (char)0xB0, (char)0xC0,
+		(char)0xD0, (char)0xE0, (char)0xF0);
+	__m128i ones = _mm_set1_epi8((char)0xFF);
+	int r, i;
+
+	groestl_masks(sbp, groestl_shift_p);
+	groestl_masks(sbq, groestl_shift_q);
+	for (r = 0; r < 14; r ++) {
+		__m128i rc = _mm_set1_epi8((char)r);
+
+		p[0] = _mm_xor_si128(p[0], _mm_xor_si128(pc, rc));
+		groestl_round_aesni(p, sbp);
+		if (q == NULL)
+			continue;
+		GROESTL_UNROLL
+		for (i = 0; i < 7; i ++)
+			q[i] = _mm_xor_si128(q[i], ones);
+		q[7] = _mm_xor_si128(q[7],
+			_mm_xor_si128(_mm_xor_si128(pc, ones), rc));
+		groestl_round_aesni(q, sbq);
+	}
+}
+
+static GROESTL_TARGET void
+groestl_big_compress_aesni(sph_u64 *H, const unsigned char *buf)
+{
+	__m128i h[8], g[8], m[8];
+	int i;
+
+	groestl_rows_in(h, H);
+	groestl_rows_in(m, buf);
+	GROESTL_UNROLL
+	for (i = 0; i < 8; i ++)
+		g[i] = _mm_xor_si128(h[i], m[i]);
+	groestl_perm_aesni(g, m);
+	GROESTL_UNROLL
+	for (i = 0; i < 8; i ++)
+		h[i] = _mm_xor_si128(h[i], _mm_xor_si128(g[i], m[i]));
+	groestl_rows_out(H, h);
+}
+
+static GROESTL_TARGET void
+groestl_big_final_aesni(sph_u64 *H)
+{
+	__m128i h[8], x[8];
+	int i;
+
+	groestl_rows_in(h, H);
+	memcpy(x, h, sizeof x);
+	groestl_perm_aesni(x, NULL);
+	GROESTL_UNROLL
+	for (i = 0; i < 8; i ++)
+		h[i] = _mm_xor_si128(h[i], x[i]);
+	groestl_rows_out(H, h);
+}
+
+#endif
+
 static void
 groestl_big_core(sph_groestl_big_context *sc, const void *data, size_t len)
 {
@@ -2925,6 +3145,11 @@ groestl_big_core(sph_groestl_big_context *sc, const void *data, size_t len)
 		data = (const unsigned char *)data + clen;
 		len -= clen;
 		if (ptr == sizeof sc->buf) {
+#if GROESTL_AESNI
+			if (sph_aes_impl() >= SPH_AES_NI)
+				groestl_big_compress_aesni(H, buf);
+			else
+#endif
 			COMPRESS_BIG;
 #if SPH_64
 			sc->count ++;
@@ -2986,6 +3211,11 @@ groestl_big_close(sph_groestl_big_context *sc,
 #endif
 	groestl_big_core(sc, pad, pad_len);
 	READ_STATE_BIG(sc);
+#if GROESTL_AESNI
+	if (sph_aes_impl() >= SPH_AES_NI)
+		groestl_big_final_aesni(H);
+	else
+#endif
 	FINAL_BIG;
 #if SPH_GROESTL_64
 	for (u = 0; u < 8; u ++)
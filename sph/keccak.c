@@ -1702,6 +1702,69 @@ DEFCLOSE(32, 136)
 DEFCLOSE(48, 104)
 DEFCLOSE(64, 72)
 
+#if SPH_64
+
+/*
+ * Lanes kept complemented in the contexts (the "lane complement").
+ */
+static const unsigned char keccak_lc[] = { 1, 2, 8, 12, 17, 20 };
+
+/* see sph_keccak.h */
+void
+sph_keccak_f1600(sph_u64 *A)
+{
+	/*
+	 * The state goes through a context, so that this is the exact
+	 * permutation code the contexts run.
+	 */
+	sph_keccak_context ctx, *kc;
+	DECL_STATE
+	int i;
+
+	kc = &ctx;
+#if SPH_KECCAK_64
+	for (i = 0; i < 25; i ++)
+		kc->u.wide[i] = A[i];
+	for (i = 0; i < 6; i ++)
+		kc->u.wide[keccak_lc[i]] = ~kc->u.wide[keccak_lc[i]];
+#else
+	for (i = 0; i < 25; i ++) {
+		kc->u.narrow[2 * i + 0] = (sph_u32)A[i];
+		kc->u.narrow[2 * i + 1] = (sph_u32)(A[i] >> 32);
+		INTERLEAVE(kc->u.narrow[2 * i + 0], kc->u.narrow[2 * i + 1]);
+	}
+	for (i = 0; i < 6; i ++) {
+		kc->u.narrow[2 * keccak_lc[i] + 0] =
+			~kc->u.narrow[2 * keccak_lc[i] + 0];
+		kc->u.narrow[2 * keccak_lc[i] + 1] =
+			~kc->u.narrow[2 * keccak_lc[i] + 1];
+	}
+#endif
+	READ_STATE(kc);
+	KECCAK_F_1600;
+	WRITE_STATE(kc);
+#if SPH_KECCAK_64
+	for (i = 0; i < 6; i ++)
+		kc->u.wide[keccak_lc[i]] = ~kc->u.wide[keccak_lc[i]];
+	for (i = 0; i < 25; i ++)
+		A[i] = kc->u.wide[i];
+#else
+	for (i = 0; i < 6; i ++) {
+		kc->u.narrow[2 * keccak_lc[i] + 0] =
+			~kc->u.narrow[2 * keccak_lc[i] + 0];
+		kc->u.narrow[2 * keccak_lc[i] + 1] =
+			~kc->u.narrow[2 * keccak_lc[i] + 1];
+	}
+	for (i = 0; i < 25; i ++) {
+		UNINTERLEAVE(kc->u.narrow[2 * i + 0], kc->u.narrow[2 * i + 1]);
+		A[i] = (sph_u64)kc->u.narrow[2 * i + 0]
+			| ((sph_u64)kc->u.narrow[2 * i + 1] << 32);
+	}
+#endif
+}
+
+#endif
+
 /* see sph_keccak.h */
 void
 sph_keccak224_init(void *cc)
@@ -34,6 +34,7 @@
 #include <string.h>
 
 #include "sph_shavite.h"
+#include "sph_aesni.h"
 
 #if SPH_SMALL_FOOTPRINT && !defined SPH_SMALL_FOOTPRINT_SHAVITE
 #define SPH_SMALL_FOOTPRINT_SHAVITE   1
@@ -1471,6 +1472,112 @@ c512(sph_shavite_big_context *sc, const void *msg)
 
 #endif
 
+#if SPH_AESNI
+
+#include <immintrin.h>
+
+/*
+ * c512() with AES-NI: each group of four state or key words is one
+ * __m128i, AES_ROUND_NOKEY(x) followed by a key XOR is one AESENC, and
+ * the message expansion is done up front as in the small footprint
+ * code above.
+ */
+static __attribute__((target("aes,sse4.1"))) void
+c512_aesni(sph_shavite_big_context *sc, const void *msg)
+{
+	__m128i rk[112];
+	__m128i p0, p1, p2, p3;
+	__m128i zero = _mm_setzero_si128();
+	const __m128i *m = (const __m128i *)msg;
+	__m128i *h = (__m128i *)(void *)sc->h;
+	unsigned u;
+	int r, s;
+
+	for (u = 0; u < 8; u ++)
+		rk[u] = _mm_loadu_si128(m + u);
+	u = 8;
+	for (;;) {
+		for (s = 0; s < 8; s ++) {
+			rk[u] = _mm_xor_si128(_mm_aesenc_si128(
+				_mm_shuffle_epi32(rk[u - 8], 0x39), zero),
+				rk[u - 1]);
+			switch (u) {
+			case 8:
+				rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(
+					(int)SPH_T32(~sc->count3), (int)sc->count2,
+					(int)sc->count1, (int)sc->count0));
+				break;
+			case 41:
+				rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(
+					(int)SPH_T32(~sc->count0), (int)sc->count1,
+					(int)sc->count2, (int)sc->count3));
+				break;
+			case 79:
+				rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(
+					(int)SPH_T32(~sc->count1), (int)sc->count0,
+					(int)sc->count3, (int)sc->count2));
+				break;
+			case 110:
+				rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(
+					(int)SPH_T32(~sc->count2), (int)sc->count3,
+					(int)sc->count0, (int)sc->count1));
+				break;
+			}
+			u ++;
+		}
+		if (u == 112)
+			break;
+		for (s = 0; s < 8; s ++) {
+			rk[u] = _mm_xor_si128(rk[u - 8],
+				_mm_alignr_epi8(rk[u - 1], rk[u - 2], 4));
+			u ++;
+		}
+	}
+
+	p0 = _mm_loadu_si128(h + 0);
+	p1 = _mm_loadu_si128(h + 1);
+	p2 = _mm_loadu_si128(h + 2);
+	p3 = _mm_loadu_si128(h + 3);
+	for (r = 0, u = 0; r < 14; r ++, u += 8) {
+		__m128i x, y, t;
+
+		x = _mm_xor_si128(p1, rk[u + 0]);
+		y = _mm_xor_si128(p3, rk[u + 4]);
+		x = _mm_aesenc_si128(x, rk[u + 1]);
+		y = _mm_aesenc_si128(y, rk[u + 5]);
+		x = _mm_aesenc_si128(x, rk[u + 2]);
+		y = _mm_aesenc_si128(y, rk[u + 6]);
+		x = _mm_aesenc_si128(x, rk[u + 3]);
+		y = _mm_aesenc_si128(y, rk[u + 7]);
+		x = _mm_aesenc_si128(x, zero);
+		y = _mm_aesenc_si128(y, zero);
+		p0 = _mm_xor_si128(p0, x);
+		p2 = _mm_xor_si128(p2, y);
+		t = p3;
+		p3 = p2;
+		p2 = p1;
+		p1 = p0;
+		p0 = t;
+	}
+	_mm_storeu_si128(h + 0, _mm_xor_si128(_mm_loadu_si128(h + 0), p0));
+	_mm_storeu_si128(h + 1, _mm_xor_si128(_mm_loadu_si128(h + 1), p1));
+	_mm_storeu_si128(h + 2, _mm_xor_si128(_mm_loadu_si128(h + 2), p2));
+	_mm_storeu_si128(h + 3, _mm_xor_si128(_mm_loadu_si128(h + 3), p3));
+}
+
+#define C512(sc, msg)   do { \
+		if (sph_aes_impl() >= SPH_AES_NI) \
+			c512_aesni(sc, msg); \
+		else \
+			c512(sc, msg); \
+	} while (0)
+
+#else
+
+#define C512   c512
+
+#endif
+
 static void
 shavite_small_init(sph_shavite_small_context *sc, const sph_u32 *iv)
 {
@@ -1586,7 +1693,7 @@ shavite_big_core(sph_shavite_big_context *sc, const void *data, size_t len)
 					}
 				}
 			}
-			c512(sc, buf);
+			C512(sc, buf);
 			ptr = 0;
 		}
 	}
@@ -1620,7 +1727,7 @@ shavite_big_close(sph_shavite_big_context *sc,
 	} else {
 		buf[ptr ++] = z;
 		memset(buf + ptr, 0, 128 - ptr);
-		c512(sc, buf);
+		C512(sc, buf);
 		memset(buf, 0, 110);
 		sc->count0 = sc->count1 = sc->count2 = sc->count3 = 0;
 	}
@@ -1630,7 +1737,7 @@ shavite_big_close(sph_shavite_big_context *sc,
 	sph_enc32le(buf + 122, count3);
 	buf[126] = out_size_w32 << 5;
 	buf[127] = out_size_w32 >> 3;
-	c512(sc, buf);
+	C512(sc, buf);
 	for (u = 0; u < out_size_w32; u ++)
 		sph_enc32le((unsigned char *)dst + (u << 2), sc->h[u]);
 }
@@ -0,0 +1,66 @@
+/**
+ * Selection of the AES round code used by the AES based functions
+ * (ECHO, Fugue-512, Groestl-512 and SHAvite-3-512).
+ *
+ * Those functions have a portable implementation, which emulates the
+ * AES rounds with lookup tables (aes_helper.c and the Fugue and Groestl
+ * tables), and, on x86 with GCC or Clang, implementations built on the
+ * AES-NI instructions and, for ECHO, on VAES with AVX-512. The fastest
+ * one the CPU supports is picked on first use; all of them compute the
+ * same values and share the context layout.
+ *
+ * @file     sph_aesni.h
+ */
+
+#ifndef SPH_AESNI_H__
+#define SPH_AESNI_H__
+
+#include "sph_types.h"
+
+/*
+ * SPH_AESNI is 1 when the AES-NI code is compiled in. Define
+ * SPH_NO_AESNI to build the table code only.
+ */
+#if !defined SPH_NO_AESNI && defined __GNUC__ \
+	&& (defined __x86_64__ || defined __i386__)
+#define SPH_AESNI   1
+#else
+#define SPH_AESNI   0
+#endif
+
+/**
+ * Lookup table rounds, available everywhere.
+ */
+#define SPH_AES_TABLE   0
+
+/**
+ * AES-NI rounds, one 128-bit block per instruction.
+ */
+#define SPH_AES_NI      1
+
+/**
+ * VAES rounds on 512-bit registers, four blocks per instruction. Only
+ * ECHO has independent blocks enough to use them; the other functions
+ * run their AES-NI code at this level.
+ */
+#define SPH_AES_VAES    2
+
+/**
+ * Get the implementation level in use: the best one the CPU supports,
+ * unless <code>sph_aes_set_impl()</code> lowered it.
+ *
+ * @return  one of the <code>SPH_AES_*</code> levels
+ */
+int sph_aes_impl(void);
+
+/**
+ * Select the implementation level, e.g. to compare them. Levels the
+ * CPU does not support are lowered to the best one it does. This must
+ * not be called while a context is being used by another thread.
+ *
+ * @param impl   the requested <code>SPH_AES_*</code> level
+ * @return  the level now in use
+ */
+int sph_aes_set_impl(int impl);
+
+#endif
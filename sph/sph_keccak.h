@@ -282,4 +282,19 @@ void sph_keccak512_close(void *cc, void *dst);
 void sph_keccak512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 
+#if SPH_64
+
+/**
+ * Apply the Keccak-f[1600] permutation, as run by the contexts above, to
+ * a bare state of 25 lanes. Lane (x, y) is <code>A[x + 5 * y]</code>, and
+ * lanes are read from and written to the sponge bytes in little-endian
+ * order. This is for code which drives the sponge itself, e.g. with a
+ * different padding.
+ *
+ * @param A   the state, updated in place
+ */
+void sph_keccak_f1600(sph_u64 *A);
+
+#endif
+
 #endif
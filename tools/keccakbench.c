@@ -0,0 +1,169 @@
+/*
+ * Benchmark for the Keccak engine (algorithm/keccakf.c) with each
+ * backend the CPU supports.
+ *
+ * Every backend is first checked against the sph Keccak contexts over
+ * messages of 0 to 300 bytes at all four digest sizes, and the SHA-3
+ * padding against the FIPS 202 "abc" vector. Each one is then timed on
+ * 64 byte Keccak-512 messages (the ethash node hash), a full batch of its
+ * lanes per call. Costs are given in TSC cycles per message, or
+ * nanoseconds per message where there is no TSC.
+ *
+ * Build with `make keccakbench`, then run `./keccakbench [seconds-per-run]`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "sph/sph_keccak.h"
+#include "algorithm/keccakf.h"
+
+struct keccak_size {
+  size_t out_len;
+  void (*init)(void *cc);
+  void (*update)(void *cc, const void *data, size_t len);
+  void (*close)(void *cc, void *dst);
+};
+
+static const struct keccak_size sizes[] = {
+  { 28, sph_keccak224_init, sph_keccak224, sph_keccak224_close },
+  { 32, sph_keccak256_init, sph_keccak256, sph_keccak256_close },
+  { 48, sph_keccak384_init, sph_keccak384, sph_keccak384_close },
+  { 64, sph_keccak512_init, sph_keccak512, sph_keccak512_close },
+};
+
+/* SHA3-256("abc") */
+static const uint8_t sha3_abc[32] = {
+  0x3a, 0x98, 0x5d, 0xa7, 0x4f, 0xe2, 0x25, 0xb2, 0x04, 0x5c, 0x17, 0x2d, 0x6b, 0xd3, 0x90, 0xbd,
+  0x85, 0x5f, 0x08, 0x6e, 0x3e, 0x9d, 0x52, 0x5b, 0x46, 0xbf, 0xe2, 0x45, 0x11, 0x43, 0x15, 0x32
+};
+
+static double now(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static uint64_t ticks(void)
+{
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return (uint64_t)(now() * 1e9);
+#endif
+}
+
+/* Compare the backend with the sph contexts, a different message per lane */
+static int check(const keccakf_backend *kb, const uint8_t *msg)
+{
+  uint8_t buf[KECCAKF_MAX_LANES][320], got[KECCAKF_MAX_LANES][64], want[64];
+  uint8_t *out[KECCAKF_MAX_LANES];
+  const uint8_t *in[KECCAKF_MAX_LANES];
+  sph_keccak_context cc;
+  size_t len, i;
+  int l;
+
+  for (l = 0; l < kb->lanes; l++) {
+    memcpy(buf[l], msg + 3 * l, 300);
+    in[l] = buf[l];
+    out[l] = got[l];
+  }
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    const struct keccak_size *s = &sizes[i];
+
+    for (len = 0; len <= 300; len++) {
+      kb->sponge(out, s->out_len, in, len, 200 - 2 * s->out_len, KECCAK_PAD_KECCAK);
+      for (l = 0; l < kb->lanes; l++) {
+        s->init(&cc);
+        s->update(&cc, buf[l], len);
+        s->close(&cc, want);
+        if (memcmp(want, got[l], s->out_len)) {
+          printf("%-7s MISMATCH against sph for Keccak-%u of %u bytes in lane %d\n",
+                 kb->name, (unsigned)(8 * s->out_len), (unsigned)len, l);
+          return 1;
+        }
+      }
+    }
+  }
+
+  for (l = 0; l < kb->lanes; l++)
+    in[l] = (const uint8_t *)"abc";
+  kb->sponge(out, 32, in, 3, 136, KECCAK_PAD_SHA3);
+  for (l = 0; l < kb->lanes; l++)
+    if (memcmp(sha3_abc, got[l], 32)) {
+      printf("%-7s MISMATCH against the SHA3-256 test vector in lane %d\n", kb->name, l);
+      return 1;
+    }
+  return 0;
+}
+
+/* Cost per message of Keccak-512 on 64 byte messages for about `seconds` */
+static double run(const keccakf_backend *kb, double seconds)
+{
+  static uint8_t buf[KECCAKF_MAX_LANES][64];
+  uint8_t *io[KECCAKF_MAX_LANES];
+  uint64_t messages = 0, start_ticks;
+  double start = now();
+  int l;
+
+  for (l = 0; l < kb->lanes; l++)
+    io[l] = buf[l];
+  start_ticks = ticks();
+  do {
+    int i;
+
+    for (i = 0; i < 64; i++)
+      kb->sponge(io, 64, (const uint8_t *const *)io, 64, 72, KECCAK_PAD_KECCAK);
+    messages += 64 * kb->lanes;
+  } while (now() - start < seconds);
+
+  return (double)(ticks() - start_ticks) / messages;
+}
+
+int main(int argc, char **argv)
+{
+  double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+  static uint8_t msg[320];
+  const keccakf_backend *kb;
+  double base = 0;
+  int n, failed = 0;
+  size_t i;
+
+  for (i = 0; i < sizeof(msg); i++)
+    msg[i] = (uint8_t)(i * 131 + 7);
+  printf("%-7s %5s %14s %9s\n", "backend", "lanes",
+#ifdef HAVE_TSC
+         "cycles/msg",
+#else
+         "ns/msg",
+#endif
+         "speedup");
+
+  /* narrowest first, so the scalar code is the baseline */
+  for (n = 0; keccakf_backend_get(n + 1); n++)
+    ;
+  for (; n >= 0; n--) {
+    double cost;
+
+    kb = keccakf_backend_get(n);
+    if (check(kb, msg)) {
+      failed = 1;
+      continue;
+    }
+    cost = run(kb, seconds);
+    if (!base)
+      base = cost;
+    printf("%-7s %5d %14.1f %8.2fx\n", kb->name, kb->lanes, cost, base / cost);
+  }
+
+  return failed;
+}
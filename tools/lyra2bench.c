@@ -0,0 +1,126 @@
+/*
+ * Micro-benchmark for the LYRA2 cores used by the lyra2 family of algorithms.
+ *
+ * Every variant is timed in two modes: allocating and freeing the memory
+ * matrix around each LYRA2 call (what LYRA2() used to do), and reusing a
+ * single workspace (what LYRA2() does now through its per-thread workspace).
+ * Each mode is warmed up, then run RUNS times alternating with the other
+ * mode, and the median rate is reported.
+ *
+ * Build with `make lyra2bench`, then run `./lyra2bench [seconds-per-run]`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "algorithm/lyra2.h"
+
+#define RUNS 5
+
+struct lyra2_variant {
+  const char *name;
+  int v3;
+  uint64_t timeCost, nRows, nCols;
+  int calls;      /* LYRA2 calls per hash */
+};
+
+static const struct lyra2_variant variants[] = {
+  { "lyra2re",        0,  1,  8,  8, 1 },
+  { "allium",         0,  1,  8,  8, 2 },
+  { "phi2",           0,  1,  8,  8, 2 },
+  { "lyra2rev2",      0,  1,  4,  4, 1 },
+  { "lyra2rev3",      1,  1,  4,  4, 2 },
+  { "lyra2z/zz",      0,  8,  8,  8, 1 },
+  { "lyra2h",         0, 16, 16, 16, 1 },
+};
+
+static double now(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void hash_once(const struct lyra2_variant *v, lyra2_workspace_t *ws, int reuse, uint8_t *in, uint8_t *out)
+{
+  int i;
+
+  for (i = 0; i < v->calls; i++) {
+    if (v->v3)
+      LYRA2_3_ws(ws, out, 32, in, 32, in, 32, v->timeCost, v->nRows, v->nCols);
+    else
+      LYRA2_ws(ws, out, 32, in, 32, in, 32, v->timeCost, v->nRows, v->nCols);
+    /* the old LYRA2() freed its matrix before returning */
+    if (!reuse)
+      lyra2_workspace_free(ws);
+    in[0] ^= out[0];
+  }
+}
+
+static double run(const struct lyra2_variant *v, int reuse, double seconds)
+{
+  uint8_t in[32], out[32];
+  lyra2_workspace_t ws;
+  double start, elapsed;
+  uint64_t hashes = 0;
+
+  memset(in, 0x5a, sizeof(in));
+  lyra2_workspace_init(&ws);
+  start = now();
+  do {
+    int i;
+
+    for (i = 0; i < 256; i++)
+      hash_once(v, &ws, reuse, in, out);
+    hashes += 256;
+    elapsed = now() - start;
+  } while (elapsed < seconds);
+  lyra2_workspace_free(&ws);
+
+  return hashes / elapsed;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+  double da = *(const double *)a, db = *(const double *)b;
+
+  return da < db ? -1 : da > db;
+}
+
+static double median(double *rates)
+{
+  qsort(rates, RUNS, sizeof(*rates), cmp_double);
+  return rates[RUNS / 2];
+}
+
+int main(int argc, char **argv)
+{
+  double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+  size_t i;
+
+  if (seconds <= 0)
+    seconds = 1.0;
+
+  printf("%-16s %14s %14s %8s\n", "variant", "alloc (H/s)", "reuse (H/s)", "speedup");
+  for (i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+    double alloc[RUNS], reuse[RUNS], before, after;
+    int r;
+
+    /* warm up caches, the allocator and the CPU clock */
+    run(&variants[i], 0, seconds / 2);
+    run(&variants[i], 1, seconds / 2);
+    for (r = 0; r < RUNS; r++) {
+      alloc[r] = run(&variants[i], 0, seconds);
+      reuse[r] = run(&variants[i], 1, seconds);
+    }
+    before = median(alloc);
+    after = median(reuse);
+
+    printf("%-16s %14.0f %14.0f %7.2fx\n", variants[i].name, before, after, after / before);
+  }
+  return 0;
+}
@@ -0,0 +1,603 @@
+/*
+ * Known-answer test and throughput benchmark for the CPU regenhash of every
+ * algorithm.
+ *
+ * Every entry of the algorithm table is set up with copy_algorithm_settings()
+ * and its regenhash() is run over recorded headers. The results are checked
+ * against the vectors below, which were recorded from the tree, so a change
+ * to the CPU hashing code that alters any hash is caught. After that the
+ * regenhash throughput is measured with 1, 2, 4, ... threads up to the
+ * requested maximum, which is what sizing the verification CPU of a rig
+ * needs. Algorithms with a batched regenhash also have it checked against
+ * the single nonce path, for every multi-buffer backend the CPU runs, and
+ * timed.
+ *
+ * Build with `make regenbench`, then run
+ * `./regenbench [-r] [-t max-threads] [-s seconds] [algorithm...]`.
+ * -r prints the current hashes in the format of the vector table instead of
+ * checking them, -s 0 skips the throughput runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "miner.h"
+#include "algorithm.h"
+#include "bench_block.h"
+#include "algorithm/mb512.h"
+
+#define MAX_BENCH_THREADS 256
+#define BATCH 16
+
+static const unsigned char bench_block[] = { SGMINER_BENCHMARK_BLOCK };
+
+/* Nonces every vector is recorded for, on top of the benchmark block */
+static const uint32_t vector_nonces[2] = { 0x00000000, 0x5a3c96e1 };
+
+/* Hashes recorded from the tree, two per algorithm, in vector_nonces order */
+static const struct {
+  const char *algo;
+  const char *hash[2];
+} vectors[] = {
+  { "ckolivas", {
+      "b0748a00b1388a48234f70339cf0344c80c7a6acc55f980b544263c3920fb50e",
+      "a2494e1a647beef1ad8719badadc44ddf89d8b94931567d2624f83f180b353ab" } },
+  { "alexkarnew", {
+      "b0748a00b1388a48234f70339cf0344c80c7a6acc55f980b544263c3920fb50e",
+      "a2494e1a647beef1ad8719badadc44ddf89d8b94931567d2624f83f180b353ab" } },
+  { "alexkarnold", {
+      "b0748a00b1388a48234f70339cf0344c80c7a6acc55f980b544263c3920fb50e",
+      "a2494e1a647beef1ad8719badadc44ddf89d8b94931567d2624f83f180b353ab" } },
+  { "bufius", {
+      "b0748a00b1388a48234f70339cf0344c80c7a6acc55f980b544263c3920fb50e",
+      "a2494e1a647beef1ad8719badadc44ddf89d8b94931567d2624f83f180b353ab" } },
+  { "psw", {
+      "b0748a00b1388a48234f70339cf0344c80c7a6acc55f980b544263c3920fb50e",
+      "a2494e1a647beef1ad8719badadc44ddf89d8b94931567d2624f83f180b353ab" } },
+  { "zuikkis", {
+      "b0748a00b1388a48234f70339cf0344c80c7a6acc55f980b544263c3920fb50e",
+      "a2494e1a647beef1ad8719badadc44ddf89d8b94931567d2624f83f180b353ab" } },
+  { "arebyp", {
+      "b0748a00b1388a48234f70339cf0344c80c7a6acc55f980b544263c3920fb50e",
+      "a2494e1a647beef1ad8719badadc44ddf89d8b94931567d2624f83f180b353ab" } },
+  { "neoscrypt", {
+      "390a0dc296651e35109d206aabaaa6c0f8c97f85fbe00fd68e3b4412dc9273b3",
+      "ef89e51bf5cbea86d8929012a8d1e9c3846530bfe2531729028329bd44459b7b" } },
+  { "neoscrypt_navi", {
+      "390a0dc296651e35109d206aabaaa6c0f8c97f85fbe00fd68e3b4412dc9273b3",
+      "ef89e51bf5cbea86d8929012a8d1e9c3846530bfe2531729028329bd44459b7b" } },
+  { "neoscrypt-xaya", {
+      "390a0dc296651e35109d206aabaaa6c0f8c97f85fbe00fd68e3b4412dc9273b3",
+      "ef89e51bf5cbea86d8929012a8d1e9c3846530bfe2531729028329bd44459b7b" } },
+  { "neoscrypt-xaya_navi", {
+      "390a0dc296651e35109d206aabaaa6c0f8c97f85fbe00fd68e3b4412dc9273b3",
+      "ef89e51bf5cbea86d8929012a8d1e9c3846530bfe2531729028329bd44459b7b" } },
+  { "pluck", {
+      "4a83a1b767bbc071c66472fd3fdcf2b9a5de2bdb2358f8cefea08e95981332c8",
+      "798965dee1cc1982070090a79c38114c01328001269688f19f77949ab9b92337" } },
+  { "credits", {
+      "19b6da46caf0d471d11bd73d9f711506ae77be0cb7f419c6fc042a934e35ab80",
+      "48be758605cadabf4e1eff1dc5dee460eeb7b08c4eb656a04fb1a247393c9ece" } },
+  { "decred", {
+      "9c04b5a330701bd8d7093ac35703c7c976d81acc15cf63c01f8a09fdf6f5dc40",
+      "cb250141b57e2c865940416bb3e01cc4859254451a5368a7e848b6601ea48787" } },
+  { "yescrypt", {
+      "9f1e73c5d8eae602a0230ae05d0908fe9a1de261cc45cd2dd94341689eedb75e",
+      "573d930eae018da223052c9c76968ea5b3f1d22ea7609f50d8e1c278f2561309" } },
+  { "yescrypt-multi", {
+      "9f1e73c5d8eae602a0230ae05d0908fe9a1de261cc45cd2dd94341689eedb75e",
+      "573d930eae018da223052c9c76968ea5b3f1d22ea7609f50d8e1c278f2561309" } },
+  { "yescrypt_navi", {
+      "9f1e73c5d8eae602a0230ae05d0908fe9a1de261cc45cd2dd94341689eedb75e",
+      "573d930eae018da223052c9c76968ea5b3f1d22ea7609f50d8e1c278f2561309" } },
+  { "yescryptr16", {
+      "5f101b1b908c6669853b7e10a30b628604aa295cd7111e4ba90c9c29455f8095",
+      "b9381765ea1204f73461a72d1d72d9146c9cae892e073040a4dcdce57ae93607" } },
+  { "yescryptr16_navi", {
+      "5f101b1b908c6669853b7e10a30b628604aa295cd7111e4ba90c9c29455f8095",
+      "b9381765ea1204f73461a72d1d72d9146c9cae892e073040a4dcdce57ae93607" } },
+  { "quarkcoin", {
+      "e676161f03334e2de2d4c61109064336158980b174e50564fff0c24c086fe9ea",
+      "e0152a7e905b52f87e02678fb00f87699312da4e9f60f219cb0cdd13115d70c3" } },
+  { "qubitcoin", {
+      "e80e6dadd41a22a0ad134fec6da16a80afed5e8d94a1b8823bfcafabca3f0ad3",
+      "1d2f19275155fe4071f34f6e89c5f15f5b21e881a30a46935d7fbd6c4679fde4" } },
+  { "animecoin", {
+      "5851a4c3146a8b097393d96807f294f8a791e45d6de01db4a3fd99acaaee8305",
+      "a3b717de94fd5a1fb45b98d48696f4a700c7401c6183fa537b7bf52ecf2c3497" } },
+  { "sifcoin", {
+      "0ef462738917a2896b1274161a00f1063b1052c4822a7195b2e03982dabd73f4",
+      "f1515dc54ab7924ab937a5ef2e0f4be0131ba22efacae68f9e9a04752b48a232" } },
+  { "darkcoin", {
+      "4d73ab12d1e236dc9f3aaa7996d82d16be95bfb3564c1b1dbfbcf49767565142",
+      "9e510735bdf6fa4ebe2081a5a9d5c9b6d6c5af9ab3cfae23a8d64889031e18fb" } },
+  { "sibcoin", {
+      "705118132867579ebf3ee546dd9b895db728cd0635dcc6b107e2ce8a190f31df",
+      "dd0eb2e216043f2bd4db6a1518bdc1d220064320c0b014389d5ee1a40960dd24" } },
+  { "inkcoin", {
+      "9b4f9bd7bc974e71b99a9ce4942b84c9a2761e0460281e14369402e403020ddf",
+      "ee75bd9d2fe2c16c43a557e5360984448cddfb9628085086ff189b2a8da4014e" } },
+  { "myriadcoin-groestl", {
+      "f5f95c6ee8d8626603681605ec3fab1bd852b5d269e61eb1ae18d1a2b4697268",
+      "262f93168697d69a062f112230bca6d6ddcbd57cf3f2e7b965cc2ffd7a62658a" } },
+  { "twecoin", {
+      "c024a5a6309822ef795344631b8fbf04dc2872595c149a5b8c4f69b2c0376d61",
+      "a80c2ea2858ed00e87e67ec66473e0eb4aa2e112c81746f3e97a436765e01a09" } },
+  { "maxcoin", {
+      "70927afab064626ec72137194f0f207270f1ffb8d02b3124547b53dacabd1500",
+      "ae3371a9828d2b742605f08f58c79774e131dc6042994efc76a39c0bab9751f6" } },
+  { "darkcoin-mod", {
+      "4d73ab12d1e236dc9f3aaa7996d82d16be95bfb3564c1b1dbfbcf49767565142",
+      "9e510735bdf6fa4ebe2081a5a9d5c9b6d6c5af9ab3cfae23a8d64889031e18fb" } },
+  { "chainox", {
+      "2a1a2e6554b759e98faa57e9bff6e0f7846b5e7ada57f6b4b12215475543b554",
+      "0a7c2e2a34601fcfd2c0c11ce5c8cb46b83bceeaee912585149998e04b5aa5cd" } },
+  { "chainox_navi", {
+      "2a1a2e6554b759e98faa57e9bff6e0f7846b5e7ada57f6b4b12215475543b554",
+      "0a7c2e2a34601fcfd2c0c11ce5c8cb46b83bceeaee912585149998e04b5aa5cd" } },
+  { "sibcoin-mod", {
+      "705118132867579ebf3ee546dd9b895db728cd0635dcc6b107e2ce8a190f31df",
+      "dd0eb2e216043f2bd4db6a1518bdc1d220064320c0b014389d5ee1a40960dd24" } },
+  { "marucoin", {
+      "b9e216c34c9c018f4827cb7d162e25e512d54d6ca5809d1f39ff4f96b4c8df29",
+      "e38655ab7d223e6ee1fd190da92540e1415f601434743b7cbca8b309af90a707" } },
+  { "marucoin-mod", {
+      "b9e216c34c9c018f4827cb7d162e25e512d54d6ca5809d1f39ff4f96b4c8df29",
+      "e38655ab7d223e6ee1fd190da92540e1415f601434743b7cbca8b309af90a707" } },
+  { "marucoin-modold", {
+      "b9e216c34c9c018f4827cb7d162e25e512d54d6ca5809d1f39ff4f96b4c8df29",
+      "e38655ab7d223e6ee1fd190da92540e1415f601434743b7cbca8b309af90a707" } },
+  { "x14", {
+      "de85b7444678de695d25e7189b72f79f5185a2c74a7be2c8c60bef80d95bddba",
+      "7dc942a5aa0e05652ed43f5c56eb3b21487b6c9468d3be8b5482030e9b1d1508" } },
+  { "x14old", {
+      "de85b7444678de695d25e7189b72f79f5185a2c74a7be2c8c60bef80d95bddba",
+      "7dc942a5aa0e05652ed43f5c56eb3b21487b6c9468d3be8b5482030e9b1d1508" } },
+  { "bitblock", {
+      "4fe1054677077197964a545d4a05cfb821f13ea32d3405d563b089d937953a78",
+      "4ae0d43ac529d226697d35f3f43b300bd10dafdcfc4153e310c119cab67dde61" } },
+  { "bitblockold", {
+      "4fe1054677077197964a545d4a05cfb821f13ea32d3405d563b089d937953a78",
+      "4ae0d43ac529d226697d35f3f43b300bd10dafdcfc4153e310c119cab67dde61" } },
+  { "argon2d", {
+      "57f22447ce947e8766a140b03a70e15c64b2337cf884051436e9ace69bda1ab1",
+      "9788bc0f2faa0d78890dd7932f26afc296b165ece3e123f52cbbc50bf0d53259" } },
+  { "x22i", {
+      "8211655aede7b3b378b4f84e4f0e0233aee283eafd9af4fa6e1128cafe687874",
+      "77e9d4e3b29a4fa8fac2fa3f09aae7cf1eadbb2c49d1170e935f620d895c6f24" } },
+  { "x25x", {
+      "8cc62205c5f89edce7bf5983b1bfb61bce7554540c9d445e6e4db7c3aff61de4",
+      "8f664a4f23bb4bbaf25eb201979d407fb67f87d7c4539b9e311280861a752a11" } },
+  { "talkcoin-mod", {
+      "f30ed2cc284487684b6f9a23eaedd7bad1ef4492e76a310846dd2e7ac6f0ea9d",
+      "2435806fd2f1f65855e544b54898de5337ab5ad5aa25e940c48992ceea184553" } },
+  { "phi", {
+      "25dcacff1c5b42a20d81237115d5d627e29efbb04e5d7d1cd966b6304062b7ca",
+      "b2a705166048038bc240762f1762de6c0df4ad3b49f9a9609f90d9c5780a0fca" } },
+  { "phi2", {
+      "aee2b315c68574b1eee2e16e7710e6f785d4d20911f11039a0ef0063aa7ced09",
+      "340d92231879ff6bd3044acfb6fbf25b460184c9be809e76da1adac42ff9b97e" } },
+  { "phi2_navi", {
+      "aee2b315c68574b1eee2e16e7710e6f785d4d20911f11039a0ef0063aa7ced09",
+      "340d92231879ff6bd3044acfb6fbf25b460184c9be809e76da1adac42ff9b97e" } },
+  { "fresh", {
+      "4759cc265dd50819694124c6668423f63613122bf2538e1ee347ea7466a1b60d",
+      "1878bb4ca2dc49af74c7a902b2df3c478a5b76a744ba36bc4b97141df35308d8" } },
+  { "lyra2re", {
+      "42d8c7eff1e0dbc0c0a6822615ce6ac40acece1a14fa81aa2f005e911be6621e",
+      "5ed836efcf161cbc6d7fc93f23193990709a633d83c51291fb5102978ff66ea1" } },
+  { "lyra2rev2", {
+      "17991da7e7ebde6c5169fcfafe4c61e4322842c9bad227c4be6da470c02383a6",
+      "f02e62f09601da0866fd3dc05af635843f92fde5e9a310769aebdaa6fe13f590" } },
+  { "lyra2rev3", {
+      "56bf048dbf5c55d4abddb6653fa59cbbaefc72a1eee9ea207a84519586497d3c",
+      "739e3b2a4ab13fd703a2537e321897cb44a768352c69275fc66581f28a6068fb" } },
+  { "lyra2rev3_navi", {
+      "56bf048dbf5c55d4abddb6653fa59cbbaefc72a1eee9ea207a84519586497d3c",
+      "739e3b2a4ab13fd703a2537e321897cb44a768352c69275fc66581f28a6068fb" } },
+  { "lyra2Z", {
+      "9edd2d50af204f3111de5bb0d8ecf6a9c94395aa57c9484c2f1a468372f2c072",
+      "d04a5e53c6556c0f8b1845524002b9f580270d67d4f4827404fb294918eb723c" } },
+  { "lyra2Z_navi", {
+      "9edd2d50af204f3111de5bb0d8ecf6a9c94395aa57c9484c2f1a468372f2c072",
+      "d04a5e53c6556c0f8b1845524002b9f580270d67d4f4827404fb294918eb723c" } },
+  { "lyra2Zz", {
+      "ac297c52e6a5d98712cbda861df8b9e5914f101abbb0daa82d7616f902af815d",
+      "01a10ebf62d7460d781880de76f92743cdae38d05013f746846c94ba13968f7a" } },
+  { "lyra2h", {
+      "58e26572e125d28d1765ba244008ccc3501551e5c8776476cec2741d9ae8a7f3",
+      "e9e07c5554c47d0597b8ed4d854c44c79f8032c4afa04e8a4ee6b221cc64799d" } },
+  { "allium", {
+      "4ce254efb0517bc2091a6e8eedd7a9deb02db40e67ce4de99b8f1c28a0636146",
+      "8abed821a72a7348e2c365f1598bffeae4697fd460cd807dd57441878a5e533c" } },
+  { "allium_navi", {
+      "4ce254efb0517bc2091a6e8eedd7a9deb02db40e67ce4de99b8f1c28a0636146",
+      "8abed821a72a7348e2c365f1598bffeae4697fd460cd807dd57441878a5e533c" } },
+  { "heavyhash", {
+      "6b55299cf13f839b7ac6a68f70342ab01075ac56092ddb5f01f066ca1d51da8a",
+      "8cf3cd224533b2760a3b7d7416f644101ff03281f152381b0d46ff8fe9f88fa3" } },
+  { "fuguecoin", {
+      "989472535f319dfb9d96e4bad037f7404458ef42fa5c214a42d7437d05c8ae49",
+      "07b973c917a6cd79d2eaa2c6cfc97f941d7959a0f76565d02d34ad7e81841c36" } },
+  { "groestlcoin", {
+      "123eb7f08278d3c4b80758e55e7612e13c4247bdcf15c1e4bb4382eca4df5a28",
+      "0c2576e896bcda0bce1beddf4e046c3f6eab56cf533a4e61b2976b50a3acc2b4" } },
+  { "groestlcoin_navi", {
+      "123eb7f08278d3c4b80758e55e7612e13c4247bdcf15c1e4bb4382eca4df5a28",
+      "0c2576e896bcda0bce1beddf4e046c3f6eab56cf533a4e61b2976b50a3acc2b4" } },
+  { "diamond", {
+      "123eb7f08278d3c4b80758e55e7612e13c4247bdcf15c1e4bb4382eca4df5a28",
+      "0c2576e896bcda0bce1beddf4e046c3f6eab56cf533a4e61b2976b50a3acc2b4" } },
+  { "whirlcoin", {
+      "05d951b1239687634819e133a24dc647aa37a3337f70718daf40f8f6af5b1b86",
+      "7560a4b1800c1b5c4a378fab1b8b9ed1b8adb9819dd203532aa5a5290a9d0b9b" } },
+  { "whirlpoolx", {
+      "784765747c4a92aca1046105c9004a03ca484f739df4afa0b84d9e85eebdac0a",
+      "93917fd01c41fa447ce0bbf788f5a4ad7a481fd6e5540b3133d5b191bae0ad42" } },
+  { "blake256r8", {
+      "39ca25e137e2fe04dcbbcf369fc36be2d7add006ba01e9239858c47c3d4c267c",
+      "7f279ca7cda0df21d87a804feaef7956317974d94bf7f3bdcca6abd6793f3c9b" } },
+  { "blake256r14", {
+      "5ab3661d83fc2a57d348aaa426d5355f7451bbd476872c173ed6619469f2a710",
+      "c58626cb4b3348bbabfa8d3f4318950cb31bea8a7c29e5b096e5c101ad410f8e" } },
+  { "sia", {
+      "604994665c607a808bbca0322600e83490bd282d76954a78b6382f65d5667bb6",
+      "aed1347f645f4ef9b65bb99e6b490cd0ceb7d2cc4a7b3dc5a4c2ae3fa9ffd0b8" } },
+  { "vanilla", {
+      "39ca25e137e2fe04dcbbcf369fc36be2d7add006ba01e9239858c47c3d4c267c",
+      "7f279ca7cda0df21d87a804feaef7956317974d94bf7f3bdcca6abd6793f3c9b" } },
+  { "lbry", {
+      "b6a6b870d85d63eadc684984ec1d978cf1358296b0c0bfe95c5e91c272dfade6",
+      "581438b11c02a72d7d50fa2d2267b7cda8adab08854cc556a1cc2386878e637a" } },
+  { "pascal", {
+      "4daf254c5002733255aca3718919ccf5dd067731e48e7050aca521c60bf6e008",
+      "ea2160fd637081701a07a3982848d0df28f0545422a151d61b0941adc0c83811" } },
+  { NULL, { NULL, NULL } }
+};
+
+/* Algorithms whose regenhash needs state only a live pool provides */
+static const char *skip_reason(const algorithm_t *algo)
+{
+  switch (algo->type) {
+    case ALGO_ETHASH:
+      return "needs the pool's DAG epoch";
+    case ALGO_MTP:
+      return "needs the pool's MTP proof state";
+    default:
+      return NULL;
+  }
+}
+
+static double now(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void init_work(struct work *work, struct pool *pool, uint32_t nonce)
+{
+  memset(work, 0, sizeof(*work));
+  memcpy(work->data, bench_block, sizeof(work->data));
+  ((uint32_t *)work->data)[19] = htole32(nonce);
+  work->pool = pool;
+}
+
+static const char *expected_hash(const char *algo, int n)
+{
+  int i;
+
+  for (i = 0; vectors[i].algo; i++)
+    if (!strcmp(vectors[i].algo, algo))
+      return vectors[i].hash[n];
+  return NULL;
+}
+
+/* Returns 1 on a mismatch, 0 if the hashes match or there is no vector */
+static int check_vectors(struct pool *pool, bool record)
+{
+  const char *algo = pool->algorithm.name;
+  int n, failed = 0;
+
+  if (record)
+    printf("  { \"%s\", {", algo);
+  for (n = 0; n < 2; n++) {
+    struct work work;
+    const char *expected;
+    char *hash;
+
+    init_work(&work, pool, vector_nonces[n]);
+    pool->algorithm.regenhash(&work);
+    hash = bin2hex(work.hash, 32);
+
+    if (record) {
+      printf("%s\n      \"%s\"", n ? "," : "", hash);
+    } else if (!(expected = expected_hash(algo, n))) {
+      if (!n)
+        printf("%-24s no vector\n", algo);
+    } else if (strcmp(hash, expected)) {
+      printf("%-24s MISMATCH for nonce %08x\n  expected %s\n  got      %s\n", algo,
+             vector_nonces[n], expected, hash);
+      failed = 1;
+    } else if (n) {
+      printf("%-24s ok\n", algo);
+    }
+    free(hash);
+  }
+  if (record)
+    printf(" } },\n");
+  return failed;
+}
+
+/* regenhash_batch() must match regenhash() nonce for nonce, including a
+ * count that leaves a short last group of lanes */
+static int check_batch(struct pool *pool)
+{
+  uint32_t nonces[BATCH - 5], hashes[BATCH - 5][8];
+  int i, count = BATCH - 5;
+  struct work work;
+
+  for (i = 0; i < count; i++)
+    nonces[i] = vector_nonces[1] + i * 0x01000193;
+  init_work(&work, pool, 0);
+  pool->algorithm.regenhash_batch(&work, nonces, count, hashes);
+  for (i = 0; i < count; i++) {
+    init_work(&work, pool, nonces[i]);
+    pool->algorithm.regenhash(&work);
+    if (memcmp(work.hash, hashes[i], 32)) {
+      printf("%-24s MISMATCH between batched and single regenhash for nonce %08x\n",
+             pool->algorithm.name, nonces[i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Every multi-buffer backend must give what the plain sph chain gives */
+static int check_mb512(void)
+{
+  uint32_t data[BATCH - 5][20], want[BATCH - 5][16], got[BATCH - 5][16];
+  const mb512_backend *mb;
+  int i, n, failed = 0;
+
+  for (i = 0; i < BATCH - 5; i++) {
+    memcpy(data[i], bench_block, 80);
+    data[i][19] = vector_nonces[1] + i;
+  }
+  mb512_x11(NULL, (const uint32_t (*)[20])data, BATCH - 5, want);
+  for (n = 0; (mb = mb512_backend_get(n)); n++) {
+    mb512_x11(mb, (const uint32_t (*)[20])data, BATCH - 5, got);
+    if (memcmp(want, got, sizeof(want))) {
+      printf("mb512 %-18s MISMATCH against sph\n", mb->name);
+      failed = 1;
+    } else {
+      printf("mb512 %-18s ok, %d lanes\n", mb->name, mb->lanes);
+    }
+  }
+  return failed;
+}
+
+struct bench_thread {
+  pthread_t pth;
+  struct pool *pool;
+  uint32_t id;
+  bool batch;
+  double seconds;
+  uint64_t hashes;
+};
+
+static void *bench_thread(void *arg)
+{
+  struct bench_thread *bt = (struct bench_thread *)arg;
+  double start = now();
+  uint32_t nonce = bt->id << 24;
+  struct work work;
+
+  init_work(&work, bt->pool, nonce);
+  do {
+    uint32_t nonces[BATCH], hashes[BATCH][8];
+    int i;
+
+    if (bt->batch) {
+      for (i = 0; i < BATCH; i++)
+        nonces[i] = nonce++;
+      bt->pool->algorithm.regenhash_batch(&work, nonces, BATCH, hashes);
+    } else {
+      for (i = 0; i < BATCH; i++) {
+        ((uint32_t *)work.data)[19] = htole32(nonce++);
+        bt->pool->algorithm.regenhash(&work);
+      }
+    }
+    bt->hashes += BATCH;
+  } while (now() - start < bt->seconds);
+
+  return NULL;
+}
+
+static double bench_threads(struct pool *pool, int threads, bool batch, double seconds)
+{
+  struct bench_thread bt[MAX_BENCH_THREADS];
+  double start = now(), elapsed;
+  uint64_t hashes = 0;
+  int i;
+
+  for (i = 0; i < threads; i++) {
+    bt[i].pool = pool;
+    bt[i].id = i;
+    bt[i].batch = batch;
+    bt[i].seconds = seconds;
+    bt[i].hashes = 0;
+    if (pthread_create(&bt[i].pth, NULL, bench_thread, &bt[i])) {
+      fprintf(stderr, "Failed to create benchmark thread\n");
+      exit(1);
+    }
+  }
+  for (i = 0; i < threads; i++) {
+    pthread_join(bt[i].pth, NULL);
+    hashes += bt[i].hashes;
+  }
+  elapsed = now() - start;
+
+  return hashes / elapsed;
+}
+
+static bool selected(const char *algo, char **names, int count)
+{
+  int i;
+
+  if (!count)
+    return true;
+  for (i = 0; i < count; i++)
+    if (!strcasecmp(names[i], algo))
+      return true;
+  return false;
+}
+
+int main(int argc, char **argv)
+{
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  int max_threads = ncpu > 0 ? (int)ncpu : 1;
+  double seconds = 1.0;
+  bool record = false;
+  int opt, threads, failed = 0;
+  struct pool *pool;
+  const char *name;
+  unsigned int i;
+
+  while ((opt = getopt(argc, argv, "rt:s:")) != -1) {
+    switch (opt) {
+      case 'r':
+        record = true;
+        break;
+      case 't':
+        max_threads = atoi(optarg);
+        break;
+      case 's':
+        seconds = atof(optarg);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-r] [-t max-threads] [-s seconds] [algorithm...]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (max_threads < 1)
+    max_threads = 1;
+  if (max_threads > MAX_BENCH_THREADS)
+    max_threads = MAX_BENCH_THREADS;
+
+  pool = (struct pool *)calloc(1, sizeof(struct pool));
+  if (!pool) {
+    fprintf(stderr, "Failed to calloc pool\n");
+    return 1;
+  }
+
+  if (!record)
+    failed |= check_mb512();
+
+  for (i = 0; (name = algorithm_name(i)); i++) {
+    const char *reason;
+
+    if (!selected(name, argv + optind, argc - optind))
+      continue;
+
+    memset(&pool->algorithm, 0, sizeof(pool->algorithm));
+    copy_algorithm_settings(&pool->algorithm, name);
+    set_algorithm_nfactor(&pool->algorithm, pool->algorithm.type == ALGO_NSCRYPT ? 11 : 10);
+    if (!pool->algorithm.regenhash)
+      continue;
+    if ((reason = skip_reason(&pool->algorithm))) {
+      if (!record)
+        printf("%-24s skipped, %s\n", name, reason);
+      continue;
+    }
+
+    failed |= check_vectors(pool, record);
+    if (!record && pool->algorithm.regenhash_batch)
+      failed |= check_batch(pool);
+    if (record || seconds <= 0)
+      continue;
+
+    for (threads = 1; ; threads *= 2) {
+      double rate;
+
+      if (threads > max_threads)
+        threads = max_threads;
+      rate = bench_threads(pool, threads, false, seconds);
+      printf("  %3d thread%s %12.1f H/s %12.1f H/s/thread\n", threads, threads > 1 ? "s" : " ",
+             rate, rate / threads);
+      if (threads == max_threads)
+        break;
+    }
+    if (pool->algorithm.regenhash_batch) {
+      double single = bench_threads(pool, 1, false, seconds);
+      double batched = bench_threads(pool, 1, true, seconds);
+
+      printf("  batched, %d nonces %12.1f H/s %11.2fx\n", BATCH, batched, batched / single);
+    }
+  }
+
+  return failed;
+}
+
+/* The parts of sgminer the algorithm code calls into */
+int opt_keccak_unroll;
+bool opt_blake_compact;
+bool opt_luffa_parallel;
+int opt_hamsi_expand_big = 4;
+bool opt_hamsi_short;
+int hw_errors;
+int total_devices;
+bool devices_enabled[MAX_DEVICES];
+
+void applog(int prio, const char *fmt, ...)
+{
+  va_list args;
+
+  if (prio > LOG_WARNING)
+    return;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+void _applog(int prio, const char *str, bool force)
+{
+  if (prio <= LOG_WARNING || force)
+    fprintf(stderr, "%s\n", str);
+}
+
+void _quit(int status)
+{
+  exit(status);
+}
+
+char *bin2hex(const unsigned char *p, size_t len)
+{
+  char *s = (char *)malloc(len * 2 + 1);
+  size_t i;
+
+  if (!s)
+    _quit(1);
+  for (i = 0; i < len; i++)
+    sprintf(s + i * 2, "%02x", p[i]);
+  return s;
+}
+
+void cgsleep_ms(int ms)
+{
+  usleep(ms * 1000);
+}
+
+void RenameThread(const char *name)
+{
+  (void)name;
+}
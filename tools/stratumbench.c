@@ -0,0 +1,209 @@
+/*
+ * Micro-benchmark for the stratum line reader.
+ *
+ * Replays stratum traffic through the old strcat/strtok reader that
+ * recv_line() used to be built on and through the linebuf reader it uses
+ * now. The traffic is fed in segment sized chunks, the way recv() returns
+ * it from a TCP socket.
+ *
+ * Build with `make stratumbench`, then run
+ * `./stratumbench [capture-file] [segment-bytes] [seconds-per-run]`.
+ * The capture is a file of newline separated stratum messages, e.g. the
+ * RECVD lines of a --protocol-dump log. Without one a stream of
+ * mining.notify messages with a long merkle branch is generated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "linebuf.h"
+
+#define RBUFSIZE 8192
+#define RECVSIZE (RBUFSIZE - 4)
+
+static double now(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static char *synth_traffic(size_t *len)
+{
+  size_t cap = 1 << 20, pos = 0;
+  char *buf = (char *)malloc(cap);
+  int msg, i;
+
+  for (msg = 0; msg < 64; msg++) {
+    if (cap - pos < 16384) {
+      cap <<= 1;
+      buf = (char *)realloc(buf, cap);
+    }
+    pos += sprintf(buf + pos, "{\"params\": [\"%x\", \"%064x\", \"", msg, msg);
+    for (i = 0; i < 600; i++)
+      pos += sprintf(buf + pos, "%02x", (msg + i) & 0xff);
+    pos += sprintf(buf + pos, "\", \"");
+    for (i = 0; i < 200; i++)
+      pos += sprintf(buf + pos, "%02x", (msg * i) & 0xff);
+    pos += sprintf(buf + pos, "\", [");
+    for (i = 0; i < 14; i++)
+      pos += sprintf(buf + pos, "%s\"%064x\"", i ? ", " : "", msg * 31 + i);
+    pos += sprintf(buf + pos, "], \"20000000\", \"1a0fffff\", \"5f5e1000\", true], \"id\": null, \"method\": \"mining.notify\"}\n");
+    if (msg % 8 == 0)
+      pos += sprintf(buf + pos, "{\"id\": %d, \"result\": true, \"error\": null}\n", msg);
+  }
+  *len = pos;
+  return buf;
+}
+
+static char *load_capture(const char *path, size_t *len)
+{
+  FILE *f = fopen(path, "rb");
+  char *buf;
+  long size;
+
+  if (!f)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buf = (char *)malloc(size + 1);
+  if (fread(buf, 1, size, f) != (size_t)size) {
+    fclose(f);
+    free(buf);
+    return NULL;
+  }
+  fclose(f);
+  *len = size;
+  return buf;
+}
+
+/* What recv_line() did before: recv into a stack buffer, strcat onto the
+ * pool buffer, strtok out the line, strdup it and memmove the rest down. */
+static uint64_t replay_legacy(const char *traffic, size_t len, size_t seg)
+{
+  size_t sockbuf_size = RBUFSIZE, off = 0;
+  char *sockbuf = (char *)calloc(sockbuf_size, 1);
+  uint64_t bytes = 0;
+
+  while (off < len || strstr(sockbuf, "\n")) {
+    char *tok, *sret;
+    size_t slen, buflen;
+
+    while (!strstr(sockbuf, "\n") && off < len) {
+      char s[RBUFSIZE];
+      size_t n = len - off < seg ? len - off : seg, old, newlen;
+
+      memset(s, 0, RBUFSIZE);
+      memcpy(s, traffic + off, n);
+      off += n;
+      slen = strlen(s);
+      old = strlen(sockbuf);
+      newlen = old + slen + 1;
+      if (newlen >= sockbuf_size) {
+        newlen = newlen + (RBUFSIZE - (newlen % RBUFSIZE));
+        sockbuf = (char *)realloc(sockbuf, newlen);
+        memset(sockbuf + old, 0, newlen - old);
+        sockbuf_size = newlen;
+      }
+      strcat(sockbuf, s);
+    }
+
+    buflen = strlen(sockbuf);
+    if ((tok = strtok(sockbuf, "\n")) == NULL)
+      break;
+    sret = strdup(tok);
+    slen = strlen(sret);
+    if (buflen > slen + 1)
+      memmove(sockbuf, sockbuf + slen + 1, buflen - slen + 1);
+    else
+      strcpy(sockbuf, "");
+    bytes += slen;
+    free(sret);
+  }
+  free(sockbuf);
+  return bytes;
+}
+
+/* The current recv_line(): recv straight into the linebuf, one copy out */
+static uint64_t replay_linebuf(const char *traffic, size_t len, size_t seg)
+{
+  struct linebuf lb;
+  size_t off = 0;
+  uint64_t bytes = 0;
+
+  linebuf_init(&lb, RBUFSIZE);
+  for (;;) {
+    size_t llen;
+    char *line = linebuf_line(&lb, &llen), *sret;
+
+    while (!line && off < len) {
+      size_t n = len - off < seg ? len - off : seg;
+      char *space = linebuf_space(&lb, RECVSIZE);
+
+      memcpy(space, traffic + off, n);
+      off += n;
+      linebuf_commit(&lb, n);
+      line = linebuf_line(&lb, &llen);
+    }
+    if (!line && !(line = linebuf_rest(&lb, &llen)))
+      break;
+    sret = (char *)malloc(llen + 1);
+    memcpy(sret, line, llen);
+    sret[llen] = '\0';
+    bytes += llen;
+    free(sret);
+  }
+  linebuf_free(&lb);
+  return bytes;
+}
+
+static double run(uint64_t (*replay)(const char *, size_t, size_t), const char *traffic, size_t len,
+                  size_t seg, double seconds)
+{
+  double start = now(), elapsed;
+  uint64_t bytes = 0;
+
+  do {
+    bytes += replay(traffic, len, seg);
+    elapsed = now() - start;
+  } while (elapsed < seconds);
+  return bytes / elapsed / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+  size_t len, seg = argc > 2 ? (size_t)atoi(argv[2]) : 1448;
+  double seconds = argc > 3 ? atof(argv[3]) : 1.0;
+  double legacy, current;
+  char *traffic;
+
+  if (argc > 1 && strcmp(argv[1], "-")) {
+    traffic = load_capture(argv[1], &len);
+    if (!traffic) {
+      fprintf(stderr, "Cannot read capture %s\n", argv[1]);
+      return 1;
+    }
+  } else
+    traffic = synth_traffic(&len);
+  if (seg < 1 || seg > RECVSIZE)
+    seg = RECVSIZE;
+  if (seconds <= 0)
+    seconds = 1.0;
+
+  printf("%zu bytes of traffic, %zu byte segments\n", len, seg);
+  if (replay_legacy(traffic, len, seg) != replay_linebuf(traffic, len, seg)) {
+    fprintf(stderr, "Readers disagree on the replayed lines\n");
+    return 1;
+  }
+  legacy = run(replay_legacy, traffic, len, seg, seconds);
+  current = run(replay_linebuf, traffic, len, seg, seconds);
+  printf("%-10s %10.1f MB/s\n", "legacy", legacy);
+  printf("%-10s %10.1f MB/s  %.2fx\n", "linebuf", current, current / legacy);
+  free(traffic);
+  return 0;
+}
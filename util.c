@@ -1441,7 +1441,7 @@ static bool socket_full(struct pool *pool, int wait)
 /* Check to see if Santa's been good to you */
 bool sock_full(struct pool *pool)
 {
-  if (strlen(pool->sockbuf))
+  if (!linebuf_empty(&pool->sockbuf) || pool->sockbuf_bossize)
     return true;
 
   return (socket_full(pool, 0));
@@ -1449,7 +1449,7 @@ bool sock_full(struct pool *pool)
 
 static void clear_sockbuf(struct pool *pool)
 {
-  strcpy(pool->sockbuf, "");
+  linebuf_clear(&pool->sockbuf);
   pool->sockbuf_bossize = 0;
 }
 
@@ -1460,7 +1460,7 @@ static void clear_sock(struct pool *pool)
   mutex_lock(&pool->stratum_lock);
   do {
     if (pool->sock)
-      n = recv(pool->sock, pool->sockbuf, RECVSIZE, 0);
+      n = recv(pool->sock, pool->sockbuf.buf, RECVSIZE, 0);
     else
       n = 0;
   } while (n > 0);
@@ -1469,56 +1469,37 @@ static void clear_sock(struct pool *pool)
   clear_sockbuf(pool);
 }
 
-/* Make sure the pool sockbuf is large enough to cope with any coinbase size
- * by reallocing it to a large enough size rounded up to a multiple of RBUFSIZE
- * and zeroing the new memory */
-static void recalloc_sock(struct pool *pool, size_t len)
-{
-  size_t old, newlen;
-
-  old = strlen(pool->sockbuf);
-  newlen = old + len + 1;
-  if (newlen < pool->sockbuf_size)
-    return;
-  newlen = newlen + (RBUFSIZE - (newlen % RBUFSIZE));
-  // Avoid potentially recursive locking
-  // applog(LOG_DEBUG, "Recallocing pool sockbuf to %d", new);
-  pool->sockbuf = (char *)realloc(pool->sockbuf, newlen);
-  if (!pool->sockbuf)
-    quithere(1, "Failed to realloc pool sockbuf");
-  memset(pool->sockbuf + old, 0, newlen - old);
-  pool->sockbuf_size = newlen;
-}
-
 static void recalloc_sock_bos(struct pool *pool, size_t len)
 {
 	size_t old, newlen;
 
 	old = pool->sockbuf_bossize;
 	newlen = old + len + 1;
-	if (newlen < pool->sockbuf_size)
+	if (newlen < pool->sockbuf.size)
 		return;
 	newlen = newlen + (RBUFSIZE - (newlen % RBUFSIZE));
 	// Avoid potentially recursive locking
 	// applog(LOG_DEBUG, "Recallocing pool sockbuf to %d", new);
 	
-	pool->sockbuf = (char*)realloc(pool->sockbuf, pool->sockbuf_bossize + len);
+	pool->sockbuf.buf = (char*)realloc(pool->sockbuf.buf, pool->sockbuf_bossize + len);
 
-	if (!pool->sockbuf)
+	if (!pool->sockbuf.buf)
 		quithere(1, "Failed to realloc pool sockbuf");
 
-	pool->sockbuf_size = newlen;
+	pool->sockbuf.size = newlen;
 }
 
-/* Peeks at a socket to find the first end of line and then reads just that
- * from the socket and returns that as a malloced char */
+/* Returns the next line received from the pool's socket as a malloced char.
+ * Lines are cut out of the pool's line buffer, so each is copied exactly
+ * once no matter how many recv() calls it took to arrive. */
 char *recv_line(struct pool *pool)
 {
-  char *tok, *sret = NULL;
-  ssize_t len, buflen;
+  char *line, *sret = NULL;
+  size_t len;
   int waited = 0;
 
-  if (!strstr(pool->sockbuf, "\n")) {
+  line = linebuf_line(&pool->sockbuf, &len);
+  if (!line) {
     struct timeval rstart, now;
 
     cgtime(&rstart);
@@ -1528,12 +1509,12 @@ char *recv_line(struct pool *pool)
     }
 
     do {
-      char s[RBUFSIZE];
-      size_t slen;
+      char *space = linebuf_space(&pool->sockbuf, RECVSIZE);
       ssize_t n;
 
-      memset(s, 0, RBUFSIZE);
-      n = recv(pool->sock, s, RECVSIZE, 0);
+      if (unlikely(!space))
+        quithere(1, "Failed to realloc pool sockbuf");
+      n = recv(pool->sock, space, RECVSIZE, 0);
       if (!n) {
         applog(LOG_DEBUG, "Socket closed waiting in recv_line");
         suspend_stratum(pool);
@@ -1548,28 +1529,28 @@ char *recv_line(struct pool *pool)
           break;
         }
       } else {
-        slen = strlen(s);
-        recalloc_sock(pool, slen);
-        strcat(pool->sockbuf, s);
+        linebuf_commit(&pool->sockbuf, n);
+        line = linebuf_line(&pool->sockbuf, &len);
       }
-    } while (waited < DEFAULT_SOCKWAIT && !strstr(pool->sockbuf, "\n"));
-  }
+    } while (!line && waited < DEFAULT_SOCKWAIT);
 
-  buflen = strlen(pool->sockbuf);
+    /* Hand out a trailing partial line as before */
+    if (!line)
+      line = linebuf_rest(&pool->sockbuf, &len);
+  }
 
-  if ((tok = strtok(pool->sockbuf, "\n")) == NULL) {
-    applog(LOG_DEBUG, "Failed to parse a \\n terminated string in recv_line: buffer = %s", pool->sockbuf);
+  if (!line) {
+    applog(LOG_DEBUG, "Failed to parse a \\n terminated string in recv_line");
     goto out;
   }
-  sret = strdup(tok);
-  len = strlen(sret);
-
-  /* Copy what's left in the buffer after the \n, including the
-   * terminating \0 */
-  if (buflen > len + 1)
-    memmove(pool->sockbuf, pool->sockbuf + len + 1, buflen - len + 1);
-  else
-    strcpy(pool->sockbuf, "");
+  sret = (char *)malloc(len + 1);
+  if (unlikely(!sret))
+    quithere(1, "Failed to malloc line in recv_line");
+  memcpy(sret, line, len);
+  sret[len] = '\0';
+  /* recv_line_bos() reads buf from the start, so drop the copied line */
+  if (linebuf_empty(&pool->sockbuf))
+    linebuf_clear(&pool->sockbuf);
 
   pool->sgminer_pool_stats.times_received++;
   pool->sgminer_pool_stats.bytes_received += len;
@@ -1688,7 +1669,7 @@ char *recv_line_bos(struct pool *pool)
 	uint32_t bossize = 0;
 
 	bool istarget = false;
-	if (!strstr(pool->sockbuf, "\n")) {
+	if (!strstr(pool->sockbuf.buf, "\n")) {
 		struct timeval rstart, now;
 	
 		cgtime(&rstart);
@@ -1730,37 +1711,37 @@ char *recv_line_bos(struct pool *pool)
 			else {
 			
 				recalloc_sock_bos(pool, n);
-				memcpy(pool->sockbuf + pool->sockbuf_bossize, s, n);
+				memcpy(pool->sockbuf.buf + pool->sockbuf_bossize, s, n);
 				pool->sockbuf_bossize += n;
 			}
 		
-		} while (waited < DEFAULT_SOCKWAIT && !strstr(pool->sockbuf, "\n"));
+		} while (waited < DEFAULT_SOCKWAIT && !strstr(pool->sockbuf.buf, "\n"));
 	}
 
 
 	len = pool->sockbuf_bossize;
 
 		json_error_t boserror;
-		if (bos_sizeof(pool->sockbuf) < pool->sockbuf_bossize) {
+		if (bos_sizeof(pool->sockbuf.buf) < pool->sockbuf_bossize) {
 			//				MyObject2 = bos_deserialize(s + bos_sizeof(s), boserror);
-			MyObject2 = bos_deserialize(pool->sockbuf, &boserror);
+			MyObject2 = bos_deserialize(pool->sockbuf.buf, &boserror);
 		}
-		else if (bos_sizeof(pool->sockbuf) > pool->sockbuf_bossize)
+		else if (bos_sizeof(pool->sockbuf.buf) > pool->sockbuf_bossize)
 			applog(LOG_ERR, "missing something in message \n");
 		else
-			MyObject2 = bos_deserialize(pool->sockbuf, &boserror);
+			MyObject2 = bos_deserialize(pool->sockbuf.buf, &boserror);
 		  MyObject = recode_message(MyObject2);
       //if (MyObject2) json_decref(MyObject2);
 
-	if (bos_sizeof(pool->sockbuf)<pool->sockbuf_bossize) {
+	if (bos_sizeof(pool->sockbuf.buf)<pool->sockbuf_bossize) {
 		uint32_t totsize = pool->sockbuf_bossize;
-		uint32_t remsize = pool->sockbuf_bossize - bos_sizeof(pool->sockbuf);
-		uint32_t currsize = bos_sizeof(pool->sockbuf);
-		memmove(pool->sockbuf, pool->sockbuf + currsize, remsize);
+		uint32_t remsize = pool->sockbuf_bossize - bos_sizeof(pool->sockbuf.buf);
+		uint32_t currsize = bos_sizeof(pool->sockbuf.buf);
+		memmove(pool->sockbuf.buf, pool->sockbuf.buf + currsize, remsize);
 		pool->sockbuf_bossize = remsize;
 	}
 	else {
-		pool->sockbuf[0] = '\0';
+		pool->sockbuf.buf[0] = '\0';
 		pool->sockbuf_bossize = 0;
 	}
 
@@ -1960,6 +1941,7 @@ static bool parse_notify(struct pool *pool, json_t *val)
   memcpy(pool->coinbase + cb1_len, pool->nonce1bin, pool->n1_len);
   // NOTE: gap for nonce2, filled at work generation time
   memcpy(pool->coinbase + cb1_len + pool->n1_len + pool->n2size, cb2, cb2_len);
+  coinbase_midstate(pool);
   cg_wunlock(&pool->data_lock);
 
   if (opt_protocol) {
@@ -3076,11 +3058,9 @@ retry:
     }
   }
 
-  if (!pool->sockbuf) {
-    pool->sockbuf = (char *)calloc(RBUFSIZE, 1);
-    if (!pool->sockbuf)
+  if (!pool->sockbuf.buf) {
+    if (!linebuf_init(&pool->sockbuf, RBUFSIZE))
       quithere(1, "Failed to calloc pool sockbuf");
-    pool->sockbuf_size = RBUFSIZE;
   }
 
   pool->sock = sockd;